@@ -407,4 +407,351 @@ acp_vulkan::image_data acp_vulkan::upload_image(renderer_context* context, image
 #endif
 
 	return new_image;
-}
\ No newline at end of file
+}
+
+// Every entry starts on this alignment in the staging buffer.
+#define UPLOAD_BATCH_ALIGNMENT 16
+
+void acp_vulkan::upload_data_batch(renderer_context* context, const upload_batch_entry* entries, size_t entry_count, buffer_data* out)
+{
+	size_t total_size = 0;
+	for (size_t ii = 0; ii < entry_count; ++ii)
+		total_size = ((total_size + UPLOAD_BATCH_ALIGNMENT - 1) & ~size_t(UPLOAD_BATCH_ALIGNMENT - 1)) + entries[ii].data_size;
+
+	for (size_t ii = 0; ii < entry_count; ++ii)
+		out[ii] = {};
+
+	if (total_size == 0)
+		return;
+
+	buffer_data staging_buffer{};
+	{
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = total_size;
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		VmaAllocationCreateInfo vmaalloc_info = {};
+		vmaalloc_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+		ACP_VK_CHECK(vmaCreateBuffer(context->gpu_allocator, &buffer_info, &vmaalloc_info,
+			&staging_buffer.buffer,
+			&staging_buffer.allocation,
+			nullptr), context);
+	}
+
+	{
+		void* stageing_data = nullptr;
+		vmaMapMemory(context->gpu_allocator, staging_buffer.allocation, &stageing_data);
+		size_t offset = 0;
+		for (size_t ii = 0; ii < entry_count; ++ii)
+		{
+			offset = (offset + UPLOAD_BATCH_ALIGNMENT - 1) & ~size_t(UPLOAD_BATCH_ALIGNMENT - 1);
+			memcpy(reinterpret_cast<uint8_t*>(stageing_data) + offset, entries[ii].data, entries[ii].data_size);
+			offset += entries[ii].data_size;
+		}
+		vmaUnmapMemory(context->gpu_allocator, staging_buffer.allocation);
+	}
+
+	for (size_t ii = 0; ii < entry_count; ++ii)
+	{
+		if (!entries[ii].data_size)
+			continue;
+
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = entries[ii].data_size;
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | entries[ii].usage;
+
+		VmaAllocationCreateInfo vmaalloc_info = {};
+		vmaalloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		ACP_VK_CHECK(vmaCreateBuffer(context->gpu_allocator, &buffer_info, &vmaalloc_info,
+			&out[ii].buffer,
+			&out[ii].allocation,
+			nullptr), context);
+
+#ifdef ENABLE_VULKAN_DEBUG_MARKERS
+		acp_vulkan::debug_set_object_name(context->logical_device, out[ii].buffer, VK_OBJECT_TYPE_BUFFER, entries[ii].name);
+#endif
+	}
+
+	immediate_submit(context, [&staging_buffer, entries, entry_count, out](VkCommandBuffer cmd) {
+		size_t offset = 0;
+		for (size_t ii = 0; ii < entry_count; ++ii)
+		{
+			offset = (offset + UPLOAD_BATCH_ALIGNMENT - 1) & ~size_t(UPLOAD_BATCH_ALIGNMENT - 1);
+			if (out[ii].buffer != VK_NULL_HANDLE)
+			{
+				VkBufferCopy copy{};
+				copy.srcOffset = offset;
+				copy.dstOffset = 0;
+				copy.size = entries[ii].data_size;
+				vkCmdCopyBuffer(cmd, staging_buffer.buffer, out[ii].buffer, 1, &copy);
+			}
+			offset += entries[ii].data_size;
+		}
+		}
+	);
+
+	vmaDestroyBuffer(context->gpu_allocator, staging_buffer.buffer, staging_buffer.allocation);
+}
+
+acp_vulkan::mesh_buffers_data acp_vulkan::upload_mesh_buffers(renderer_context* context, const gltf_mesh_buffers& mesh_buffers, const char* name)
+{
+	upload_batch_entry entries[] = {
+		{
+			.data = mesh_buffers.vertices.data,
+			.data_size = mesh_buffers.vertices.data_length,
+			.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			.name = name,
+		},
+		{
+			.data = mesh_buffers.indices.data,
+			.data_size = mesh_buffers.indices.data_length * sizeof(uint32_t),
+			.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			.name = name,
+		},
+	};
+
+	buffer_data buffers[2]{};
+	upload_data_batch(context, entries, 2, buffers);
+	return { .vertices = buffers[0], .indices = buffers[1] };
+}
+
+bool acp_vulkan::mesh_device_vertex_attributes(renderer_context* context, gltf_vertex_attribute* attributes, uint32_t attribute_count)
+{
+	bool supported = true;
+	for (uint32_t ii = 0; ii < attribute_count; ++ii)
+	{
+		VkFormatProperties properties{};
+		vkGetPhysicalDeviceFormatProperties(context->physical_device, attributes[ii].format, &properties);
+		if (properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)
+			continue;
+
+		// Vertex fetch of A2B10G10R10_SNORM_PACK32 is optional, R16G16_SNORM and R16G16B16A16_SNORM are required to support it.
+		if (attributes[ii].format == VK_FORMAT_A2B10G10R10_SNORM_PACK32 && attributes[ii].attribute == gltf_data::attribute::NORMAL)
+			attributes[ii].format = VK_FORMAT_R16G16_SNORM;
+		else if (attributes[ii].format == VK_FORMAT_A2B10G10R10_SNORM_PACK32 && attributes[ii].attribute == gltf_data::attribute::TANGENT)
+			attributes[ii].format = VK_FORMAT_R16G16B16A16_SNORM;
+		else
+			supported = false;
+	}
+	return supported;
+}
+
+acp_vulkan::input_attribute_data acp_vulkan::mesh_input_attributes(const gltf_mesh_buffers& mesh_buffers, uint32_t binding, const uint32_t* locations)
+{
+	input_attribute_data input{ .binding = binding, .stride = mesh_buffers.vertex_stride, .input_rate = VK_VERTEX_INPUT_RATE_VERTEX };
+	for (size_t ii = 0; ii < mesh_buffers.attributes.data_length; ++ii)
+	{
+		input.offsets.push_back(mesh_buffers.attribute_offsets.data[ii]);
+		input.locations.push_back(locations[ii]);
+		input.formats.push_back(mesh_buffers.attributes.data[ii].format);
+	}
+	return input;
+}
+
+acp_vulkan::input_attribute_data acp_vulkan::mesh_stream_input_attributes(const gltf_mesh_buffers& mesh_buffers, uint32_t attribute_index, uint32_t binding, uint32_t location)
+{
+	const gltf_vertex_attribute& attribute = mesh_buffers.attributes.data[attribute_index];
+	return {
+		.binding = binding,
+		.offsets = { 0 },
+		.locations = { location },
+		.stride = gltf_vertex_attribute_size(attribute),
+		.input_rate = VK_VERTEX_INPUT_RATE_VERTEX,
+		.formats = { attribute.format },
+	};
+}
+
+acp_vulkan::meshlet_buffers_data acp_vulkan::upload_meshlet_buffers(renderer_context* context, const gltf_meshlet_buffers& meshlet_buffers, const char* name)
+{
+	upload_batch_entry entries[] = {
+		{
+			.data = meshlet_buffers.meshlets.data,
+			.data_size = meshlet_buffers.meshlets.data_length * sizeof(gltf_meshlet),
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			.name = name,
+		},
+		{
+			.data = meshlet_buffers.vertices.data,
+			.data_size = meshlet_buffers.vertices.data_length * sizeof(uint32_t),
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			.name = name,
+		},
+		{
+			.data = meshlet_buffers.triangles.data,
+			.data_size = meshlet_buffers.triangles.data_length * sizeof(uint32_t),
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			.name = name,
+		},
+	};
+
+	buffer_data buffers[3]{};
+	upload_data_batch(context, entries, 3, buffers);
+	return { .meshlets = buffers[0], .vertices = buffers[1], .triangles = buffers[2] };
+}
+
+// Matches the push constants of gltf_skinning.comp, offsets in 32 bit words.
+struct skinning_constants
+{
+	uint32_t first_vertex;
+	uint32_t vertex_count;
+	uint32_t joint_count;
+	uint32_t stride;
+	uint32_t position;
+	uint32_t normal;
+	uint32_t tangent;
+	uint32_t joints;
+	uint32_t weights;
+};
+#define SKINNING_GROUP_SIZE 64
+
+acp_vulkan::skinning_pipeline_data acp_vulkan::skinning_pipeline_create(renderer_context* context, const shader* skinning_shader, uint32_t max_instances, const char* name)
+{
+	skinning_pipeline_data out{};
+	out.program = compute_program_init(context->logical_device, context->host_allocator, skinning_shader, sizeof(skinning_constants), false, name);
+	if (!out.program)
+		return out;
+	// Three storage buffers per instance.
+	out.descriptor_pool = descriptor_pool_create(context, max_instances * 3, name);
+	return out;
+}
+
+void acp_vulkan::skinning_pipeline_destroy(renderer_context* context, skinning_pipeline_data& pipeline)
+{
+	descriptor_pool_destroy(context, pipeline.descriptor_pool);
+	if (pipeline.program)
+		program_destroy(context->logical_device, context->host_allocator, pipeline.program);
+	pipeline = {};
+}
+
+acp_vulkan::skinning_instance_data acp_vulkan::skinning_instance_create(renderer_context* context, const skinning_pipeline_data& pipeline, const mesh_buffers_data& mesh_buffers_data,
+	const gltf_mesh_buffers& mesh_buffers, uint32_t mesh, uint32_t joint_count, const char* name)
+{
+	skinning_instance_data out{ .mesh = mesh, .joint_count = joint_count };
+	gltf_skinning_layout layout;
+	if (!gltf_skinning_layout_for(&mesh_buffers, &layout) || mesh >= mesh_buffers.meshes.data_length || !joint_count ||
+		!pipeline.program || pipeline.program->descriptor_layouts.empty())
+		return out;
+	const gltf_mesh_buffers::mesh_data& mesh_data = mesh_buffers.meshes.data[mesh];
+	if (!mesh_data.vertex_count)
+		return out;
+
+	{
+		VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		buffer_info.size = size_t(joint_count) * 12 * sizeof(float);
+		buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+		VmaAllocationCreateInfo vmaalloc_info = {};
+		vmaalloc_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+		vmaalloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo allocation_info{};
+		ACP_VK_CHECK(vmaCreateBuffer(context->gpu_allocator, &buffer_info, &vmaalloc_info,
+			&out.palette.buffer,
+			&out.palette.allocation,
+			&allocation_info), context);
+		out.palette_mapped = allocation_info.pMappedData;
+	}
+	{
+		VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		buffer_info.size = size_t(mesh_data.vertex_count) * layout.stride;
+		buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+		VmaAllocationCreateInfo vmaalloc_info = {};
+		vmaalloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		ACP_VK_CHECK(vmaCreateBuffer(context->gpu_allocator, &buffer_info, &vmaalloc_info,
+			&out.vertices.buffer,
+			&out.vertices.allocation,
+			nullptr), context);
+	}
+
+#ifdef ENABLE_VULKAN_DEBUG_MARKERS
+	acp_vulkan::debug_set_object_name(context->logical_device, out.palette.buffer, VK_OBJECT_TYPE_BUFFER, name);
+	acp_vulkan::debug_set_object_name(context->logical_device, out.vertices.buffer, VK_OBJECT_TYPE_BUFFER, name);
+#endif
+
+	VkDescriptorSetLayout descriptor_layout = pipeline.program->descriptor_layouts[0].first;
+	VkDescriptorSetAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	allocate_info.descriptorPool = pipeline.descriptor_pool;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &descriptor_layout;
+	ACP_VK_CHECK(vkAllocateDescriptorSets(context->logical_device, &allocate_info, &out.descriptor_set), context);
+
+	VkDescriptorBufferInfo buffer_infos[3]{
+		{ mesh_buffers_data.vertices.buffer, 0, VK_WHOLE_SIZE },
+		{ out.palette.buffer, 0, VK_WHOLE_SIZE },
+		{ out.vertices.buffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[3]{};
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		writes[ii].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[ii].dstSet = out.descriptor_set;
+		writes[ii].dstBinding = ii;
+		writes[ii].descriptorCount = 1;
+		writes[ii].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[ii].pBufferInfo = &buffer_infos[ii];
+	}
+	vkUpdateDescriptorSets(context->logical_device, 3, writes, 0, nullptr);
+	return out;
+}
+
+void acp_vulkan::skinning_instance_update(skinning_instance_data& instance, const gltf_skin_palette& palette)
+{
+	uint32_t joint_count = palette.joint_count < instance.joint_count ? palette.joint_count : instance.joint_count;
+	if (instance.palette_mapped)
+		memcpy(instance.palette_mapped, palette.matrices.data, size_t(joint_count) * 12 * sizeof(float));
+}
+
+void acp_vulkan::skinning_instance_dispatch(VkCommandBuffer command_buffer, const skinning_pipeline_data& pipeline, const skinning_instance_data& instance,
+	const gltf_mesh_buffers& mesh_buffers)
+{
+	gltf_skinning_layout layout;
+	if (instance.descriptor_set == VK_NULL_HANDLE || !gltf_skinning_layout_for(&mesh_buffers, &layout))
+		return;
+
+	const gltf_mesh_buffers::mesh_data& mesh_data = mesh_buffers.meshes.data[instance.mesh];
+	auto word = [](uint32_t offset) { return offset == UINT32_MAX ? UINT32_MAX : offset / uint32_t(sizeof(uint32_t)); };
+	skinning_constants constants{
+		.first_vertex = mesh_data.first_vertex,
+		.vertex_count = mesh_data.vertex_count,
+		.joint_count = instance.joint_count,
+		.stride = word(layout.stride),
+		.position = word(layout.position),
+		.normal = word(layout.normal),
+		.tangent = word(layout.tangent),
+		.joints = word(layout.joints),
+		.weights = word(layout.weights),
+	};
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.program->pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.program->pipeline_layout, 0, 1, &instance.descriptor_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, pipeline.program->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(command_buffer, (mesh_data.vertex_count + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, 1, 1);
+
+	VkBufferMemoryBarrier2 barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2 };
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = instance.vertices.buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	push_pipeline_barrier(command_buffer, 0, 1, &barrier, 0, nullptr);
+}
+
+void acp_vulkan::skinning_instance_destroy(renderer_context* context, skinning_instance_data& instance)
+{
+	// The descriptor set goes back with the descriptor pool of the pipeline.
+	if (instance.palette.buffer != VK_NULL_HANDLE)
+		vmaDestroyBuffer(context->gpu_allocator, instance.palette.buffer, instance.palette.allocation);
+	if (instance.vertices.buffer != VK_NULL_HANDLE)
+		vmaDestroyBuffer(context->gpu_allocator, instance.vertices.buffer, instance.vertices.allocation);
+	instance = {};
+}
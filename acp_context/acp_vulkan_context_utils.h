@@ -3,6 +3,8 @@
 #include <vulkan/vulkan.h>
 #include <vma/vk_mem_alloc.h>
 #include <acp_dds_vulkan.h>
+#include <acp_gltf_vulkan.h>
+#include <acp_program_vulkan.h>
 #include <functional>
 
 #define ACP_VK_CHECK(x, c)										\
@@ -61,4 +63,68 @@ namespace acp_vulkan
 	};
 	buffer_data upload_data(renderer_context* context, void* verts, uint32_t num_vertices, uint32_t one_vertex_size, VkBufferUsageFlagBits usage, const char* name);
 	image_data upload_image(renderer_context* context, image_mip_data* image_mip_data, const VkImageCreateInfo& image_info, const char* name);
+
+	struct upload_batch_entry
+	{
+		const void* data;
+		size_t data_size;
+		VkBufferUsageFlags usage;
+		const char* name;
+	};
+	// Creates one gpu buffer per entry and fills all of them from a single staging buffer with one immediate_submit, empty entries get no buffer.
+	void upload_data_batch(renderer_context* context, const upload_batch_entry* entries, size_t entry_count, buffer_data* out);
+
+	struct mesh_buffers_data
+	{
+		buffer_data vertices;
+		buffer_data indices;
+	};
+	// Uploads the vertex and index buffers packed by gltf_mesh_buffers_build in one staged transfer, both are also usable as storage buffers.
+	mesh_buffers_data upload_mesh_buffers(renderer_context* context, const gltf_mesh_buffers& mesh_buffers, const char* name);
+	// Swaps the formats the device cannot read from a vertex buffer for ones it can before gltf_mesh_buffers_build: A2B10G10R10_SNORM_PACK32 normals
+	// become octahedral R16G16_SNORM and tangents R16G16B16A16_SNORM. Returns false when another format is not supported.
+	bool mesh_device_vertex_attributes(renderer_context* context, gltf_vertex_attribute* attributes, uint32_t attribute_count);
+	// Vertex input of an interleaved gltf_mesh_buffers with the formats it was built with, quantized ones included, one location per requested attribute.
+	input_attribute_data mesh_input_attributes(const gltf_mesh_buffers& mesh_buffers, uint32_t binding, const uint32_t* locations);
+	// Vertex input of one attribute stream of a gltf_mesh_buffers built with gltf_mesh_deinterleaved, bind vertices at attribute_offsets[attribute_index].
+	input_attribute_data mesh_stream_input_attributes(const gltf_mesh_buffers& mesh_buffers, uint32_t attribute_index, uint32_t binding, uint32_t location);
+
+	struct meshlet_buffers_data
+	{
+		buffer_data meshlets;
+		buffer_data vertices;
+		buffer_data triangles;
+	};
+	// Uploads the storage buffers built by gltf_meshlet_buffers_build for task and mesh shaders in one staged transfer.
+	meshlet_buffers_data upload_meshlet_buffers(renderer_context* context, const gltf_meshlet_buffers& meshlet_buffers, const char* name);
+
+	// Compute skinning, the gpu counterpart of gltf_skin_vertices writing the same vertices. skinning_shader is acp_context/shaders/gltf_skinning.comp built to SPIR-V.
+	struct skinning_pipeline_data
+	{
+		program* program{ nullptr };
+		VkDescriptorPool descriptor_pool{ VK_NULL_HANDLE };
+	};
+	skinning_pipeline_data skinning_pipeline_create(renderer_context* context, const shader* skinning_shader, uint32_t max_instances, const char* name);
+	void skinning_pipeline_destroy(renderer_context* context, skinning_pipeline_data& pipeline);
+
+	struct skinning_instance_data
+	{
+		// joint_count joint matrices, host visible and mapped.
+		buffer_data palette;
+		void* palette_mapped{ nullptr };
+		// The vertices of the mesh (mesh_data first_vertex and vertex_count) once skinned, usable as a vertex buffer.
+		buffer_data vertices;
+		VkDescriptorSet descriptor_set{ VK_NULL_HANDLE };
+		uint32_t mesh{ 0 };
+		uint32_t joint_count{ 0 };
+	};
+	// The vertices have to be skinnable (gltf_skinning_layout_for), returns an instance without descriptor_set otherwise.
+	skinning_instance_data skinning_instance_create(renderer_context* context, const skinning_pipeline_data& pipeline, const mesh_buffers_data& mesh_buffers_data,
+		const gltf_mesh_buffers& mesh_buffers, uint32_t mesh, uint32_t joint_count, const char* name);
+	// Copies the joint matrices of palette, the dispatch reading the previous ones has to be finished.
+	void skinning_instance_update(skinning_instance_data& instance, const gltf_skin_palette& palette);
+	// Records the dispatch and a barrier that makes the skinned vertices visible to vertex input.
+	void skinning_instance_dispatch(VkCommandBuffer command_buffer, const skinning_pipeline_data& pipeline, const skinning_instance_data& instance,
+		const gltf_mesh_buffers& mesh_buffers);
+	void skinning_instance_destroy(renderer_context* context, skinning_instance_data& instance);
 };
\ No newline at end of file
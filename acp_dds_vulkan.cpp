@@ -4,6 +4,16 @@
 #include <stdio.h>
 #include <malloc.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ACP_DDS_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define ACP_DDS_MMAP 0
+#endif
+
 // header dwFlags
 typedef enum DDSD_FLAGS {
 	DDSD_CAPS = 0x1,
@@ -1087,8 +1097,65 @@ acp_vulkan::dds_data acp_vulkan::dds_data_from_memory(void* data, size_t data_si
 	return out;
 }
 
+// Maps the whole file read only, the mips then point straight in to the page cache instead of a heap copy.
+static unsigned char* map_dds_file(const char* path, size_t* out_size)
+{
+#if ACP_DDS_MMAP
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return nullptr;
+
+	struct stat file_stat {};
+	if (fstat(file, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size <= 0)
+	{
+		close(file);
+		return nullptr;
+	}
+
+	size_t file_size = size_t(file_stat.st_size);
+	void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	// Every mip is usually uploaded right after the load, front to back.
+	madvise(mapping, file_size, MADV_SEQUENTIAL);
+	madvise(mapping, file_size, MADV_WILLNEED);
+	*out_size = file_size;
+	return reinterpret_cast<unsigned char*>(mapping);
+#else
+	(void)path;
+	(void)out_size;
+	return nullptr;
+#endif
+}
+
+static void unmap_dds_file(void* data, size_t data_size)
+{
+#if ACP_DDS_MMAP
+	munmap(data, data_size);
+#else
+	(void)data;
+	(void)data_size;
+#endif
+}
+
 acp_vulkan::dds_data acp_vulkan::dds_data_from_file(const char* path, VkAllocationCallbacks* host_allocator)
 {
+	size_t mapped_size = 0;
+	if (unsigned char* mapped = map_dds_file(path, &mapped_size))
+	{
+		acp_vulkan::dds_data out = dds_data_from_memory(mapped, mapped_size, false, nullptr);
+		if (!out.dss_buffer_data)
+		{
+			unmap_dds_file(mapped, mapped_size);
+			return {};
+		}
+		out.full_data = mapped; // The mapping is released on dds_data_free.
+		out.mapped_size = mapped_size;
+		return out;
+	}
+
 	FILE* dds_bytes = fopen(path, "rb");
 	if (!dds_bytes)
 		return {};
@@ -1097,7 +1164,7 @@ acp_vulkan::dds_data acp_vulkan::dds_data_from_file(const char* path, VkAllocati
 	long dds_size = ftell(dds_bytes);
 	fseek(dds_bytes, 0, SEEK_SET);
 
-	unsigned char* dds_data = host_allocator ? 
+	unsigned char* dds_data = dds_size <= 0 ? nullptr : host_allocator ? 
 		reinterpret_cast<unsigned char*>(host_allocator->pfnAllocation(host_allocator->pUserData, dds_size, 1, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)) 
 		: new unsigned char[dds_size];
 
@@ -1117,7 +1184,8 @@ acp_vulkan::dds_data acp_vulkan::dds_data_from_file(const char* path, VkAllocati
 
 	fclose(dds_bytes);
 
-	if (dds_size < offset)
+	acp_vulkan::dds_data out = offset == size_t(dds_size) ? dds_data_from_memory(dds_data, dds_size, false, nullptr) : acp_vulkan::dds_data{};
+	if (!out.dss_buffer_data)
 	{
 		if (host_allocator)
 			host_allocator->pfnFree(host_allocator->pUserData, dds_data);
@@ -1127,20 +1195,24 @@ acp_vulkan::dds_data acp_vulkan::dds_data_from_file(const char* path, VkAllocati
 		return {};
 	}
 
-	acp_vulkan::dds_data out = dds_data_from_memory(dds_data, dds_size, false, nullptr);
 	out.full_data = dds_data; // The dds_data will own the memory and it will be removed on dds_data_free.
 	return out;
 }
 
 void acp_vulkan::dds_data_free(dds_data* dds_data, VkAllocationCallbacks* host_allocator)
 {
-	if (host_allocator)
-	{
-		host_allocator->pfnFree(host_allocator->pUserData, dds_data);
+	if (!dds_data->full_data)
 		return;
-	}
-	if (dds_data->full_data)
-		delete[] dds_data->full_data;
+
+	if (dds_data->mapped_size)
+		unmap_dds_file(dds_data->full_data, dds_data->mapped_size);
+	else if (host_allocator)
+		host_allocator->pfnFree(host_allocator->pUserData, dds_data->full_data);
+	else
+		delete[] reinterpret_cast<unsigned char*>(dds_data->full_data);
+
+	dds_data->full_data = nullptr;
+	dds_data->mapped_size = 0;
 }
 
 VkImageViewCreateInfo acp_vulkan::dds_data_create_view_info(const dds_data* dds_data, VkImage image)
@@ -20,6 +20,8 @@ namespace acp_vulkan
 		size_t num_mips{ 0 };
 		unsigned char* dss_buffer_data{ nullptr };
 		void* full_data{ nullptr };
+		// Non zero when full_data is a read only mapping of the file, dds_data_free unmaps it.
+		size_t mapped_size{ 0 };
 	};
 
 	dds_data dds_data_from_memory(void* data, size_t data_size, bool will_own_data, VkAllocationCallbacks* host_allocator);
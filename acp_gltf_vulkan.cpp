@@ -5,7 +5,39 @@
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include <float.h>
 #include <map>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ACP_GLTF_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ACP_GLTF_TARGET_AVX2
+#define ACP_GLTF_TARGET_SSSE3
+#else
+#define ACP_GLTF_TARGET_AVX2 __attribute__((target("avx2")))
+#define ACP_GLTF_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#else
+#define ACP_GLTF_X86 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ACP_GLTF_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define ACP_GLTF_MMAP 0
+#endif
 
 template<typename A, typename B>
 using pair = acp_vulkan::gltf_data::pair<A,B>;
@@ -55,16 +87,19 @@ struct temp_data_view
 		data = other.data;
 		data_capacity = other.data_capacity;
 		data_length = other.data_length;
+		host_allocator = other.host_allocator;
 
 		other.data = nullptr;
 		other.data_capacity = 0;
 		other.data_length = 0;
+		return *this;
 	}
 	temp_data_view(temp_data_view&& other)
 	{
 		data = other.data;
 		data_capacity = other.data_capacity;
 		data_length = other.data_length;
+		host_allocator = other.host_allocator;
 
 		other.data = nullptr;
 		other.data_capacity = 0;
@@ -100,7 +135,7 @@ struct temp_data_view
 		if (!data)
 		{
 			data = host_allocator ?
-				reinterpret_cast<T*>(host_allocator->pfnAllocation(host_allocator->pUserData, data_capacity, alignof(T), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+				reinterpret_cast<T*>(host_allocator->pfnAllocation(host_allocator->pUserData, data_capacity * sizeof(T), alignof(T), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
 				: new T[data_capacity];
 		}
 
@@ -149,6 +184,248 @@ static string_view copy(string_view from, VkAllocationCallbacks* host_allocator)
 	return { .data = data, .data_length = from.data_length };
 }
 
+struct acp_vulkan::gltf_arena
+{
+	struct block
+	{
+		block* previous;
+		size_t size;
+		size_t used;
+	};
+	block* current{ nullptr };
+	size_t next_block_size{ 0 };
+	// Where the blocks come from.
+	VkAllocationCallbacks* host_allocator{ nullptr };
+	// Handed to the parser in place of host_allocator, frees are no-ops as everything goes away with the blocks.
+	VkAllocationCallbacks callbacks{};
+};
+
+#define MIN_ARENA_BLOCK_SIZE (64 * 1024)
+
+static VKAPI_ATTR void* VKAPI_CALL arena_allocation(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope)
+{
+	acp_vulkan::gltf_arena* arena = reinterpret_cast<acp_vulkan::gltf_arena*>(user_data);
+	if (alignment == 0)
+		alignment = 1;
+
+	acp_vulkan::gltf_arena::block* block = arena->current;
+	if (block)
+	{
+		uintptr_t top = uintptr_t(block) + block->used;
+		uintptr_t aligned_top = (top + alignment - 1) & ~uintptr_t(alignment - 1);
+		if (aligned_top + size <= uintptr_t(block) + block->size)
+		{
+			block->used = aligned_top + size - uintptr_t(block);
+			return reinterpret_cast<void*>(aligned_top);
+		}
+	}
+
+	size_t block_size = sizeof(acp_vulkan::gltf_arena::block) + size + alignment;
+	if (block_size < arena->next_block_size)
+		block_size = arena->next_block_size;
+
+	acp_vulkan::gltf_arena::block* new_block = arena->host_allocator ?
+		reinterpret_cast<acp_vulkan::gltf_arena::block*>(arena->host_allocator->pfnAllocation(arena->host_allocator->pUserData, block_size, alignof(max_align_t), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: reinterpret_cast<acp_vulkan::gltf_arena::block*>(new max_align_t[(block_size + sizeof(max_align_t) - 1) / sizeof(max_align_t)]);
+	if (!new_block)
+		return nullptr;
+
+	new_block->previous = block;
+	new_block->size = block_size;
+	new_block->used = sizeof(acp_vulkan::gltf_arena::block);
+	arena->current = new_block;
+
+	return arena_allocation(user_data, size, alignment, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+}
+
+static VKAPI_ATTR void* VKAPI_CALL arena_reallocation(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	// Only used as a fresh allocation, the parser never reallocates.
+	assert(!original);
+	return arena_allocation(user_data, size, alignment, scope);
+}
+
+static VKAPI_ATTR void VKAPI_CALL arena_free(void*, void*)
+{
+}
+
+static acp_vulkan::gltf_arena* arena_create(size_t input_size, VkAllocationCallbacks* host_allocator)
+{
+	acp_vulkan::gltf_arena* arena = host_allocator ?
+		reinterpret_cast<acp_vulkan::gltf_arena*>(host_allocator->pfnAllocation(host_allocator->pUserData, sizeof(acp_vulkan::gltf_arena), alignof(acp_vulkan::gltf_arena), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new acp_vulkan::gltf_arena;
+	if (!arena)
+		return nullptr;
+
+	// The parsed data is usually smaller than the JSON that describes it, the first block should hold all of it.
+	*arena = {
+		.current = nullptr,
+		.next_block_size = input_size > MIN_ARENA_BLOCK_SIZE ? input_size : MIN_ARENA_BLOCK_SIZE,
+		.host_allocator = host_allocator,
+		.callbacks = {
+			.pUserData = arena,
+			.pfnAllocation = arena_allocation,
+			.pfnReallocation = arena_reallocation,
+			.pfnFree = arena_free,
+		}
+	};
+	return arena;
+}
+
+static void arena_release(acp_vulkan::gltf_arena* arena)
+{
+	VkAllocationCallbacks* host_allocator = arena->host_allocator;
+	acp_vulkan::gltf_arena::block* block = arena->current;
+	while (block)
+	{
+		acp_vulkan::gltf_arena::block* previous = block->previous;
+		if (host_allocator)
+			host_allocator->pfnFree(host_allocator->pUserData, block);
+		else
+			delete[] reinterpret_cast<max_align_t*>(block);
+		block = previous;
+	}
+
+	if (host_allocator)
+		host_allocator->pfnFree(host_allocator->pUserData, arena);
+	else
+		delete arena;
+}
+
+static void release_arena_of(acp_vulkan::gltf_data* gltf_data, VkAllocationCallbacks*)
+{
+	if (!gltf_data->arena)
+		return;
+
+	arena_release(gltf_data->arena);
+
+	acp_vulkan::gltf_data::gltf_state_type state = gltf_data->gltf_state;
+	size_t parsing_error_location = gltf_data->parsing_error_location;
+	acp_vulkan::gltf_source* source = gltf_data->source;
+	*gltf_data = {};
+	gltf_data->gltf_state = state;
+	gltf_data->parsing_error_location = parsing_error_location;
+	gltf_data->source = source;
+}
+
+struct acp_vulkan::gltf_source
+{
+	// Copy of the input, or the file gltf_data_from_file mapped or read, string_views and the GLB BIN chunk point in to it.
+	char* data{ nullptr };
+	size_t data_size{ 0 };
+	// data is a file mapping instead of an allocation.
+	bool mapped{ false };
+	// data belongs to the caller (gltf_cache_from_memory), only the source itself is freed.
+	bool borrowed{ false };
+	VkAllocationCallbacks* host_allocator{ nullptr };
+	// Handed to the parser in place of host_allocator, frees of pointers in to data are ignored.
+	VkAllocationCallbacks callbacks{};
+};
+
+static VKAPI_ATTR void* VKAPI_CALL source_allocation(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	acp_vulkan::gltf_source* source = reinterpret_cast<acp_vulkan::gltf_source*>(user_data);
+	if (source->host_allocator)
+		return source->host_allocator->pfnAllocation(source->host_allocator->pUserData, size, alignment, scope);
+	return malloc(size);
+}
+
+static VKAPI_ATTR void* VKAPI_CALL source_reallocation(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	acp_vulkan::gltf_source* source = reinterpret_cast<acp_vulkan::gltf_source*>(user_data);
+	if (source->host_allocator)
+		return source->host_allocator->pfnReallocation(source->host_allocator->pUserData, original, size, alignment, scope);
+	return realloc(original, size);
+}
+
+static VKAPI_ATTR void VKAPI_CALL source_free(void* user_data, void* memory)
+{
+	acp_vulkan::gltf_source* source = reinterpret_cast<acp_vulkan::gltf_source*>(user_data);
+	if (!memory || (memory >= source->data && memory < source->data + source->data_size))
+		return;
+
+	if (source->host_allocator)
+		source->host_allocator->pfnFree(source->host_allocator->pUserData, memory);
+	else
+		free(memory);
+}
+
+// Takes ownership of data when adopt is set, it must come from host_allocator or new char[], otherwise data is copied.
+static acp_vulkan::gltf_source* source_create(const char* data, size_t data_size, bool adopt, VkAllocationCallbacks* host_allocator)
+{
+	acp_vulkan::gltf_source* source = host_allocator ?
+		reinterpret_cast<acp_vulkan::gltf_source*>(host_allocator->pfnAllocation(host_allocator->pUserData, sizeof(acp_vulkan::gltf_source), alignof(acp_vulkan::gltf_source), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new acp_vulkan::gltf_source;
+	if (!source)
+		return nullptr;
+
+	char* source_data = const_cast<char*>(data);
+	if (!adopt)
+	{
+		source_data = host_allocator ?
+			reinterpret_cast<char*>(host_allocator->pfnAllocation(host_allocator->pUserData, data_size, 1, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+			: new char[data_size];
+		if (!source_data)
+		{
+			if (host_allocator)
+				host_allocator->pfnFree(host_allocator->pUserData, source);
+			else
+				delete source;
+			return nullptr;
+		}
+		memcpy(source_data, data, data_size);
+	}
+
+	*source = {
+		.data = source_data,
+		.data_size = data_size,
+		.host_allocator = host_allocator,
+		.callbacks = {
+			.pUserData = source,
+			.pfnAllocation = source_allocation,
+			.pfnReallocation = source_reallocation,
+			.pfnFree = source_free,
+		}
+	};
+	return source;
+}
+
+static void release_file_data(char* data, size_t data_size, bool mapped, VkAllocationCallbacks* host_allocator)
+{
+#if ACP_GLTF_MMAP
+	if (mapped)
+	{
+		munmap(data, data_size);
+		return;
+	}
+#endif
+	assert(!mapped);
+	if (host_allocator)
+		host_allocator->pfnFree(host_allocator->pUserData, data);
+	else
+		delete[] data;
+}
+
+static void source_release(acp_vulkan::gltf_source* source)
+{
+	VkAllocationCallbacks* host_allocator = source->host_allocator;
+	if (!source->borrowed)
+		release_file_data(source->data, source->data_size, source->mapped, host_allocator);
+	if (host_allocator)
+		host_allocator->pfnFree(host_allocator->pUserData, source);
+	else
+		delete source;
+}
+
+static void release_source_of(acp_vulkan::gltf_data* gltf_data, VkAllocationCallbacks*)
+{
+	if (!gltf_data->source)
+		return;
+
+	source_release(gltf_data->source);
+	gltf_data->source = nullptr;
+}
+
 #define MAX_TOKENS_PER_ENTITY (1024 * 1024)
 
 
@@ -231,6 +508,7 @@ static string_view copy(string_view from, VkAllocationCallbacks* host_allocator)
 	X(buffer)\
 	X(byteLength)\
 	X(byteOffset)\
+	X(byteStride)\
 	X(buffers)\
 	X(uri)\
 	X(images)\
@@ -276,6 +554,8 @@ static string_view copy(string_view from, VkAllocationCallbacks* host_allocator)
 	X(doubleSided) \
 	X(skin) \
 	X(matrix) \
+	X(children) \
+	X(camera) \
 	X(samplers) \
 	X(magFilter) \
 	X(minFilter) \
@@ -324,7 +604,7 @@ enum class token_types : uint32_t {
 
 #define TO_STRING_VALUE1(x, y) #y,
 #define TO_STRING_VALUE2(x) "\""#x"\"",
-static const char* token_as_strings[] = {
+static constexpr const char* token_as_strings[] = {
 	TOKENS_WITH_DIFFERENT_REPRESENATATION(TO_STRING_VALUE1)
 	TOKENS(TO_STRING_VALUE2)
 	TOKENS_FOR_ATTRIBUES(TO_STRING_VALUE2)
@@ -336,7 +616,7 @@ static const char* token_as_strings[] = {
 
 #define TO_STRING_VALUE1(x, y) false,
 #define TO_STRING_VALUE2(x) true,
-static const bool is_string_like[] = {
+static constexpr bool is_string_like[] = {
 	TOKENS_WITH_DIFFERENT_REPRESENATATION(TO_STRING_VALUE1)
 	TOKENS(TO_STRING_VALUE2)
 	TOKENS_FOR_ATTRIBUES(TO_STRING_VALUE2)
@@ -378,11 +658,60 @@ struct token {
 	} value;
 };
 
+struct peeked_token
+{
+	token token;
+	size_t next;
+};
+
+// Stage 1 of the tokenizer, one bit per input byte for every 64 byte block.
+// Only whitespace and quotes are classified, structural characters are single bytes that lex_token reads directly.
+struct structural_masks
+{
+	uint64_t whitespace;
+	uint64_t quote;
+};
+
+typedef void(*classify_blocks_type)(const char* data, size_t block_count, structural_masks* out);
+
+// Only used by the parallel sections pre-pass.
+struct section_masks
+{
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t bracket;
+	uint64_t comma;
+};
+
+typedef void(*classify_section_blocks_type)(const char* data, size_t block_count, section_masks* out);
+
+#define STRUCTURAL_WINDOW_BLOCKS 64
+
 struct tokenizer_state {
 	const char* data;
 	size_t data_size;
 	size_t next_char;
 	VkAllocationCallbacks* host_allocator;
+
+	// Masks for STRUCTURAL_WINDOW_BLOCKS consecutive blocks, refilled when the tokenizer leaves the window.
+	classify_blocks_type classify_blocks{ nullptr };
+	size_t window_first_block{ 0 };
+	size_t window_block_count{ 0 };
+	structural_masks window[STRUCTURAL_WINDOW_BLOCKS];
+
+	// One token lookahead, valid while next_char is still lookahead_location.
+	bool has_lookahead{ false };
+	size_t lookahead_location{ 0 };
+	peeked_token lookahead{};
+
+	size_t tokens_lexed{ 0 };
+
+	// data is owned by a gltf_source, strings are kept as views in to it instead of being copied.
+	bool strings_in_source{ false };
+
+	// data_size is the end of a parallel section chunk or of the complete stream entries, malformed elements can run in to it before they
+	// are parsed again.
+	bool chunk_end_is_eof{ false };
 };
 
 template<typename T>
@@ -415,12 +744,6 @@ struct on_scope_end
 	}
 };
 
-struct peeked_token
-{
-	token token;
-	size_t next;
-};
-
 enum class return_value {
 	none,
 	false_value,
@@ -428,210 +751,678 @@ enum class return_value {
 	error_value
 };
 
-static peeked_token peek_token(tokenizer_state* state)
+enum class char_class : uint8_t
+{
+	other,
+	whitespace,
+	structural,
+	quote,
+	number,
+	literal
+};
+
+struct char_class_table
+{
+	char_class classes[256]{};
+	token_types structural_tokens[256]{};
+};
+
+static constexpr char_class_table build_char_class_table()
 {
-	while (state->data_size > state->next_char)
+	char_class_table out{};
+	for (size_t ii = 0; ii < 256; ++ii)
+		out.structural_tokens[ii] = token_types::none;
+
+	const unsigned char whitespaces[] = { ' ', '\t', '\n', '\v', '\f', '\r' };
+	for (unsigned char c : whitespaces)
+		out.classes[c] = char_class::whitespace;
+
+	const pair<unsigned char, token_types> structurals[] = {
+		{ '{', token_types::open_curly },
+		{ '}', token_types::close_curly },
+		{ '[', token_types::open_bracket },
+		{ ']', token_types::closed_bracket },
+		{ ':', token_types::colon },
+		{ ',', token_types::comma },
+		{ 0xA6, token_types::none }
+	};
+	for (auto s : structurals)
 	{
-		bool is_skipable = isspace(*(state->data + state->next_char));
-		if (!is_skipable && *(state->data + state->next_char) == '\n')
-			is_skipable = true;
-		if (!is_skipable && *(state->data + state->next_char) == '\r')
-			is_skipable = true;
-		if (!is_skipable)
-			break;
-		state->next_char++;
+		out.classes[s.first] = char_class::structural;
+		out.structural_tokens[s.first] = s.second;
 	}
-	if (state->data_size > state->next_char)
+
+	out.classes['\"'] = char_class::quote;
+
+	for (unsigned char c = '0'; c <= '9'; ++c)
+		out.classes[c] = char_class::number;
+	out.classes['-'] = char_class::number;
+	out.classes['+'] = char_class::number;
+	out.classes['.'] = char_class::number;
+
+	out.classes['t'] = char_class::literal;
+	out.classes['f'] = char_class::literal;
+
+	return out;
+}
+
+static constexpr char_class_table char_classes = build_char_class_table();
+
+static void classify_blocks_scalar(const char* data, size_t block_count, structural_masks* out)
+{
+	for (size_t block = 0; block < block_count; ++block)
 	{
-		for (uint32_t ii = 0; ii < uint32_t(token_types::TOKENS_COUNT); ++ii)
+		structural_masks masks{};
+		for (uint32_t ii = 0; ii < 64; ++ii)
 		{
-			size_t token_length = strlen(token_as_strings[size_t(ii)]);
-			if ((state->next_char + token_length) <= state->data_size)
-			{
-				if (strncmp(state->data + state->next_char, token_as_strings[size_t(ii)], token_length) == 0)
-				{
-					token out{
-						.type = token_types(ii),
-						.view {
-							.data = state->data + state->next_char + 1,
-							.data_length = token_length - 2
-						}
-					};
-					return { out, state->next_char + token_length };
-				}
-			}
+			uint8_t c = uint8_t(data[block * 64 + ii]);
+			char_class type = char_classes.classes[c];
+			if (type == char_class::whitespace)
+				masks.whitespace |= uint64_t(1) << ii;
+			else if (type == char_class::quote)
+				masks.quote |= uint64_t(1) << ii;
 		}
-		if (*(state->data + state->next_char) == '\"')
+		out[block] = masks;
+	}
+}
+
+#if ACP_GLTF_X86
+static void classify_blocks_sse2(const char* data, size_t block_count, structural_masks* out)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i before_tab = _mm_set1_epi8('\t' - 1);
+	const __m128i after_carriage_return = _mm_set1_epi8('\r' + 1);
+	const __m128i quote = _mm_set1_epi8('\"');
+
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		structural_masks masks{};
+		for (uint32_t ii = 0; ii < 4; ++ii)
 		{
-			size_t last_location = state->next_char + 1;
-			while (last_location < state->data_size && *(state->data + last_location) != '\"')
-			{
-				++last_location;
-			}
-			if (*(state->data + last_location) == '\"')
-			{
-				token out{
-					.type = token_types::is_string,
-					.view {
-						.data = state->data + state->next_char + 1,
-						.data_length = (last_location + 1) - state->next_char - 2
-					},
-				};
-				return { out, last_location + 1 };
-			}
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + block * 64 + ii * 16));
+			__m128i whitespace = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_and_si128(_mm_cmpgt_epi8(v, before_tab), _mm_cmplt_epi8(v, after_carriage_return)));
+			masks.whitespace |= uint64_t(uint32_t(_mm_movemask_epi8(whitespace))) << (ii * 16);
+			masks.quote |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << (ii * 16);
 		}
+		out[block] = masks;
+	}
+}
+
+ACP_GLTF_TARGET_AVX2 static void classify_blocks_avx2(const char* data, size_t block_count, structural_masks* out)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i before_tab = _mm256_set1_epi8('\t' - 1);
+	const __m256i after_carriage_return = _mm256_set1_epi8('\r' + 1);
+	const __m256i quote = _mm256_set1_epi8('\"');
+
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		structural_masks masks{};
+		for (uint32_t ii = 0; ii < 2; ++ii)
 		{
-			char* end = nullptr;
-			errno = 0;
-			size_t token_length = 0;
-			token number_token{};
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + block * 64 + ii * 32));
+			__m256i whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_and_si256(_mm256_cmpgt_epi8(v, before_tab), _mm256_cmpgt_epi8(after_carriage_return, v)));
+			masks.whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(whitespace))) << (ii * 32);
+			masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << (ii * 32);
+		}
+		out[block] = masks;
+	}
+}
 
-			long long value_as_ll = strtoll(state->data + state->next_char, &end, 0);
-			if ((errno == 0) && end != state->data + state->next_char && end != nullptr)
-			{
-				token_length = end - (state->data + state->next_char);
-				number_token = {
-					.type = token_types::is_int,
-					.view {
-						.data = state->data + state->next_char,
-						.data_length = token_length
-					},
-					.value{.as_int = value_as_ll }
-				};
-			}
+static bool cpu_supports_avx2()
+{
+#if defined(_MSC_VER)
+	int info[4]{};
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool os_saves_ymm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6);
+	__cpuidex(info, 7, 0);
+	return os_saves_ymm && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
 
-			end = nullptr;
-			errno = 0;
-			double value_as_d = strtod(state->data + state->next_char, &end);
-			if ((errno == 0) && end != state->data + state->next_char && end != nullptr)
-			{
-				size_t token_length_as_double = end - (state->data + state->next_char);
-				if (token_length < token_length_as_double)
-				{
-					token_length = token_length_as_double;
-					number_token = {
-						.type = token_types::is_float,
-						.view {
-							.data = state->data + state->next_char,
-							.data_length = token_length_as_double
-						},
-						.value{.as_real = value_as_d }
-					};
-				}
-			}
+static bool cpu_supports_ssse3()
+{
+#if defined(_MSC_VER)
+	int info[4]{};
+	__cpuid(info, 1);
+	return info[2] & (1 << 9);
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
 
-			if (number_token.view.data_length > 0)
-				return { number_token, state->next_char + token_length };
-			
-		}
-		
-		if (state->next_char == state->data_size)
-		{
-			token out{
-					.type = token_types::eof,
-					.view {
-						.data = state->data + state->next_char,
-						.data_length = 0
-					},
-			};
-			return { out, 0 };
-		}
+static bool cpu_supports_sse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4]{};
+	__cpuid(info, 1);
+	return info[3] & (1 << 26);
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
 
-		token out{
-				.type = token_types::none,
-				.view {
-					.data = state->data + state->next_char,
-					.data_length = 0
-				},
-		};
-		return { out , 0 };
-	}
+static acp_vulkan::gltf_scan_backend requested_scan_backend = acp_vulkan::gltf_scan_backend::automatic;
 
-	token out{
-		.type = token_types::eof,
-		.view {
-			.data = state->data + state->next_char,
-			.data_length = 0
-		},
-	};
-	return { out, 0 };
+static acp_vulkan::gltf_scan_backend resolve_scan_backend(acp_vulkan::gltf_scan_backend requested)
+{
+#if ACP_GLTF_X86
+	if ((requested == acp_vulkan::gltf_scan_backend::automatic || requested == acp_vulkan::gltf_scan_backend::avx2) && cpu_supports_avx2())
+		return acp_vulkan::gltf_scan_backend::avx2;
+	if (requested != acp_vulkan::gltf_scan_backend::scalar && cpu_supports_sse2())
+		return acp_vulkan::gltf_scan_backend::sse2;
+#endif
+	return acp_vulkan::gltf_scan_backend::scalar;
 }
 
-static return_value expect(const token& t, token_types type)
+static classify_blocks_type classify_blocks_for(acp_vulkan::gltf_scan_backend backend)
 {
-	assert(t.type == type);
-	if (t.type == type)
-		return return_value::true_value;
-	return return_value::error_value;
+#if ACP_GLTF_X86
+	if (backend == acp_vulkan::gltf_scan_backend::avx2)
+		return classify_blocks_avx2;
+	if (backend == acp_vulkan::gltf_scan_backend::sse2)
+		return classify_blocks_sse2;
+#endif
+	return classify_blocks_scalar;
 }
 
-static token next_token(tokenizer_state* state)
+void acp_vulkan::gltf_set_scan_backend(gltf_scan_backend backend)
 {
-	peeked_token p = peek_token(state);
-	if (p.next != 0)
-		state->next_char = p.next;
-	return p.token;
+	requested_scan_backend = backend;
 }
 
-static return_value try_read_string_property_in_to(tokenizer_state* state, token_types type, acp_vulkan::gltf_data::string_view* target, bool allocate_new_data)
+acp_vulkan::gltf_scan_backend acp_vulkan::gltf_get_scan_backend()
 {
-	peeked_token t = peek_token(state);
-	if (t.token.type == type)
+	return resolve_scan_backend(requested_scan_backend);
+}
+
+static uint32_t count_trailing_zeros(uint64_t value)
+{
+	assert(value);
+#if defined(_MSC_VER)
+	unsigned long out = 0;
+	_BitScanForward64(&out, value);
+	return uint32_t(out);
+#else
+	return uint32_t(__builtin_ctzll(value));
+#endif
+}
+
+static void fill_structural_window(tokenizer_state* state, size_t first_block)
+{
+	size_t block_count = (state->data_size + 63) / 64;
+	assert(first_block < block_count);
+
+	state->window_first_block = first_block;
+	state->window_block_count = block_count - first_block < STRUCTURAL_WINDOW_BLOCKS ? block_count - first_block : STRUCTURAL_WINDOW_BLOCKS;
+
+	// The last block is usually partial, classify it from a zero padded copy so the backends never read past the input.
+	size_t full_blocks = state->window_block_count;
+	if ((first_block + full_blocks) * 64 > state->data_size)
+		full_blocks--;
+
+	state->classify_blocks(state->data + first_block * 64, full_blocks, state->window);
+
+	if (full_blocks != state->window_block_count)
 	{
-		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
-			return return_value::error_value;
-		token value = next_token(state);
-		if (!((size_t(value.type) > 0) && (size_t(value.type) < sizeof(is_string_like)/ sizeof(is_string_like[0])) && is_string_like[size_t(value.type)]))
-			return return_value::error_value;
-		
-		if (allocate_new_data)
-			*target = copy(value.view, state->host_allocator);
-		else
-			*target = value.view;
-		
-		return return_value::true_value;
+		char tail[64]{};
+		size_t tail_start = (first_block + full_blocks) * 64;
+		memcpy(tail, state->data + tail_start, state->data_size - tail_start);
+		state->classify_blocks(tail, 1, state->window + full_blocks);
 	}
-	return return_value::false_value;
 }
 
-template<typename T>
-static return_value try_read_real_property_to(tokenizer_state* state, token_types type, T* target)
+static const structural_masks& structural_masks_for(tokenizer_state* state, size_t block)
 {
-	peeked_token t = peek_token(state);
-	if (t.token.type == type)
+	if (block < state->window_first_block || block >= state->window_first_block + state->window_block_count)
+		fill_structural_window(state, block);
+	return state->window[block - state->window_first_block];
+}
+
+static size_t next_non_whitespace(tokenizer_state* state, size_t location)
+{
+	// Tokens are mostly separated by one or two characters, those are cheaper to check directly than through the masks.
+	for (uint32_t ii = 0; ii < 2 && location < state->data_size; ++ii, ++location)
+		if (char_classes.classes[uint8_t(state->data[location])] != char_class::whitespace)
+			return location;
+
+	while (location < state->data_size)
 	{
-		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
-			return return_value::error_value;
-		token value = next_token(state);
-		if (value.type == token_types::is_float)
-		{
-			*target = T(value.value.as_real);
-			return return_value::true_value;
-		} 
-		else if (value.type == token_types::is_int)
+		uint64_t not_whitespace = ~structural_masks_for(state, location / 64).whitespace >> (location % 64);
+		if (not_whitespace)
 		{
-			*target = T(value.value.as_int);
-			return return_value::true_value;
+			location += count_trailing_zeros(not_whitespace);
+			return location < state->data_size ? location : state->data_size;
 		}
-
-		return return_value::error_value;
+		location = (location / 64 + 1) * 64;
 	}
-	return return_value::false_value;
+	return state->data_size;
 }
 
-template<typename T>
-static return_value try_read_bool_property_to(tokenizer_state* state, token_types type, T* target)
+static size_t next_quote(tokenizer_state* state, size_t location)
 {
-	peeked_token t = peek_token(state);
-	if (t.token.type == type)
+	if (location >= state->data_size)
+		return state->data_size;
+
+	// Make sure the window covers location before its end is read, it is still empty before the first lookup.
+	structural_masks_for(state, location / 64);
+	size_t window_end = (state->window_first_block + state->window_block_count) * 64;
+	while (location < state->data_size && location < window_end)
 	{
-		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
-			return return_value::error_value;
-		token value = next_token(state);
-		if (value.type == token_types::true_value)
+		uint64_t quotes = structural_masks_for(state, location / 64).quote >> (location % 64);
+		if (quotes)
+		{
+			location += count_trailing_zeros(quotes);
+			return location < state->data_size ? location : state->data_size;
+		}
+		location = (location / 64 + 1) * 64;
+	}
+
+	// Long strings (mostly base64 data uris) run past the classified window, the libc memchr is faster there than classifying every block.
+	if (location >= state->data_size)
+		return state->data_size;
+	const char* quote = reinterpret_cast<const char*>(memchr(state->data + location, '\"', state->data_size - location));
+	return quote ? size_t(quote - state->data) : state->data_size;
+}
+
+// A quote after an odd run of backslashes belongs to the string.
+static bool is_escaped(const char* data, size_t string_start, size_t quote_location)
+{
+	size_t backslashes = 0;
+	while (quote_location - backslashes > string_start && data[quote_location - backslashes - 1] == '\\')
+		++backslashes;
+	return backslashes & 1;
+}
+
+static constexpr size_t const_string_length(const char* s)
+{
+	size_t out = 0;
+	while (s[out])
+		++out;
+	return out;
+}
+
+static constexpr uint32_t key_hash(const char* key, size_t key_length)
+{
+	uint32_t out = 2166136261u;
+	for (size_t ii = 0; ii < key_length; ++ii)
+	{
+		out ^= uint32_t(uint8_t(key[ii]));
+		out *= 16777619u;
+	}
+	return out;
+}
+
+// Open addressing table that maps the content of a quoted key to its token, built at compile time from token_as_strings.
+struct key_lookup_table
+{
+	static constexpr size_t size = 512;
+	struct entry
+	{
+		const char* key{ nullptr };
+		size_t key_length{ 0 };
+		token_types type{ token_types::is_string };
+	};
+	entry entries[size]{};
+	size_t max_key_length{ 0 };
+};
+
+static constexpr key_lookup_table build_key_lookup_table()
+{
+	key_lookup_table out{};
+	for (uint32_t ii = 0; ii < uint32_t(token_types::TOKENS_COUNT); ++ii)
+	{
+		if (!is_string_like[ii])
+			continue;
+
+		const char* key = token_as_strings[ii] + 1;
+		size_t key_length = const_string_length(token_as_strings[ii]) - 2;
+		size_t slot = key_hash(key, key_length) & (key_lookup_table::size - 1);
+		while (out.entries[slot].key)
+			slot = (slot + 1) & (key_lookup_table::size - 1);
+
+		out.entries[slot] = { .key = key, .key_length = key_length, .type = token_types(ii) };
+		if (key_length > out.max_key_length)
+			out.max_key_length = key_length;
+	}
+	return out;
+}
+
+static constexpr key_lookup_table key_lookup = build_key_lookup_table();
+
+static token_types lookup_key(const char* key, size_t key_length)
+{
+	if (key_length > key_lookup.max_key_length)
+		return token_types::is_string;
+
+	size_t slot = key_hash(key, key_length) & (key_lookup_table::size - 1);
+	while (key_lookup.entries[slot].key)
+	{
+		const key_lookup_table::entry& e = key_lookup.entries[slot];
+		if (e.key_length == key_length && memcmp(e.key, key, key_length) == 0)
+			return e.type;
+		slot = (slot + 1) & (key_lookup_table::size - 1);
+	}
+	return token_types::is_string;
+}
+
+static constexpr double exact_powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Scans [sign] digits [. digits] [(e|E) [sign] digits], the decimal grammar strtod accepts, without looking at the locale.
+// Reals whose significand fits in 53 bits and whose power of ten is exactly representable are built directly (Clinger's fast path),
+// everything else goes through std::from_chars which is correctly rounded, so the result is the same double strtod would give.
+static peeked_token peek_number_token(tokenizer_state* state)
+{
+	const char* start = state->data + state->next_char;
+	const char* end_of_data = state->data + state->data_size;
+	const char* current = start;
+
+	token out{
+		.type = token_types::none,
+		.view {
+			.data = start,
+			.data_length = 0
+		},
+	};
+
+	bool negative = false;
+	if (current < end_of_data && (*current == '-' || *current == '+'))
+	{
+		negative = *current == '-';
+		++current;
+	}
+	const char* digits_start = current;
+
+	uint64_t significand = 0;
+	uint32_t significant_digits = 0;
+	int64_t exponent = 0;
+
+	while (current < end_of_data && uint8_t(*current - '0') < 10)
+	{
+		if (significand != 0 || *current != '0')
+		{
+			if (significant_digits < 19)
+				significand = significand * 10 + uint8_t(*current - '0');
+			else
+				exponent++;
+			significant_digits++;
+		}
+		++current;
+	}
+	const char* integer_end = current;
+	bool has_integer_digits = integer_end != digits_start;
+
+	bool is_real = false;
+	bool has_fraction_digits = false;
+	if (current < end_of_data && *current == '.')
+	{
+		const char* fraction_start = ++current;
+		while (current < end_of_data && uint8_t(*current - '0') < 10)
+		{
+			if (significand != 0 || *current != '0')
+			{
+				if (significant_digits < 19)
+				{
+					significand = significand * 10 + uint8_t(*current - '0');
+					exponent--;
+				}
+				significant_digits++;
+			}
+			else
+			{
+				exponent--;
+			}
+			++current;
+		}
+		has_fraction_digits = current != fraction_start;
+		is_real = has_integer_digits || has_fraction_digits;
+		if (!is_real)
+			return { out, 0 };
+	}
+	else if (!has_integer_digits)
+	{
+		return { out, 0 };
+	}
+
+	if (current < end_of_data && (*current == 'e' || *current == 'E'))
+	{
+		const char* exponent_start = current + 1;
+		bool negative_exponent = false;
+		if (exponent_start < end_of_data && (*exponent_start == '-' || *exponent_start == '+'))
+		{
+			negative_exponent = *exponent_start == '-';
+			++exponent_start;
+		}
+		if (exponent_start < end_of_data && uint8_t(*exponent_start - '0') < 10)
+		{
+			int64_t explicit_exponent = 0;
+			current = exponent_start;
+			while (current < end_of_data && uint8_t(*current - '0') < 10)
+			{
+				if (explicit_exponent < 100000)
+					explicit_exponent = explicit_exponent * 10 + uint8_t(*current - '0');
+				++current;
+			}
+			exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+			is_real = true;
+		}
+	}
+
+	out.view.data_length = current - start;
+
+	// 19 digits always fit the significand, the negative limit is one more than the positive one.
+	uint64_t int_limit = negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX);
+	if (!is_real && significant_digits <= 19 && significand <= int_limit)
+	{
+		out.type = token_types::is_int;
+		out.value.as_int = negative ? int64_t(0 - significand) : int64_t(significand);
+		return { out, state->next_char + out.view.data_length };
+	}
+	// Out of range for an integer, read it as a real.
+
+	if (significant_digits <= 19 && significand <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double value = double(significand);
+		value = exponent < 0 ? value / exact_powers_of_ten[-exponent] : value * exact_powers_of_ten[exponent];
+		out.type = token_types::is_float;
+		out.value.as_real = negative ? -value : value;
+		return { out, state->next_char + out.view.data_length };
+	}
+
+	double value_as_d = 0.0;
+	std::from_chars_result result = std::from_chars(digits_start, current, value_as_d);
+	if (result.ec == std::errc() && result.ptr == current)
+	{
+		out.type = token_types::is_float;
+		out.value.as_real = negative ? -value_as_d : value_as_d;
+		return { out, state->next_char + out.view.data_length };
+	}
+
+	// Reals that overflow or underflow a double were never accepted, keep only the integer part like strtoll did.
+	long long value_as_ll = 0;
+	if (has_integer_digits && std::from_chars(negative ? digits_start - 1 : digits_start, integer_end, value_as_ll).ec == std::errc())
+	{
+		out.type = token_types::is_int;
+		out.view.data_length = integer_end - start;
+		out.value.as_int = value_as_ll;
+		return { out, state->next_char + out.view.data_length };
+	}
+
+	out.view.data_length = 0;
+	return { out, 0 };
+}
+
+static peeked_token lex_token(tokenizer_state* state)
+{
+	state->tokens_lexed++;
+
+	state->next_char = next_non_whitespace(state, state->next_char);
+
+	token out{
+		.type = token_types::eof,
+		.view {
+			.data = state->data + state->next_char,
+			.data_length = 0
+		},
+	};
+
+	if (state->data_size <= state->next_char)
+		return { out, 0 };
+
+	const char* current = state->data + state->next_char;
+	size_t remaining = state->data_size - state->next_char;
+	switch (char_classes.classes[uint8_t(*current)])
+	{
+		case char_class::structural:
+		{
+			out.type = char_classes.structural_tokens[uint8_t(*current)];
+			out.view.data_length = 1;
+			return { out, state->next_char + 1 };
+		}
+		case char_class::quote:
+		{
+			size_t closing_quote_location = next_quote(state, state->next_char + 1);
+			while (closing_quote_location != state->data_size && is_escaped(state->data, state->next_char + 1, closing_quote_location))
+				closing_quote_location = next_quote(state, closing_quote_location + 1);
+			if (closing_quote_location == state->data_size)
+				break;
+			const char* closing_quote = state->data + closing_quote_location;
+
+			out.view.data = current + 1;
+			out.view.data_length = closing_quote - current - 1;
+			out.type = lookup_key(out.view.data, out.view.data_length);
+			return { out, size_t(closing_quote - state->data) + 1 };
+		}
+		case char_class::number:
+		{
+			peeked_token number = peek_number_token(state);
+			if (number.next != 0)
+				return number;
+			break;
+		}
+		case char_class::literal:
+		{
+			if (remaining >= 4 && strncmp(current, "true", 4) == 0)
+			{
+				out.type = token_types::true_value;
+				out.view.data_length = 4;
+				return { out, state->next_char + 4 };
+			}
+			if (remaining >= 5 && strncmp(current, "false", 5) == 0)
+			{
+				out.type = token_types::false_value;
+				out.view.data_length = 5;
+				return { out, state->next_char + 5 };
+			}
+			break;
+		}
+		default:
+			break;
+	}
+
+	out.type = token_types::none;
+	out.view.data_length = 0;
+	return { out, 0 };
+}
+
+static peeked_token peek_token(tokenizer_state* state)
+{
+	if (state->has_lookahead && state->lookahead_location == state->next_char)
+		return state->lookahead;
+
+	// lex_token skips the leading whitespace so the lookahead is keyed on the location of the token itself.
+	state->lookahead = lex_token(state);
+	state->lookahead_location = state->next_char;
+	state->has_lookahead = true;
+	return state->lookahead;
+}
+
+static return_value expect(tokenizer_state* state, const token& t, token_types type)
+{
+	assert(t.type == type || (state->chunk_end_is_eof && (t.type == token_types::eof || t.type == token_types::none)));
+	if (t.type == type)
+		return return_value::true_value;
+	return return_value::error_value;
+}
+
+static token next_token(tokenizer_state* state)
+{
+	peeked_token p = peek_token(state);
+	if (p.next != 0)
+		state->next_char = p.next;
+	return p.token;
+}
+
+static return_value try_read_string_property_in_to(tokenizer_state* state, token_types type, acp_vulkan::gltf_data::string_view* target, bool allocate_new_data)
+{
+	peeked_token t = peek_token(state);
+	if (t.token.type == type)
+	{
+		next_token(state);
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
+			return return_value::error_value;
+		token value = next_token(state);
+		if (!((size_t(value.type) > 0) && (size_t(value.type) < sizeof(is_string_like)/ sizeof(is_string_like[0])) && is_string_like[size_t(value.type)]))
+			return return_value::error_value;
+		
+		if (allocate_new_data && !state->strings_in_source)
+			*target = copy(value.view, state->host_allocator);
+		else
+			*target = value.view;
+		
+		return return_value::true_value;
+	}
+	return return_value::false_value;
+}
+
+template<typename T>
+static return_value try_read_real_property_to(tokenizer_state* state, token_types type, T* target)
+{
+	peeked_token t = peek_token(state);
+	if (t.token.type == type)
+	{
+		next_token(state);
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
+			return return_value::error_value;
+		token value = next_token(state);
+		if (value.type == token_types::is_float)
+		{
+			*target = T(value.value.as_real);
+			return return_value::true_value;
+		} 
+		else if (value.type == token_types::is_int)
+		{
+			*target = T(value.value.as_int);
+			return return_value::true_value;
+		}
+
+		return return_value::error_value;
+	}
+	return return_value::false_value;
+}
+
+template<typename T>
+static return_value try_read_bool_property_to(tokenizer_state* state, token_types type, T* target)
+{
+	peeked_token t = peek_token(state);
+	if (t.token.type == type)
+	{
+		next_token(state);
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
+			return return_value::error_value;
+		token value = next_token(state);
+		if (value.type == token_types::true_value)
 		{
 			*target = T(true);
 			return return_value::true_value;
@@ -654,7 +1445,7 @@ static return_value try_read_int_property_to(tokenizer_state* state, token_types
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		token value = next_token(state);
 		if (value.type == token_types::is_int)
@@ -672,7 +1463,7 @@ static return_value try_read_int_property_to(tokenizer_state* state, token_types
 static return_value expect_ordered_and_discard_tokens(tokenizer_state* state, std::initializer_list<token_types> expected)
 {
 	for (token_types t : expected)
-		if (expect(next_token(state), t) == return_value::error_value)
+		if (expect(state, next_token(state), t) == return_value::error_value)
 			return return_value::error_value;
 
 	return return_value::true_value;
@@ -686,7 +1477,7 @@ static return_value discard_next_or_return_if_token(tokenizer_state* state, toke
 
 	if (p.token.type == token_types::eof || p.token.type == token_types::none)
 	{
-		assert(false);
+		assert(state->chunk_end_is_eof);
 		return return_value::error_value;
 	}
 
@@ -702,7 +1493,7 @@ static return_value return_if_token(tokenizer_state* state, token_types expected
 
 	if (p.token.type == token_types::eof || p.token.type == token_types::none)
 	{
-		assert(false);
+		assert(state->chunk_end_is_eof);
 		return return_value::error_value;
 	}
 
@@ -720,7 +1511,7 @@ static return_value skip_object_and_arries_if_found(tokenizer_state* state)
 			token t = next_token(state);
 			if (t.type == token_types::eof || t.type == token_types::none)
 			{
-				assert(false);
+				assert(state->chunk_end_is_eof);
 				return return_value::error_value;
 			}
 			else if (t.type == token_types::open_curly || t.type == token_types::open_bracket)
@@ -782,7 +1573,7 @@ static return_value discard_next_if_token(tokenizer_state* state, token_types ex
 
 	if (p.token.type == token_types::eof || p.token.type == token_types::none)
 	{
-		assert(false);
+		assert(state->chunk_end_is_eof);
 		return return_value::error_value;
 	}
 
@@ -916,6 +1707,7 @@ static pair<acp_vulkan::gltf_data::buffer_view, return_value> parse_buffer_view(
 		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::buffer, &out.buffer);
 		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::byteLength, &out.byte_length);
 		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::byteOffset, &out.byte_offset);
+		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::byteStride, &out.byte_stride);
 		BREAK_LOOP_ON_TOKRN_OR_ERROR_DISCARD_OTHERWISE(token_types::close_curly);
 	ELEMENT_END
 
@@ -1028,7 +1820,7 @@ static return_value try_read_float_array_property_to(tokenizer_state* state, tok
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		auto value = parse_float_array(state);
 		if (value.second != return_value::true_value)
@@ -1054,7 +1846,7 @@ static return_value try_read_float_array_property_to(tokenizer_state* state, tok
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		auto value = parse_float_array(state);
 		if (value.second != return_value::true_value)
@@ -1115,7 +1907,7 @@ static return_value try_read_int_array_property_to(tokenizer_state* state, token
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		auto value = parse_int_array(state);
 		if (value.second != return_value::true_value)
@@ -1125,7 +1917,7 @@ static return_value try_read_int_array_property_to(tokenizer_state* state, token
 		{
 			if (value.first.data_length <= ii)
 				break;
-			target[ii] = value.first[ii];
+			target[ii] = value.first.data[ii];
 			if (found_values)
 				found_values++;
 		}
@@ -1141,7 +1933,7 @@ static return_value try_read_int_array_property_to(tokenizer_state* state, token
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		auto value = parse_int_array(state);
 		if (value.second != return_value::true_value)
@@ -1214,7 +2006,7 @@ static return_value try_read_subsection_to(tokenizer_state* state, token_types t
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		auto v = subsection_parser(state);
 		if (v.second != return_value::true_value)
@@ -1242,7 +2034,7 @@ static return_value try_read_subsection_array_to(tokenizer_state* state, token_t
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 
 		DESCARD_IF_EXCPECTED_RETURN_STATE_OTHERWISE(token_types::open_bracket);
@@ -1254,6 +2046,9 @@ static return_value try_read_subsection_array_to(tokenizer_state* state, token_t
 				out.emplace_back(std::move(v.first));
 				if (found_subsection)
 					*found_subsection = true;
+				// Only the separator is dropped here, the discard below would otherwise skip the element after it.
+				if (discard_next_if_token(state, token_types::comma) == return_value::true_value)
+					continue;
 			}
 			BREAK_LOOP_ON_TOKRN_OR_ERROR_STATE_DISCARD_OTHERWISE(token_types::closed_bracket);
 		ELEMENT_END_STATE
@@ -1378,6 +2173,9 @@ static pair<acp_vulkan::gltf_data::accesor, return_value> parse_accesor(tokenize
 	if (!found_type)
 		return { {}, return_value::error_value };
 
+	if (out.buffer_view != UINT32_MAX)
+		out.has_buffer_view = true;
+
 	delete_on_failure.drop();
 	return { std::move(out), return_value::true_value };
 }
@@ -1400,18 +2198,15 @@ static pair<temp_data_view<T>, return_value> parse_elements(tokenizer_state* sta
 	return { std::move(out), return_value::true_value };
 }
 
-#define GLTF_SECTION(TARGET, DESTINSTION, DESTINATION_TYPE, ELEMENT_PARSER)												\
+#define GLTF_SECTION(TARGET, SECTION, DESTINSTION, DESTINATION_TYPE, ELEMENT_PARSER)										\
 	case TARGET:																										\
 	{																													\
-		auto asset_data = parse_elements<DESTINATION_TYPE>(&state, ELEMENT_PARSER);										\
+		auto asset_data = parse_or_take_section<DESTINATION_TYPE>(state, parallel_ready, key, ELEMENT_PARSER);			\
 		if (asset_data.second == return_value::error_value)																\
-		{																												\
-			acp_vulkan::gltf_data_free(&out, state.host_allocator);														\
-			return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };	\
-		}																												\
-			out.DESTINSTION = std::move(asset_data.first.to());															\
-			found_sections.emplace_back(TARGET);																		\
-			break;																										\
+			return return_value::error_value;																			\
+		out->DESTINSTION = std::move(asset_data.first.to());															\
+		*found_sections |= SECTION;																						\
+		break;																											\
 	}
 
 static void delete_texture_data(acp_vulkan::gltf_data::texture* in, VkAllocationCallbacks* host_allocator)
@@ -1518,7 +2313,7 @@ static return_value try_read_attributes_property_to(tokenizer_state* state, toke
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		auto value = parse_attributes(state);
 		if (value.second != return_value::true_value)
@@ -1544,21 +2339,15 @@ static void delete_mesh_primitive_targets_data(acp_vulkan::gltf_data::mesh::prim
 	free_gltf_buffer(in->attributes, host_allocator);
 }
 
+// A morph target is an attribute dictionary itself, { "POSITION": 1, "NORMAL": 2 }.
 static pair<acp_vulkan::gltf_data::mesh::primitive_type::target, return_value> parse_mesh_primitive_targets(tokenizer_state* state)
 {
-	acp_vulkan::gltf_data::mesh::primitive_type::target out{};
-	on_scope_end<decltype(out)> delete_on_failure(&out, delete_mesh_primitive_targets_data, state->host_allocator);
-
-	DESCARD_IF_EXCPECTED_RETURN_OTHERWISE(token_types::open_curly);
-
-	ELEMENT_START
-		TRY_READ_ATTRIBUTE_ARRAY_OR_REPORT_ERROR(token_types::attributes, out.attributes);
-		BREAK_LOOP_ON_TOKRN_OR_ERROR_DISCARD_OTHERWISE(token_types::close_curly);
-	ELEMENT_END
-
-	DESCARD_IF_EXCPECTED(token_types::close_curly);
+	auto attributes = parse_attributes(state);
+	if (attributes.second != return_value::true_value)
+		return { {}, return_value::error_value };
 
-	delete_on_failure.drop();
+	acp_vulkan::gltf_data::mesh::primitive_type::target out{};
+	out.attributes = attributes.first.to();
 	return { std::move(out), return_value::true_value };
 }
 
@@ -1588,6 +2377,11 @@ static pair<acp_vulkan::gltf_data::mesh::primitive_type, return_value> parse_mes
 
 		DESCARD_IF_EXCPECTED(token_types::close_curly);
 
+	if (out.indices != UINT32_MAX)
+		out.has_indices = true;
+	if (out.material != UINT32_MAX)
+		out.has_material = true;
+
 	delete_on_failure.drop();
 	return { std::move(out), return_value::true_value };
 }
@@ -1701,7 +2495,7 @@ static return_value try_read_alpha_mode_property_to(tokenizer_state* state, toke
 	if (t.token.type == type)
 	{
 		next_token(state);
-		if (expect(next_token(state), token_types::colon) == return_value::error_value)
+		if (expect(state, next_token(state), token_types::colon) == return_value::error_value)
 			return return_value::error_value;
 		token value = next_token(state);
 		if (auto iter = tokens_to_alpha_mode.find(value.type); iter != tokens_to_alpha_mode.end())
@@ -1772,6 +2566,8 @@ static pair<acp_vulkan::gltf_data::node, return_value> parse_node(tokenizer_stat
 	ELEMENT_START
 		TRY_READ_STRING_OR_REPORT_ERROR(token_types::name, &out.name);
 		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::skin, &out.skin);
+		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::camera, &out.camera);
+		TRY_READ_INT_ARRAY_OR_REPORT_ERROR(token_types::children, out.children, SIZE_MAX);
 		TRY_READ_FLOAT_ARRAY_OR_REPORT_ERROR(token_types::matrix, out.matrix, 16);
 		TRY_READ_INT_VALUE_OR_REPORT_ERROR(token_types::mesh, &out.mesh);
 		TRY_READ_FLOAT_ARRAY_OR_REPORT_ERROR(token_types::rotation, out.rotation, 4);
@@ -2102,6 +2898,8 @@ static pair<acp_vulkan::gltf_data::animation::sampler, return_value> parse_anima
 
 static void delete_animation_data(acp_vulkan::gltf_data::animation* in, VkAllocationCallbacks* host_allocator)
 {
+	free_gltf_buffer(in->channels, host_allocator);
+	free_gltf_buffer(in->samplers, host_allocator);
 	free_gltf_buffer(in->name, host_allocator);
 }
 
@@ -2162,43 +2960,120 @@ static constexpr const unsigned char decoding_table[256] = {
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 
-data_view<uint8_t> base64_decode(string_view input)
-{
-	if (input.data_length % 4 != 0)
-		return {};
+typedef void(*base64_decode_type)(const char* input, size_t input_length, uint8_t* output);
 
-	size_t output_length = input.data_length / 4 * 3 + 2;
-
-	if (input.data[input.data_length - 1] == '=') (output_length)--;
-	if (input.data[input.data_length - 2] == '=') (output_length)--;
+// Reference decoder, every 4 characters become 3 bytes. Characters outside the alphabet, the '=' padding included, decode as 0.
+static void base64_decode_scalar(const char* input, size_t input_length, uint8_t* output)
+{
+	for (size_t ii = 0; ii + 4 <= input_length; ii += 4, output += 3)
+	{
+		uint32_t triple = (uint32_t(decoding_table[uint8_t(input[ii])]) << 3 * 6)
+			| (uint32_t(decoding_table[uint8_t(input[ii + 1])]) << 2 * 6)
+			| (uint32_t(decoding_table[uint8_t(input[ii + 2])]) << 1 * 6)
+			| (uint32_t(decoding_table[uint8_t(input[ii + 3])]) << 0 * 6);
+
+		output[0] = uint8_t(triple >> 2 * 8);
+		output[1] = uint8_t(triple >> 1 * 8);
+		output[2] = uint8_t(triple >> 0 * 8);
+	}
+}
 
-	temp_data_view<uint8_t> decoded_data;
-	decoded_data.reserve(output_length);
+#if ACP_GLTF_X86
+// The vector decoders classify the characters by nibble lookups and turn them in to sextets with one add, blocks that hold anything outside the
+// alphabet (the padding included) go through base64_decode_scalar so every backend writes the same bytes.
+ACP_GLTF_TARGET_SSSE3 static void base64_decode_ssse3(const char* input, size_t input_length, uint8_t* output)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i slash = _mm_set1_epi8(0x2f);
+	const __m128i merge_pairs = _mm_set1_epi32(0x01400140);
+	const __m128i merge_quads = _mm_set1_epi32(0x00011000);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m128i zero = _mm_setzero_si128();
+
+	// Every store writes 16 bytes for 12 decoded ones, stop while the input left still covers the extra 4.
+	for (; input_length >= 24; input += 16, input_length -= 16, output += 12)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+		__m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), slash);
+		__m128i lo_nibbles = _mm_and_si128(v, slash);
+		__m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, zero)) != 0xffff)
+		{
+			base64_decode_scalar(input, 16, output);
+			continue;
+		}
 
-	if (!decoded_data.data)
-		return {};
+		__m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, slash), hi_nibbles));
+		__m128i sextets = _mm_add_epi8(v, roll);
+		__m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(sextets, merge_pairs), merge_quads);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(merged, pack));
+	}
+	base64_decode_scalar(input, input_length, output);
+}
 
-	for (int i = 0, j = 0; i < input.data_length;)
+ACP_GLTF_TARGET_AVX2 static void base64_decode_avx2(const char* input, size_t input_length, uint8_t* output)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i slash = _mm256_set1_epi8(0x2f);
+	const __m256i merge_pairs = _mm256_set1_epi32(0x01400140);
+	const __m256i merge_quads = _mm256_set1_epi32(0x00011000);
+	const __m256i pack = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+	// Every store writes 32 bytes for 24 decoded ones, stop while the input left still covers the extra 8.
+	for (; input_length >= 44; input += 32, input_length -= 32, output += 24)
 	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input));
+		__m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), slash);
+		__m256i lo_nibbles = _mm256_and_si256(v, slash);
+		if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), _mm256_shuffle_epi8(lut_hi, hi_nibbles)))
+		{
+			base64_decode_scalar(input, 32, output);
+			continue;
+		}
 
-		uint32_t sextet_a = input.data[i] == '=' ? 0 & i++ : decoding_table[input.data[i++]];
-		uint32_t sextet_b = input.data[i] == '=' ? 0 & i++ : decoding_table[input.data[i++]];
-		uint32_t sextet_c = input.data[i] == '=' ? 0 & i++ : decoding_table[input.data[i++]];
-		uint32_t sextet_d = input.data[i] == '=' ? 0 & i++ : decoding_table[input.data[i++]];
-
-		uint32_t triple = (sextet_a << 3 * 6)
-			+ (sextet_b << 2 * 6)
-			+ (sextet_c << 1 * 6)
-			+ (sextet_d << 0 * 6);
+		__m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, slash), hi_nibbles));
+		__m256i sextets = _mm256_add_epi8(v, roll);
+		__m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(sextets, merge_pairs), merge_quads);
+		merged = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, pack), compact);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output), merged);
+	}
+	base64_decode_scalar(input, input_length, output);
+}
+#endif
 
-		if (j < output_length) decoded_data.emplace_back((triple >> 2 * 8) & 0xFF);
-		if (j < output_length) decoded_data.emplace_back((triple >> 1 * 8) & 0xFF);
-		if (j < output_length) decoded_data.emplace_back((triple >> 0 * 8) & 0xFF);
+static base64_decode_type base64_decode_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend == acp_vulkan::gltf_scan_backend::avx2)
+		return base64_decode_avx2;
+	if (backend == acp_vulkan::gltf_scan_backend::sse2 && cpu_supports_ssse3())
+		return base64_decode_ssse3;
+#endif
+	return base64_decode_scalar;
+}
 
-	}
+// Size of the decoded data without the padding, 0 when input is not a whole number of 4 character groups.
+static size_t base64_decoded_size(string_view input)
+{
+	if (input.data_length == 0 || input.data_length % 4 != 0)
+		return 0;
 
-	return decoded_data.to();
-};
+	size_t padding = (input.data[input.data_length - 1] == '=') + (input.data[input.data_length - 2] == '=');
+	return input.data_length / 4 * 3 - padding;
+}
 
 static std::pair<string_view, string_view> get_embedded_data(string_view uri)
 {
@@ -2239,272 +3114,7563 @@ static std::pair<string_view, string_view> get_embedded_data(string_view uri)
 	return {};
 }
 
-acp_vulkan::gltf_data acp_vulkan::gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator)
-{
-	acp_vulkan::gltf_data out{};
+// Parallel section parsing: a pre-pass over quote, bracket and comma masks finds the byte range of every top level array section
+// and splits the big ones at element boundaries, the chunks are then parsed as independent jobs and stitched back in order.
 
+#define MAX_PARSING_THREADS 64
+#define MIN_PARALLEL_INPUT_SIZE (1024 * 1024)
+#define MIN_SECTION_CHUNK_SIZE (64 * 1024)
 
-	tokenizer_state state{
-		.data = data,
-		.data_size = data_size,
+static uint32_t requested_parsing_threads = 0;
+static acp_vulkan::gltf_job_system parsing_job_system{};
+
+void acp_vulkan::gltf_set_parsing_threads(uint32_t thread_count, const gltf_job_system* job_system)
+{
+	requested_parsing_threads = thread_count > MAX_PARSING_THREADS ? MAX_PARSING_THREADS : thread_count;
+	parsing_job_system = job_system ? *job_system : gltf_job_system{};
+}
+
+static uint32_t parsing_thread_count()
+{
+	if (requested_parsing_threads)
+		return requested_parsing_threads;
+	uint32_t hardware_threads = std::thread::hardware_concurrency();
+	if (hardware_threads == 0)
+		return 1;
+	return hardware_threads > MAX_PARSING_THREADS ? MAX_PARSING_THREADS : hardware_threads;
+}
+
+static void run_parsing_jobs(void (*job)(void* job_data, size_t job_index), void* job_data, size_t job_count)
+{
+	if (parsing_job_system.run)
+	{
+		parsing_job_system.run(parsing_job_system.user_data, job, job_data, job_count);
+		return;
+	}
+
+	uint32_t thread_count = parsing_thread_count();
+	if (thread_count > job_count)
+		thread_count = uint32_t(job_count);
+
+	std::atomic<size_t> next_job{ 0 };
+	auto worker = [&]()
+	{
+		for (size_t ii = next_job++; ii < job_count; ii = next_job++)
+			job(job_data, ii);
+	};
+
+	// The calling thread is one of the workers.
+	std::thread threads[MAX_PARSING_THREADS];
+	for (uint32_t ii = 1; ii < thread_count; ++ii)
+		threads[ii] = std::thread(worker);
+	worker();
+	for (uint32_t ii = 1; ii < thread_count; ++ii)
+		threads[ii].join();
+}
+
+struct section_chunk;
+typedef return_value(*parse_section_chunk_type)(tokenizer_state* state, section_chunk* chunk);
+typedef void(*release_section_chunk_type)(section_chunk* chunk);
+
+struct section_chunk
+{
+	size_t section;
+	size_t begin;
+	size_t end;
+	parse_section_chunk_type parse;
+	release_section_chunk_type release;
+
+	// Filled by the job, elements is a data_view<T> of the section type.
+	void* elements{ nullptr };
+	size_t element_count{ 0 };
+	VkAllocationCallbacks* allocator{ nullptr };
+	acp_vulkan::gltf_arena* arena{ nullptr };
+	return_value result{ return_value::none };
+	size_t tokens_lexed{ 0 };
+};
+
+struct section_range
+{
+	// Where the key string starts, matches the view of the key token the main pass reads.
+	size_t key_location;
+	size_t value_end;
+	size_t first_chunk;
+	size_t chunk_count;
+};
+
+struct parallel_sections
+{
+	const char* data;
+	size_t data_size;
+	classify_blocks_type classify_blocks;
+	classify_section_blocks_type classify_section_blocks;
+	bool strings_in_source;
+	VkAllocationCallbacks* data_allocator;
+	// Set in arena mode, every chunk gets its own arena and they are merged in to the gltf_data one afterwards.
+	VkAllocationCallbacks* arena_host_allocator;
+	bool use_arenas;
+
+	temp_data_view<section_range> sections;
+	temp_data_view<section_chunk> chunks;
+	// Chunk arenas end up in the arena of owner, or are released with it when it already went away.
+	acp_vulkan::gltf_data* owner;
+};
+
+template<typename T, typename F>
+static pair<temp_data_view<T>, return_value> parse_element_range(tokenizer_state* state, F parse_element)
+{
+	temp_data_view<T> out{};
+	out.host_allocator = state->host_allocator;
+
+	// The range stops before the closing bracket or at the comma that starts the next chunk, the end of the range reads as eof.
+	ELEMENT_START
+		if (peek_token(state).token.type == token_types::eof)
+			break;
+		GLTF_ELEMENT(parse_element);
+	ELEMENT_END
+
+	return { std::move(out), return_value::true_value };
+}
+
+template<typename T, pair<T, return_value>(*ELEMENT_PARSER)(tokenizer_state*)>
+static return_value parse_section_chunk(tokenizer_state* state, section_chunk* chunk)
+{
+	auto elements = parse_element_range<T>(state, ELEMENT_PARSER);
+	if (elements.second != return_value::true_value)
+		return return_value::error_value;
+
+	data_view<T> view = elements.first.to();
+	chunk->elements = view.data;
+	chunk->element_count = view.data_length;
+	return return_value::true_value;
+}
+
+template<typename T, void(*ELEMENT_DELETER)(T*, VkAllocationCallbacks*)>
+static void release_section_chunk(section_chunk* chunk)
+{
+	data_view<T> view{ .data = reinterpret_cast<T*>(chunk->elements), .data_length = chunk->element_count };
+	for (size_t ii = 0; ii < view.data_length; ++ii)
+		ELEMENT_DELETER(&view.data[ii], chunk->allocator);
+	free_gltf_buffer(view, chunk->allocator);
+	chunk->elements = nullptr;
+	chunk->element_count = 0;
+}
+
+static void delete_buffer_view_data(acp_vulkan::gltf_data::buffer_view*, VkAllocationCallbacks*)
+{
+}
+
+#define GLTF_PARALLEL_SECTION(TARGET, DESTINATION_TYPE, ELEMENT_PARSER, ELEMENT_DELETER)							\
+	case TARGET:																									\
+		*parse = parse_section_chunk<DESTINATION_TYPE, ELEMENT_PARSER>;												\
+		*release = release_section_chunk<DESTINATION_TYPE, ELEMENT_DELETER>;										\
+		return true;
+
+static bool section_chunk_functions(token_types section, parse_section_chunk_type* parse, release_section_chunk_type* release)
+{
+	switch (section)
+	{
+		GLTF_PARALLEL_SECTION(token_types::bufferViews, acp_vulkan::gltf_data::buffer_view, parse_buffer_view, delete_buffer_view_data);
+		GLTF_PARALLEL_SECTION(token_types::buffers, acp_vulkan::gltf_data::buffer, parse_buffer, delete_buffer_data);
+		GLTF_PARALLEL_SECTION(token_types::images, acp_vulkan::gltf_data::image, parse_image, delete_image_data);
+		GLTF_PARALLEL_SECTION(token_types::accessors, acp_vulkan::gltf_data::accesor, parse_accesor, delete_accesor_data);
+		GLTF_PARALLEL_SECTION(token_types::textures, acp_vulkan::gltf_data::texture, parse_texture, delete_texture_data);
+		GLTF_PARALLEL_SECTION(token_types::meshes, acp_vulkan::gltf_data::mesh, parse_mesh, delete_mesh_data);
+		GLTF_PARALLEL_SECTION(token_types::materials, acp_vulkan::gltf_data::material, parse_material, delete_material_data);
+		GLTF_PARALLEL_SECTION(token_types::nodes, acp_vulkan::gltf_data::node, parse_node, delete_node_data);
+		GLTF_PARALLEL_SECTION(token_types::scenes, acp_vulkan::gltf_data::scene, parse_scene, delete_scene_data);
+		GLTF_PARALLEL_SECTION(token_types::samplers, acp_vulkan::gltf_data::sampler, parse_sampler, delete_sampler_data);
+		GLTF_PARALLEL_SECTION(token_types::skins, acp_vulkan::gltf_data::skin, parse_skin, delete_skin_data);
+		GLTF_PARALLEL_SECTION(token_types::cameras, acp_vulkan::gltf_data::camera, parse_camera, delete_camera_data);
+		GLTF_PARALLEL_SECTION(token_types::animations, acp_vulkan::gltf_data::animation, parse_animation, delete_animation_data);
+		default:
+			return false;
+	}
+}
+
+static void classify_section_blocks_scalar(const char* data, size_t block_count, section_masks* out)
+{
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		section_masks masks{};
+		for (uint32_t ii = 0; ii < 64; ++ii)
+		{
+			char c = data[block * 64 + ii];
+			if (c == '\"')
+				masks.quote |= uint64_t(1) << ii;
+			else if (c == '\\')
+				masks.backslash |= uint64_t(1) << ii;
+			else if (c == '[' || c == ']' || c == '{' || c == '}')
+				masks.bracket |= uint64_t(1) << ii;
+			else if (c == ',')
+				masks.comma |= uint64_t(1) << ii;
+		}
+		out[block] = masks;
+	}
+}
+
+#if ACP_GLTF_X86
+static void classify_section_blocks_sse2(const char* data, size_t block_count, section_masks* out)
+{
+	const __m128i quote = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i lower_case_bit = _mm_set1_epi8(0x20);
+	const __m128i open_curly = _mm_set1_epi8('{');
+	const __m128i close_curly = _mm_set1_epi8('}');
+	const __m128i comma = _mm_set1_epi8(',');
+
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		section_masks masks{};
+		for (uint32_t ii = 0; ii < 4; ++ii)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + block * 64 + ii * 16));
+			__m128i folded = _mm_or_si128(v, lower_case_bit);
+			__m128i bracket = _mm_or_si128(_mm_cmpeq_epi8(folded, open_curly), _mm_cmpeq_epi8(folded, close_curly));
+
+			masks.quote |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << (ii * 16);
+			masks.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << (ii * 16);
+			masks.bracket |= uint64_t(uint32_t(_mm_movemask_epi8(bracket))) << (ii * 16);
+			masks.comma |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma)))) << (ii * 16);
+		}
+		out[block] = masks;
+	}
+}
+
+ACP_GLTF_TARGET_AVX2 static void classify_section_blocks_avx2(const char* data, size_t block_count, section_masks* out)
+{
+	const __m256i quote = _mm256_set1_epi8('\"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i lower_case_bit = _mm256_set1_epi8(0x20);
+	const __m256i open_curly = _mm256_set1_epi8('{');
+	const __m256i close_curly = _mm256_set1_epi8('}');
+	const __m256i comma = _mm256_set1_epi8(',');
+
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		section_masks masks{};
+		for (uint32_t ii = 0; ii < 2; ++ii)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + block * 64 + ii * 32));
+			__m256i folded = _mm256_or_si256(v, lower_case_bit);
+			__m256i bracket = _mm256_or_si256(_mm256_cmpeq_epi8(folded, open_curly), _mm256_cmpeq_epi8(folded, close_curly));
+
+			masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << (ii * 32);
+			masks.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << (ii * 32);
+			masks.bracket |= uint64_t(uint32_t(_mm256_movemask_epi8(bracket))) << (ii * 32);
+			masks.comma |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, comma)))) << (ii * 32);
+		}
+		out[block] = masks;
+	}
+}
+#endif
+
+static classify_section_blocks_type classify_section_blocks_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend == acp_vulkan::gltf_scan_backend::avx2)
+		return classify_section_blocks_avx2;
+	if (backend == acp_vulkan::gltf_scan_backend::sse2)
+		return classify_section_blocks_sse2;
+#endif
+	return classify_section_blocks_scalar;
+}
+
+// Bit i is set when an odd number of quotes is at or before i, that is from an opening quote up to the character before the closing one.
+static uint64_t prefix_xor(uint64_t bits)
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+#define SECTION_MASK_BATCH_BLOCKS 64
+
+// Bracket matching over whole blocks, the string mask comes from the quote bits so only brackets, and commas and keys near the top level, are
+// visited one by one. Returns false when the JSON is malformed, the main pass then reports the error.
+static bool find_parallel_sections(parallel_sections* out, size_t chunk_size)
+{
+	section_masks batch[SECTION_MASK_BATCH_BLOCKS];
+	size_t block_count = (out->data_size + 63) / 64;
+
+	size_t depth = 0;
+	uint64_t in_string_carry = 0;
+	uint64_t backslash_carry = 0;
+	bool in_key = false;
+	bool expect_key = false;
+	token_types key = token_types::none;
+	size_t key_location = 0;
+	bool in_section = false;
+	section_range section{};
+	size_t chunk_begin = 0;
+	section_chunk chunk{};
+
+	size_t root = 0;
+	while (root < out->data_size && char_classes.classes[uint8_t(out->data[root])] == char_class::whitespace)
+		++root;
+	if (root == out->data_size || out->data[root] != '{')
+		return false;
+
+	for (size_t first_block = 0; first_block < block_count; first_block += SECTION_MASK_BATCH_BLOCKS)
+	{
+		size_t batch_blocks = block_count - first_block < SECTION_MASK_BATCH_BLOCKS ? block_count - first_block : SECTION_MASK_BATCH_BLOCKS;
+		size_t full_blocks = batch_blocks;
+		if ((first_block + full_blocks) * 64 > out->data_size)
+			full_blocks--;
+		out->classify_section_blocks(out->data + first_block * 64, full_blocks, batch);
+		if (full_blocks != batch_blocks)
+		{
+			char tail[64]{};
+			size_t tail_start = (first_block + full_blocks) * 64;
+			memcpy(tail, out->data + tail_start, out->data_size - tail_start);
+			out->classify_section_blocks(tail, 1, batch + full_blocks);
+		}
+
+		for (size_t ii = 0; ii < batch_blocks; ++ii)
+		{
+			const section_masks& masks = batch[ii];
+			size_t block_start = (first_block + ii) * 64;
+
+			uint64_t quotes = masks.quote;
+			uint64_t maybe_escaped = quotes & ((masks.backslash << 1) | backslash_carry);
+			backslash_carry = masks.backslash >> 63;
+			while (maybe_escaped)
+			{
+				uint32_t bit = count_trailing_zeros(maybe_escaped);
+				maybe_escaped &= maybe_escaped - 1;
+				if (is_escaped(out->data, 0, block_start + bit))
+					quotes &= ~(uint64_t(1) << bit);
+			}
+
+			uint64_t in_string = prefix_xor(quotes) ^ in_string_carry;
+			in_string_carry = uint64_t(0) - (in_string >> 63);
+			uint64_t brackets = masks.bracket & ~in_string;
+			uint64_t commas = masks.comma & ~in_string;
+
+			// Deep in the document only brackets change anything, most blocks are skipped here.
+			if (depth > 2 && !brackets)
+				continue;
+
+			uint64_t remaining = ~uint64_t(0);
+			for (;;)
+			{
+				uint64_t events = brackets;
+				if (depth == 1)
+					events |= commas | quotes;
+				else if (depth == 2 && in_section && block_start + 64 - chunk_begin > chunk_size)
+					events |= commas;
+				events &= remaining;
+				if (!events)
+					break;
+
+				uint32_t bit = count_trailing_zeros(events);
+				remaining = bit == 63 ? 0 : ~uint64_t(0) << (bit + 1);
+				size_t location = block_start + bit;
+				char c = out->data[location];
+
+				switch (c)
+				{
+					case '\"':
+					{
+						if (!in_key)
+						{
+							in_key = expect_key;
+							key_location = location + 1;
+						}
+						else
+						{
+							key = lookup_key(out->data + key_location, location - key_location);
+							in_key = false;
+							expect_key = false;
+						}
+						break;
+					}
+					case '{':
+					case '[':
+					{
+						if (depth == 0 && location != root)
+							return false;
+						++depth;
+						if (depth == 1)
+							expect_key = true;
+						else if (depth == 2 && c == '[' && section_chunk_functions(key, &chunk.parse, &chunk.release))
+						{
+							in_section = true;
+							section = { .key_location = key_location, .first_chunk = out->chunks.data_length };
+							chunk.section = out->sections.data_length;
+							chunk_begin = location + 1;
+						}
+						break;
+					}
+					case '}':
+					case ']':
+					{
+						if (depth == 0)
+							return false;
+						--depth;
+						if (depth == 1 && in_section)
+						{
+							chunk.begin = chunk_begin;
+							chunk.end = location;
+							out->chunks.emplace_back(section_chunk(chunk));
+							section.value_end = location + 1;
+							section.chunk_count = out->chunks.data_length - section.first_chunk;
+							out->sections.emplace_back(section_range(section));
+							in_section = false;
+						}
+						if (depth == 0)
+							return true;
+						break;
+					}
+					case ',':
+					{
+						if (depth == 1)
+						{
+							expect_key = true;
+							key = token_types::none;
+						}
+						else if (location - chunk_begin >= chunk_size)
+						{
+							// The comma stays with the next chunk, the element parsers skip it the same way they do inside the array.
+							chunk.begin = chunk_begin;
+							chunk.end = location;
+							out->chunks.emplace_back(section_chunk(chunk));
+							chunk_begin = location;
+						}
+						break;
+					}
+					default:
+						break;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+static void parse_section_chunk_job(void* job_data, size_t job_index)
+{
+	parallel_sections* sections = reinterpret_cast<parallel_sections*>(job_data);
+	section_chunk* chunk = &sections->chunks.data[job_index];
+
+	chunk->allocator = sections->data_allocator;
+	if (sections->use_arenas)
+	{
+		chunk->arena = arena_create(chunk->end - chunk->begin, sections->arena_host_allocator);
+		if (!chunk->arena)
+		{
+			chunk->result = return_value::error_value;
+			return;
+		}
+		chunk->allocator = &chunk->arena->callbacks;
+	}
+
+	tokenizer_state state{
+		.data = sections->data,
+		.data_size = chunk->end,
+		.next_char = chunk->begin,
+		.host_allocator = chunk->allocator,
+		.classify_blocks = sections->classify_blocks,
+		.strings_in_source = sections->strings_in_source,
+		.chunk_end_is_eof = true,
+	};
+
+	chunk->result = chunk->parse(&state, chunk);
+	chunk->tokens_lexed = state.tokens_lexed;
+}
+
+// Moves the blocks of a chunk arena under the current block of the gltf_data arena.
+static void arena_adopt(acp_vulkan::gltf_arena* arena, acp_vulkan::gltf_arena* child)
+{
+	acp_vulkan::gltf_arena::block* newest = child->current;
+	if (newest)
+	{
+		acp_vulkan::gltf_arena::block* oldest = newest;
+		while (oldest->previous)
+			oldest = oldest->previous;
+
+		if (arena->current)
+		{
+			oldest->previous = arena->current->previous;
+			arena->current->previous = newest;
+		}
+		else
+			arena->current = newest;
+	}
+
+	child->current = nullptr;
+	arena_release(child);
+}
+
+static void release_parallel_sections(parallel_sections* sections, VkAllocationCallbacks*)
+{
+	for (size_t ii = 0; ii < sections->chunks.data_length; ++ii)
+	{
+		section_chunk* chunk = &sections->chunks.data[ii];
+		if (chunk->elements)
+			chunk->release(chunk);
+		if (chunk->arena)
+		{
+			if (sections->owner->arena)
+				arena_adopt(sections->owner->arena, chunk->arena);
+			else
+				arena_release(chunk->arena);
+			chunk->arena = nullptr;
+		}
+	}
+}
+
+static size_t find_parallel_section(parallel_sections* sections, const token& key)
+{
+	size_t key_location = size_t(key.view.data - sections->data);
+	for (size_t ii = 0; ii < sections->sections.data_length; ++ii)
+		if (sections->sections.data[ii].key_location == key_location)
+			return ii;
+	return SIZE_MAX;
+}
+
+// Stitches the chunks of a section parsed by the jobs in to one array and moves the main pass past the section, false_value when a chunk failed.
+template<typename T>
+static pair<temp_data_view<T>, return_value> take_parsed_section(tokenizer_state* state, parallel_sections* sections, size_t section_index)
+{
+	section_range* section = &sections->sections.data[section_index];
+
+	temp_data_view<T> out{};
+	out.host_allocator = state->host_allocator;
+
+	size_t element_count = 0;
+	for (size_t ii = section->first_chunk; ii < section->first_chunk + section->chunk_count; ++ii)
+	{
+		section_chunk* chunk = &sections->chunks.data[ii];
+		if (chunk->result != return_value::true_value)
+			return { {}, return_value::false_value };
+		element_count += chunk->element_count;
+	}
+
+	if (element_count)
+		out.reserve(element_count);
+	for (size_t ii = section->first_chunk; ii < section->first_chunk + section->chunk_count; ++ii)
+	{
+		section_chunk* chunk = &sections->chunks.data[ii];
+		data_view<T> elements{ .data = reinterpret_cast<T*>(chunk->elements), .data_length = chunk->element_count };
+		for (size_t jj = 0; jj < elements.data_length; ++jj)
+			out.emplace_back(std::move(elements.data[jj]));
+		free_gltf_buffer(elements, chunk->allocator);
+		chunk->elements = nullptr;
+		chunk->element_count = 0;
+	}
+
+	state->next_char = section->value_end;
+	state->has_lookahead = false;
+	return { std::move(out), return_value::true_value };
+}
+
+template<typename T, typename F>
+static pair<temp_data_view<T>, return_value> parse_or_take_section(tokenizer_state* state, parallel_sections* sections, const token& key, F parse_element)
+{
+	size_t section_index = sections ? find_parallel_section(sections, key) : SIZE_MAX;
+	if (section_index != SIZE_MAX)
+	{
+		auto taken = take_parsed_section<T>(state, sections, section_index);
+		if (taken.second == return_value::true_value)
+			return taken;
+	}
+	// Malformed elements are recovered from differently once the whole array is in view, a failed chunk parses its section again here.
+	return parse_elements<T>(state, parse_element);
+}
+
+// Data uris are decoded in slices so one large buffer spreads over every thread, the outputs are allocated up front on the calling thread.
+#define BASE64_SLICE_SIZE (1024 * 1024)
+
+struct base64_slice
+{
+	const char* input;
+	size_t input_length;
+	uint8_t* output;
+};
+
+struct base64_slices
+{
+	temp_data_view<base64_slice> slices;
+	base64_decode_type decode;
+};
+
+static data_view<uint8_t> queue_base64_decode(base64_slices* slices, string_view input, VkAllocationCallbacks* host_allocator)
+{
+	size_t decoded_size = base64_decoded_size(input);
+	if (decoded_size == 0)
+		return {};
+
+	// Room for the padding bytes too, the decoders write whole groups.
+	temp_data_view<uint8_t> out{};
+	out.host_allocator = host_allocator;
+	out.reserve(input.data_length / 4 * 3);
+	if (!out.data)
+		return {};
+
+	for (size_t offset = 0; offset < input.data_length; offset += BASE64_SLICE_SIZE)
+	{
+		size_t length = input.data_length - offset < BASE64_SLICE_SIZE ? input.data_length - offset : BASE64_SLICE_SIZE;
+		slices->slices.emplace_back(base64_slice{ .input = input.data + offset, .input_length = length, .output = out.data + offset / 4 * 3 });
+	}
+
+	out.data_length = decoded_size;
+	return out.to();
+}
+
+static void decode_base64_slice_job(void* job_data, size_t job_index)
+{
+	base64_slices* slices = reinterpret_cast<base64_slices*>(job_data);
+	const base64_slice& slice = slices->slices.data[job_index];
+	slices->decode(slice.input, slice.input_length, slice.output);
+}
+
+// Allocates embedded_bytes for the buffers or images with a data uri and queues their slices.
+template<typename T>
+static void queue_embedded_data(base64_slices* embedded, data_view<T> items, VkAllocationCallbacks* data_allocator, bool strings_in_source)
+{
+	for (size_t ii = 0; ii < items.data_length; ++ii)
+	{
+		T& item = items.data[ii];
+		auto embaded_data = get_embedded_data(item.uri);
+		if (embaded_data.first.data && embaded_data.second.data)
+		{
+			item.embedded_bytes = queue_base64_decode(embedded, embaded_data.second, data_allocator);
+			if (item.embedded_bytes.data && item.embedded_bytes.data_length != 0)
+				item.embedded_mime = strings_in_source ? embaded_data.first : copy(embaded_data.first, data_allocator);
+		}
+	}
+}
+
+static void decode_embedded_data(base64_slices* embedded, bool parallel)
+{
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if (parallel && embedded->slices.data_length > 1 && has_workers)
+		run_parsing_jobs(decode_base64_slice_job, embedded, embedded->slices.data_length);
+	else
+		for (size_t ii = 0; ii < embedded->slices.data_length; ++ii)
+			decode_base64_slice_job(embedded, ii);
+}
+
+static uint32_t hex_digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return uint32_t(c - '0');
+	if (c >= 'a' && c <= 'f')
+		return uint32_t(c - 'a' + 10);
+	if (c >= 'A' && c <= 'F')
+		return uint32_t(c - 'A' + 10);
+	return UINT32_MAX;
+}
+
+static bool read_utf16_unit(const char* data, size_t data_length, size_t location, uint32_t* out)
+{
+	if (location + 6 > data_length || data[location] != '\\' || data[location + 1] != 'u')
+		return false;
+
+	uint32_t value = 0;
+	for (size_t ii = 0; ii < 4; ++ii)
+	{
+		uint32_t digit = hex_digit_value(data[location + 2 + ii]);
+		if (digit == UINT32_MAX)
+			return false;
+		value = value * 16 + digit;
+	}
+	*out = value;
+	return true;
+}
+
+size_t acp_vulkan::gltf_string_unescape(gltf_data::string_view in, char* out)
+{
+	const char* backslash = reinterpret_cast<const char*>(memchr(in.data, '\\', in.data_length));
+	if (!backslash)
+	{
+		memcpy(out, in.data, in.data_length);
+		return in.data_length;
+	}
+
+	size_t out_length = size_t(backslash - in.data);
+	memcpy(out, in.data, out_length);
+	for (size_t ii = out_length; ii < in.data_length; ++ii)
+	{
+		char c = in.data[ii];
+		if (c != '\\' || ii + 1 == in.data_length)
+		{
+			out[out_length++] = c;
+			continue;
+		}
+
+		char escaped = in.data[++ii];
+		switch (escaped)
+		{
+			case 'b': out[out_length++] = '\b'; break;
+			case 'f': out[out_length++] = '\f'; break;
+			case 'n': out[out_length++] = '\n'; break;
+			case 'r': out[out_length++] = '\r'; break;
+			case 't': out[out_length++] = '\t'; break;
+			case 'u':
+			{
+				uint32_t code_point = 0;
+				if (!read_utf16_unit(in.data, in.data_length, ii - 1, &code_point))
+				{
+					out[out_length++] = '\\';
+					out[out_length++] = escaped;
+					break;
+				}
+				ii += 4;
+
+				uint32_t low_surrogate = 0;
+				if (code_point >= 0xD800 && code_point < 0xDC00 && read_utf16_unit(in.data, in.data_length, ii + 1, &low_surrogate) && low_surrogate >= 0xDC00 && low_surrogate < 0xE000)
+				{
+					code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+					ii += 6;
+				}
+
+				// Never longer than the escape it came from, 6 bytes in for up to 3 out or 12 in for 4 out.
+				if (code_point < 0x80)
+					out[out_length++] = char(code_point);
+				else if (code_point < 0x800)
+				{
+					out[out_length++] = char(0xC0 | (code_point >> 6));
+					out[out_length++] = char(0x80 | (code_point & 0x3F));
+				}
+				else if (code_point < 0x10000)
+				{
+					out[out_length++] = char(0xE0 | (code_point >> 12));
+					out[out_length++] = char(0x80 | ((code_point >> 6) & 0x3F));
+					out[out_length++] = char(0x80 | (code_point & 0x3F));
+				}
+				else
+				{
+					out[out_length++] = char(0xF0 | (code_point >> 18));
+					out[out_length++] = char(0x80 | ((code_point >> 12) & 0x3F));
+					out[out_length++] = char(0x80 | ((code_point >> 6) & 0x3F));
+					out[out_length++] = char(0x80 | (code_point & 0x3F));
+				}
+				break;
+			}
+			default:
+				// \", \\ and \/ stand for the character itself.
+				out[out_length++] = escaped;
+		}
+	}
+	return out_length;
+}
+
+// Parses the value of a top level key in to out, unknown keys are skipped. The section that was read is added to found_sections.
+static return_value parse_top_level_value(tokenizer_state* state, const token& key, acp_vulkan::gltf_data* out, parallel_sections* parallel_ready, acp_vulkan::gltf_sections* found_sections)
+{
+	switch (key.type)
+	{
+		GLTF_SECTION(token_types::bufferViews, acp_vulkan::gltf_section_buffer_views, buffer_views, acp_vulkan::gltf_data::buffer_view, parse_buffer_view);
+		GLTF_SECTION(token_types::buffers, acp_vulkan::gltf_section_buffers, buffers, acp_vulkan::gltf_data::buffer, parse_buffer);
+		GLTF_SECTION(token_types::images, acp_vulkan::gltf_section_images, images, acp_vulkan::gltf_data::image, parse_image);
+		GLTF_SECTION(token_types::accessors, acp_vulkan::gltf_section_accessors, accesors, acp_vulkan::gltf_data::accesor, parse_accesor);
+		GLTF_SECTION(token_types::textures, acp_vulkan::gltf_section_textures, textures, acp_vulkan::gltf_data::texture, parse_texture);
+		GLTF_SECTION(token_types::meshes, acp_vulkan::gltf_section_meshes, meshes, acp_vulkan::gltf_data::mesh, parse_mesh);
+		GLTF_SECTION(token_types::materials, acp_vulkan::gltf_section_materials, materials, acp_vulkan::gltf_data::material, parse_material);
+		GLTF_SECTION(token_types::nodes, acp_vulkan::gltf_section_nodes, nodes, acp_vulkan::gltf_data::node, parse_node);
+		GLTF_SECTION(token_types::scenes, acp_vulkan::gltf_section_scenes, scenes, acp_vulkan::gltf_data::scene, parse_scene);
+		GLTF_SECTION(token_types::samplers, acp_vulkan::gltf_section_samplers, samplers, acp_vulkan::gltf_data::sampler, parse_sampler);
+		GLTF_SECTION(token_types::skins, acp_vulkan::gltf_section_skins, skins, acp_vulkan::gltf_data::skin, parse_skin);
+		GLTF_SECTION(token_types::cameras, acp_vulkan::gltf_section_cameras, cameras, acp_vulkan::gltf_data::camera, parse_camera);
+		GLTF_SECTION(token_types::animations, acp_vulkan::gltf_section_animations, animations, acp_vulkan::gltf_data::animation, parse_animation);
+		case token_types::asset:
+		{
+			auto asset = parse_asset(state);
+			if (asset.second != return_value::true_value)
+				return return_value::error_value;
+			out->asset = asset.first;
+			*found_sections |= acp_vulkan::gltf_section_asset;
+			break;
+		}
+		case token_types::scene:
+		{
+			if (expect_ordered_and_discard_tokens(state, { token_types::colon }) == return_value::error_value)
+				return return_value::error_value;
+
+			token default_scene = next_token(state);
+			if (default_scene.type != token_types::is_int)
+				return return_value::error_value;
+			out->default_scene = uint32_t(default_scene.value.as_int);
+			out->has_defautl_scene = true;
+			*found_sections |= acp_vulkan::gltf_section_scene;
+			break;
+		}
+		default:
+			skip_object_and_arries_if_found(state);
+	}
+	return return_value::true_value;
+}
+
+// Takes ownership of source, when set data has to point in to it.
+static acp_vulkan::gltf_data gltf_json_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator, acp_vulkan::gltf_load_flags load_flags, acp_vulkan::gltf_source* source)
+{
+	acp_vulkan::gltf_data out{};
+	out.source = source;
+	on_scope_end<decltype(out)> release_source_on_failure(&out, release_source_of, nullptr);
+	assert(!source || (data >= source->data && data + data_size <= source->data + source->data_size));
+
+	if (load_flags & acp_vulkan::gltf_load_arena_allocation)
+	{
+		out.arena = arena_create(data_size, host_allocator);
+		if (!out.arena)
+			return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = 0 };
+	}
+	on_scope_end<decltype(out)> release_arena_on_failure(&out, release_arena_of, nullptr);
+	VkAllocationCallbacks* data_allocator = out.arena ? &out.arena->callbacks : (source ? &source->callbacks : host_allocator);
+
+	tokenizer_state state{
+		.data = data,
+		.data_size = data_size,
+		.host_allocator = data_allocator,
+		.classify_blocks = classify_blocks_for(acp_vulkan::gltf_get_scan_backend()),
+		.strings_in_source = source && (load_flags & acp_vulkan::gltf_load_strings_in_source),
+	};
+
+	parallel_sections sections{
+		.data = data,
+		.data_size = data_size,
+		.classify_blocks = state.classify_blocks,
+		.classify_section_blocks = classify_section_blocks_for(acp_vulkan::gltf_get_scan_backend()),
+		.strings_in_source = state.strings_in_source,
+		.data_allocator = data_allocator,
+		.arena_host_allocator = host_allocator,
+		.use_arenas = out.arena != nullptr,
+		.owner = &out,
+	};
+	sections.sections.host_allocator = host_allocator;
+	sections.chunks.host_allocator = host_allocator;
+	on_scope_end<parallel_sections> release_sections(&sections, release_parallel_sections, nullptr);
+
+	// The main pass below still reads everything outside the array sections, it picks up the parsed chunks when it reaches their keys.
+	parallel_sections* parallel_ready = nullptr;
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((load_flags & acp_vulkan::gltf_load_parallel_sections) && has_workers && data_size >= MIN_PARALLEL_INPUT_SIZE)
+	{
+		size_t chunk_size = data_size / (size_t(parsing_thread_count()) * 4);
+		if (chunk_size < MIN_SECTION_CHUNK_SIZE)
+			chunk_size = MIN_SECTION_CHUNK_SIZE;
+
+		if (find_parallel_sections(&sections, chunk_size) && sections.chunks.data_length > 1)
+		{
+			run_parsing_jobs(parse_section_chunk_job, &sections, sections.chunks.data_length);
+			for (size_t ii = 0; ii < sections.chunks.data_length; ++ii)
+				out.parsing_stats.tokens_lexed += sections.chunks.data[ii].tokens_lexed;
+			parallel_ready = &sections;
+		}
+	}
+
+	if (expect(&state, next_token(&state), token_types::open_curly) == return_value::error_value)
+		return {.gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char};
+
+	acp_vulkan::gltf_sections found_sections = 0;
+	pair<acp_vulkan::gltf_sections, acp_vulkan::gltf_data::gltf_state_type> mandatory_sections[] = {
+		{acp_vulkan::gltf_section_asset, acp_vulkan::gltf_data::missing_asset_section }
+	};
+	while (true)
+	{
+		token t = next_token(&state);
+		if (t.type == token_types::none)
+		{
+			return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };
+			assert(false);
+		}
+
+		if (parse_top_level_value(&state, t, &out, parallel_ready, &found_sections) == return_value::error_value)
+		{
+			acp_vulkan::gltf_data_free(&out, state.host_allocator);
+			return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };
+		}
+
+		if (t.type == token_types::eof)
+			break;
+	}
+
+	for (auto ii : mandatory_sections)
+	{
+		if (!(found_sections & ii.first))
+		{
+			return { .gltf_state = ii.second, .parsing_error_location = 0 };
+			assert(false);
+		}
+	}
+
+	base64_slices embedded{ .decode = base64_decode_for(acp_vulkan::gltf_get_scan_backend()) };
+	embedded.slices.host_allocator = host_allocator;
+	queue_embedded_data(&embedded, out.buffers, data_allocator, state.strings_in_source);
+	queue_embedded_data(&embedded, out.images, data_allocator, state.strings_in_source);
+	decode_embedded_data(&embedded, load_flags & acp_vulkan::gltf_load_parallel_sections);
+
+	out.gltf_state = acp_vulkan::gltf_data::gltf_state_type::valid;
+	out.parsing_stats.tokens_lexed += state.tokens_lexed;
+	out.parsing_stats.bytes_consumed = state.next_char;
+
+	release_arena_on_failure.drop();
+	release_source_on_failure.drop();
+
+	return out;
+}
+
+acp_vulkan::gltf_data acp_vulkan::gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags)
+{
+	gltf_source* source = nullptr;
+	if (load_flags & gltf_load_strings_in_source)
+	{
+		source = source_create(data, data_size, false, host_allocator);
+		if (!source)
+			return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = 0 };
+		data = source->data;
+	}
+
+	return gltf_json_from_memory(data, data_size, host_allocator, load_flags, source);
+}
+
+#define MIN_STREAM_BUFFER_SIZE (64 * 1024)
+
+struct acp_vulkan::gltf_stream_parser
+{
+	acp_vulkan::gltf_data out{};
+	acp_vulkan::gltf_sections sections{ 0 };
+	VkAllocationCallbacks* host_allocator{ nullptr };
+	// The arena callbacks with gltf_load_arena_allocation, host_allocator otherwise.
+	VkAllocationCallbacks* data_allocator{ nullptr };
+	acp_vulkan::gltf_load_flags load_flags{ 0 };
+	classify_blocks_type classify_blocks{ nullptr };
+	classify_section_blocks_type classify_section_blocks{ nullptr };
+
+	// Input that is not parsed yet, buffer[0] is input byte discarded. Parsed bytes are dropped in whole blocks so the scan stays block aligned.
+	char* buffer{ nullptr };
+	size_t buffer_size{ 0 };
+	size_t buffer_capacity{ 0 };
+	size_t discarded{ 0 };
+
+	// Bracket matching over the whole blocks received so far, complete_end is just past the last top level comma or the closing curly.
+	// Once the root is closed the rest is only buffered for finish.
+	size_t scanned{ 0 };
+	size_t depth{ 0 };
+	uint64_t in_string_carry{ 0 };
+	uint64_t backslash_carry{ 0 };
+	bool closed{ false };
+	size_t complete_end{ 0 };
+
+	// Where the tokenizer continues from, and the complete_end the entry there last failed to parse at.
+	size_t parse_location{ 0 };
+	size_t failed_end{ 0 };
+	bool opened{ false };
+	size_t tokens_lexed{ 0 };
+
+	acp_vulkan::gltf_data::gltf_state_type state{ acp_vulkan::gltf_data::valid };
+	size_t error_location{ 0 };
+};
+
+static void stream_parser_release(acp_vulkan::gltf_stream_parser* parser)
+{
+	VkAllocationCallbacks* host_allocator = parser->host_allocator;
+	if (host_allocator)
+	{
+		if (parser->buffer)
+			host_allocator->pfnFree(host_allocator->pUserData, parser->buffer);
+		host_allocator->pfnFree(host_allocator->pUserData, parser);
+	}
+	else
+	{
+		delete[] parser->buffer;
+		delete parser;
+	}
+}
+
+static void fail_stream(acp_vulkan::gltf_stream_parser* parser, size_t location)
+{
+	parser->state = acp_vulkan::gltf_data::parsing_error;
+	parser->error_location = parser->discarded + location;
+	acp_vulkan::gltf_data_free(&parser->out, parser->host_allocator);
+}
+
+static bool reserve_stream_buffer(acp_vulkan::gltf_stream_parser* parser, size_t data_size)
+{
+	if (parser->buffer_size + data_size <= parser->buffer_capacity)
+		return true;
+
+	// Only the entries still arriving are kept, drop the parsed blocks before growing.
+	size_t dropped = parser->parse_location / 64 * 64;
+	if (dropped)
+	{
+		memmove(parser->buffer, parser->buffer + dropped, parser->buffer_size - dropped);
+		parser->buffer_size -= dropped;
+		parser->scanned -= dropped;
+		parser->complete_end -= dropped;
+		parser->parse_location -= dropped;
+		parser->failed_end = parser->failed_end > dropped ? parser->failed_end - dropped : 0;
+		parser->discarded += dropped;
+		if (parser->buffer_size + data_size <= parser->buffer_capacity)
+			return true;
+	}
+
+	size_t capacity = parser->buffer_capacity * 2;
+	if (capacity < parser->buffer_size + data_size)
+		capacity = parser->buffer_size + data_size;
+	if (capacity < MIN_STREAM_BUFFER_SIZE)
+		capacity = MIN_STREAM_BUFFER_SIZE;
+
+	VkAllocationCallbacks* host_allocator = parser->host_allocator;
+	char* buffer = host_allocator ?
+		reinterpret_cast<char*>(host_allocator->pfnAllocation(host_allocator->pUserData, capacity, 64, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new char[capacity];
+	if (!buffer)
+		return false;
+
+	if (parser->buffer)
+	{
+		memcpy(buffer, parser->buffer, parser->buffer_size);
+		if (host_allocator)
+			host_allocator->pfnFree(host_allocator->pUserData, parser->buffer);
+		else
+			delete[] parser->buffer;
+	}
+	parser->buffer = buffer;
+	parser->buffer_capacity = capacity;
+	return true;
+}
+
+// Classifies the whole blocks received since the last scan, and the partial last one at the end of the input, to move complete_end.
+// Strings are tracked like find_parallel_sections does, only brackets and the commas between top level entries matter here.
+static void scan_stream(acp_vulkan::gltf_stream_parser* parser, bool end_of_input)
+{
+	section_masks batch[SECTION_MASK_BATCH_BLOCKS];
+	size_t block_end = end_of_input ? (parser->buffer_size + 63) / 64 : parser->buffer_size / 64;
+
+	for (size_t first_block = parser->scanned / 64; first_block < block_end && !parser->closed; first_block += SECTION_MASK_BATCH_BLOCKS)
+	{
+		size_t batch_blocks = block_end - first_block < SECTION_MASK_BATCH_BLOCKS ? block_end - first_block : SECTION_MASK_BATCH_BLOCKS;
+		size_t full_blocks = batch_blocks;
+		if ((first_block + full_blocks) * 64 > parser->buffer_size)
+			full_blocks--;
+		parser->classify_section_blocks(parser->buffer + first_block * 64, full_blocks, batch);
+		if (full_blocks != batch_blocks)
+		{
+			char tail[64]{};
+			size_t tail_start = (first_block + full_blocks) * 64;
+			memcpy(tail, parser->buffer + tail_start, parser->buffer_size - tail_start);
+			parser->classify_section_blocks(tail, 1, batch + full_blocks);
+		}
+
+		for (size_t ii = 0; ii < batch_blocks && !parser->closed; ++ii)
+		{
+			const section_masks& masks = batch[ii];
+			size_t block_start = (first_block + ii) * 64;
+
+			uint64_t quotes = masks.quote;
+			uint64_t maybe_escaped = quotes & ((masks.backslash << 1) | parser->backslash_carry);
+			parser->backslash_carry = masks.backslash >> 63;
+			while (maybe_escaped)
+			{
+				uint32_t bit = count_trailing_zeros(maybe_escaped);
+				maybe_escaped &= maybe_escaped - 1;
+				if (is_escaped(parser->buffer, 0, block_start + bit))
+					quotes &= ~(uint64_t(1) << bit);
+			}
+
+			uint64_t in_string = prefix_xor(quotes) ^ parser->in_string_carry;
+			parser->in_string_carry = uint64_t(0) - (in_string >> 63);
+			uint64_t brackets = masks.bracket & ~in_string;
+			uint64_t commas = masks.comma & ~in_string;
+
+			// Inside the sections only brackets change anything, most blocks are skipped here.
+			if (parser->depth > 1 && !brackets)
+				continue;
+
+			uint64_t remaining = ~uint64_t(0);
+			for (;;)
+			{
+				uint64_t events = (parser->depth == 1 ? brackets | commas : brackets) & remaining;
+				if (!events)
+					break;
+
+				uint32_t bit = count_trailing_zeros(events);
+				remaining = bit == 63 ? 0 : ~uint64_t(0) << (bit + 1);
+				size_t location = block_start + bit;
+				char c = parser->buffer[location];
+
+				if (c == ',')
+					parser->complete_end = location + 1;
+				else if (c == '{' || c == '[')
+					++parser->depth;
+				else if (parser->depth <= 1)
+				{
+					// The root closed (or a stray bracket did), the tokenizer takes it from here.
+					parser->depth = 0;
+					parser->closed = true;
+					parser->complete_end = location + 1;
+					break;
+				}
+				else
+					--parser->depth;
+			}
+		}
+	}
+
+	size_t scanned = block_end * 64;
+	parser->scanned = scanned < parser->buffer_size ? scanned : parser->buffer_size;
+}
+
+// Parses the top level entries that are complete, the tokenizer never reads past complete_end. Before the end of the input an entry that fails
+// is parsed again once more arrives: a bracket out of place in malformed input moves complete_end in to it, and gltf_data_from_memory would read on.
+static void parse_stream_entries(acp_vulkan::gltf_stream_parser* parser, bool end_of_input)
+{
+	if (parser->state != acp_vulkan::gltf_data::valid || parser->parse_location >= parser->complete_end)
+		return;
+
+	// The failed entry is tried again once its span has doubled, so the retries stay linear in its size.
+	size_t failed_span = parser->failed_end > parser->parse_location ? parser->failed_end - parser->parse_location : 0;
+	if (!end_of_input && parser->complete_end - parser->parse_location < 2 * failed_span)
+		return;
+
+	tokenizer_state state{
+		.data = parser->buffer,
+		.data_size = parser->complete_end,
+		.next_char = parser->parse_location,
+		.host_allocator = parser->data_allocator,
+		.classify_blocks = parser->classify_blocks,
+		.chunk_end_is_eof = true,
+	};
+
+	if (!parser->opened)
+	{
+		if (expect(&state, next_token(&state), token_types::open_curly) == return_value::error_value)
+		{
+			fail_stream(parser, state.next_char);
+			return;
+		}
+		parser->opened = true;
+	}
+
+	acp_vulkan::gltf_sections found_sections = 0;
+	size_t entry_start = state.next_char;
+	while (true)
+	{
+		token t = next_token(&state);
+		if (t.type == token_types::eof)
+		{
+			entry_start = state.next_char;
+			break;
+		}
+
+		if (t.type == token_types::none || parse_top_level_value(&state, t, &parser->out, nullptr, &found_sections) == return_value::error_value)
+		{
+			if (end_of_input)
+			{
+				fail_stream(parser, state.next_char);
+				return;
+			}
+			parser->failed_end = parser->complete_end;
+			break;
+		}
+		entry_start = state.next_char;
+	}
+
+	parser->parse_location = entry_start;
+	parser->tokens_lexed += state.tokens_lexed;
+
+	// The caller can start on the buffers and images as soon as they are in, decode their data uris now.
+	if (found_sections & (acp_vulkan::gltf_section_buffers | acp_vulkan::gltf_section_images))
+	{
+		base64_slices embedded{ .decode = base64_decode_for(acp_vulkan::gltf_get_scan_backend()) };
+		embedded.slices.host_allocator = parser->host_allocator;
+		if (found_sections & acp_vulkan::gltf_section_buffers)
+			queue_embedded_data(&embedded, parser->out.buffers, parser->data_allocator, false);
+		if (found_sections & acp_vulkan::gltf_section_images)
+			queue_embedded_data(&embedded, parser->out.images, parser->data_allocator, false);
+		decode_embedded_data(&embedded, parser->load_flags & acp_vulkan::gltf_load_parallel_sections);
+	}
+
+	parser->sections |= found_sections;
+}
+
+acp_vulkan::gltf_stream_parser* acp_vulkan::gltf_stream_parser_create(VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags, size_t size_hint)
+{
+	gltf_stream_parser* parser = host_allocator ?
+		reinterpret_cast<gltf_stream_parser*>(host_allocator->pfnAllocation(host_allocator->pUserData, sizeof(gltf_stream_parser), alignof(gltf_stream_parser), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new gltf_stream_parser;
+	if (!parser)
+		return nullptr;
+
+	*parser = {
+		.host_allocator = host_allocator,
+		.data_allocator = host_allocator,
+		.load_flags = load_flags,
+		.classify_blocks = classify_blocks_for(gltf_get_scan_backend()),
+		.classify_section_blocks = classify_section_blocks_for(gltf_get_scan_backend()),
+	};
+
+	if (load_flags & gltf_load_arena_allocation)
+	{
+		parser->out.arena = arena_create(size_hint, host_allocator);
+		if (!parser->out.arena)
+		{
+			stream_parser_release(parser);
+			return nullptr;
+		}
+		parser->data_allocator = &parser->out.arena->callbacks;
+	}
+	return parser;
+}
+
+acp_vulkan::gltf_data::gltf_state_type acp_vulkan::gltf_stream_parser_append(gltf_stream_parser* parser, const char* data, size_t data_size)
+{
+	if (parser->state != gltf_data::valid || !data_size)
+		return parser->state;
+
+	if (!reserve_stream_buffer(parser, data_size))
+	{
+		fail_stream(parser, parser->buffer_size);
+		return parser->state;
+	}
+	memcpy(parser->buffer + parser->buffer_size, data, data_size);
+	parser->buffer_size += data_size;
+
+	scan_stream(parser, false);
+	parse_stream_entries(parser, false);
+	return parser->state;
+}
+
+acp_vulkan::gltf_sections acp_vulkan::gltf_stream_parser_sections(const gltf_stream_parser* parser)
+{
+	return parser->sections;
+}
+
+acp_vulkan::gltf_data* acp_vulkan::gltf_stream_parser_data(gltf_stream_parser* parser)
+{
+	return &parser->out;
+}
+
+acp_vulkan::gltf_data acp_vulkan::gltf_stream_parser_finish(gltf_stream_parser* parser)
+{
+	// Like gltf_data_from_memory the rest is read up to the end of the input, closed or not.
+	parser->complete_end = parser->buffer_size;
+	parse_stream_entries(parser, true);
+
+	gltf_data out{};
+	if (parser->state != gltf_data::valid)
+		out = { .gltf_state = parser->state, .parsing_error_location = parser->error_location };
+	else if (!parser->opened)
+	{
+		gltf_data_free(&parser->out, parser->host_allocator);
+		out = { .gltf_state = gltf_data::parsing_error, .parsing_error_location = parser->discarded + parser->buffer_size };
+	}
+	else if (!(parser->sections & gltf_section_asset))
+	{
+		gltf_data_free(&parser->out, parser->host_allocator);
+		out = { .gltf_state = gltf_data::missing_asset_section, .parsing_error_location = 0 };
+	}
+	else
+	{
+		out = parser->out;
+		out.gltf_state = gltf_data::valid;
+		out.parsing_stats.tokens_lexed = parser->tokens_lexed;
+		out.parsing_stats.bytes_consumed = parser->discarded + parser->parse_location;
+	}
+
+	stream_parser_release(parser);
+	return out;
+}
+
+void acp_vulkan::gltf_stream_parser_free(gltf_stream_parser* parser)
+{
+	if (parser->state == gltf_data::valid)
+		gltf_data_free(&parser->out, parser->host_allocator);
+	stream_parser_release(parser);
+}
+
+struct gltf_binary_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t length;
+};
+
+struct gltf_binary_chunk_header
+{
+	enum class type
+	{
+		JSON = 0x4E4F534A,
+		BIN = 0x004E4942
+	};
+	uint32_t chunk_length;
+	type chunk_type;
+};
+
+gltf_binary_header binary_gltf_header(const char* data, size_t data_size)
+{
+	if (data_size < sizeof(gltf_binary_header))
+		return {};
+
+	gltf_binary_header out{};
+	memcpy(&out, data, sizeof(gltf_binary_header));
+
+	if (out.magic == 0x46546C67 /*glTF*/)
+		return out;
+
+	return {};
+}
+
+bool is_binary_gltf(const char* data, size_t data_size)
+{
+	gltf_binary_header test = binary_gltf_header(data, data_size);
+	return test.version == 2 && test.length != 0 && test.magic == 0x46546C67;
+}
+
+// Has to match the allocator gltf_data_free uses for the data.
+static VkAllocationCallbacks* binary_chunk_allocator(acp_vulkan::gltf_data* gltf_data, VkAllocationCallbacks* host_allocator)
+{
+	if (gltf_data->arena)
+		return &gltf_data->arena->callbacks;
+	return gltf_data->source ? &gltf_data->source->callbacks : host_allocator;
+}
+
+// Takes ownership of source, when set data has to point in to it.
+static acp_vulkan::gltf_data binary_gltf_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator, acp_vulkan::gltf_load_flags load_flags, acp_vulkan::gltf_source* source)
+{
+	acp_vulkan::gltf_data source_holder{ .source = source };
+	on_scope_end<acp_vulkan::gltf_data> release_unused_source(&source_holder, release_source_of, nullptr);
+
+	gltf_binary_header header = binary_gltf_header(data, data_size);
+	if(header.version != 2)
+		return { .gltf_state = acp_vulkan::gltf_data::invalid_binary_data_version, .parsing_error_location = 0 };
+
+	if (header.magic != 0x46546C67)
+		return { .gltf_state = acp_vulkan::gltf_data::invalid_binary_data_magic, .parsing_error_location = 0 };
+
+	if (header.length <= sizeof(gltf_binary_header))
+		return { .gltf_state = acp_vulkan::gltf_data::invalid_binary_data_with_zero_length, .parsing_error_location = 0 };
+
+	data += sizeof(gltf_binary_header);
+	// header.length counts the header itself.
+	size_t chunks_length = (header.length < data_size ? header.length : data_size) - sizeof(gltf_binary_header);
+
+	uint8_t* data_buffer = nullptr;
+	size_t data_buffer_size = 0;
+	acp_vulkan::gltf_data out_data{};
+	bool has_json = false;
+
+	for (size_t ii = 0; ii < chunks_length;)
+	{
+		if (ii + sizeof(gltf_binary_chunk_header) > chunks_length)
+			break;
+		gltf_binary_chunk_header chunk{};
+		memcpy(&chunk, data + ii, sizeof(gltf_binary_chunk_header));
+		ii += sizeof(gltf_binary_chunk_header);
+
+		if (chunks_length - ii < chunk.chunk_length)
+			break;
+
+		// The spec allows one JSON chunk followed by at most one BIN chunk, repeated ones are skipped like unknown chunks.
+		if (chunk.chunk_type == gltf_binary_chunk_header::type::JSON && !has_json)
+		{
+			has_json = true;
+			const char* json = data + ii;
+			if ((load_flags & acp_vulkan::gltf_load_strings_in_source) && !source_holder.source)
+			{
+				// Only the JSON chunk has to outlive the call, the BIN chunk gets its own copy below.
+				source_holder.source = source_create(json, chunk.chunk_length, false, host_allocator);
+				if (!source_holder.source)
+					return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = 0 };
+				json = source_holder.source->data;
+			}
+			out_data = gltf_json_from_memory(json, chunk.chunk_length, host_allocator, load_flags, source_holder.source);
+			source_holder.source = nullptr;
+			// A failed parse already released the source, data may have been part of it.
+			if (out_data.gltf_state != acp_vulkan::gltf_data::valid)
+				return out_data;
+		}
+		else if (chunk.chunk_type == gltf_binary_chunk_header::type::BIN && !data_buffer)
+		{
+			// Parsing the JSON replaces out_data, a BIN chunk before it would lose embedded_buffer_borrowed and its allocator.
+			if (!has_json)
+				return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = sizeof(gltf_binary_header) + ii - sizeof(gltf_binary_chunk_header) };
+
+			const char* chunk_start = data + ii;
+			if (out_data.source && chunk_start >= out_data.source->data && chunk_start + chunk.chunk_length <= out_data.source->data + out_data.source->data_size)
+			{
+				// Loaded from a file the whole file mapping or buffer is the source, the chunk can stay where it is.
+				data_buffer = reinterpret_cast<uint8_t*>(const_cast<char*>(chunk_start));
+				data_buffer_size = chunk.chunk_length;
+				ii += chunk.chunk_length;
+				continue;
+			}
+
+			if (load_flags & acp_vulkan::gltf_load_borrow_binary_chunk)
+			{
+				data_buffer = reinterpret_cast<uint8_t*>(const_cast<char*>(chunk_start));
+				data_buffer_size = chunk.chunk_length;
+				out_data.embedded_buffer_borrowed = true;
+				ii += chunk.chunk_length;
+				continue;
+			}
+
+			// The BIN chunk follows the JSON one, so in arena mode the arena already exists by now.
+			VkAllocationCallbacks* chunk_allocator = binary_chunk_allocator(&out_data, host_allocator);
+			uint8_t* chunk_data = chunk_allocator ?
+				reinterpret_cast<uint8_t*>(chunk_allocator->pfnAllocation(chunk_allocator->pUserData, chunk.chunk_length, sizeof(uint8_t), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+				: new uint8_t[chunk.chunk_length];
+
+			memcpy(chunk_data, data + ii, chunk.chunk_length);
+
+			data_buffer = chunk_data;
+			data_buffer_size = chunk.chunk_length;
+		}
+
+		ii += chunk.chunk_length;
+	}
+
+	out_data.embedded_buffer.data = data_buffer;
+	out_data.embedded_buffer.data_length = data_buffer_size;
+
+	if (out_data.gltf_state != acp_vulkan::gltf_data::valid)
+	{
+		if (out_data.arena)
+			release_arena_of(&out_data, host_allocator);
+		else if (!out_data.embedded_buffer_borrowed)
+			free_gltf_buffer(out_data.embedded_buffer, binary_chunk_allocator(&out_data, host_allocator));
+		release_source_of(&out_data, host_allocator);
+	}
+
+	return out_data;
+}
+
+acp_vulkan::gltf_data acp_vulkan::binary_gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags)
+{
+	return binary_gltf_from_memory(data, data_size, host_allocator, load_flags, nullptr);
+}
+
+// Maps the file when the platform supports it, otherwise reads it in to a buffer from host_allocator.
+// copy_on_write maps the file writable and private, for caches that are fixed up in place.
+static char* read_file(const char* path, VkAllocationCallbacks* host_allocator, size_t* out_size, bool* out_mapped, acp_vulkan::gltf_data::gltf_state_type* out_state, bool copy_on_write = false)
+{
+#if ACP_GLTF_MMAP
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		*out_state = acp_vulkan::gltf_data::unable_to_open_file;
+		return nullptr;
+	}
+
+	struct stat file_stat {};
+	if (fstat(file, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0)
+	{
+		size_t file_size = size_t(file_stat.st_size);
+		void* mapping = mmap(nullptr, file_size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping != MAP_FAILED)
+		{
+			close(file);
+			// The parser walks the file front to back once, read ahead aggressively and start now.
+			madvise(mapping, file_size, MADV_SEQUENTIAL);
+			madvise(mapping, file_size, MADV_WILLNEED);
+			*out_size = file_size;
+			*out_mapped = true;
+			return reinterpret_cast<char*>(mapping);
+		}
+	}
+	close(file);
+#endif
+
+	FILE* gltf_bytes = fopen(path, "rb");
+	if (!gltf_bytes)
+	{
+		*out_state = acp_vulkan::gltf_data::unable_to_open_file;
+		return nullptr;
+	}
+
+	fseek(gltf_bytes, 0, SEEK_END);
+	long gltf_size = ftell(gltf_bytes);
+	fseek(gltf_bytes, 0, SEEK_SET);
+
+	char* gltf_data = gltf_size <= 0 ? nullptr : host_allocator ?
+		reinterpret_cast<char*>(host_allocator->pfnAllocation(host_allocator->pUserData, gltf_size, 16, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new char[gltf_size];
+
+	if (!gltf_data)
+	{
+		fclose(gltf_bytes);
+		*out_state = acp_vulkan::gltf_data::unable_to_read_file;
+		return nullptr;
+	}
+
+	size_t bytes_to_read = gltf_size;
+	size_t offset = 0;
+	while (size_t bytes_read = fread(gltf_data + offset, 1, bytes_to_read, gltf_bytes))
+	{
+		offset += bytes_read;
+		bytes_to_read -= bytes_read;
+	}
+
+	fclose(gltf_bytes);
+
+	if (offset != size_t(gltf_size))
+	{
+		release_file_data(gltf_data, gltf_size, false, host_allocator);
+		*out_state = acp_vulkan::gltf_data::unable_to_read_file;
+		return nullptr;
+	}
+
+	*out_size = size_t(gltf_size);
+	*out_mapped = false;
+	return gltf_data;
+}
+
+// Parses the bytes read_file returned and takes care of them, they are either handed to the parsed data or released.
+static acp_vulkan::gltf_data gltf_from_file_data(char* gltf_data, size_t gltf_size, bool mapped, VkAllocationCallbacks* host_allocator, acp_vulkan::gltf_load_flags load_flags)
+{
+	// When something keeps pointing in to the file, the GLB BIN chunk or the strings, hand it to the parsed data instead of copying out of it.
+	bool is_binary = is_binary_gltf(gltf_data, gltf_size);
+	if (is_binary || (load_flags & acp_vulkan::gltf_load_strings_in_source))
+	{
+		acp_vulkan::gltf_source* source = source_create(gltf_data, gltf_size, true, host_allocator);
+		if (source)
+		{
+			source->mapped = mapped;
+			return is_binary ?
+				binary_gltf_from_memory(gltf_data, gltf_size, host_allocator, load_flags, source) :
+				gltf_json_from_memory(gltf_data, gltf_size, host_allocator, load_flags, source);
+		}
+	}
+
+	acp_vulkan::gltf_data out = is_binary ?
+		binary_gltf_from_memory(gltf_data, gltf_size, host_allocator, load_flags & ~acp_vulkan::gltf_load_strings_in_source, nullptr) :
+		gltf_json_from_memory(gltf_data, gltf_size, host_allocator, load_flags & ~acp_vulkan::gltf_load_strings_in_source, nullptr);
+
+	release_file_data(gltf_data, gltf_size, mapped, host_allocator);
+
+	return out;
+}
+
+acp_vulkan::gltf_data acp_vulkan::gltf_data_from_file(const char* path, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags)
+{
+	size_t gltf_size = 0;
+	bool mapped = false;
+	gltf_data::gltf_state_type read_state = gltf_data::valid;
+	char* gltf_data = read_file(path, host_allocator, &gltf_size, &mapped, &read_state);
+	if (!gltf_data)
+		return { .gltf_state = read_state, .parsing_error_location = 0 };
+
+	return gltf_from_file_data(gltf_data, gltf_size, mapped, host_allocator, load_flags);
+}
+
+#define CACHE_VERSION 1
+#define CACHE_BYTE_ALIGNMENT 16
+
+// Starts every cache blob, the parsed gltf_data follows at data_offset and the arrays its views point at after it.
+struct cache_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	// Sizes of the parsed structs and of a pointer, a cache is only read by a build with the same layout.
+	uint64_t layout;
+	uint64_t blob_size;
+	uint64_t data_offset;
+	acp_vulkan::gltf_cache_key key;
+};
+static constexpr char cache_magic[8] = { 'A', 'C', 'P', 'G', 'L', 'T', 'F', 'C' };
+static constexpr size_t cache_data_offset = (sizeof(cache_header) + alignof(acp_vulkan::gltf_data) - 1) & ~(alignof(acp_vulkan::gltf_data) - 1);
+
+static constexpr uint64_t cache_layout_signature()
+{
+	using gd = acp_vulkan::gltf_data;
+	const size_t sizes[] = {
+		sizeof(void*), sizeof(gd), sizeof(gd::buffer_view), sizeof(gd::buffer), sizeof(gd::image), sizeof(gd::accesor), sizeof(gd::texture),
+		sizeof(gd::mesh), sizeof(gd::mesh::primitive_type), sizeof(gd::mesh::primitive_type::target), sizeof(pair<gd::attribute, uint32_t>),
+		sizeof(gd::material), sizeof(gd::node), sizeof(gd::scene), sizeof(gd::sampler), sizeof(gd::skin), sizeof(gd::camera),
+		sizeof(gd::animation), sizeof(gd::animation::channel), sizeof(gd::animation::sampler)
+	};
+	uint64_t signature = 14695981039346656037ull;
+	for (size_t size : sizes)
+		signature = (signature ^ size) * 1099511628211ull;
+	return signature;
+}
+
+// Bytes (buffers, data uris) start on 16 bytes for SIMD reads, strings are packed.
+template<typename T>
+static constexpr size_t cache_alignment()
+{
+	return sizeof(T) == 1 ? (std::is_same_v<std::remove_const_t<T>, uint8_t> ? CACHE_BYTE_ALIGNMENT : 1) : alignof(T);
+}
+
+template<typename P, typename T, typename F>
+static void place_each(P& place, data_view<T>& view, F&& visit)
+{
+	size_t count = view.data_length;
+	T* elements = place(view);
+	if (elements)
+		for (size_t ii = 0; ii < count; ++ii)
+			visit(elements[ii]);
+}
+
+// Calls place on every view of the parsed data, parents before their children, in the order the arrays are laid out in the cache.
+// place returns the elements of the view to descend in to, or null. drop is called on the views of derived data that is not cached.
+template<typename P>
+static void walk_cache_views(acp_vulkan::gltf_data* gltf_data, P& place)
+{
+	using gd = acp_vulkan::gltf_data;
+
+	place(gltf_data->asset.generator);
+	place(gltf_data->asset.version);
+	place(gltf_data->buffer_views);
+	place_each(place, gltf_data->buffers, [&](gd::buffer& buffer) {
+		place(buffer.uri);
+		place(buffer.name);
+		place(buffer.embedded_bytes);
+		place(buffer.embedded_mime);
+		place.drop(buffer.resolved_bytes);
+	});
+	place_each(place, gltf_data->images, [&](gd::image& image) {
+		place(image.uri);
+		place(image.mime_type);
+		place(image.embedded_bytes);
+		place(image.embedded_mime);
+		place.drop(image.resolved_bytes);
+	});
+	place_each(place, gltf_data->accesors, [&](gd::accesor& accessor) {
+		place.drop(accessor.sparse_resolved_bytes);
+		place(accessor.name);
+	});
+	place_each(place, gltf_data->textures, [&](gd::texture& texture) { place(texture.name); });
+	place_each(place, gltf_data->meshes, [&](gd::mesh& mesh) {
+		place_each(place, mesh.primitives, [&](gd::mesh::primitive_type& primitive) {
+			place(primitive.attributes);
+			place_each(place, primitive.targets, [&](gd::mesh::primitive_type::target& target) { place(target.attributes); });
+		});
+		place(mesh.weights);
+		place(mesh.name);
+	});
+	place_each(place, gltf_data->materials, [&](gd::material& material) { place(material.name); });
+	place_each(place, gltf_data->nodes, [&](gd::node& node) {
+		place(node.children);
+		place(node.weights);
+		place(node.name);
+	});
+	place_each(place, gltf_data->scenes, [&](gd::scene& scene) {
+		place(scene.nodes);
+		place(scene.name);
+	});
+	place_each(place, gltf_data->samplers, [&](gd::sampler& sampler) { place(sampler.name); });
+	place_each(place, gltf_data->skins, [&](gd::skin& skin) {
+		place(skin.joints);
+		place(skin.name);
+	});
+	place_each(place, gltf_data->cameras, [&](gd::camera& camera) { place(camera.name); });
+	place_each(place, gltf_data->animations, [&](gd::animation& animation) {
+		place(animation.channels);
+		place(animation.samplers);
+		place(animation.name);
+	});
+	place(gltf_data->embedded_buffer);
+}
+
+// The cached structs are stored field by field in to zeroed memory, their padding would otherwise carry whatever the heap or stack held
+// and the same file would not serialize to the same bytes. Structs without padding or floats are copied whole.
+template<typename T>
+static void cache_store(T* out, const T& in)
+{
+	static_assert(std::has_unique_object_representations_v<T>, "structs with padding are stored field by field");
+	memcpy(out, &in, sizeof(T));
+}
+
+static void cache_store(acp_vulkan::gltf_data::buffer* out, const acp_vulkan::gltf_data::buffer& in)
+{
+	out->uri = in.uri;
+	out->name = in.name;
+	out->byte_length = in.byte_length;
+	out->embedded_bytes = in.embedded_bytes;
+	out->embedded_mime = in.embedded_mime;
+	out->resolved_bytes = in.resolved_bytes;
+}
+
+static void cache_store(acp_vulkan::gltf_data::image* out, const acp_vulkan::gltf_data::image& in)
+{
+	out->uri = in.uri;
+	out->buffer_view = in.buffer_view;
+	out->mime_type = in.mime_type;
+	out->embedded_bytes = in.embedded_bytes;
+	out->embedded_mime = in.embedded_mime;
+	out->resolved_bytes = in.resolved_bytes;
+}
+
+static void cache_store(acp_vulkan::gltf_data::accesor* out, const acp_vulkan::gltf_data::accesor& in)
+{
+	out->has_buffer_view = in.has_buffer_view;
+	out->buffer_view = in.buffer_view;
+	out->byte_offset = in.byte_offset;
+	out->component_type = in.component_type;
+	out->normalized = in.normalized;
+	out->count = in.count;
+	out->type = in.type;
+	memcpy(out->max, in.max, sizeof(in.max));
+	memcpy(out->min, in.min, sizeof(in.min));
+	out->is_sparse = in.is_sparse;
+	cache_store(&out->sparse, in.sparse);
+	out->sparse_resolved_bytes = in.sparse_resolved_bytes;
+	out->name = in.name;
+}
+
+static void cache_store(acp_vulkan::gltf_data::texture* out, const acp_vulkan::gltf_data::texture& in)
+{
+	out->has_sampler = in.has_sampler;
+	out->sampler = in.sampler;
+	out->has_source = in.has_source;
+	out->source = in.source;
+	out->name = in.name;
+	out->has_MSFT_source = in.has_MSFT_source;
+	out->MSFT_source = in.MSFT_source;
+}
+
+static void cache_store(acp_vulkan::gltf_data::mesh::primitive_type* out, const acp_vulkan::gltf_data::mesh::primitive_type& in)
+{
+	out->attributes = in.attributes;
+	out->has_indices = in.has_indices;
+	out->indices = in.indices;
+	out->has_material = in.has_material;
+	out->material = in.material;
+	out->mode = in.mode;
+	out->targets = in.targets;
+}
+
+static void cache_store(acp_vulkan::gltf_data::material* out, const acp_vulkan::gltf_data::material& in)
+{
+	out->has_pbr_metallic_roughness = in.has_pbr_metallic_roughness;
+	memcpy(out->pbr_metallic_roughness.base_color_factor, in.pbr_metallic_roughness.base_color_factor, sizeof(in.pbr_metallic_roughness.base_color_factor));
+	out->pbr_metallic_roughness.has_base_color_texture = in.pbr_metallic_roughness.has_base_color_texture;
+	cache_store(&out->pbr_metallic_roughness.base_color_texture, in.pbr_metallic_roughness.base_color_texture);
+	out->pbr_metallic_roughness.metallic_factor = in.pbr_metallic_roughness.metallic_factor;
+	out->pbr_metallic_roughness.roughness_factor = in.pbr_metallic_roughness.roughness_factor;
+	out->pbr_metallic_roughness.has_metallic_roughness_texture = in.pbr_metallic_roughness.has_metallic_roughness_texture;
+	cache_store(&out->pbr_metallic_roughness.metallic_roughness_texture, in.pbr_metallic_roughness.metallic_roughness_texture);
+	out->has_normal_texture = in.has_normal_texture;
+	out->normal_texture.index = in.normal_texture.index;
+	out->normal_texture.tex_coord = in.normal_texture.tex_coord;
+	out->normal_texture.scale = in.normal_texture.scale;
+	out->has_occlusion_texture = in.has_occlusion_texture;
+	out->occlusion_texture.index = in.occlusion_texture.index;
+	out->occlusion_texture.tex_coord = in.occlusion_texture.tex_coord;
+	out->occlusion_texture.strength = in.occlusion_texture.strength;
+	out->has_emissive_texture = in.has_emissive_texture;
+	cache_store(&out->emissive_texture, in.emissive_texture);
+	memcpy(out->emissive_factor, in.emissive_factor, sizeof(in.emissive_factor));
+	out->alpha_mode = in.alpha_mode;
+	out->alpha_cutoff = in.alpha_cutoff;
+	out->double_sided = in.double_sided;
+	out->name = in.name;
+}
+
+static void cache_store(acp_vulkan::gltf_data::node* out, const acp_vulkan::gltf_data::node& in)
+{
+	out->has_camera = in.has_camera;
+	out->camera = in.camera;
+	out->children = in.children;
+	out->has_skin = in.has_skin;
+	out->skin = in.skin;
+	out->has_mesh = in.has_mesh;
+	out->mesh = in.mesh;
+	out->has_matrix = in.has_matrix;
+	memcpy(out->matrix, in.matrix, sizeof(in.matrix));
+	out->has_rotation = in.has_rotation;
+	memcpy(out->rotation, in.rotation, sizeof(in.rotation));
+	out->has_scale = in.has_scale;
+	memcpy(out->scale, in.scale, sizeof(in.scale));
+	out->has_translation = in.has_translation;
+	memcpy(out->translation, in.translation, sizeof(in.translation));
+	out->weights = in.weights;
+	out->name = in.name;
+}
+
+static void cache_store(acp_vulkan::gltf_data::skin* out, const acp_vulkan::gltf_data::skin& in)
+{
+	out->has_inverse_bind_matrices = in.has_inverse_bind_matrices;
+	out->inverse_bind_matrices = in.inverse_bind_matrices;
+	out->has_skeleton = in.has_skeleton;
+	out->skeleton = in.skeleton;
+	out->joints = in.joints;
+	out->name = in.name;
+}
+
+static void cache_store(acp_vulkan::gltf_data::camera* out, const acp_vulkan::gltf_data::camera& in)
+{
+	out->type = in.type;
+	out->orthographic.x_mag = in.orthographic.x_mag;
+	out->orthographic.y_mag = in.orthographic.y_mag;
+	out->orthographic.z_far = in.orthographic.z_far;
+	out->orthographic.z_near = in.orthographic.z_near;
+	out->perspective.aspect_ratio = in.perspective.aspect_ratio;
+	out->perspective.y_fov = in.perspective.y_fov;
+	out->perspective.z_far = in.perspective.z_far;
+	out->perspective.z_near = in.perspective.z_near;
+	out->name = in.name;
+}
+
+static void cache_store(acp_vulkan::gltf_data* out, const acp_vulkan::gltf_data& in)
+{
+	out->gltf_state = in.gltf_state;
+	out->parsing_error_location = in.parsing_error_location;
+	out->parsing_stats = in.parsing_stats;
+	out->asset = in.asset;
+	out->buffer_views = in.buffer_views;
+	out->buffers = in.buffers;
+	out->images = in.images;
+	out->accesors = in.accesors;
+	out->textures = in.textures;
+	out->meshes = in.meshes;
+	out->materials = in.materials;
+	out->nodes = in.nodes;
+	out->scenes = in.scenes;
+	out->default_scene = in.default_scene;
+	out->has_defautl_scene = in.has_defautl_scene;
+	out->samplers = in.samplers;
+	out->skins = in.skins;
+	out->cameras = in.cameras;
+	out->animations = in.animations;
+	out->embedded_buffer = in.embedded_buffer;
+	out->embedded_buffer_borrowed = in.embedded_buffer_borrowed;
+	out->arena = in.arena;
+	out->source = in.source;
+	out->resolved_files = in.resolved_files;
+}
+
+// Lays the arrays out one after the other from cursor. Without out it only measures and returns the source elements,
+// otherwise it copies them, turns the view in to an offset and returns the copy so the views inside it are rewritten next.
+struct cache_writer
+{
+	uint8_t* out;
+	size_t cursor;
+
+	template<typename T>
+	T* operator()(data_view<T>& view)
+	{
+		if (!view.data || !view.data_length)
+		{
+			if (out)
+				view = {};
+			return nullptr;
+		}
+
+		size_t alignment = cache_alignment<T>();
+		size_t offset = (cursor + alignment - 1) & ~(alignment - 1);
+		size_t byte_size = view.data_length * sizeof(T);
+		if (!out)
+		{
+			cursor = offset + byte_size;
+			return view.data;
+		}
+
+		memset(out + cursor, 0, offset - cursor);
+		T* elements = reinterpret_cast<T*>(out + offset);
+		if constexpr (std::is_arithmetic_v<T>)
+			memcpy(elements, view.data, byte_size);
+		else
+		{
+			memset(elements, 0, byte_size);
+			for (size_t ii = 0; ii < view.data_length; ++ii)
+				cache_store(elements + ii, view.data[ii]);
+		}
+		cursor = offset + byte_size;
+		view.data = reinterpret_cast<T*>(uintptr_t(offset));
+		return elements;
+	}
+
+	template<typename T>
+	void drop(data_view<T>& view)
+	{
+		if (out)
+			view = {};
+	}
+};
+
+// Turns offsets back in to pointers. Arrays have to be in range, aligned and follow each other in walk order like cache_writer placed them,
+// so no two views share memory and nothing is fixed up twice.
+struct cache_fixup
+{
+	uint8_t* data;
+	size_t data_size;
+	size_t cursor;
+	bool damaged;
+
+	template<typename T>
+	T* operator()(data_view<T>& view)
+	{
+		size_t offset = size_t(uintptr_t(view.data));
+		if (!offset && !view.data_length)
+			return nullptr;
+
+		if (!offset || offset < cursor || offset > data_size || offset % cache_alignment<T>() != 0 || view.data_length > (data_size - offset) / sizeof(T))
+		{
+			damaged = true;
+			view = {};
+			return nullptr;
+		}
+
+		cursor = offset + view.data_length * sizeof(T);
+		view.data = reinterpret_cast<T*>(data + offset);
+		return view.data;
+	}
+
+	template<typename T>
+	void drop(data_view<T>& view)
+	{
+		view = {};
+	}
+};
+
+// Four independent lanes so hashing the source keeps up with reading it, this only has to notice edits, it is not a cryptographic hash.
+static uint64_t cache_content_hash(const uint8_t* data, size_t data_size)
+{
+	const uint64_t prime_0 = 0x9E3779B185EBCA87ull;
+	const uint64_t prime_1 = 0xC2B2AE3D27D4EB4Full;
+	auto rotate = [](uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+	auto round = [&](uint64_t lane, uint64_t word) { return rotate(lane + word * prime_1, 31) * prime_0; };
+
+	uint64_t lanes[4] = { prime_0 + prime_1, prime_1, 0, 0 - prime_0 };
+	size_t ii = 0;
+	for (; ii + 32 <= data_size; ii += 32)
+	{
+		uint64_t words[4];
+		memcpy(words, data + ii, 32);
+		lanes[0] = round(lanes[0], words[0]);
+		lanes[1] = round(lanes[1], words[1]);
+		lanes[2] = round(lanes[2], words[2]);
+		lanes[3] = round(lanes[3], words[3]);
+	}
+
+	uint64_t hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18) + uint64_t(data_size);
+	for (; ii + 8 <= data_size; ii += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + ii, 8);
+		hash = rotate(hash ^ round(0, word), 27) * prime_0 + prime_1;
+	}
+	for (; ii < data_size; ++ii)
+		hash = rotate(hash ^ (data[ii] * prime_0), 11) * prime_1;
+
+	hash ^= hash >> 33;
+	hash *= prime_1;
+	hash ^= hash >> 29;
+	hash *= prime_0;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+// Size and modification time in nanoseconds of the file at path, the time is 0 where it is not available.
+static bool file_stamp(const char* path, uint64_t* out_size, uint64_t* out_mtime)
+{
+#if ACP_GLTF_MMAP
+	struct stat file_stat {};
+	if (stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+		return false;
+#if defined(__APPLE__)
+	const struct timespec& mtime = file_stat.st_mtimespec;
+#else
+	const struct timespec& mtime = file_stat.st_mtim;
+#endif
+	*out_size = uint64_t(file_stat.st_size);
+	*out_mtime = uint64_t(mtime.tv_sec) * 1000000000ull + uint64_t(mtime.tv_nsec);
+	return true;
+#else
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	fclose(file);
+	if (file_size < 0)
+		return false;
+	*out_size = uint64_t(file_size);
+	*out_mtime = 0;
+	return true;
+#endif
+}
+
+bool acp_vulkan::gltf_cache_key_for_file(const char* path, gltf_cache_key* key)
+{
+	if (!file_stamp(path, &key->source_size, &key->source_mtime))
+		return false;
+
+	size_t data_size = 0;
+	bool mapped = false;
+	gltf_data::gltf_state_type state = gltf_data::valid;
+	char* data = read_file(path, nullptr, &data_size, &mapped, &state);
+	if (!data)
+		return false;
+
+	key->source_size = data_size;
+	key->source_hash = cache_content_hash(reinterpret_cast<const uint8_t*>(data), data_size);
+	release_file_data(data, data_size, mapped, nullptr);
+	return true;
+}
+
+size_t acp_vulkan::gltf_cache_serialize(const gltf_data* gltf_data, const gltf_cache_key& key, void* out, size_t out_size)
+{
+	if (gltf_data->gltf_state != gltf_data::valid)
+		return 0;
+
+	// Allocations and files the data owns stay with it, the cache becomes the source of the data loaded from it.
+	acp_vulkan::gltf_data top = *gltf_data;
+	top.embedded_buffer_borrowed = false;
+	top.arena = nullptr;
+	top.source = nullptr;
+	top.resolved_files = nullptr;
+
+	cache_writer sizing{ .out = nullptr, .cursor = cache_data_offset + sizeof(acp_vulkan::gltf_data) };
+	walk_cache_views(&top, sizing);
+	size_t blob_size = (sizing.cursor + CACHE_BYTE_ALIGNMENT - 1) & ~size_t(CACHE_BYTE_ALIGNMENT - 1);
+	if (!out)
+		return blob_size;
+	if (out_size < blob_size || uintptr_t(out) % CACHE_BYTE_ALIGNMENT != 0)
+		return 0;
+
+	uint8_t* blob = reinterpret_cast<uint8_t*>(out);
+	cache_writer writer{ .out = blob, .cursor = cache_data_offset + sizeof(acp_vulkan::gltf_data) };
+	walk_cache_views(&top, writer);
+	memset(blob + writer.cursor, 0, blob_size - writer.cursor);
+
+	cache_header header{};
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = CACHE_VERSION;
+	header.header_size = sizeof(cache_header);
+	header.layout = cache_layout_signature();
+	header.blob_size = blob_size;
+	header.data_offset = cache_data_offset;
+	header.key = key;
+	memset(blob, 0, cache_data_offset + sizeof(top));
+	memcpy(blob, &header, sizeof(header));
+	cache_store(reinterpret_cast<acp_vulkan::gltf_data*>(blob + cache_data_offset), top);
+	return blob_size;
+}
+
+static const cache_header* cache_header_of(const void* data, size_t data_size)
+{
+	if (uintptr_t(data) % CACHE_BYTE_ALIGNMENT != 0 || data_size < cache_data_offset + sizeof(acp_vulkan::gltf_data))
+		return nullptr;
+
+	const cache_header* header = reinterpret_cast<const cache_header*>(data);
+	bool matches = memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0 && header->version == CACHE_VERSION && header->header_size == sizeof(cache_header) &&
+		header->layout == cache_layout_signature() && header->blob_size == data_size && header->data_offset == cache_data_offset;
+	return matches ? header : nullptr;
+}
+
+// The source holds the blob, its views are fixed up and the data takes the source over. The source is released when the blob is damaged.
+static acp_vulkan::gltf_data cache_load(acp_vulkan::gltf_source* source)
+{
+	uint8_t* blob = reinterpret_cast<uint8_t*>(source->data);
+	acp_vulkan::gltf_data out;
+	memcpy(&out, blob + cache_data_offset, sizeof(out));
+
+	cache_fixup fixup{ .data = blob, .data_size = source->data_size, .cursor = cache_data_offset + sizeof(acp_vulkan::gltf_data), .damaged = false };
+	walk_cache_views(&out, fixup);
+	if (fixup.damaged || out.gltf_state != acp_vulkan::gltf_data::valid)
+	{
+		source_release(source);
+		return { .gltf_state = acp_vulkan::gltf_data::invalid_cache, .parsing_error_location = 0 };
+	}
+
+	out.embedded_buffer_borrowed = false;
+	out.arena = nullptr;
+	out.source = source;
+	out.resolved_files = nullptr;
+	return out;
+}
+
+acp_vulkan::gltf_data acp_vulkan::gltf_cache_from_memory(void* data, size_t data_size, const gltf_cache_key* expected_key, VkAllocationCallbacks* host_allocator)
+{
+	const cache_header* header = cache_header_of(data, data_size);
+	if (!header || (expected_key && (header->key.source_size != expected_key->source_size || header->key.source_hash != expected_key->source_hash)))
+		return { .gltf_state = gltf_data::invalid_cache, .parsing_error_location = 0 };
+
+	gltf_source* source = source_create(reinterpret_cast<const char*>(data), data_size, true, host_allocator);
+	if (!source)
+		return { .gltf_state = gltf_data::invalid_cache, .parsing_error_location = 0 };
+
+	source->borrowed = true;
+	return cache_load(source);
+}
+
+// Written next to cache_path and renamed over it, a reader never sees a partial cache.
+static void write_cache_file(const char* cache_path, const acp_vulkan::gltf_data& gltf_data, const acp_vulkan::gltf_cache_key& key, VkAllocationCallbacks* host_allocator)
+{
+	size_t blob_size = acp_vulkan::gltf_cache_serialize(&gltf_data, key, nullptr, 0);
+	size_t path_length = strlen(cache_path);
+	if (!blob_size)
+		return;
+
+	char* blob = host_allocator ?
+		reinterpret_cast<char*>(host_allocator->pfnAllocation(host_allocator->pUserData, blob_size + path_length + 5, CACHE_BYTE_ALIGNMENT, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND))
+		: new char[blob_size + path_length + 5];
+	if (!blob)
+		return;
+
+	char* temp_path = blob + blob_size;
+	memcpy(temp_path, cache_path, path_length);
+	memcpy(temp_path + path_length, ".tmp", 5);
+
+	if (acp_vulkan::gltf_cache_serialize(&gltf_data, key, blob, blob_size) == blob_size)
+	{
+		FILE* file = fopen(temp_path, "wb");
+		bool written = file && fwrite(blob, 1, blob_size, file) == blob_size;
+		if (file)
+			written = fclose(file) == 0 && written;
+
+		if (written && rename(temp_path, cache_path) != 0)
+		{
+			// rename does not replace an existing file everywhere.
+			remove(cache_path);
+			written = rename(temp_path, cache_path) == 0;
+		}
+		if (!written)
+			remove(temp_path);
+	}
+
+	if (host_allocator)
+		host_allocator->pfnFree(host_allocator->pUserData, blob);
+	else
+		delete[] blob;
+}
+
+// Stamps the cache with the mtime of a source that was touched but hashes the same, the next load skips the hash.
+static void update_cache_key(const char* cache_path, const acp_vulkan::gltf_cache_key& key)
+{
+	FILE* file = fopen(cache_path, "r+b");
+	if (!file)
+		return;
+	if (fseek(file, long(offsetof(cache_header, key)), SEEK_SET) == 0)
+		fwrite(&key, sizeof(key), 1, file);
+	fclose(file);
+}
+
+acp_vulkan::gltf_data acp_vulkan::gltf_data_from_file_cached(const char* path, const char* cache_path, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags)
+{
+	gltf_cache_key key{};
+	if (!file_stamp(path, &key.source_size, &key.source_mtime))
+		return gltf_data_from_file(path, host_allocator, load_flags);
+
+	size_t source_size = 0;
+	bool source_mapped = false;
+	char* source_data = nullptr;
+	gltf_data::gltf_state_type read_state = gltf_data::valid;
+
+	size_t cache_size = 0;
+	bool cache_mapped = false;
+	gltf_data::gltf_state_type cache_state = gltf_data::valid;
+	char* cache = read_file(cache_path, host_allocator, &cache_size, &cache_mapped, &cache_state, true);
+	if (cache)
+	{
+		const cache_header* header = cache_header_of(cache, cache_size);
+		bool fresh = header && header->key.source_size == key.source_size && key.source_mtime && header->key.source_mtime == key.source_mtime;
+		if (header && !fresh && header->key.source_size == key.source_size)
+		{
+			source_data = read_file(path, host_allocator, &source_size, &source_mapped, &read_state);
+			if (source_data)
+			{
+				key.source_hash = cache_content_hash(reinterpret_cast<const uint8_t*>(source_data), source_size);
+				fresh = header->key.source_hash == key.source_hash;
+				if (fresh)
+					update_cache_key(cache_path, key);
+			}
+		}
+		if (fresh)
+			key.source_hash = header->key.source_hash;
+
+		gltf_source* source = fresh ? source_create(cache, cache_size, true, host_allocator) : nullptr;
+		if (source)
+		{
+			source->mapped = cache_mapped;
+			gltf_data out = cache_load(source);
+			if (out.gltf_state == gltf_data::valid)
+			{
+				if (source_data)
+					release_file_data(source_data, source_size, source_mapped, host_allocator);
+				return out;
+			}
+		}
+		else
+			release_file_data(cache, cache_size, cache_mapped, host_allocator);
+	}
+
+	// Missing, stale or damaged, parse the source and write the cache again.
+	if (!source_data)
+	{
+		source_data = read_file(path, host_allocator, &source_size, &source_mapped, &read_state);
+		if (!source_data)
+			return { .gltf_state = read_state, .parsing_error_location = 0 };
+		key.source_size = source_size;
+		key.source_hash = cache_content_hash(reinterpret_cast<const uint8_t*>(source_data), source_size);
+	}
+
+	gltf_data out = gltf_from_file_data(source_data, source_size, source_mapped, host_allocator, load_flags);
+	if (out.gltf_state == gltf_data::valid)
+		write_cache_file(cache_path, out, key, host_allocator);
+	return out;
+}
+
+
+struct acp_vulkan::gltf_resolved_files
+{
+	struct file
+	{
+		// base_directory joined with the unescaped uri, null terminated.
+		char* path;
+		size_t path_length;
+		uint64_t path_hash;
+		uint8_t* data;
+		size_t data_size;
+		bool mapped;
+		acp_vulkan::gltf_data::gltf_state_type state;
+	};
+	data_view<file> files;
+	// Copy of the reader the files came from, read is null when read_file loaded them.
+	acp_vulkan::gltf_file_reader reader;
+	VkAllocationCallbacks* host_allocator;
+};
+
+static void resolved_files_release(acp_vulkan::gltf_resolved_files* resolved)
+{
+	VkAllocationCallbacks* host_allocator = resolved->host_allocator;
+	for (size_t ii = 0; ii < resolved->files.data_length; ++ii)
+	{
+		acp_vulkan::gltf_resolved_files::file* file = &resolved->files.data[ii];
+		if (file->data)
+		{
+			if (resolved->reader.read)
+				resolved->reader.release(resolved->reader.user_data, file->data, file->data_size);
+			else
+				release_file_data(reinterpret_cast<char*>(file->data), file->data_size, file->mapped, host_allocator);
+		}
+		data_view<char> path{ .data = file->path, .data_length = file->path_length };
+		free_gltf_buffer(path, host_allocator);
+	}
+	free_gltf_buffer(resolved->files, host_allocator);
+
+	if (host_allocator)
+		host_allocator->pfnFree(host_allocator->pUserData, resolved);
+	else
+		delete resolved;
+}
+
+static void release_resolved_files_of(acp_vulkan::gltf_data* gltf_data, VkAllocationCallbacks*)
+{
+	if (!gltf_data->resolved_files)
+		return;
+
+	for (size_t ii = 0; ii < gltf_data->buffers.data_length; ++ii)
+		gltf_data->buffers.data[ii].resolved_bytes = {};
+	for (size_t ii = 0; ii < gltf_data->images.data_length; ++ii)
+		gltf_data->images.data[ii].resolved_bytes = {};
+
+	resolved_files_release(gltf_data->resolved_files);
+	gltf_data->resolved_files = nullptr;
+}
+
+// base_directory joined with uri, JSON escapes and then %XX escapes decoded. Returns an empty view for uris with a scheme, they do not name a local file.
+static data_view<char> uri_to_path(const char* base_directory, string_view uri, VkAllocationCallbacks* host_allocator)
+{
+	size_t scheme_length = 0;
+	while (scheme_length < uri.data_length && (isalnum(uint8_t(uri.data[scheme_length])) || uri.data[scheme_length] == '+' || uri.data[scheme_length] == '-' || uri.data[scheme_length] == '.'))
+		++scheme_length;
+	// A single letter is a Windows drive instead of a scheme.
+	if (scheme_length > 1 && scheme_length < uri.data_length && uri.data[scheme_length] == ':')
+		return {};
+
+	size_t base_length = base_directory ? strlen(base_directory) : 0;
+	bool needs_separator = base_length && base_directory[base_length - 1] != '/' && base_directory[base_length - 1] != '\\';
+	size_t capacity = base_length + needs_separator + uri.data_length + 1;
+
+	char* path = host_allocator ?
+		reinterpret_cast<char*>(host_allocator->pfnAllocation(host_allocator->pUserData, capacity, 1, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new char[capacity];
+	if (!path)
+		return {};
+
+	memcpy(path, base_directory, base_length);
+	size_t length = base_length;
+	if (needs_separator)
+		path[length++] = '/';
+
+	size_t uri_start = length;
+	size_t uri_end = uri_start + acp_vulkan::gltf_string_unescape(uri, path + uri_start);
+	for (size_t ii = uri_start; ii < uri_end; ++ii)
+	{
+		uint32_t high = ii + 2 < uri_end && path[ii] == '%' ? hex_digit_value(path[ii + 1]) : UINT32_MAX;
+		uint32_t low = high != UINT32_MAX ? hex_digit_value(path[ii + 2]) : UINT32_MAX;
+		if (low != UINT32_MAX)
+		{
+			path[length++] = char(high * 16 + low);
+			ii += 2;
+		}
+		else
+			path[length++] = path[ii];
+	}
+	path[length] = '\0';
+
+	return { .data = path, .data_length = length };
+}
+
+static uint64_t path_hash(const char* path, size_t path_length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t ii = 0; ii < path_length; ++ii)
+		hash = (hash ^ uint8_t(path[ii])) * 1099511628211ull;
+	return hash;
+}
+
+struct resolved_files_builder
+{
+	acp_vulkan::gltf_resolved_files* resolved;
+	temp_data_view<acp_vulkan::gltf_resolved_files::file> files;
+	// Open addressing table of file indices keyed by path, UINT32_MAX marks a free slot.
+	temp_data_view<uint32_t> slots;
+};
+
+// Index of the file uri resolves to, reusing the one added for an earlier identical path. UINT32_MAX when uri is not a local file.
+static uint32_t find_or_add_resolved_file(resolved_files_builder* builder, const char* base_directory, string_view uri)
+{
+	VkAllocationCallbacks* host_allocator = builder->resolved->host_allocator;
+	if (!uri.data || uri.data_length == 0)
+		return UINT32_MAX;
+
+	data_view<char> path = uri_to_path(base_directory, uri, host_allocator);
+	if (!path.data)
+		return UINT32_MAX;
+
+	uint64_t hash = path_hash(path.data, path.data_length);
+	size_t mask = builder->slots.data_length - 1;
+	for (size_t slot = size_t(hash) & mask;; slot = (slot + 1) & mask)
+	{
+		uint32_t index = builder->slots.data[slot];
+		if (index == UINT32_MAX)
+		{
+			builder->slots.data[slot] = uint32_t(builder->files.data_length);
+			builder->files.emplace_back(acp_vulkan::gltf_resolved_files::file{
+				.path = path.data,
+				.path_length = path.data_length,
+				.path_hash = hash,
+				.state = acp_vulkan::gltf_data::valid,
+			});
+			return builder->slots.data[slot];
+		}
+
+		const acp_vulkan::gltf_resolved_files::file& file = builder->files.data[index];
+		if (file.path_hash == hash && file.path_length == path.data_length && memcmp(file.path, path.data, path.data_length) == 0)
+		{
+			free_gltf_buffer(path, host_allocator);
+			return index;
+		}
+	}
+}
+
+static void read_resolved_file_job(void* job_data, size_t job_index)
+{
+	acp_vulkan::gltf_resolved_files* resolved = reinterpret_cast<acp_vulkan::gltf_resolved_files*>(job_data);
+	acp_vulkan::gltf_resolved_files::file* file = &resolved->files.data[job_index];
+
+	if (resolved->reader.read)
+	{
+		if (!resolved->reader.read(resolved->reader.user_data, file->path, &file->data, &file->data_size))
+		{
+			file->data = nullptr;
+			file->state = acp_vulkan::gltf_data::unable_to_open_file;
+		}
+		return;
+	}
+
+	file->data = reinterpret_cast<uint8_t*>(read_file(file->path, resolved->host_allocator, &file->data_size, &file->mapped, &file->state));
+}
+
+acp_vulkan::gltf_data::gltf_state_type acp_vulkan::gltf_resolve_uris(gltf_data* gltf_data, const char* base_directory, VkAllocationCallbacks* host_allocator,
+	gltf_resolve_flags resolve_flags, const gltf_file_reader* reader)
+{
+	release_resolved_files_of(gltf_data, host_allocator);
+
+	gltf_resolved_files* resolved = host_allocator ?
+		reinterpret_cast<gltf_resolved_files*>(host_allocator->pfnAllocation(host_allocator->pUserData, sizeof(gltf_resolved_files), alignof(gltf_resolved_files), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+		: new gltf_resolved_files;
+	if (!resolved)
+		return gltf_data::unable_to_read_file;
+	*resolved = {
+		.reader = reader && reader->read ? *reader : gltf_file_reader{},
+		.host_allocator = host_allocator,
+	};
+
+	size_t image_count = (resolve_flags & gltf_resolve_images) ? gltf_data->images.data_length : 0;
+	size_t uri_count = gltf_data->buffers.data_length + image_count;
+
+	resolved_files_builder builder{ .resolved = resolved };
+	builder.files.host_allocator = host_allocator;
+	builder.slots.host_allocator = host_allocator;
+	size_t slot_count = 16;
+	while (slot_count < uri_count * 2)
+		slot_count *= 2;
+	builder.slots.reserve(slot_count);
+	for (size_t ii = 0; ii < slot_count; ++ii)
+		builder.slots.data[ii] = UINT32_MAX;
+	builder.slots.data_length = slot_count;
+
+	temp_data_view<uint32_t> uri_files{};
+	uri_files.host_allocator = host_allocator;
+	uri_files.reserve(uri_count);
+	for (size_t ii = 0; ii < gltf_data->buffers.data_length; ++ii)
+		uri_files.emplace_back(gltf_data->buffers.data[ii].embedded_bytes.data ? UINT32_MAX : find_or_add_resolved_file(&builder, base_directory, gltf_data->buffers.data[ii].uri));
+	for (size_t ii = 0; ii < image_count; ++ii)
+		uri_files.emplace_back(gltf_data->images.data[ii].embedded_bytes.data ? UINT32_MAX : find_or_add_resolved_file(&builder, base_directory, gltf_data->images.data[ii].uri));
+
+	resolved->files = builder.files.to();
+	gltf_data->resolved_files = resolved;
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((resolve_flags & gltf_resolve_parallel_reads) && resolved->files.data_length > 1 && has_workers)
+		run_parsing_jobs(read_resolved_file_job, resolved, resolved->files.data_length);
+	else
+		for (size_t ii = 0; ii < resolved->files.data_length; ++ii)
+			read_resolved_file_job(resolved, ii);
+
+	gltf_data::gltf_state_type out = gltf_data::valid;
+	for (size_t ii = 0; ii < uri_count; ++ii)
+	{
+		uint32_t file_index = uri_files.data[ii];
+		if (file_index == UINT32_MAX)
+			continue;
+
+		const gltf_resolved_files::file& file = resolved->files.data[file_index];
+		bool is_buffer = ii < gltf_data->buffers.data_length;
+		if (!file.data || (is_buffer && file.data_size < gltf_data->buffers.data[ii].byte_length))
+		{
+			if (out == gltf_data::valid)
+				out = file.data ? gltf_data::unable_to_read_file : file.state;
+			continue;
+		}
+
+		if (is_buffer)
+			gltf_data->buffers.data[ii].resolved_bytes = { .data = file.data, .data_length = gltf_data->buffers.data[ii].byte_length };
+		else
+			gltf_data->images.data[ii - gltf_data->buffers.data_length].resolved_bytes = { .data = file.data, .data_length = file.data_size };
+	}
+
+	return out;
+}
+
+acp_vulkan::gltf_data::data_view<uint8_t> acp_vulkan::gltf_buffer_bytes(const gltf_data* gltf_data, uint32_t buffer_index)
+{
+	if (buffer_index >= gltf_data->buffers.data_length)
+		return {};
+
+	const gltf_data::buffer& buffer = gltf_data->buffers.data[buffer_index];
+	if (buffer.embedded_bytes.data)
+		return buffer.embedded_bytes;
+	if (buffer.resolved_bytes.data)
+		return buffer.resolved_bytes;
+	// The GLB BIN chunk is the first buffer, the one without an uri.
+	if (buffer_index == 0 && !buffer.uri.data)
+		return gltf_data->embedded_buffer;
+	return {};
+}
+
+enum class component_kind : uint8_t
+{
+	none,
+	i8,
+	u8,
+	i16,
+	u16,
+	u32,
+	i32,
+	f16,
+	f32
+};
+
+struct component_layout
+{
+	component_kind kind;
+	bool normalized;
+	uint32_t component_count;
+};
+
+static uint32_t component_size(component_kind kind)
+{
+	switch (kind)
+	{
+	case component_kind::i8:
+	case component_kind::u8:
+		return 1;
+	case component_kind::i16:
+	case component_kind::u16:
+	case component_kind::f16:
+		return 2;
+	case component_kind::u32:
+	case component_kind::i32:
+	case component_kind::f32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static bool is_integer_kind(component_kind kind)
+{
+	return kind != component_kind::f16 && kind != component_kind::f32 && kind != component_kind::none;
+}
+
+static component_layout target_layout(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM: return { component_kind::u8, true, 1 };
+	case VK_FORMAT_R8G8_UNORM: return { component_kind::u8, true, 2 };
+	case VK_FORMAT_R8G8B8_UNORM: return { component_kind::u8, true, 3 };
+	case VK_FORMAT_R8G8B8A8_UNORM: return { component_kind::u8, true, 4 };
+	case VK_FORMAT_R8_SNORM: return { component_kind::i8, true, 1 };
+	case VK_FORMAT_R8G8_SNORM: return { component_kind::i8, true, 2 };
+	case VK_FORMAT_R8G8B8_SNORM: return { component_kind::i8, true, 3 };
+	case VK_FORMAT_R8G8B8A8_SNORM: return { component_kind::i8, true, 4 };
+	case VK_FORMAT_R8_UINT: return { component_kind::u8, false, 1 };
+	case VK_FORMAT_R8G8_UINT: return { component_kind::u8, false, 2 };
+	case VK_FORMAT_R8G8B8_UINT: return { component_kind::u8, false, 3 };
+	case VK_FORMAT_R8G8B8A8_UINT: return { component_kind::u8, false, 4 };
+	case VK_FORMAT_R8_SINT: return { component_kind::i8, false, 1 };
+	case VK_FORMAT_R8G8_SINT: return { component_kind::i8, false, 2 };
+	case VK_FORMAT_R8G8B8_SINT: return { component_kind::i8, false, 3 };
+	case VK_FORMAT_R8G8B8A8_SINT: return { component_kind::i8, false, 4 };
+	case VK_FORMAT_R16_UNORM: return { component_kind::u16, true, 1 };
+	case VK_FORMAT_R16G16_UNORM: return { component_kind::u16, true, 2 };
+	case VK_FORMAT_R16G16B16_UNORM: return { component_kind::u16, true, 3 };
+	case VK_FORMAT_R16G16B16A16_UNORM: return { component_kind::u16, true, 4 };
+	case VK_FORMAT_R16_SNORM: return { component_kind::i16, true, 1 };
+	case VK_FORMAT_R16G16_SNORM: return { component_kind::i16, true, 2 };
+	case VK_FORMAT_R16G16B16_SNORM: return { component_kind::i16, true, 3 };
+	case VK_FORMAT_R16G16B16A16_SNORM: return { component_kind::i16, true, 4 };
+	case VK_FORMAT_R16_UINT: return { component_kind::u16, false, 1 };
+	case VK_FORMAT_R16G16_UINT: return { component_kind::u16, false, 2 };
+	case VK_FORMAT_R16G16B16_UINT: return { component_kind::u16, false, 3 };
+	case VK_FORMAT_R16G16B16A16_UINT: return { component_kind::u16, false, 4 };
+	case VK_FORMAT_R16_SINT: return { component_kind::i16, false, 1 };
+	case VK_FORMAT_R16G16_SINT: return { component_kind::i16, false, 2 };
+	case VK_FORMAT_R16G16B16_SINT: return { component_kind::i16, false, 3 };
+	case VK_FORMAT_R16G16B16A16_SINT: return { component_kind::i16, false, 4 };
+	case VK_FORMAT_R16_SFLOAT: return { component_kind::f16, false, 1 };
+	case VK_FORMAT_R16G16_SFLOAT: return { component_kind::f16, false, 2 };
+	case VK_FORMAT_R16G16B16_SFLOAT: return { component_kind::f16, false, 3 };
+	case VK_FORMAT_R16G16B16A16_SFLOAT: return { component_kind::f16, false, 4 };
+	case VK_FORMAT_R32_UINT: return { component_kind::u32, false, 1 };
+	case VK_FORMAT_R32G32_UINT: return { component_kind::u32, false, 2 };
+	case VK_FORMAT_R32G32B32_UINT: return { component_kind::u32, false, 3 };
+	case VK_FORMAT_R32G32B32A32_UINT: return { component_kind::u32, false, 4 };
+	case VK_FORMAT_R32_SINT: return { component_kind::i32, false, 1 };
+	case VK_FORMAT_R32G32_SINT: return { component_kind::i32, false, 2 };
+	case VK_FORMAT_R32G32B32_SINT: return { component_kind::i32, false, 3 };
+	case VK_FORMAT_R32G32B32A32_SINT: return { component_kind::i32, false, 4 };
+	case VK_FORMAT_R32_SFLOAT: return { component_kind::f32, false, 1 };
+	case VK_FORMAT_R32G32_SFLOAT: return { component_kind::f32, false, 2 };
+	case VK_FORMAT_R32G32B32_SFLOAT: return { component_kind::f32, false, 3 };
+	case VK_FORMAT_R32G32B32A32_SFLOAT: return { component_kind::f32, false, 4 };
+	default: return {};
+	}
+}
+
+static component_kind accessor_component_kind(acp_vulkan::gltf_data::accesor::component_type_type component_type)
+{
+	using component_type_type = acp_vulkan::gltf_data::accesor::component_type_type;
+	switch (component_type)
+	{
+	case component_type_type::BYTE: return component_kind::i8;
+	case component_type_type::UNSIGNED_BYTE: return component_kind::u8;
+	case component_type_type::SHORT: return component_kind::i16;
+	case component_type_type::UNSIGNED_SHORT: return component_kind::u16;
+	case component_type_type::UNSIGNED_INT: return component_kind::u32;
+	case component_type_type::FLOAT: return component_kind::f32;
+	default: return component_kind::none;
+	}
+}
+
+// How an accessor element sits in its buffer view. Matrix columns of 1 and 2 byte components start on 4 byte boundaries.
+struct accessor_layout
+{
+	component_layout source;
+	component_layout target;
+	uint32_t rows;
+	uint32_t columns;
+	uint32_t column_stride;
+	uint32_t element_size;
+	uint32_t target_element_size;
+};
+
+static bool accessor_layout_for(const acp_vulkan::gltf_data::accesor& accessor, VkFormat target_format, accessor_layout* out)
+{
+	using type_type = acp_vulkan::gltf_data::accesor::type_type;
+	uint32_t rows = 1;
+	uint32_t columns = 1;
+	switch (accessor.type)
+	{
+	case type_type::SCALAR: rows = 1; break;
+	case type_type::VEC2: rows = 2; break;
+	case type_type::VEC3: rows = 3; break;
+	case type_type::VEC4: rows = 4; break;
+	case type_type::MAT2: rows = 2; columns = 2; break;
+	case type_type::MAT3: rows = 3; columns = 3; break;
+	case type_type::MAT4: rows = 4; columns = 4; break;
+	default: return false;
+	}
+
+	component_layout source{ accessor_component_kind(accessor.component_type), accessor.normalized, rows * columns };
+	// VK_FORMAT_UNDEFINED keeps the accessor's own components.
+	component_layout target = target_format == VK_FORMAT_UNDEFINED ? source : target_layout(target_format);
+	if (source.kind == component_kind::none || target.kind == component_kind::none)
+		return false;
+	if (target.component_count != source.component_count && target.component_count != 1)
+		return false;
+
+	uint32_t source_size = component_size(source.kind);
+	uint32_t column_stride = rows * source_size;
+	if (columns > 1)
+		column_stride = (column_stride + 3) & ~3u;
+
+	*out = {
+		.source = source,
+		.target = target,
+		.rows = rows,
+		.columns = columns,
+		.column_stride = column_stride,
+		.element_size = column_stride * columns,
+		.target_element_size = source.component_count * component_size(target.kind),
+	};
+	return true;
+}
+
+// The bytes of a buffer view, null when the view or its buffer is missing or the view does not fit in the buffer.
+static const uint8_t* buffer_view_bytes(const acp_vulkan::gltf_data* gltf_data, uint32_t buffer_view, const acp_vulkan::gltf_data::buffer_view** out_view)
+{
+	if (buffer_view >= gltf_data->buffer_views.data_length)
+		return nullptr;
+
+	const acp_vulkan::gltf_data::buffer_view& view = gltf_data->buffer_views.data[buffer_view];
+	acp_vulkan::gltf_data::data_view<uint8_t> bytes = acp_vulkan::gltf_buffer_bytes(gltf_data, view.buffer);
+	if (!bytes.data || uint64_t(view.byte_offset) + view.byte_length > bytes.data_length)
+		return nullptr;
+
+	*out_view = &view;
+	return bytes.data + view.byte_offset;
+}
+
+// Finds the bytes of the first element and the distance between elements, checking every element lies inside the buffer view and buffer.
+static bool accessor_source(const acp_vulkan::gltf_data* gltf_data, const acp_vulkan::gltf_data::accesor& accessor, const accessor_layout& layout,
+	const uint8_t** out_data, size_t* out_stride)
+{
+	const acp_vulkan::gltf_data::buffer_view* view = nullptr;
+	const uint8_t* bytes = buffer_view_bytes(gltf_data, accessor.buffer_view, &view);
+	if (!bytes)
+		return false;
+
+	size_t stride = view->byte_stride ? view->byte_stride : layout.element_size;
+	if (accessor.count && uint64_t(accessor.byte_offset) + uint64_t(accessor.count - 1) * stride + layout.element_size > view->byte_length)
+		return false;
+
+	*out_data = bytes + accessor.byte_offset;
+	*out_stride = stride;
+	return true;
+}
+
+// Copying the bytes gives the same result as converting them.
+static bool is_identity_conversion(const accessor_layout& layout)
+{
+	if (layout.source.kind != layout.target.kind)
+		return false;
+	return is_integer_kind(layout.target.kind) ? (!layout.target.normalized || layout.source.normalized) : true;
+}
+
+template<typename T>
+static T load_component(const uint8_t* data)
+{
+	T out;
+	memcpy(&out, data, sizeof(T));
+	return out;
+}
+
+static uint16_t float_to_half(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff)
+		return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	int32_t half_exponent = int32_t(exponent) - 127 + 15;
+	if (half_exponent >= 31)
+		return uint16_t(sign | 0x7c00);
+	if (half_exponent <= 0)
+	{
+		if (half_exponent < -10)
+			return uint16_t(sign);
+		// Denormal, round to nearest even on the bits shifted out.
+		mantissa |= 0x800000;
+		uint32_t shift = uint32_t(14 - half_exponent);
+		uint32_t half_mantissa = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half_mantissa & 1)))
+			++half_mantissa;
+		return uint16_t(sign | half_mantissa);
+	}
+
+	uint32_t half = sign | (uint32_t(half_exponent) << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	// A carry out of the mantissa moves in to the exponent, which also rounds the largest values to infinity.
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		++half;
+	return uint16_t(half);
+}
+
+static void read_components_float(component_kind kind, bool normalized, const uint8_t* data, uint32_t count, float* out)
+{
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		switch (kind)
+		{
+		case component_kind::i8:
+		{
+			float value = float(load_component<int8_t>(data + ii));
+			out[ii] = normalized ? (value / 127.0f < -1.0f ? -1.0f : value / 127.0f) : value;
+			break;
+		}
+		case component_kind::u8:
+			out[ii] = float(data[ii]) * (normalized ? 1.0f / 255.0f : 1.0f);
+			break;
+		case component_kind::i16:
+		{
+			float value = float(load_component<int16_t>(data + ii * 2));
+			out[ii] = normalized ? (value / 32767.0f < -1.0f ? -1.0f : value / 32767.0f) : value;
+			break;
+		}
+		case component_kind::u16:
+			out[ii] = float(load_component<uint16_t>(data + ii * 2)) * (normalized ? 1.0f / 65535.0f : 1.0f);
+			break;
+		case component_kind::u32:
+			out[ii] = float(load_component<uint32_t>(data + ii * 4));
+			break;
+		case component_kind::i32:
+			out[ii] = float(load_component<int32_t>(data + ii * 4));
+			break;
+		case component_kind::f32:
+			out[ii] = load_component<float>(data + ii * 4);
+			break;
+		default:
+			out[ii] = 0.0f;
+			break;
+		}
+	}
+}
+
+template<typename T>
+static void store_component(uint8_t* data, T value)
+{
+	memcpy(data, &value, sizeof(T));
+}
+
+// Clamps to [low, high] with NaN going to 0, then rounds when the target is normalized and truncates otherwise.
+static float quantize_component(float value, float low, float high, float scale, bool normalized)
+{
+	if (!(value == value))
+		return 0.0f;
+	value = value < low ? low : value > high ? high : value;
+	return normalized ? roundf(value * scale) : truncf(value);
+}
+
+static void write_components_float(component_kind kind, bool normalized, const float* in, uint32_t count, uint8_t* out)
+{
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		switch (kind)
+		{
+		case component_kind::i8:
+			store_component(out + ii, int8_t(normalized ? quantize_component(in[ii], -1.0f, 1.0f, 127.0f, true) : quantize_component(in[ii], -128.0f, 127.0f, 1.0f, false)));
+			break;
+		case component_kind::u8:
+			store_component(out + ii, uint8_t(normalized ? quantize_component(in[ii], 0.0f, 1.0f, 255.0f, true) : quantize_component(in[ii], 0.0f, 255.0f, 1.0f, false)));
+			break;
+		case component_kind::i16:
+			store_component(out + ii * 2, int16_t(normalized ? quantize_component(in[ii], -1.0f, 1.0f, 32767.0f, true) : quantize_component(in[ii], -32768.0f, 32767.0f, 1.0f, false)));
+			break;
+		case component_kind::u16:
+			store_component(out + ii * 2, uint16_t(normalized ? quantize_component(in[ii], 0.0f, 1.0f, 65535.0f, true) : quantize_component(in[ii], 0.0f, 65535.0f, 1.0f, false)));
+			break;
+		case component_kind::u32:
+			// 4294967295 is not representable as a float, 4294967040 is the largest one below it.
+			store_component(out + ii * 4, uint32_t(quantize_component(in[ii], 0.0f, 4294967040.0f, 1.0f, false)));
+			break;
+		case component_kind::i32:
+			store_component(out + ii * 4, int32_t(quantize_component(in[ii], -2147483648.0f, 2147483520.0f, 1.0f, false)));
+			break;
+		case component_kind::f16:
+			store_component(out + ii * 2, float_to_half(in[ii]));
+			break;
+		case component_kind::f32:
+			store_component(out + ii * 4, in[ii]);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void read_components_int(component_kind kind, const uint8_t* data, uint32_t count, int64_t* out)
+{
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		switch (kind)
+		{
+		case component_kind::i8: out[ii] = load_component<int8_t>(data + ii); break;
+		case component_kind::u8: out[ii] = data[ii]; break;
+		case component_kind::i16: out[ii] = load_component<int16_t>(data + ii * 2); break;
+		case component_kind::u16: out[ii] = load_component<uint16_t>(data + ii * 2); break;
+		case component_kind::u32: out[ii] = load_component<uint32_t>(data + ii * 4); break;
+		case component_kind::i32: out[ii] = load_component<int32_t>(data + ii * 4); break;
+		default: out[ii] = 0; break;
+		}
+	}
+}
+
+static int64_t clamp_component(int64_t value, int64_t low, int64_t high)
+{
+	return value < low ? low : value > high ? high : value;
+}
+
+static void write_components_int(component_kind kind, const int64_t* in, uint32_t count, uint8_t* out)
+{
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		switch (kind)
+		{
+		case component_kind::i8: store_component(out + ii, int8_t(clamp_component(in[ii], INT8_MIN, INT8_MAX))); break;
+		case component_kind::u8: store_component(out + ii, uint8_t(clamp_component(in[ii], 0, UINT8_MAX))); break;
+		case component_kind::i16: store_component(out + ii * 2, int16_t(clamp_component(in[ii], INT16_MIN, INT16_MAX))); break;
+		case component_kind::u16: store_component(out + ii * 2, uint16_t(clamp_component(in[ii], 0, UINT16_MAX))); break;
+		case component_kind::u32: store_component(out + ii * 4, uint32_t(clamp_component(in[ii], 0, UINT32_MAX))); break;
+		case component_kind::i32: store_component(out + ii * 4, int32_t(clamp_component(in[ii], INT32_MIN, INT32_MAX))); break;
+		default: break;
+		}
+	}
+}
+
+// Widens tightly packed 8 and 16 bit components to 32 bit integers, or to floats multiplied by scale (and clamped to -1 for snorm).
+struct widen_params
+{
+	component_kind source;
+	bool to_float;
+	float scale;
+	bool clamp_to_minus_one;
+};
+
+typedef void (*widen_components_type)(const uint8_t* data, size_t count, const widen_params& params, uint8_t* out);
+
+static void widen_components_scalar(const uint8_t* data, size_t count, const widen_params& params, uint8_t* out)
+{
+	for (size_t ii = 0; ii < count; ++ii)
+	{
+		int32_t value = 0;
+		switch (params.source)
+		{
+		case component_kind::i8: value = load_component<int8_t>(data + ii); break;
+		case component_kind::u8: value = data[ii]; break;
+		case component_kind::i16: value = load_component<int16_t>(data + ii * 2); break;
+		case component_kind::u16: value = load_component<uint16_t>(data + ii * 2); break;
+		default: break;
+		}
+
+		if (params.to_float)
+		{
+			float as_float = float(value) * params.scale;
+			store_component(out + ii * 4, params.clamp_to_minus_one && as_float < -1.0f ? -1.0f : as_float);
+		}
+		else
+			store_component(out + ii * 4, value);
+	}
+}
+
+#if ACP_GLTF_X86
+template<component_kind kind>
+static __m128i load_widened_sse2(const uint8_t* data)
+{
+	const __m128i zero = _mm_setzero_si128();
+	if constexpr (kind == component_kind::u8)
+	{
+		int32_t bytes;
+		memcpy(&bytes, data, sizeof(bytes));
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+	}
+	else if constexpr (kind == component_kind::i8)
+	{
+		int32_t bytes;
+		memcpy(&bytes, data, sizeof(bytes));
+		__m128i v = _mm_cvtsi32_si128(bytes);
+		v = _mm_unpacklo_epi8(v, v);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+	}
+	else if constexpr (kind == component_kind::u16)
+		return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)), zero);
+	else
+	{
+		__m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	}
+}
+
+template<component_kind kind>
+static void widen_components_sse2_for(const uint8_t* data, size_t count, const widen_params& params, uint8_t* out)
+{
+	const size_t source_size = kind == component_kind::u8 || kind == component_kind::i8 ? 1 : 2;
+	const __m128 scale = _mm_set1_ps(params.scale);
+	const __m128 minus_one = _mm_set1_ps(params.clamp_to_minus_one ? -1.0f : -FLT_MAX);
+
+	size_t ii = 0;
+	for (; ii + 4 <= count; ii += 4)
+	{
+		__m128i v = load_widened_sse2<kind>(data + ii * source_size);
+		if (params.to_float)
+			_mm_storeu_ps(reinterpret_cast<float*>(out + ii * 4), _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), scale), minus_one));
+		else
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + ii * 4), v);
+	}
+	widen_components_scalar(data + ii * source_size, count - ii, params, out + ii * 4);
+}
+
+static void widen_components_sse2(const uint8_t* data, size_t count, const widen_params& params, uint8_t* out)
+{
+	switch (params.source)
+	{
+	case component_kind::i8: widen_components_sse2_for<component_kind::i8>(data, count, params, out); break;
+	case component_kind::u8: widen_components_sse2_for<component_kind::u8>(data, count, params, out); break;
+	case component_kind::i16: widen_components_sse2_for<component_kind::i16>(data, count, params, out); break;
+	case component_kind::u16: widen_components_sse2_for<component_kind::u16>(data, count, params, out); break;
+	default: widen_components_scalar(data, count, params, out); break;
+	}
+}
+
+template<component_kind kind>
+ACP_GLTF_TARGET_AVX2 static __m256i load_widened_avx2(const uint8_t* data)
+{
+	if constexpr (kind == component_kind::u8)
+		return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+	else if constexpr (kind == component_kind::i8)
+		return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+	else if constexpr (kind == component_kind::u16)
+		return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+	else
+		return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+}
+
+template<component_kind kind>
+ACP_GLTF_TARGET_AVX2 static void widen_components_avx2_for(const uint8_t* data, size_t count, const widen_params& params, uint8_t* out)
+{
+	const size_t source_size = kind == component_kind::u8 || kind == component_kind::i8 ? 1 : 2;
+	const __m256 scale = _mm256_set1_ps(params.scale);
+	const __m256 minus_one = _mm256_set1_ps(params.clamp_to_minus_one ? -1.0f : -FLT_MAX);
+
+	size_t ii = 0;
+	for (; ii + 8 <= count; ii += 8)
+	{
+		__m256i v = load_widened_avx2<kind>(data + ii * source_size);
+		if (params.to_float)
+			_mm256_storeu_ps(reinterpret_cast<float*>(out + ii * 4), _mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(v), scale), minus_one));
+		else
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + ii * 4), v);
+	}
+	widen_components_scalar(data + ii * source_size, count - ii, params, out + ii * 4);
+}
+
+ACP_GLTF_TARGET_AVX2 static void widen_components_avx2(const uint8_t* data, size_t count, const widen_params& params, uint8_t* out)
+{
+	switch (params.source)
+	{
+	case component_kind::i8: widen_components_avx2_for<component_kind::i8>(data, count, params, out); break;
+	case component_kind::u8: widen_components_avx2_for<component_kind::u8>(data, count, params, out); break;
+	case component_kind::i16: widen_components_avx2_for<component_kind::i16>(data, count, params, out); break;
+	case component_kind::u16: widen_components_avx2_for<component_kind::u16>(data, count, params, out); break;
+	default: widen_components_scalar(data, count, params, out); break;
+	}
+}
+#endif
+
+static widen_components_type widen_components_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend == acp_vulkan::gltf_scan_backend::avx2)
+		return widen_components_avx2;
+	if (backend == acp_vulkan::gltf_scan_backend::sse2)
+		return widen_components_sse2;
+#endif
+	return widen_components_scalar;
+}
+
+// The widening kernels cover 8 and 16 bit sources going to 32 bit integers, or normalized ones going to floats.
+static bool widen_params_for(const accessor_layout& layout, widen_params* out)
+{
+	component_kind source = layout.source.kind;
+	if (source != component_kind::i8 && source != component_kind::u8 && source != component_kind::i16 && source != component_kind::u16)
+		return false;
+
+	bool is_signed = source == component_kind::i8 || source == component_kind::i16;
+	if (layout.target.kind == component_kind::u32 || layout.target.kind == component_kind::i32)
+	{
+		// Negative values clamp to 0 in a u32 target.
+		if (is_signed && layout.target.kind == component_kind::u32)
+			return false;
+		*out = { .source = source, .to_float = false, .scale = 1.0f, .clamp_to_minus_one = false };
+		return true;
+	}
+
+	if (layout.target.kind != component_kind::f32)
+		return false;
+
+	float scale = 1.0f;
+	if (layout.source.normalized)
+	{
+		switch (source)
+		{
+		case component_kind::i8: scale = 1.0f / 127.0f; break;
+		case component_kind::u8: scale = 1.0f / 255.0f; break;
+		case component_kind::i16: scale = 1.0f / 32767.0f; break;
+		default: scale = 1.0f / 65535.0f; break;
+		}
+	}
+	*out = { .source = source, .to_float = true, .scale = scale, .clamp_to_minus_one = layout.source.normalized && is_signed };
+	return true;
+}
+
+static void convert_element(const accessor_layout& layout, const uint8_t* data, uint8_t* out)
+{
+	bool integer_conversion = is_integer_kind(layout.source.kind) && is_integer_kind(layout.target.kind) && !layout.target.normalized;
+	uint32_t target_size = component_size(layout.target.kind);
+	for (uint32_t column = 0; column < layout.columns; ++column)
+	{
+		const uint8_t* column_data = data + column * layout.column_stride;
+		uint8_t* column_out = out + column * layout.rows * target_size;
+		if (integer_conversion)
+		{
+			int64_t values[4];
+			read_components_int(layout.source.kind, column_data, layout.rows, values);
+			write_components_int(layout.target.kind, values, layout.rows, column_out);
+		}
+		else
+		{
+			float values[4];
+			read_components_float(layout.source.kind, layout.source.normalized, column_data, layout.rows, values);
+			write_components_float(layout.target.kind, layout.target.normalized, values, layout.rows, column_out);
+		}
+	}
+}
+
+size_t acp_vulkan::gltf_accessor_read_size(const gltf_data* gltf_data, uint32_t accessor_index, VkFormat target_format)
+{
+	if (accessor_index >= gltf_data->accesors.data_length)
+		return 0;
+
+	const gltf_data::accesor& accessor = gltf_data->accesors.data[accessor_index];
+	accessor_layout layout;
+	if (!accessor_layout_for(accessor, target_format, &layout))
+		return 0;
+	return size_t(accessor.count) * layout.target_element_size;
+}
+
+// Converts count elements stride bytes apart in to tightly packed target elements.
+static void convert_accessor_elements(const accessor_layout& layout, const uint8_t* data, size_t stride, size_t count, uint8_t* out)
+{
+	bool packed = stride == layout.element_size && layout.element_size == layout.source.component_count * component_size(layout.source.kind);
+	if (is_identity_conversion(layout) && layout.element_size == layout.target_element_size)
+	{
+		if (packed)
+			memcpy(out, data, count * layout.target_element_size);
+		else
+			for (size_t ii = 0; ii < count; ++ii)
+				memcpy(out + ii * layout.target_element_size, data + ii * stride, layout.target_element_size);
+		return;
+	}
+
+	widen_params params;
+	if (widen_params_for(layout, &params))
+	{
+		widen_components_type widen_components = widen_components_for(acp_vulkan::gltf_get_scan_backend());
+		if (packed)
+			widen_components(data, count * layout.source.component_count, params, out);
+		else
+			for (size_t ii = 0; ii < count; ++ii)
+				for (uint32_t column = 0; column < layout.columns; ++column)
+					widen_components_scalar(data + ii * stride + column * layout.column_stride, layout.rows, params,
+						out + ii * layout.target_element_size + column * layout.rows * 4);
+		return;
+	}
+
+	for (size_t ii = 0; ii < count; ++ii)
+		convert_element(layout, data + ii * stride, out + ii * layout.target_element_size);
+}
+
+struct sparse_source
+{
+	const uint8_t* indices;
+	uint32_t index_size;
+	// Tightly packed elements in the accessor layout.
+	const uint8_t* values;
+	uint32_t count;
+};
+
+static bool sparse_source_for(const acp_vulkan::gltf_data* gltf_data, const acp_vulkan::gltf_data::accesor& accessor, const accessor_layout& layout, sparse_source* out)
+{
+	const acp_vulkan::gltf_data::accesor::sparse_type& sparse = accessor.sparse;
+	uint32_t index_size = 0;
+	switch (acp_vulkan::gltf_data::accesor::component_type_type(sparse.indices.component_type))
+	{
+	case acp_vulkan::gltf_data::accesor::component_type_type::UNSIGNED_BYTE: index_size = 1; break;
+	case acp_vulkan::gltf_data::accesor::component_type_type::UNSIGNED_SHORT: index_size = 2; break;
+	case acp_vulkan::gltf_data::accesor::component_type_type::UNSIGNED_INT: index_size = 4; break;
+	default: return false;
+	}
+
+	const acp_vulkan::gltf_data::buffer_view* indices_view = nullptr;
+	const acp_vulkan::gltf_data::buffer_view* values_view = nullptr;
+	const uint8_t* indices = buffer_view_bytes(gltf_data, sparse.indices.buffer_view, &indices_view);
+	const uint8_t* values = buffer_view_bytes(gltf_data, sparse.values.buffer_view, &values_view);
+	if (!indices || !values)
+		return false;
+	if (uint64_t(sparse.indices.byte_offset) + uint64_t(sparse.count) * index_size > indices_view->byte_length)
+		return false;
+	if (uint64_t(sparse.values.byte_offset) + uint64_t(sparse.count) * layout.element_size > values_view->byte_length)
+		return false;
+
+	*out = {
+		.indices = indices + sparse.indices.byte_offset,
+		.index_size = index_size,
+		.values = values + sparse.values.byte_offset,
+		.count = sparse.count,
+	};
+	return true;
+}
+
+// Sparse elements are decoded, converted and scattered this many at a time so the batch stays on the stack.
+#define SPARSE_BATCH_ELEMENTS 64
+// The largest target element, a MAT4 of 32 bit components.
+#define SPARSE_MAX_ELEMENT_SIZE 64
+
+template<size_t ELEMENT_SIZE>
+static void scatter_elements_for(uint8_t* out, const uint32_t* indices, const uint8_t* values, uint32_t count)
+{
+	for (uint32_t ii = 0; ii < count; ++ii)
+		memcpy(out + size_t(indices[ii]) * ELEMENT_SIZE, values + size_t(ii) * ELEMENT_SIZE, ELEMENT_SIZE);
+}
+
+// Fixed size copies for the common element sizes let the compiler use single vector moves per element.
+static void scatter_elements(uint8_t* out, size_t element_size, const uint32_t* indices, const uint8_t* values, uint32_t count)
+{
+	switch (element_size)
+	{
+	case 4: scatter_elements_for<4>(out, indices, values, count); break;
+	case 8: scatter_elements_for<8>(out, indices, values, count); break;
+	case 12: scatter_elements_for<12>(out, indices, values, count); break;
+	case 16: scatter_elements_for<16>(out, indices, values, count); break;
+	case 64: scatter_elements_for<64>(out, indices, values, count); break;
+	default:
+		for (uint32_t ii = 0; ii < count; ++ii)
+			memcpy(out + size_t(indices[ii]) * element_size, values + size_t(ii) * element_size, element_size);
+		break;
+	}
+}
+
+// Writes the sparse values over out (element_count elements of out_element_size bytes), converting them to the target layout when convert is set.
+// Returns false when an index is outside the accessor.
+static bool apply_sparse(const accessor_layout& layout, const sparse_source& sparse, uint32_t element_count, bool convert, uint8_t* out, size_t out_element_size)
+{
+	widen_components_type widen_components = widen_components_for(acp_vulkan::gltf_get_scan_backend());
+	const widen_params index_params{ .source = sparse.index_size == 1 ? component_kind::u8 : component_kind::u16, .to_float = false, .scale = 1.0f, .clamp_to_minus_one = false };
+
+	uint32_t indices[SPARSE_BATCH_ELEMENTS];
+	uint8_t converted[SPARSE_BATCH_ELEMENTS * SPARSE_MAX_ELEMENT_SIZE];
+	for (uint32_t first = 0; first < sparse.count; first += SPARSE_BATCH_ELEMENTS)
+	{
+		uint32_t batch = sparse.count - first < SPARSE_BATCH_ELEMENTS ? sparse.count - first : SPARSE_BATCH_ELEMENTS;
+
+		const uint8_t* index_data = sparse.indices + size_t(first) * sparse.index_size;
+		if (sparse.index_size == 4)
+			memcpy(indices, index_data, batch * sizeof(uint32_t));
+		else
+			widen_components(index_data, batch, index_params, reinterpret_cast<uint8_t*>(indices));
+
+		uint32_t max_index = 0;
+		for (uint32_t ii = 0; ii < batch; ++ii)
+			max_index = indices[ii] > max_index ? indices[ii] : max_index;
+		if (max_index >= element_count)
+			return false;
+
+		const uint8_t* values = sparse.values + size_t(first) * layout.element_size;
+		if (convert)
+		{
+			convert_accessor_elements(layout, values, layout.element_size, batch, converted);
+			values = converted;
+		}
+		scatter_elements(out, out_element_size, indices, values, batch);
+	}
+	return true;
+}
+
+static void release_sparse_resolved_of(acp_vulkan::gltf_data* gltf_data, VkAllocationCallbacks* host_allocator)
+{
+	for (size_t ii = 0; ii < gltf_data->accesors.data_length; ++ii)
+		free_gltf_buffer(gltf_data->accesors.data[ii].sparse_resolved_bytes, host_allocator);
+}
+
+bool acp_vulkan::gltf_resolve_sparse_accessors(gltf_data* gltf_data, VkAllocationCallbacks* host_allocator)
+{
+	bool resolved_all = true;
+	for (size_t ii = 0; ii < gltf_data->accesors.data_length; ++ii)
+	{
+		gltf_data::accesor& accessor = gltf_data->accesors.data[ii];
+		if (!accessor.is_sparse || accessor.sparse_resolved_bytes.data || !accessor.count)
+			continue;
+
+		accessor_layout layout;
+		sparse_source sparse;
+		const uint8_t* data = nullptr;
+		size_t stride = 0;
+		if (!accessor_layout_for(accessor, VK_FORMAT_UNDEFINED, &layout) || !sparse_source_for(gltf_data, accessor, layout, &sparse)
+			|| (accessor.has_buffer_view && !accessor_source(gltf_data, accessor, layout, &data, &stride)))
+		{
+			resolved_all = false;
+			continue;
+		}
+
+		size_t size = size_t(accessor.count) * layout.element_size;
+		uint8_t* bytes = host_allocator ?
+			reinterpret_cast<uint8_t*>(host_allocator->pfnAllocation(host_allocator->pUserData, size, 16, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+			: new uint8_t[size];
+		if (!bytes)
+		{
+			resolved_all = false;
+			continue;
+		}
+
+		gltf_data::data_view<uint8_t> resolved{ .data = bytes, .data_length = size };
+		if (!data)
+			memset(bytes, 0, size);
+		else if (stride == layout.element_size)
+			memcpy(bytes, data, size);
+		else
+			for (size_t jj = 0; jj < accessor.count; ++jj)
+				memcpy(bytes + jj * layout.element_size, data + jj * stride, layout.element_size);
+
+		if (!apply_sparse(layout, sparse, accessor.count, false, bytes, layout.element_size))
+		{
+			free_gltf_buffer(resolved, host_allocator);
+			resolved_all = false;
+			continue;
+		}
+		accessor.sparse_resolved_bytes = resolved;
+	}
+	return resolved_all;
+}
+
+acp_vulkan::gltf_data::data_view<const uint8_t> acp_vulkan::gltf_accessor_packed_view(const gltf_data* gltf_data, uint32_t accessor_index, VkFormat target_format)
+{
+	if (accessor_index >= gltf_data->accesors.data_length)
+		return {};
+
+	const gltf_data::accesor& accessor = gltf_data->accesors.data[accessor_index];
+	accessor_layout layout;
+	if (!accessor_layout_for(accessor, target_format, &layout))
+		return {};
+	if (!is_identity_conversion(layout) || layout.element_size != layout.target_element_size)
+		return {};
+
+	if (accessor.is_sparse)
+	{
+		if (!accessor.sparse_resolved_bytes.data)
+			return {};
+		return { .data = accessor.sparse_resolved_bytes.data, .data_length = accessor.sparse_resolved_bytes.data_length };
+	}
+
+	const uint8_t* data = nullptr;
+	size_t stride = 0;
+	if (!accessor.has_buffer_view || !accessor_source(gltf_data, accessor, layout, &data, &stride) || stride != layout.element_size)
+		return {};
+
+	return { .data = data, .data_length = size_t(accessor.count) * layout.element_size };
+}
+
+bool acp_vulkan::gltf_accessor_read(const gltf_data* gltf_data, uint32_t accessor_index, VkFormat target_format, void* out)
+{
+	if (accessor_index >= gltf_data->accesors.data_length)
+		return false;
+
+	const gltf_data::accesor& accessor = gltf_data->accesors.data[accessor_index];
+	accessor_layout layout;
+	if (!accessor_layout_for(accessor, target_format, &layout))
+		return false;
+
+	uint8_t* out_bytes = reinterpret_cast<uint8_t*>(out);
+	if (accessor.sparse_resolved_bytes.data)
+	{
+		convert_accessor_elements(layout, accessor.sparse_resolved_bytes.data, layout.element_size, accessor.count, out_bytes);
+		return true;
+	}
+
+	sparse_source sparse{};
+	if (accessor.is_sparse && !sparse_source_for(gltf_data, accessor, layout, &sparse))
+		return false;
+
+	const uint8_t* data = nullptr;
+	size_t stride = 0;
+	if (!accessor.has_buffer_view)
+		memset(out_bytes, 0, size_t(accessor.count) * layout.target_element_size);
+	else if (accessor_source(gltf_data, accessor, layout, &data, &stride))
+		convert_accessor_elements(layout, data, stride, accessor.count, out_bytes);
+	else
+		return false;
+
+	if (accessor.is_sparse)
+		return apply_sparse(layout, sparse, accessor.count, true, out_bytes, layout.target_element_size);
+	return true;
+}
+
+// Attribute formats a plain conversion cannot produce from the accessor, the mesh builder quantizes in to them instead.
+enum class vertex_encoding
+{
+	direct,
+	// POSITION in R16G16B16A16_UNORM, normalized to the bounds of its mesh.
+	position_unorm16,
+	// NORMAL in R16G16_SNORM, octahedral.
+	octahedral_snorm16,
+	// NORMAL or TANGENT in A2B10G10R10_SNORM_PACK32, the tangent handedness goes in alpha.
+	snorm_10_10_10_2,
+};
+
+static vertex_encoding attribute_encoding(const acp_vulkan::gltf_vertex_attribute& attribute)
+{
+	using acp_vulkan::gltf_data;
+	if (attribute.attribute == gltf_data::attribute::POSITION && attribute.format == VK_FORMAT_R16G16B16A16_UNORM)
+		return vertex_encoding::position_unorm16;
+	if (attribute.attribute == gltf_data::attribute::NORMAL && attribute.format == VK_FORMAT_R16G16_SNORM)
+		return vertex_encoding::octahedral_snorm16;
+	if ((attribute.attribute == gltf_data::attribute::NORMAL || attribute.attribute == gltf_data::attribute::TANGENT) && attribute.format == VK_FORMAT_A2B10G10R10_SNORM_PACK32)
+		return vertex_encoding::snorm_10_10_10_2;
+	return vertex_encoding::direct;
+}
+
+// The format the accessor is read as before it is encoded.
+static VkFormat attribute_decode_format(const acp_vulkan::gltf_vertex_attribute& attribute)
+{
+	switch (attribute_encoding(attribute))
+	{
+	case vertex_encoding::direct: return attribute.format;
+	case vertex_encoding::snorm_10_10_10_2:
+		return attribute.attribute == acp_vulkan::gltf_data::attribute::TANGENT ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+	default: return VK_FORMAT_R32G32B32_SFLOAT;
+	}
+}
+
+// Bytes of the attribute in a vertex, 0 when its format is not supported.
+static uint32_t vertex_attribute_size(const acp_vulkan::gltf_vertex_attribute& attribute)
+{
+	if (attribute_encoding(attribute) == vertex_encoding::snorm_10_10_10_2)
+		return sizeof(uint32_t);
+	component_layout layout = target_layout(attribute.format);
+	return layout.component_count * component_size(layout.kind);
+}
+
+uint32_t acp_vulkan::gltf_vertex_attribute_size(const gltf_vertex_attribute& attribute)
+{
+	return vertex_attribute_size(attribute);
+}
+
+static int32_t quantize_snorm(float value, int32_t max_value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return int32_t(roundf(value * float(max_value)));
+}
+
+// Writes count decoded elements (floats laid out as attribute_decode_format) in their encoding, every stride bytes of out.
+static void encode_vertex_attributes(vertex_encoding encoding, const float* decoded, uint32_t decoded_components, uint32_t count,
+	const acp_vulkan::gltf_mesh_buffers::mesh_data& mesh, uint8_t* out, size_t stride)
+{
+	for (uint32_t ii = 0; ii < count; ++ii, decoded += decoded_components, out += stride)
+	{
+		switch (encoding)
+		{
+		case vertex_encoding::position_unorm16:
+		{
+			uint16_t quantized[4]{ 0, 0, 0, UINT16_MAX };
+			for (uint32_t jj = 0; jj < 3; ++jj)
+			{
+				float normalized = mesh.position_scale[jj] > 0.0f ? (decoded[jj] - mesh.position_offset[jj]) / mesh.position_scale[jj] : 0.0f;
+				normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+				quantized[jj] = uint16_t(roundf(normalized * float(UINT16_MAX)));
+			}
+			memcpy(out, quantized, sizeof(quantized));
+			break;
+		}
+		case vertex_encoding::octahedral_snorm16:
+		{
+			// Project on to the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals.
+			float length = fabsf(decoded[0]) + fabsf(decoded[1]) + fabsf(decoded[2]);
+			float x = length > 0.0f ? decoded[0] / length : 0.0f;
+			float y = length > 0.0f ? decoded[1] / length : 0.0f;
+			if (decoded[2] < 0.0f)
+			{
+				float folded_x = (1.0f - fabsf(y)) * (x < 0.0f ? -1.0f : 1.0f);
+				float folded_y = (1.0f - fabsf(x)) * (y < 0.0f ? -1.0f : 1.0f);
+				x = folded_x;
+				y = folded_y;
+			}
+			int16_t quantized[2]{ int16_t(quantize_snorm(x, INT16_MAX)), int16_t(quantize_snorm(y, INT16_MAX)) };
+			memcpy(out, quantized, sizeof(quantized));
+			break;
+		}
+		case vertex_encoding::snorm_10_10_10_2:
+		{
+			uint32_t packed = 0;
+			for (uint32_t jj = 0; jj < 3; ++jj)
+				packed |= (uint32_t(quantize_snorm(decoded[jj], 511)) & 0x3ff) << (jj * 10);
+			if (decoded_components == 4)
+				packed |= (uint32_t(quantize_snorm(decoded[3], 1)) & 0x3) << 30;
+			memcpy(out, &packed, sizeof(packed));
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+struct mesh_build_job
+{
+	const acp_vulkan::gltf_data* gltf_data;
+	const acp_vulkan::gltf_vertex_attribute* attributes;
+	uint32_t attribute_count;
+	// Bytes of every requested attribute.
+	const uint32_t* attribute_sizes;
+	acp_vulkan::gltf_mesh_buffers* out;
+	VkAllocationCallbacks* host_allocator;
+	std::atomic<bool> failed;
+};
+
+static uint32_t primitive_attribute_accessor(const acp_vulkan::gltf_data::mesh::primitive_type& primitive, acp_vulkan::gltf_data::attribute attribute)
+{
+	for (size_t ii = 0; ii < primitive.attributes.data_length; ++ii)
+		if (primitive.attributes.data[ii].first == attribute)
+			return primitive.attributes.data[ii].second;
+	return UINT32_MAX;
+}
+
+static void build_mesh_primitive_job(void* job_data, size_t job_index)
+{
+	mesh_build_job* job = reinterpret_cast<mesh_build_job*>(job_data);
+	acp_vulkan::gltf_mesh_buffers* out = job->out;
+	const acp_vulkan::gltf_mesh_buffers::draw_range& draw = out->draw_ranges.data[job_index];
+	const acp_vulkan::gltf_data::mesh::primitive_type& primitive = job->gltf_data->meshes.data[draw.mesh].primitives.data[draw.primitive];
+
+	uint32_t* indices = out->indices.data + draw.first_index;
+	if (primitive.has_indices)
+	{
+		// The optimizers and the gpu index the primitive's vertices with these, all of them have to be in range.
+		uint32_t out_of_range = 0;
+		if (acp_vulkan::gltf_accessor_read(job->gltf_data, primitive.indices, VK_FORMAT_R32_UINT, indices))
+			for (uint32_t ii = 0; ii < draw.index_count; ++ii)
+				out_of_range |= indices[ii] >= draw.vertex_count;
+		else
+			out_of_range = 1;
+		if (out_of_range)
+			job->failed = true;
+	}
+	else
+		for (uint32_t ii = 0; ii < draw.index_count; ++ii)
+			indices[ii] = ii;
+
+	for (uint32_t ii = 0; ii < job->attribute_count; ++ii)
+	{
+		uint32_t accessor = primitive_attribute_accessor(primitive, job->attributes[ii].attribute);
+		uint32_t size = job->attribute_sizes[ii];
+		vertex_encoding encoding = attribute_encoding(job->attributes[ii]);
+
+		if (!out->vertex_stride && encoding == vertex_encoding::direct)
+		{
+			uint8_t* stream = out->vertices.data + out->attribute_offsets.data[ii] + size_t(draw.vertex_offset) * size;
+			if (accessor == UINT32_MAX)
+				memset(stream, 0, size_t(draw.vertex_count) * size);
+			else if (!acp_vulkan::gltf_accessor_read(job->gltf_data, accessor, job->attributes[ii].format, stream))
+				job->failed = true;
+			continue;
+		}
+
+		size_t stride = out->vertex_stride ? out->vertex_stride : size;
+		uint8_t* vertices = out->vertex_stride ? out->vertices.data + size_t(draw.vertex_offset) * out->vertex_stride + out->attribute_offsets.data[ii]
+			: out->vertices.data + out->attribute_offsets.data[ii] + size_t(draw.vertex_offset) * size;
+		if (accessor == UINT32_MAX)
+		{
+			for (uint32_t jj = 0; jj < draw.vertex_count; ++jj)
+				memset(vertices + size_t(jj) * stride, 0, size);
+			continue;
+		}
+
+		// Interleaving and encoding go through a packed copy of the attribute so the conversions run on whole streams.
+		VkFormat decode_format = attribute_decode_format(job->attributes[ii]);
+		component_layout decode_layout = target_layout(decode_format);
+		uint32_t decode_size = decode_layout.component_count * component_size(decode_layout.kind);
+		temp_data_view<uint8_t> packed{};
+		packed.host_allocator = job->host_allocator;
+		packed.reserve(size_t(draw.vertex_count) * decode_size);
+		if (!acp_vulkan::gltf_accessor_read(job->gltf_data, accessor, decode_format, packed.data))
+		{
+			job->failed = true;
+			continue;
+		}
+
+		if (encoding != vertex_encoding::direct)
+		{
+			encode_vertex_attributes(encoding, reinterpret_cast<const float*>(packed.data), decode_layout.component_count, draw.vertex_count,
+				out->meshes.data[draw.mesh], vertices, stride);
+			continue;
+		}
+		for (uint32_t jj = 0; jj < draw.vertex_count; ++jj)
+			memcpy(vertices + size_t(jj) * stride, packed.data + size_t(jj) * size, size);
+	}
+}
+
+struct position_bounds
+{
+	float min[3];
+	float max[3];
+};
+
+struct position_bounds_job
+{
+	const acp_vulkan::gltf_data* gltf_data;
+	const acp_vulkan::gltf_mesh_buffers* out;
+	VkAllocationCallbacks* host_allocator;
+	// One per draw range, ranges without positions keep an empty box.
+	position_bounds* bounds;
+	std::atomic<bool> failed;
+};
+
+static void find_position_bounds_job(void* job_data, size_t job_index)
+{
+	position_bounds_job* job = reinterpret_cast<position_bounds_job*>(job_data);
+	const acp_vulkan::gltf_mesh_buffers::draw_range& draw = job->out->draw_ranges.data[job_index];
+	const acp_vulkan::gltf_data::mesh::primitive_type& primitive = job->gltf_data->meshes.data[draw.mesh].primitives.data[draw.primitive];
+	position_bounds& bounds = job->bounds[job_index];
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		bounds.min[ii] = FLT_MAX;
+		bounds.max[ii] = -FLT_MAX;
+	}
+
+	uint32_t accessor = primitive_attribute_accessor(primitive, acp_vulkan::gltf_data::attribute::POSITION);
+	if (accessor == UINT32_MAX)
+		return;
+
+	temp_data_view<float> positions{};
+	positions.host_allocator = job->host_allocator;
+	positions.reserve(size_t(draw.vertex_count) * 3);
+	if (!acp_vulkan::gltf_accessor_read(job->gltf_data, accessor, VK_FORMAT_R32G32B32_SFLOAT, positions.data))
+	{
+		job->failed = true;
+		return;
+	}
+	for (size_t ii = 0; ii < size_t(draw.vertex_count) * 3; ++ii)
+	{
+		bounds.min[ii % 3] = fminf(bounds.min[ii % 3], positions.data[ii]);
+		bounds.max[ii % 3] = fmaxf(bounds.max[ii % 3], positions.data[ii]);
+	}
+}
+
+// Streams start on this alignment so each of them can also be bound as a storage buffer range.
+#define MESH_STREAM_ALIGNMENT 256
+
+bool acp_vulkan::gltf_mesh_buffers_build(const gltf_data* gltf_data, const gltf_vertex_attribute* attributes, uint32_t attribute_count,
+	VkAllocationCallbacks* host_allocator, gltf_mesh_buffers* out, gltf_mesh_flags mesh_flags)
+{
+	*out = {};
+
+	temp_data_view<uint32_t> attribute_sizes{};
+	attribute_sizes.host_allocator = host_allocator;
+	attribute_sizes.reserve(attribute_count);
+	uint32_t vertex_stride = 0;
+	uint32_t float_vertex_size = 0;
+	bool quantized_positions = false;
+	bool padded_vertices = false;
+	for (uint32_t ii = 0; ii < attribute_count; ++ii)
+	{
+		uint32_t size = vertex_attribute_size(attributes[ii]);
+		if (!size)
+			return false;
+		attribute_sizes.emplace_back(uint32_t(size));
+		vertex_stride += (size + 3) & ~3u;
+		padded_vertices |= (size & 3) != 0;
+
+		component_layout decode_layout = target_layout(attribute_decode_format(attributes[ii]));
+		float_vertex_size += decode_layout.component_count * sizeof(float);
+		quantized_positions |= attribute_encoding(attributes[ii]) == vertex_encoding::position_unorm16;
+	}
+
+	temp_data_view<gltf_mesh_buffers::draw_range> draw_ranges{};
+	draw_ranges.host_allocator = host_allocator;
+	uint64_t vertex_count = 0;
+	uint64_t index_count = 0;
+	for (size_t ii = 0; ii < gltf_data->meshes.data_length; ++ii)
+	{
+		const gltf_data::mesh& mesh = gltf_data->meshes.data[ii];
+		for (size_t jj = 0; jj < mesh.primitives.data_length; ++jj)
+		{
+			const gltf_data::mesh::primitive_type& primitive = mesh.primitives.data[jj];
+
+			// Every attribute of a primitive has the same count, the requested ones have to agree and be readable as their format.
+			uint32_t primitive_vertex_count = UINT32_MAX;
+			for (uint32_t kk = 0; kk < attribute_count; ++kk)
+			{
+				uint32_t accessor = primitive_attribute_accessor(primitive, attributes[kk].attribute);
+				if (accessor == UINT32_MAX)
+					continue;
+				// A one component format reads every component of a wider accessor, the attribute has to be exactly count decoded elements.
+				VkFormat decode_format = attribute_decode_format(attributes[kk]);
+				component_layout decode_layout = target_layout(decode_format);
+				size_t read_size = gltf_accessor_read_size(gltf_data, accessor, decode_format);
+				if (!read_size)
+					return false;
+				uint32_t count = gltf_data->accesors.data[accessor].count;
+				if (read_size != size_t(count) * decode_layout.component_count * component_size(decode_layout.kind))
+					return false;
+				if (primitive_vertex_count != UINT32_MAX && primitive_vertex_count != count)
+					return false;
+				primitive_vertex_count = count;
+			}
+			if (primitive_vertex_count == UINT32_MAX)
+			{
+				primitive_vertex_count = 0;
+				if (primitive.attributes.data_length && primitive.attributes.data[0].second < gltf_data->accesors.data_length)
+					primitive_vertex_count = gltf_data->accesors.data[primitive.attributes.data[0].second].count;
+			}
+
+			uint32_t primitive_index_count = primitive_vertex_count;
+			if (primitive.has_indices)
+			{
+				if (!gltf_accessor_read_size(gltf_data, primitive.indices, VK_FORMAT_R32_UINT) ||
+					gltf_data->accesors.data[primitive.indices].type != gltf_data::accesor::type_type::SCALAR)
+					return false;
+				primitive_index_count = gltf_data->accesors.data[primitive.indices].count;
+			}
+
+			draw_ranges.emplace_back(gltf_mesh_buffers::draw_range{
+				.mesh = uint32_t(ii),
+				.primitive = uint32_t(jj),
+				.first_index = uint32_t(index_count),
+				.vertex_offset = int32_t(vertex_count),
+				.index_count = primitive_index_count,
+				.vertex_count = primitive_vertex_count,
+				.material = primitive.has_material ? primitive.material : UINT32_MAX,
+				.mode = primitive.mode,
+			});
+			vertex_count += primitive_vertex_count;
+			index_count += primitive_index_count;
+
+			// vertex_offset is signed and first_index 32 bit in the draw commands.
+			if (vertex_count > INT32_MAX || index_count > UINT32_MAX)
+				return false;
+		}
+	}
+
+	out->vertex_count = uint32_t(vertex_count);
+	out->vertex_stride = (mesh_flags & gltf_mesh_deinterleaved) ? 0 : vertex_stride;
+
+	temp_data_view<uint32_t> attribute_offsets{};
+	attribute_offsets.host_allocator = host_allocator;
+	attribute_offsets.reserve(attribute_count);
+	size_t vertex_bytes = 0;
+	for (uint32_t ii = 0; ii < attribute_count; ++ii)
+	{
+		if (out->vertex_stride)
+		{
+			attribute_offsets.emplace_back(uint32_t(vertex_bytes));
+			vertex_bytes += (attribute_sizes.data[ii] + 3) & ~3u;
+			continue;
+		}
+
+		vertex_bytes = (vertex_bytes + MESH_STREAM_ALIGNMENT - 1) & ~size_t(MESH_STREAM_ALIGNMENT - 1);
+		if (vertex_bytes > UINT32_MAX)
+			return false;
+		attribute_offsets.emplace_back(uint32_t(vertex_bytes));
+		vertex_bytes += size_t(vertex_count) * attribute_sizes.data[ii];
+	}
+	if (out->vertex_stride)
+		vertex_bytes = size_t(vertex_count) * out->vertex_stride;
+
+	temp_data_view<uint8_t> vertices{};
+	vertices.host_allocator = host_allocator;
+	vertices.reserve(vertex_bytes);
+	vertices.data_length = vertex_bytes;
+	// The padding after 1 and 2 byte attributes and the gaps between streams are uploaded with the rest, keep them zero.
+	if (out->vertex_stride)
+	{
+		if (padded_vertices)
+			memset(vertices.data, 0, vertex_bytes);
+	}
+	else
+		for (uint32_t ii = 0; ii < attribute_count; ++ii)
+		{
+			size_t stream_end = attribute_offsets.data[ii] + size_t(vertex_count) * attribute_sizes.data[ii];
+			size_t next_stream = ii + 1 < attribute_count ? attribute_offsets.data[ii + 1] : vertex_bytes;
+			memset(vertices.data + stream_end, 0, next_stream - stream_end);
+		}
+	temp_data_view<uint32_t> indices{};
+	indices.host_allocator = host_allocator;
+	indices.reserve(size_t(index_count));
+	indices.data_length = size_t(index_count);
+
+	temp_data_view<gltf_vertex_attribute> attributes_copy{};
+	attributes_copy.host_allocator = host_allocator;
+	attributes_copy.reserve(attribute_count);
+	for (uint32_t ii = 0; ii < attribute_count; ++ii)
+		attributes_copy.emplace_back(gltf_vertex_attribute(attributes[ii]));
+
+	uint32_t vertex_size = vertex_stride;
+	if (!out->vertex_stride)
+	{
+		vertex_size = 0;
+		for (uint32_t ii = 0; ii < attribute_count; ++ii)
+			vertex_size += attribute_sizes.data[ii];
+	}
+
+	temp_data_view<gltf_mesh_buffers::mesh_data> meshes{};
+	meshes.host_allocator = host_allocator;
+	meshes.reserve(gltf_data->meshes.data_length);
+	for (size_t ii = 0; ii < gltf_data->meshes.data_length; ++ii)
+		meshes.emplace_back(gltf_mesh_buffers::mesh_data{ .position_scale = { 1.0f, 1.0f, 1.0f } });
+	for (size_t ii = 0; ii < draw_ranges.data_length; ++ii)
+	{
+		gltf_mesh_buffers::mesh_data& mesh = meshes.data[draw_ranges.data[ii].mesh];
+		if (!mesh.vertex_count)
+			mesh.first_vertex = uint32_t(draw_ranges.data[ii].vertex_offset);
+		mesh.vertex_count += draw_ranges.data[ii].vertex_count;
+		mesh.vertex_bytes += uint64_t(draw_ranges.data[ii].vertex_count) * vertex_size;
+		mesh.float_vertex_bytes += uint64_t(draw_ranges.data[ii].vertex_count) * float_vertex_size;
+	}
+
+	out->draw_ranges = draw_ranges.to();
+	out->meshes = meshes.to();
+	out->attributes = attributes_copy.to();
+	out->attribute_offsets = attribute_offsets.to();
+	out->vertices = vertices.to();
+	out->indices = indices.to();
+
+	mesh_build_job job{
+		.gltf_data = gltf_data,
+		.attributes = attributes,
+		.attribute_count = attribute_count,
+		.attribute_sizes = attribute_sizes.data,
+		.out = out,
+		.host_allocator = host_allocator,
+		.failed = false,
+	};
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	bool parallel = (mesh_flags & gltf_mesh_parallel_decode) && out->draw_ranges.data_length > 1 && has_workers;
+	if (quantized_positions)
+	{
+		// Every primitive of a mesh shares the dequantization of its positions, so the bounds of the whole mesh are known before encoding.
+		temp_data_view<position_bounds> bounds{};
+		bounds.host_allocator = host_allocator;
+		bounds.reserve(out->draw_ranges.data_length);
+		position_bounds_job bounds_job{
+			.gltf_data = gltf_data,
+			.out = out,
+			.host_allocator = host_allocator,
+			.bounds = bounds.data,
+			.failed = false,
+		};
+		if (parallel)
+			run_parsing_jobs(find_position_bounds_job, &bounds_job, out->draw_ranges.data_length);
+		else
+			for (size_t ii = 0; ii < out->draw_ranges.data_length; ++ii)
+				find_position_bounds_job(&bounds_job, ii);
+		if (bounds_job.failed)
+		{
+			gltf_mesh_buffers_free(out, host_allocator);
+			return false;
+		}
+
+		temp_data_view<position_bounds> mesh_bounds{};
+		mesh_bounds.host_allocator = host_allocator;
+		mesh_bounds.reserve(out->meshes.data_length);
+		for (size_t ii = 0; ii < out->meshes.data_length; ++ii)
+			mesh_bounds.emplace_back(position_bounds{ .min = { FLT_MAX, FLT_MAX, FLT_MAX }, .max = { -FLT_MAX, -FLT_MAX, -FLT_MAX } });
+		for (size_t ii = 0; ii < out->draw_ranges.data_length; ++ii)
+		{
+			position_bounds& mesh = mesh_bounds.data[out->draw_ranges.data[ii].mesh];
+			for (uint32_t jj = 0; jj < 3; ++jj)
+			{
+				mesh.min[jj] = fminf(mesh.min[jj], bounds.data[ii].min[jj]);
+				mesh.max[jj] = fmaxf(mesh.max[jj], bounds.data[ii].max[jj]);
+			}
+		}
+		for (size_t ii = 0; ii < out->meshes.data_length; ++ii)
+		{
+			const position_bounds& mesh = mesh_bounds.data[ii];
+			if (mesh.min[0] > mesh.max[0])
+				continue;
+			for (uint32_t jj = 0; jj < 3; ++jj)
+			{
+				out->meshes.data[ii].position_offset[jj] = mesh.min[jj];
+				out->meshes.data[ii].position_scale[jj] = mesh.max[jj] - mesh.min[jj];
+			}
+		}
+	}
+
+	if (parallel)
+		run_parsing_jobs(build_mesh_primitive_job, &job, out->draw_ranges.data_length);
+	else
+		for (size_t ii = 0; ii < out->draw_ranges.data_length; ++ii)
+			build_mesh_primitive_job(&job, ii);
+
+	if (job.failed)
+	{
+		gltf_mesh_buffers_free(out, host_allocator);
+		return false;
+	}
+	return true;
+}
+
+void acp_vulkan::gltf_mesh_buffers_free(gltf_mesh_buffers* mesh_buffers, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(mesh_buffers->draw_ranges, host_allocator);
+	free_gltf_buffer(mesh_buffers->meshes, host_allocator);
+	free_gltf_buffer(mesh_buffers->vertices, host_allocator);
+	free_gltf_buffer(mesh_buffers->indices, host_allocator);
+	free_gltf_buffer(mesh_buffers->attributes, host_allocator);
+	free_gltf_buffer(mesh_buffers->attribute_offsets, host_allocator);
+	free_gltf_buffer(mesh_buffers->lods, host_allocator);
+	*mesh_buffers = {};
+}
+
+// Entries of the simulated post transform cache, used by Tipsify and for the ACMR/ATVR stats.
+#define VERTEX_CACHE_SIZE 16
+// Clusters are split once their triangles so far miss the cache at most this much more often than the whole cluster does.
+#define OVERDRAW_SPLIT_THRESHOLD 1.05f
+
+template<typename T>
+static T* mesh_scratch(temp_data_view<T>& view, size_t count, VkAllocationCallbacks* host_allocator)
+{
+	view.host_allocator = host_allocator;
+	view.reserve(count);
+	view.data_length = count;
+	return view.data;
+}
+
+// A vertex is in the FIFO cache while fewer than VERTEX_CACHE_SIZE other vertices were loaded after it, stamps start at 0 and time at VERTEX_CACHE_SIZE + 1.
+static bool vertex_cache_load(uint32_t* stamps, uint32_t* time, uint32_t vertex)
+{
+	if (*time - stamps[vertex] <= VERTEX_CACHE_SIZE)
+		return false;
+	stamps[vertex] = (*time)++;
+	return true;
+}
+
+static uint32_t vertex_cache_misses(const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t* stamps)
+{
+	memset(stamps, 0, vertex_count * sizeof(uint32_t));
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+	uint32_t misses = 0;
+	for (size_t ii = 0; ii < index_count; ++ii)
+		misses += vertex_cache_load(stamps, &time, indices[ii]);
+	return misses;
+}
+
+// Tipsify from Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw": fans around the vertex that stays in the
+// cache longest and falls back to the dead end stack (then a linear scan) when no candidate is left. cluster_starts marks the triangles the fanning
+// restarts at, the cache is cold there.
+static void tipsify(const uint32_t* indices, uint32_t triangle_count, uint32_t vertex_count, VkAllocationCallbacks* host_allocator, uint32_t* out, uint8_t* cluster_starts)
+{
+	temp_data_view<uint32_t> adjacency_offsets_view{}, adjacency_view{}, live_view{}, stamps_view{}, dead_end_view{};
+	temp_data_view<uint8_t> emitted_view{};
+	uint32_t* adjacency_offsets = mesh_scratch(adjacency_offsets_view, size_t(vertex_count) + 1, host_allocator);
+	uint32_t* adjacency = mesh_scratch(adjacency_view, size_t(triangle_count) * 3, host_allocator);
+	uint32_t* live = mesh_scratch(live_view, vertex_count, host_allocator);
+	uint32_t* stamps = mesh_scratch(stamps_view, vertex_count, host_allocator);
+	uint32_t* dead_end = mesh_scratch(dead_end_view, size_t(triangle_count) * 3, host_allocator);
+	uint8_t* emitted = mesh_scratch(emitted_view, triangle_count, host_allocator);
+
+	memset(live, 0, vertex_count * sizeof(uint32_t));
+	memset(stamps, 0, vertex_count * sizeof(uint32_t));
+	memset(emitted, 0, triangle_count);
+	memset(cluster_starts, 0, triangle_count);
+	for (size_t ii = 0; ii < size_t(triangle_count) * 3; ++ii)
+		live[indices[ii]]++;
+
+	adjacency_offsets[0] = 0;
+	for (uint32_t ii = 0; ii < vertex_count; ++ii)
+		adjacency_offsets[ii + 1] = adjacency_offsets[ii] + live[ii];
+	for (uint32_t ii = 0; ii < triangle_count; ++ii)
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			adjacency[adjacency_offsets[indices[ii * 3 + jj]]++] = ii;
+	// Filling moved every offset to the start of the next vertex.
+	for (uint32_t ii = vertex_count; ii > 0; --ii)
+		adjacency_offsets[ii] = adjacency_offsets[ii - 1];
+	adjacency_offsets[0] = 0;
+
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+	size_t dead_end_top = 0;
+	uint32_t scan_cursor = 0;
+	size_t written = 0;
+	bool restarted = true;
+	uint32_t fanning = triangle_count ? indices[0] : UINT32_MAX;
+	while (fanning != UINT32_MAX)
+	{
+		// The vertices of the triangles emitted around fanning are the candidates for the next one.
+		size_t candidates_begin = dead_end_top;
+		for (uint32_t ii = adjacency_offsets[fanning]; ii < adjacency_offsets[fanning + 1]; ++ii)
+		{
+			uint32_t triangle = adjacency[ii];
+			if (emitted[triangle])
+				continue;
+
+			if (restarted)
+			{
+				cluster_starts[written / 3] = 1;
+				restarted = false;
+			}
+			for (uint32_t jj = 0; jj < 3; ++jj)
+			{
+				uint32_t vertex = indices[triangle * 3 + jj];
+				out[written++] = vertex;
+				dead_end[dead_end_top++] = vertex;
+				live[vertex]--;
+				vertex_cache_load(stamps, &time, vertex);
+			}
+			emitted[triangle] = 1;
+		}
+
+		// Prefer the candidate that entered the cache first among those that still fit in it after emitting their remaining triangles.
+		uint32_t next = UINT32_MAX;
+		int64_t best_priority = -1;
+		for (size_t ii = candidates_begin; ii < dead_end_top; ++ii)
+		{
+			uint32_t vertex = dead_end[ii];
+			if (!live[vertex])
+				continue;
+
+			int64_t priority = 0;
+			if (time - stamps[vertex] + 2 * live[vertex] <= VERTEX_CACHE_SIZE)
+				priority = time - stamps[vertex];
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				next = vertex;
+			}
+		}
+
+		if (next == UINT32_MAX)
+		{
+			restarted = true;
+			while (next == UINT32_MAX && dead_end_top)
+			{
+				uint32_t vertex = dead_end[--dead_end_top];
+				if (live[vertex])
+					next = vertex;
+			}
+			while (next == UINT32_MAX && scan_cursor < vertex_count)
+			{
+				if (live[scan_cursor])
+					next = scan_cursor;
+				else
+					++scan_cursor;
+			}
+		}
+		fanning = next;
+	}
+}
+
+struct overdraw_cluster
+{
+	uint32_t first_triangle;
+	uint32_t triangle_count;
+	float center[3];
+	float normal[3];
+	float sort_key;
+};
+
+// Positions of a draw range as the optimizer and the meshlet builder read them.
+struct range_positions
+{
+	const uint8_t* data;
+	size_t stride;
+	// Set when the positions are quantized to R16G16B16A16_UNORM.
+	const acp_vulkan::gltf_mesh_buffers::mesh_data* dequantization;
+};
+
+// UINT32_MAX without a R32G32B32_SFLOAT or R16G16B16A16_UNORM POSITION attribute.
+static uint32_t readable_position_attribute(const acp_vulkan::gltf_mesh_buffers* mesh_buffers)
+{
+	for (size_t ii = 0; ii < mesh_buffers->attributes.data_length; ++ii)
+	{
+		const acp_vulkan::gltf_vertex_attribute& attribute = mesh_buffers->attributes.data[ii];
+		if (attribute.attribute == acp_vulkan::gltf_data::attribute::POSITION &&
+			(attribute.format == VK_FORMAT_R32G32B32_SFLOAT || attribute_encoding(attribute) == vertex_encoding::position_unorm16))
+			return uint32_t(ii);
+	}
+	return UINT32_MAX;
+}
+
+static range_positions range_positions_for(const acp_vulkan::gltf_mesh_buffers* mesh_buffers, uint32_t position_attribute,
+	const acp_vulkan::gltf_mesh_buffers::draw_range& range)
+{
+	bool quantized = attribute_encoding(mesh_buffers->attributes.data[position_attribute]) == vertex_encoding::position_unorm16;
+	size_t stride = mesh_buffers->vertex_stride ? mesh_buffers->vertex_stride : vertex_attribute_size(mesh_buffers->attributes.data[position_attribute]);
+	return {
+		.data = mesh_buffers->vertices.data + mesh_buffers->attribute_offsets.data[position_attribute] + size_t(range.vertex_offset) * stride,
+		.stride = stride,
+		.dequantization = quantized ? &mesh_buffers->meshes.data[range.mesh] : nullptr,
+	};
+}
+
+static void load_position(const range_positions& positions, uint32_t vertex, float* out)
+{
+	const uint8_t* position = positions.data + size_t(vertex) * positions.stride;
+	if (!positions.dequantization)
+	{
+		memcpy(out, position, sizeof(float) * 3);
+		return;
+	}
+
+	uint16_t quantized[3];
+	memcpy(quantized, position, sizeof(quantized));
+	for (uint32_t ii = 0; ii < 3; ++ii)
+		out[ii] = float(quantized[ii]) / float(UINT16_MAX) * positions.dequantization->position_scale[ii] + positions.dequantization->position_offset[ii];
+}
+
+static uint32_t cluster_end(const uint8_t* cluster_starts, uint32_t begin, uint32_t triangle_count)
+{
+	uint32_t end = begin + 1;
+	while (end < triangle_count && !cluster_starts[end])
+		++end;
+	return end;
+}
+
+// Splits the Tipsify clusters further while the cache stays efficient, then draws the clusters facing away from the mesh center first since they are
+// the likeliest to occlude the rest (the linear speed sort of the Tipsify paper).
+static void order_clusters_for_overdraw(const uint32_t* indices, uint32_t triangle_count, uint32_t vertex_count, uint8_t* cluster_starts,
+	const range_positions& positions, VkAllocationCallbacks* host_allocator, uint32_t* out)
+{
+	temp_data_view<uint32_t> stamps_view{};
+	uint32_t* stamps = mesh_scratch(stamps_view, vertex_count, host_allocator);
+	memset(stamps, 0, vertex_count * sizeof(uint32_t));
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+
+	for (uint32_t begin = 0; begin < triangle_count;)
+	{
+		uint32_t end = cluster_end(cluster_starts, begin, triangle_count);
+
+		// Moving time past every stamp empties the cache.
+		time += VERTEX_CACHE_SIZE + 1;
+		uint32_t cluster_misses = 0;
+		for (size_t ii = size_t(begin) * 3; ii < size_t(end) * 3; ++ii)
+			cluster_misses += vertex_cache_load(stamps, &time, indices[ii]);
+		float split_misses = float(cluster_misses) / float(end - begin) * OVERDRAW_SPLIT_THRESHOLD;
+
+		time += VERTEX_CACHE_SIZE + 1;
+		uint32_t misses = 0;
+		uint32_t count = 0;
+		for (uint32_t ii = begin; ii < end; ++ii)
+		{
+			for (uint32_t jj = 0; jj < 3; ++jj)
+				misses += vertex_cache_load(stamps, &time, indices[ii * 3 + jj]);
+			++count;
+			if (ii + 1 < end && float(misses) <= split_misses * float(count))
+			{
+				cluster_starts[ii + 1] = 1;
+				time += VERTEX_CACHE_SIZE + 1;
+				misses = 0;
+				count = 0;
+			}
+		}
+		begin = end;
+	}
+
+	temp_data_view<overdraw_cluster> clusters{};
+	clusters.host_allocator = host_allocator;
+	float mesh_center[3]{};
+	float mesh_area = 0.0f;
+	for (uint32_t begin = 0; begin < triangle_count;)
+	{
+		uint32_t end = cluster_end(cluster_starts, begin, triangle_count);
+		overdraw_cluster cluster{};
+		cluster.first_triangle = begin;
+		cluster.triangle_count = end - begin;
+		float area = 0.0f;
+		for (uint32_t ii = begin; ii < end; ++ii)
+		{
+			float p0[3], p1[3], p2[3];
+			load_position(positions, indices[ii * 3 + 0], p0);
+			load_position(positions, indices[ii * 3 + 1], p1);
+			load_position(positions, indices[ii * 3 + 2], p2);
+			float e0[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e1[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float cross[3]{ e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+			float triangle_area = sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]) * 0.5f;
+			for (uint32_t kk = 0; kk < 3; ++kk)
+			{
+				cluster.center[kk] += (p0[kk] + p1[kk] + p2[kk]) * (triangle_area / 3.0f);
+				cluster.normal[kk] += cross[kk];
+			}
+			area += triangle_area;
+		}
+
+		for (uint32_t kk = 0; kk < 3; ++kk)
+			mesh_center[kk] += cluster.center[kk];
+		mesh_area += area;
+
+		float inverse_area = area > 0.0f ? 1.0f / area : 0.0f;
+		float normal_length = sqrtf(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+		float inverse_normal_length = normal_length > 0.0f ? 1.0f / normal_length : 0.0f;
+		for (uint32_t kk = 0; kk < 3; ++kk)
+		{
+			cluster.center[kk] *= inverse_area;
+			cluster.normal[kk] *= inverse_normal_length;
+		}
+		clusters.emplace_back(overdraw_cluster(cluster));
+		begin = end;
+	}
+
+	float inverse_mesh_area = mesh_area > 0.0f ? 1.0f / mesh_area : 0.0f;
+	for (uint32_t kk = 0; kk < 3; ++kk)
+		mesh_center[kk] *= inverse_mesh_area;
+	for (size_t ii = 0; ii < clusters.data_length; ++ii)
+	{
+		overdraw_cluster& cluster = clusters.data[ii];
+		cluster.sort_key = (cluster.center[0] - mesh_center[0]) * cluster.normal[0] + (cluster.center[1] - mesh_center[1]) * cluster.normal[1] +
+			(cluster.center[2] - mesh_center[2]) * cluster.normal[2];
+	}
+
+	std::stable_sort(clusters.data, clusters.data + clusters.data_length,
+		[](const overdraw_cluster& a, const overdraw_cluster& b) { return a.sort_key > b.sort_key; });
+
+	size_t written = 0;
+	for (size_t ii = 0; ii < clusters.data_length; ++ii)
+	{
+		size_t cluster_index_count = size_t(clusters.data[ii].triangle_count) * 3;
+		memcpy(out + written, indices + size_t(clusters.data[ii].first_triangle) * 3, cluster_index_count * sizeof(uint32_t));
+		written += cluster_index_count;
+	}
+}
+
+// Renumbers the vertices of a draw range in the order the indices first reference them and moves their data to match, unreferenced vertices keep their
+// relative order at the end.
+static void remap_vertex_fetch(acp_vulkan::gltf_mesh_buffers* mesh_buffers, size_t range_index, const uint32_t* attribute_sizes, VkAllocationCallbacks* host_allocator)
+{
+	const acp_vulkan::gltf_mesh_buffers::draw_range& range = mesh_buffers->draw_ranges.data[range_index];
+	uint32_t* indices = mesh_buffers->indices.data + range.first_index;
+	temp_data_view<uint32_t> remap_view{};
+	uint32_t* remap = mesh_scratch(remap_view, range.vertex_count, host_allocator);
+	memset(remap, 0xff, range.vertex_count * sizeof(uint32_t));
+
+	uint32_t next = 0;
+	for (uint32_t ii = 0; ii < range.index_count; ++ii)
+	{
+		uint32_t& vertex = indices[ii];
+		if (remap[vertex] == UINT32_MAX)
+			remap[vertex] = next++;
+		vertex = remap[vertex];
+	}
+	for (uint32_t ii = 0; ii < range.vertex_count; ++ii)
+		if (remap[ii] == UINT32_MAX)
+			remap[ii] = next++;
+
+	// Levels of detail of the range index the same vertices, levels that reuse the range indices are already done.
+	for (uint32_t ii = 0; ii < mesh_buffers->lod_level_count; ++ii)
+	{
+		const acp_vulkan::gltf_mesh_buffers::lod_range& lod = mesh_buffers->lods.data[range_index * mesh_buffers->lod_level_count + ii];
+		if (lod.first_index == range.first_index || (ii && lod.first_index == mesh_buffers->lods.data[range_index * mesh_buffers->lod_level_count + ii - 1].first_index))
+			continue;
+		for (uint32_t jj = 0; jj < lod.index_count; ++jj)
+			mesh_buffers->indices.data[lod.first_index + jj] = remap[mesh_buffers->indices.data[lod.first_index + jj]];
+	}
+
+	auto permute = [&](uint8_t* stream, size_t element_size)
+	{
+		temp_data_view<uint8_t> copy_view{};
+		uint8_t* copy = mesh_scratch(copy_view, size_t(range.vertex_count) * element_size, host_allocator);
+		memcpy(copy, stream, size_t(range.vertex_count) * element_size);
+		for (uint32_t ii = 0; ii < range.vertex_count; ++ii)
+			memcpy(stream + size_t(remap[ii]) * element_size, copy + size_t(ii) * element_size, element_size);
+	};
+
+	if (mesh_buffers->vertex_stride)
+	{
+		permute(mesh_buffers->vertices.data + size_t(range.vertex_offset) * mesh_buffers->vertex_stride, mesh_buffers->vertex_stride);
+		return;
+	}
+
+	for (size_t ii = 0; ii < mesh_buffers->attributes.data_length; ++ii)
+		permute(mesh_buffers->vertices.data + mesh_buffers->attribute_offsets.data[ii] + size_t(range.vertex_offset) * attribute_sizes[ii], attribute_sizes[ii]);
+}
+
+struct mesh_optimize_result
+{
+	uint32_t misses_before;
+	uint32_t misses_after;
+	uint32_t referenced_vertices;
+	uint32_t triangle_count;
+	bool optimized;
+};
+
+struct mesh_optimize_job
+{
+	acp_vulkan::gltf_mesh_buffers* mesh_buffers;
+	const uint32_t* attribute_sizes;
+	// UINT32_MAX when there are no readable positions and overdraw ordering is skipped.
+	uint32_t position_attribute;
+	VkAllocationCallbacks* host_allocator;
+	mesh_optimize_result* results;
+};
+
+static void optimize_draw_range_job(void* job_data, size_t job_index)
+{
+	mesh_optimize_job* job = (mesh_optimize_job*)job_data;
+	acp_vulkan::gltf_mesh_buffers* mesh_buffers = job->mesh_buffers;
+	const acp_vulkan::gltf_mesh_buffers::draw_range& range = mesh_buffers->draw_ranges.data[job_index];
+	mesh_optimize_result& result = job->results[job_index];
+	result = {};
+
+	if (range.mode != acp_vulkan::gltf_data::mesh::mode::TRIANGLES || range.index_count < 3 || range.index_count % 3)
+		return;
+
+	uint32_t* indices = mesh_buffers->indices.data + range.first_index;
+	for (uint32_t ii = 0; ii < range.index_count; ++ii)
+		if (indices[ii] >= range.vertex_count)
+			return;
+
+	uint32_t triangle_count = range.index_count / 3;
+	temp_data_view<uint32_t> stamps_view{}, reordered_view{};
+	temp_data_view<uint8_t> cluster_starts_view{};
+	uint32_t* stamps = mesh_scratch(stamps_view, range.vertex_count, job->host_allocator);
+	uint32_t* reordered = mesh_scratch(reordered_view, range.index_count, job->host_allocator);
+	uint8_t* cluster_starts = mesh_scratch(cluster_starts_view, triangle_count, job->host_allocator);
+
+	result.misses_before = vertex_cache_misses(indices, range.index_count, range.vertex_count, stamps);
+	result.triangle_count = triangle_count;
+	for (uint32_t ii = 0; ii < range.index_count; ++ii)
+	{
+		result.referenced_vertices += stamps[indices[ii]] != UINT32_MAX;
+		stamps[indices[ii]] = UINT32_MAX;
+	}
+
+	tipsify(indices, triangle_count, range.vertex_count, job->host_allocator, reordered, cluster_starts);
+	if (job->position_attribute != UINT32_MAX)
+	{
+		order_clusters_for_overdraw(reordered, triangle_count, range.vertex_count, cluster_starts, range_positions_for(mesh_buffers, job->position_attribute, range),
+			job->host_allocator, indices);
+	}
+	else
+		memcpy(indices, reordered, range.index_count * sizeof(uint32_t));
+
+	remap_vertex_fetch(mesh_buffers, job_index, job->attribute_sizes, job->host_allocator);
+	result.misses_after = vertex_cache_misses(indices, range.index_count, range.vertex_count, stamps);
+	result.optimized = true;
+}
+
+void acp_vulkan::gltf_mesh_buffers_optimize(gltf_mesh_buffers* mesh_buffers, VkAllocationCallbacks* host_allocator, gltf_mesh_optimize_stats* stats, gltf_mesh_flags mesh_flags)
+{
+	size_t range_count = mesh_buffers->draw_ranges.data_length;
+	temp_data_view<uint32_t> attribute_sizes{};
+	temp_data_view<mesh_optimize_result> results{};
+	mesh_optimize_job job{
+		.mesh_buffers = mesh_buffers,
+		.attribute_sizes = mesh_scratch(attribute_sizes, mesh_buffers->attributes.data_length, host_allocator),
+		.position_attribute = readable_position_attribute(mesh_buffers),
+		.host_allocator = host_allocator,
+		.results = mesh_scratch(results, range_count, host_allocator),
+	};
+
+	for (size_t ii = 0; ii < mesh_buffers->attributes.data_length; ++ii)
+		attribute_sizes.data[ii] = vertex_attribute_size(mesh_buffers->attributes.data[ii]);
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((mesh_flags & gltf_mesh_parallel_decode) && has_workers && range_count > 1)
+		run_parsing_jobs(optimize_draw_range_job, &job, range_count);
+	else
+		for (size_t ii = 0; ii < range_count; ++ii)
+			optimize_draw_range_job(&job, ii);
+
+	if (!stats)
+		return;
+
+	uint64_t misses_before = 0, misses_after = 0, referenced_vertices = 0, triangle_count = 0;
+	*stats = {};
+	for (size_t ii = 0; ii < range_count; ++ii)
+	{
+		const mesh_optimize_result& result = job.results[ii];
+		if (!result.optimized)
+			continue;
+
+		misses_before += result.misses_before;
+		misses_after += result.misses_after;
+		referenced_vertices += result.referenced_vertices;
+		triangle_count += result.triangle_count;
+		stats->optimized_draw_ranges++;
+	}
+	if (triangle_count)
+	{
+		stats->acmr_before = float(double(misses_before) / double(triangle_count));
+		stats->acmr_after = float(double(misses_after) / double(triangle_count));
+		stats->atvr_before = float(double(misses_before) / double(referenced_vertices));
+		stats->atvr_after = float(double(misses_after) / double(referenced_vertices));
+	}
+}
+
+// Mesh shader friendly limits, 124 triangles leave the primitive output of a 128 slot meshlet room for per primitive culling data.
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+// Below this cosine between the cone axis and a triangle normal the cone is too wide to ever cull the meshlet.
+#define MESHLET_MIN_CONE_COSINE 0.1f
+
+static float dot3(const float* a, const float* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Ritter's bounding sphere: the sphere around the farthest pair of axis extremes, grown to take in every point outside of it.
+static void bounding_sphere(const float (*points)[3], uint32_t point_count, float* center, float* radius)
+{
+	uint32_t min_points[3]{}, max_points[3]{};
+	for (uint32_t ii = 1; ii < point_count; ++ii)
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			if (points[ii][axis] < points[min_points[axis]][axis])
+				min_points[axis] = ii;
+			if (points[ii][axis] > points[max_points[axis]][axis])
+				max_points[axis] = ii;
+		}
+
+	float best_distance = -1.0f;
+	const float* first = points[0];
+	const float* second = points[0];
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		const float* a = points[min_points[axis]];
+		const float* b = points[max_points[axis]];
+		float delta[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float distance = dot3(delta, delta);
+		if (distance > best_distance)
+		{
+			best_distance = distance;
+			first = a;
+			second = b;
+		}
+	}
+
+	for (uint32_t axis = 0; axis < 3; ++axis)
+		center[axis] = (first[axis] + second[axis]) * 0.5f;
+	float sphere_radius = sqrtf(best_distance) * 0.5f;
+
+	for (uint32_t ii = 0; ii < point_count; ++ii)
+	{
+		float delta[3]{ points[ii][0] - center[0], points[ii][1] - center[1], points[ii][2] - center[2] };
+		float distance = sqrtf(dot3(delta, delta));
+		if (distance <= sphere_radius)
+			continue;
+
+		// Move the center towards the point so the new sphere touches it and the far side of the old one.
+		float shift = (distance - sphere_radius) * 0.5f / distance;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			center[axis] += delta[axis] * shift;
+		sphere_radius = (sphere_radius + distance) * 0.5f;
+	}
+	*radius = sphere_radius;
+}
+
+// The bounding sphere of the meshlet and the cone around its triangle normals, with the apex placed so every triangle is in front of it.
+static void meshlet_bounds(acp_vulkan::gltf_meshlet* meshlet, const uint32_t* meshlet_vertices, const uint32_t* meshlet_triangles, const range_positions& positions)
+{
+	float points[MESHLET_MAX_VERTICES][3];
+	for (uint32_t ii = 0; ii < meshlet->vertex_count; ++ii)
+		load_position(positions, meshlet_vertices[ii], points[ii]);
+	bounding_sphere(points, meshlet->vertex_count, meshlet->center, &meshlet->radius);
+
+	float normals[MESHLET_MAX_TRIANGLES][3];
+	uint32_t corners[MESHLET_MAX_TRIANGLES];
+	uint32_t normal_count = 0;
+	for (uint32_t ii = 0; ii < meshlet->triangle_count; ++ii)
+	{
+		uint32_t triangle = meshlet_triangles[ii];
+		const float* p0 = points[triangle & 0xff];
+		const float* p1 = points[(triangle >> 8) & 0xff];
+		const float* p2 = points[(triangle >> 16) & 0xff];
+		float e0[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e1[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float cross[3]{ e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+		float length = sqrtf(dot3(cross, cross));
+		// Degenerate triangles face nowhere.
+		if (length <= 0.0f)
+			continue;
+
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			normals[normal_count][axis] = cross[axis] / length;
+		corners[normal_count++] = triangle & 0xff;
+	}
+
+	memcpy(meshlet->cone_apex, meshlet->center, sizeof(meshlet->center));
+	meshlet->cone_axis[0] = 0.0f;
+	meshlet->cone_axis[1] = 0.0f;
+	meshlet->cone_axis[2] = 1.0f;
+	meshlet->cone_cutoff = 1.0f;
+	if (!normal_count)
+		return;
+
+	float axis[3], normal_radius;
+	bounding_sphere(normals, normal_count, axis, &normal_radius);
+	float axis_length = sqrtf(dot3(axis, axis));
+	if (axis_length <= 0.0f)
+		return;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+		axis[ii] /= axis_length;
+
+	float min_cosine = 1.0f;
+	for (uint32_t ii = 0; ii < normal_count; ++ii)
+		min_cosine = fminf(min_cosine, dot3(normals[ii], axis));
+	memcpy(meshlet->cone_axis, axis, sizeof(axis));
+	if (min_cosine <= MESHLET_MIN_CONE_COSINE)
+		return;
+
+	float max_distance = 0.0f;
+	for (uint32_t ii = 0; ii < normal_count; ++ii)
+	{
+		const float* corner = points[corners[ii]];
+		float to_center[3]{ meshlet->center[0] - corner[0], meshlet->center[1] - corner[1], meshlet->center[2] - corner[2] };
+		max_distance = fmaxf(max_distance, dot3(to_center, normals[ii]) / dot3(normals[ii], axis));
+	}
+	for (uint32_t ii = 0; ii < 3; ++ii)
+		meshlet->cone_apex[ii] = meshlet->center[ii] - axis[ii] * max_distance;
+	meshlet->cone_cutoff = sqrtf(1.0f - min_cosine * min_cosine);
+}
+
+struct meshlet_range_result
+{
+	acp_vulkan::gltf_data::data_view<acp_vulkan::gltf_meshlet> meshlets;
+	acp_vulkan::gltf_data::data_view<uint32_t> vertices;
+	acp_vulkan::gltf_data::data_view<uint32_t> triangles;
+};
+
+struct meshlet_build_job
+{
+	const acp_vulkan::gltf_mesh_buffers* mesh_buffers;
+	uint32_t position_attribute;
+	VkAllocationCallbacks* host_allocator;
+	meshlet_range_result* results;
+	std::atomic<bool> failed;
+};
+
+// Fills meshlets with the triangles in index order, so the vertex cache order of gltf_mesh_buffers_optimize keeps them compact.
+static void build_meshlets_job(void* job_data, size_t job_index)
+{
+	meshlet_build_job* job = reinterpret_cast<meshlet_build_job*>(job_data);
+	const acp_vulkan::gltf_mesh_buffers::draw_range& range = job->mesh_buffers->draw_ranges.data[job_index];
+	meshlet_range_result& result = job->results[job_index];
+	if (range.mode != acp_vulkan::gltf_data::mesh::mode::TRIANGLES)
+		return;
+
+	const uint32_t* indices = job->mesh_buffers->indices.data + range.first_index;
+	if (range.index_count % 3)
+	{
+		job->failed = true;
+		return;
+	}
+	for (uint32_t ii = 0; ii < range.index_count; ++ii)
+		if (indices[ii] >= range.vertex_count)
+		{
+			job->failed = true;
+			return;
+		}
+
+	// Meshlet local index of every vertex of the range, 0xff while it is not in the current meshlet.
+	temp_data_view<uint8_t> local_indices_view{};
+	uint8_t* local_indices = mesh_scratch(local_indices_view, range.vertex_count, job->host_allocator);
+	memset(local_indices, 0xff, range.vertex_count);
+
+	temp_data_view<acp_vulkan::gltf_meshlet> meshlets{};
+	temp_data_view<uint32_t> vertices{}, triangles{};
+	meshlets.host_allocator = job->host_allocator;
+	vertices.host_allocator = job->host_allocator;
+	triangles.host_allocator = job->host_allocator;
+	vertices.reserve(range.index_count);
+	triangles.reserve(range.index_count / 3);
+
+	range_positions positions = range_positions_for(job->mesh_buffers, job->position_attribute, range);
+	acp_vulkan::gltf_meshlet meshlet{};
+	auto flush = [&]()
+	{
+		for (uint32_t ii = 0; ii < meshlet.vertex_count; ++ii)
+			local_indices[vertices.data[meshlet.vertex_offset + ii]] = 0xff;
+		meshlet_bounds(&meshlet, vertices.data + meshlet.vertex_offset, triangles.data + meshlet.triangle_offset, positions);
+		meshlet.draw_range = uint32_t(job_index);
+		meshlets.emplace_back(acp_vulkan::gltf_meshlet(meshlet));
+
+		meshlet = {};
+		meshlet.vertex_offset = uint32_t(vertices.data_length);
+		meshlet.triangle_offset = uint32_t(triangles.data_length);
+	};
+
+	for (uint32_t ii = 0; ii < range.index_count; ii += 3)
+	{
+		uint32_t a = indices[ii + 0], b = indices[ii + 1], c = indices[ii + 2];
+		uint32_t new_vertices = (local_indices[a] == 0xff) + (b != a && local_indices[b] == 0xff) + (c != a && c != b && local_indices[c] == 0xff);
+		if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES)
+			flush();
+
+		uint32_t packed = 0;
+		uint32_t corners[3]{ a, b, c };
+		for (uint32_t jj = 0; jj < 3; ++jj)
+		{
+			uint32_t vertex = corners[jj];
+			if (local_indices[vertex] == 0xff)
+			{
+				local_indices[vertex] = uint8_t(meshlet.vertex_count++);
+				vertices.emplace_back(uint32_t(vertex));
+			}
+			packed |= uint32_t(local_indices[vertex]) << (jj * 8);
+		}
+		triangles.emplace_back(uint32_t(packed));
+		meshlet.triangle_count++;
+	}
+	if (meshlet.triangle_count)
+		flush();
+
+	// The bounds read positions relative to the range, the gpu reads vertices from the start of the packed buffer.
+	for (size_t ii = 0; ii < vertices.data_length; ++ii)
+		vertices.data[ii] += uint32_t(range.vertex_offset);
+
+	result.meshlets = meshlets.to();
+	result.vertices = vertices.to();
+	result.triangles = triangles.to();
+}
+
+bool acp_vulkan::gltf_meshlet_buffers_build(const gltf_mesh_buffers* mesh_buffers, VkAllocationCallbacks* host_allocator, gltf_meshlet_buffers* out,
+	gltf_mesh_flags mesh_flags)
+{
+	*out = {};
+
+	uint32_t position_attribute = readable_position_attribute(mesh_buffers);
+	if (position_attribute == UINT32_MAX)
+		return false;
+
+	size_t range_count = mesh_buffers->draw_ranges.data_length;
+	temp_data_view<meshlet_range_result> results{};
+	mesh_scratch(results, range_count, host_allocator);
+	for (size_t ii = 0; ii < range_count; ++ii)
+		results.data[ii] = {};
+
+	meshlet_build_job job{
+		.mesh_buffers = mesh_buffers,
+		.position_attribute = position_attribute,
+		.host_allocator = host_allocator,
+		.results = results.data,
+		.failed = false,
+	};
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((mesh_flags & gltf_mesh_parallel_decode) && range_count > 1 && has_workers)
+		run_parsing_jobs(build_meshlets_job, &job, range_count);
+	else
+		for (size_t ii = 0; ii < range_count; ++ii)
+			build_meshlets_job(&job, ii);
+
+	size_t meshlet_count = 0, vertex_count = 0, triangle_count = 0;
+	for (size_t ii = 0; ii < range_count; ++ii)
+	{
+		meshlet_count += results.data[ii].meshlets.data_length;
+		vertex_count += results.data[ii].vertices.data_length;
+		triangle_count += results.data[ii].triangles.data_length;
+	}
+
+	bool built = !job.failed && vertex_count <= UINT32_MAX && triangle_count <= UINT32_MAX;
+	if (built)
+	{
+		temp_data_view<gltf_meshlet_buffers::draw_range> draw_ranges{};
+		temp_data_view<gltf_meshlet> meshlets{};
+		temp_data_view<uint32_t> vertices{}, triangles{};
+		mesh_scratch(draw_ranges, range_count, host_allocator);
+		mesh_scratch(meshlets, meshlet_count, host_allocator);
+		mesh_scratch(vertices, vertex_count, host_allocator);
+		mesh_scratch(triangles, triangle_count, host_allocator);
+
+		size_t first_meshlet = 0, first_vertex = 0, first_triangle = 0;
+		for (size_t ii = 0; ii < range_count; ++ii)
+		{
+			const meshlet_range_result& result = results.data[ii];
+			draw_ranges.data[ii] = { .first_meshlet = uint32_t(first_meshlet), .meshlet_count = uint32_t(result.meshlets.data_length) };
+			for (size_t jj = 0; jj < result.meshlets.data_length; ++jj)
+			{
+				gltf_meshlet& meshlet = meshlets.data[first_meshlet + jj];
+				meshlet = result.meshlets.data[jj];
+				meshlet.vertex_offset += uint32_t(first_vertex);
+				meshlet.triangle_offset += uint32_t(first_triangle);
+			}
+			if (result.vertices.data_length)
+				memcpy(vertices.data + first_vertex, result.vertices.data, result.vertices.data_length * sizeof(uint32_t));
+			if (result.triangles.data_length)
+				memcpy(triangles.data + first_triangle, result.triangles.data, result.triangles.data_length * sizeof(uint32_t));
+			first_meshlet += result.meshlets.data_length;
+			first_vertex += result.vertices.data_length;
+			first_triangle += result.triangles.data_length;
+		}
+
+		out->draw_ranges = draw_ranges.to();
+		out->meshlets = meshlets.to();
+		out->vertices = vertices.to();
+		out->triangles = triangles.to();
+	}
+
+	for (size_t ii = 0; ii < range_count; ++ii)
+	{
+		free_gltf_buffer(results.data[ii].meshlets, host_allocator);
+		free_gltf_buffer(results.data[ii].vertices, host_allocator);
+		free_gltf_buffer(results.data[ii].triangles, host_allocator);
+	}
+	return built;
+}
+
+void acp_vulkan::gltf_meshlet_buffers_free(gltf_meshlet_buffers* meshlet_buffers, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(meshlet_buffers->draw_ranges, host_allocator);
+	free_gltf_buffer(meshlet_buffers->meshlets, host_allocator);
+	free_gltf_buffer(meshlet_buffers->vertices, host_allocator);
+	free_gltf_buffer(meshlet_buffers->triangles, host_allocator);
+	*meshlet_buffers = {};
+}
+
+// Border edges pull their vertices back with this weight over the plane of the triangles, so open boundaries keep their outline.
+#define LOD_BORDER_WEIGHT 10.0f
+// A collapse is refused when it turns a triangle around a vertex by more than about 75 degrees (the cosine of the normals drops under this).
+#define LOD_MIN_NORMAL_COSINE 0.25f
+
+// How a vertex may move during simplification.
+enum class lod_vertex_kind : uint8_t
+{
+	// Every edge is shared by two triangles, collapses on to any neighbour.
+	manifold,
+	// On one open edge in and one out, slides along them.
+	border,
+	// On a uv or normal seam: an open edge in and out that the twin vertex at the same position closes. Collapses along the seam together with its twin.
+	seam,
+	// Corners and anything else with a more complex neighbourhood stay where they are.
+	locked,
+};
+
+// Plane distance squared error: p^T A p + 2 b.p + c with A symmetric.
+struct lod_quadric
+{
+	float a00, a11, a22, a01, a02, a12;
+	float b0, b1, b2;
+	float c;
+	// Sum of the plane weights, errors are divided by it so they stay distances squared.
+	float weight;
+};
+
+static void add_plane_quadric(lod_quadric* quadric, const float* normal, float distance, float weight)
+{
+	quadric->a00 += weight * normal[0] * normal[0];
+	quadric->a11 += weight * normal[1] * normal[1];
+	quadric->a22 += weight * normal[2] * normal[2];
+	quadric->a01 += weight * normal[0] * normal[1];
+	quadric->a02 += weight * normal[0] * normal[2];
+	quadric->a12 += weight * normal[1] * normal[2];
+	quadric->b0 += weight * normal[0] * distance;
+	quadric->b1 += weight * normal[1] * distance;
+	quadric->b2 += weight * normal[2] * distance;
+	quadric->c += weight * distance * distance;
+	quadric->weight += weight;
+}
+
+static void add_quadric(lod_quadric* quadric, const lod_quadric& other)
+{
+	quadric->a00 += other.a00;
+	quadric->a11 += other.a11;
+	quadric->a22 += other.a22;
+	quadric->a01 += other.a01;
+	quadric->a02 += other.a02;
+	quadric->a12 += other.a12;
+	quadric->b0 += other.b0;
+	quadric->b1 += other.b1;
+	quadric->b2 += other.b2;
+	quadric->c += other.c;
+	quadric->weight += other.weight;
+}
+
+static float quadric_error(const lod_quadric& quadric, const float* p)
+{
+	float error = quadric.a00 * p[0] * p[0] + quadric.a11 * p[1] * p[1] + quadric.a22 * p[2] * p[2] +
+		2.0f * (quadric.a01 * p[0] * p[1] + quadric.a02 * p[0] * p[2] + quadric.a12 * p[1] * p[2]) +
+		2.0f * (quadric.b0 * p[0] + quadric.b1 * p[1] + quadric.b2 * p[2]) + quadric.c;
+	return error > 0.0f && quadric.weight > 0.0f ? error / quadric.weight : 0.0f;
+}
+
+static void triangle_normal(const float* p0, const float* p1, const float* p2, float* normal)
+{
+	float e0[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	float e1[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+struct lod_collapse
+{
+	uint32_t from;
+	uint32_t to;
+	float error;
+};
+
+// Simplification state of one draw range, positions are normalized to the largest extent of the range so errors are relative to its size.
+struct lod_simplifier
+{
+	uint32_t vertex_count;
+	temp_data_view<float> positions;
+	// The first vertex at the same position, quadrics live there so seam twins share theirs.
+	temp_data_view<uint32_t> position_remap;
+	// Circular list of the vertices at the same position.
+	temp_data_view<uint32_t> wedges;
+	temp_data_view<lod_vertex_kind> kinds;
+	temp_data_view<lod_quadric> quadrics;
+	temp_data_view<uint32_t> indices;
+	temp_data_view<uint32_t> adjacency_offsets;
+	temp_data_view<uint32_t> adjacency;
+	// Per position stamps for the topology test of a collapse.
+	temp_data_view<uint32_t> marks;
+	uint32_t mark;
+	VkAllocationCallbacks* host_allocator;
+
+	const float* position(uint32_t vertex) const { return positions.data + size_t(vertex) * 3; }
+};
+
+static void rebuild_lod_adjacency(lod_simplifier* simplifier)
+{
+	uint32_t* offsets = simplifier->adjacency_offsets.data;
+	memset(offsets, 0, (size_t(simplifier->vertex_count) + 1) * sizeof(uint32_t));
+	for (size_t ii = 0; ii < simplifier->indices.data_length; ++ii)
+		offsets[simplifier->indices.data[ii] + 1]++;
+	for (uint32_t ii = 0; ii < simplifier->vertex_count; ++ii)
+		offsets[ii + 1] += offsets[ii];
+	for (size_t ii = 0; ii < simplifier->indices.data_length; ++ii)
+		simplifier->adjacency.data[offsets[simplifier->indices.data[ii]]++] = uint32_t(ii / 3);
+	for (uint32_t ii = simplifier->vertex_count; ii > 0; --ii)
+		offsets[ii] = offsets[ii - 1];
+	offsets[0] = 0;
+}
+
+// Whether a triangle has the directed edge from -> to.
+static bool has_lod_edge(const lod_simplifier& simplifier, uint32_t from, uint32_t to)
+{
+	for (uint32_t ii = simplifier.adjacency_offsets.data[from]; ii < simplifier.adjacency_offsets.data[from + 1]; ++ii)
+	{
+		const uint32_t* triangle = simplifier.indices.data + size_t(simplifier.adjacency.data[ii]) * 3;
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			if (triangle[jj] == from && triangle[(jj + 1) % 3] == to)
+				return true;
+	}
+	return false;
+}
+
+// A vertex at the position of vertex that shares an edge with other, UINT32_MAX when none does.
+static uint32_t lod_wedge_neighbour(const lod_simplifier& simplifier, uint32_t vertex, uint32_t other)
+{
+	uint32_t wedge = vertex;
+	do
+	{
+		if (has_lod_edge(simplifier, wedge, other) || has_lod_edge(simplifier, other, wedge))
+			return wedge;
+		wedge = simplifier.wedges.data[wedge];
+	} while (wedge != vertex);
+	return UINT32_MAX;
+}
+
+static void classify_lod_vertices(lod_simplifier* simplifier)
+{
+	lod_simplifier& s = *simplifier;
+	for (uint32_t ii = 0; ii < s.vertex_count; ++ii)
+		s.kinds.data[ii] = lod_vertex_kind::manifold;
+
+	// Count the open edges leaving and entering every vertex and whether a twin closes them.
+	temp_data_view<uint8_t> open_out_view{}, open_in_view{}, unclosed_view{};
+	uint8_t* open_out = mesh_scratch(open_out_view, s.vertex_count, s.host_allocator);
+	uint8_t* open_in = mesh_scratch(open_in_view, s.vertex_count, s.host_allocator);
+	uint8_t* unclosed = mesh_scratch(unclosed_view, s.vertex_count, s.host_allocator);
+	memset(open_out, 0, s.vertex_count);
+	memset(open_in, 0, s.vertex_count);
+	memset(unclosed, 0, s.vertex_count);
+	for (size_t ii = 0; ii < s.indices.data_length; ii += 3)
+		for (uint32_t jj = 0; jj < 3; ++jj)
+		{
+			uint32_t from = s.indices.data[ii + jj];
+			uint32_t to = s.indices.data[ii + (jj + 1) % 3];
+			if (has_lod_edge(s, to, from))
+				continue;
+
+			open_out[from] = open_out[from] < 2 ? open_out[from] + 1 : 2;
+			open_in[to] = open_in[to] < 2 ? open_in[to] + 1 : 2;
+
+			// A twin closes the edge when the same positions are joined by an edge going the other way.
+			bool closed = false;
+			for (uint32_t twin_to = s.wedges.data[to]; twin_to != to && !closed; twin_to = s.wedges.data[twin_to])
+				for (uint32_t twin_from = s.wedges.data[from]; twin_from != from && !closed; twin_from = s.wedges.data[twin_from])
+					closed = has_lod_edge(s, twin_to, twin_from);
+			if (!closed)
+			{
+				unclosed[from] = 1;
+				unclosed[to] = 1;
+			}
+		}
+
+	for (uint32_t ii = 0; ii < s.vertex_count; ++ii)
+	{
+		uint32_t wedge_size = 1;
+		for (uint32_t wedge = s.wedges.data[ii]; wedge != ii; wedge = s.wedges.data[wedge])
+			++wedge_size;
+
+		lod_vertex_kind kind = lod_vertex_kind::locked;
+		if (!open_out[ii] && !open_in[ii])
+			kind = wedge_size == 1 ? lod_vertex_kind::manifold : lod_vertex_kind::locked;
+		else if (open_out[ii] == 1 && open_in[ii] == 1)
+		{
+			if (wedge_size == 1)
+				kind = lod_vertex_kind::border;
+			else if (wedge_size == 2 && !unclosed[ii])
+				kind = lod_vertex_kind::seam;
+		}
+		s.kinds.data[ii] = kind;
+	}
+}
+
+static void init_lod_quadrics(lod_simplifier* simplifier)
+{
+	lod_simplifier& s = *simplifier;
+	memset(s.quadrics.data, 0, size_t(s.vertex_count) * sizeof(lod_quadric));
+	for (size_t ii = 0; ii < s.indices.data_length; ii += 3)
+	{
+		const uint32_t* triangle = s.indices.data + ii;
+		float normal[3];
+		triangle_normal(s.position(triangle[0]), s.position(triangle[1]), s.position(triangle[2]), normal);
+		float length = sqrtf(dot3(normal, normal));
+		if (length <= 0.0f)
+			continue;
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			normal[jj] /= length;
+
+		float distance = -dot3(normal, s.position(triangle[0]));
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			add_plane_quadric(&s.quadrics.data[s.position_remap.data[triangle[jj]]], normal, distance, length * 0.5f);
+
+		// Open edges add a plane through the edge perpendicular to the triangle.
+		for (uint32_t jj = 0; jj < 3; ++jj)
+		{
+			uint32_t from = triangle[jj];
+			uint32_t to = triangle[(jj + 1) % 3];
+			if (has_lod_edge(s, to, from))
+				continue;
+
+			const float* p0 = s.position(from);
+			const float* p1 = s.position(to);
+			float edge[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float edge_length_squared = dot3(edge, edge);
+			float plane[3]{ edge[1] * normal[2] - edge[2] * normal[1], edge[2] * normal[0] - edge[0] * normal[2], edge[0] * normal[1] - edge[1] * normal[0] };
+			float plane_length = sqrtf(dot3(plane, plane));
+			if (plane_length <= 0.0f)
+				continue;
+			for (uint32_t kk = 0; kk < 3; ++kk)
+				plane[kk] /= plane_length;
+
+			float plane_distance = -dot3(plane, p0);
+			add_plane_quadric(&s.quadrics.data[s.position_remap.data[from]], plane, plane_distance, edge_length_squared * LOD_BORDER_WEIGHT);
+			add_plane_quadric(&s.quadrics.data[s.position_remap.data[to]], plane, plane_distance, edge_length_squared * LOD_BORDER_WEIGHT);
+		}
+	}
+}
+
+// Whether from can move on to to along this edge without tearing a border or seam open.
+static bool lod_collapse_allowed(const lod_simplifier& s, uint32_t from, uint32_t to)
+{
+	lod_vertex_kind from_kind = s.kinds.data[from];
+	lod_vertex_kind to_kind = s.kinds.data[to];
+	switch (from_kind)
+	{
+	case lod_vertex_kind::manifold:
+		return true;
+	case lod_vertex_kind::border:
+		return (to_kind == lod_vertex_kind::border || to_kind == lod_vertex_kind::locked) && (!has_lod_edge(s, from, to) || !has_lod_edge(s, to, from));
+	case lod_vertex_kind::seam:
+		// The twin follows on to the vertex at the position of to it shares an edge with.
+		return (to_kind == lod_vertex_kind::seam || to_kind == lod_vertex_kind::locked) && (!has_lod_edge(s, from, to) || !has_lod_edge(s, to, from)) &&
+			lod_wedge_neighbour(s, to, s.wedges.data[from]) != UINT32_MAX;
+	default:
+		return false;
+	}
+}
+
+// Whether the triangle has a corner at the position of vertex.
+static bool lod_triangle_touches(const lod_simplifier& s, const uint32_t* triangle, uint32_t vertex)
+{
+	uint32_t position = s.position_remap.data[vertex];
+	return s.position_remap.data[triangle[0]] == position || s.position_remap.data[triangle[1]] == position || s.position_remap.data[triangle[2]] == position;
+}
+
+// Whether moving from on to the position of to turns any triangle around from too far, triangles at the position of to are about to vanish.
+static bool lod_collapse_flips(const lod_simplifier& s, uint32_t from, uint32_t to)
+{
+	const float* target = s.position(to);
+	for (uint32_t ii = s.adjacency_offsets.data[from]; ii < s.adjacency_offsets.data[from + 1]; ++ii)
+	{
+		const uint32_t* triangle = s.indices.data + size_t(s.adjacency.data[ii]) * 3;
+		if (lod_triangle_touches(s, triangle, to))
+			continue;
+
+		const float* corners[3]{ s.position(triangle[0]), s.position(triangle[1]), s.position(triangle[2]) };
+		float before[3];
+		triangle_normal(corners[0], corners[1], corners[2], before);
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			if (triangle[jj] == from)
+				corners[jj] = target;
+		float after[3];
+		triangle_normal(corners[0], corners[1], corners[2], after);
+		if (dot3(before, after) < LOD_MIN_NORMAL_COSINE * sqrtf(dot3(before, before) * dot3(after, after)))
+			return true;
+	}
+	return false;
+}
+
+// Whether the collapse keeps the surface a manifold: the positions around both ends have to be only those of the triangles on the edge, otherwise
+// triangles end up on top of each other or the surface gets pinched.
+static bool lod_collapse_keeps_topology(lod_simplifier* simplifier, uint32_t from, uint32_t to)
+{
+	lod_simplifier& s = *simplifier;
+	s.mark += 2;
+	uint32_t wedge = to;
+	do
+	{
+		for (uint32_t ii = s.adjacency_offsets.data[wedge]; ii < s.adjacency_offsets.data[wedge + 1]; ++ii)
+			for (uint32_t jj = 0; jj < 3; ++jj)
+				s.marks.data[s.position_remap.data[s.indices.data[size_t(s.adjacency.data[ii]) * 3 + jj]]] = s.mark;
+		wedge = s.wedges.data[wedge];
+	} while (wedge != to);
+
+	uint32_t edge_triangles = 0, shared = 0;
+	uint32_t from_position = s.position_remap.data[from];
+	wedge = from;
+	do
+	{
+		for (uint32_t ii = s.adjacency_offsets.data[wedge]; ii < s.adjacency_offsets.data[wedge + 1]; ++ii)
+		{
+			const uint32_t* triangle = s.indices.data + size_t(s.adjacency.data[ii]) * 3;
+			if (lod_triangle_touches(s, triangle, to))
+			{
+				++edge_triangles;
+				continue;
+			}
+			for (uint32_t jj = 0; jj < 3; ++jj)
+			{
+				uint32_t position = s.position_remap.data[triangle[jj]];
+				if (position != from_position && s.marks.data[position] == s.mark)
+				{
+					s.marks.data[position] = s.mark + 1;
+					++shared;
+				}
+			}
+		}
+		wedge = s.wedges.data[wedge];
+	} while (wedge != from);
+	return shared <= edge_triangles;
+}
+
+// Collapses edges in passes of independent collapses, cheapest first, until the triangle count reaches target_triangles or the next collapse costs more
+// than max_error. Returns the largest error among the collapses done.
+static float simplify_lod(lod_simplifier* simplifier, size_t target_triangles, float max_error, float error)
+{
+	lod_simplifier& s = *simplifier;
+	temp_data_view<lod_collapse> collapses{};
+	collapses.host_allocator = s.host_allocator;
+	temp_data_view<uint32_t> collapse_remap_view{};
+	temp_data_view<uint8_t> touched_view{};
+	uint32_t* collapse_remap = mesh_scratch(collapse_remap_view, s.vertex_count, s.host_allocator);
+	uint8_t* touched = mesh_scratch(touched_view, s.vertex_count, s.host_allocator);
+	float max_quadric_error = max_error * max_error;
+
+	while (s.indices.data_length / 3 > target_triangles)
+	{
+		rebuild_lod_adjacency(&s);
+
+		collapses.data_length = 0;
+		for (size_t ii = 0; ii < s.indices.data_length; ++ii)
+		{
+			uint32_t a = s.indices.data[ii];
+			uint32_t b = s.indices.data[ii - ii % 3 + (ii % 3 + 1) % 3];
+			// Closed edges come up in both of their triangles, keep one.
+			if (s.position_remap.data[a] == s.position_remap.data[b] || (a > b && has_lod_edge(s, b, a)))
+				continue;
+
+			lod_collapse best{ .from = UINT32_MAX, .to = UINT32_MAX, .error = FLT_MAX };
+			for (uint32_t direction = 0; direction < 2; ++direction)
+			{
+				uint32_t from = direction ? b : a;
+				uint32_t to = direction ? a : b;
+				if (!lod_collapse_allowed(s, from, to))
+					continue;
+				lod_quadric quadric = s.quadrics.data[s.position_remap.data[from]];
+				add_quadric(&quadric, s.quadrics.data[s.position_remap.data[to]]);
+				float collapse_error = quadric_error(quadric, s.position(to));
+				if (collapse_error < best.error)
+					best = { .from = from, .to = to, .error = collapse_error };
+			}
+			if (best.from != UINT32_MAX && best.error <= max_quadric_error)
+				collapses.emplace_back(lod_collapse(best));
+		}
+		if (!collapses.data_length)
+			break;
+
+		std::sort(collapses.data, collapses.data + collapses.data_length, [](const lod_collapse& a, const lod_collapse& b) { return a.error < b.error; });
+
+		for (uint32_t ii = 0; ii < s.vertex_count; ++ii)
+			collapse_remap[ii] = ii;
+		memset(touched, 0, s.vertex_count);
+
+		size_t triangles_left = s.indices.data_length / 3;
+		size_t applied = 0;
+		for (size_t ii = 0; ii < collapses.data_length && triangles_left > target_triangles; ++ii)
+		{
+			const lod_collapse& collapse = collapses.data[ii];
+			uint32_t from = collapse.from;
+			uint32_t to = collapse.to;
+			uint32_t twin_from = UINT32_MAX, twin_to = UINT32_MAX;
+			if (s.kinds.data[from] == lod_vertex_kind::seam)
+			{
+				twin_from = s.wedges.data[from];
+				twin_to = lod_wedge_neighbour(s, to, twin_from);
+			}
+
+			// Collapses of one pass share no vertex, so the quadrics and adjacency they read stay valid.
+			if (touched[s.position_remap.data[from]] || touched[s.position_remap.data[to]])
+				continue;
+			if (lod_collapse_flips(s, from, to) || (twin_from != UINT32_MAX && lod_collapse_flips(s, twin_from, twin_to)) || !lod_collapse_keeps_topology(&s, from, to))
+				continue;
+
+			// Mark every vertex around both ends so later collapses of the pass stay away from the changed triangles.
+			uint32_t ends[4]{ from, to, twin_from, twin_to };
+			for (uint32_t end : ends)
+			{
+				if (end == UINT32_MAX)
+					continue;
+				for (uint32_t jj = s.adjacency_offsets.data[end]; jj < s.adjacency_offsets.data[end + 1]; ++jj)
+				{
+					const uint32_t* triangle = s.indices.data + size_t(s.adjacency.data[jj]) * 3;
+					for (uint32_t kk = 0; kk < 3; ++kk)
+						touched[s.position_remap.data[triangle[kk]]] = 1;
+				}
+			}
+
+			for (uint32_t jj = s.adjacency_offsets.data[from]; jj < s.adjacency_offsets.data[from + 1]; ++jj)
+				triangles_left -= lod_triangle_touches(s, s.indices.data + size_t(s.adjacency.data[jj]) * 3, to);
+			collapse_remap[from] = to;
+			if (twin_from != UINT32_MAX)
+			{
+				for (uint32_t jj = s.adjacency_offsets.data[twin_from]; jj < s.adjacency_offsets.data[twin_from + 1]; ++jj)
+					triangles_left -= lod_triangle_touches(s, s.indices.data + size_t(s.adjacency.data[jj]) * 3, twin_to);
+				collapse_remap[twin_from] = twin_to;
+			}
+			add_quadric(&s.quadrics.data[s.position_remap.data[to]], s.quadrics.data[s.position_remap.data[from]]);
+			error = fmaxf(error, sqrtf(collapse.error));
+			++applied;
+		}
+		if (!applied)
+			break;
+
+		size_t written = 0;
+		for (size_t ii = 0; ii < s.indices.data_length; ii += 3)
+		{
+			uint32_t a = collapse_remap[s.indices.data[ii + 0]];
+			uint32_t b = collapse_remap[s.indices.data[ii + 1]];
+			uint32_t c = collapse_remap[s.indices.data[ii + 2]];
+			// Collapsing next to another vertex at the position of to also leaves triangles without area.
+			uint32_t pa = s.position_remap.data[a], pb = s.position_remap.data[b], pc = s.position_remap.data[c];
+			if (pa == pb || pb == pc || pa == pc)
+				continue;
+			s.indices.data[written++] = a;
+			s.indices.data[written++] = b;
+			s.indices.data[written++] = c;
+		}
+		s.indices.data_length = written;
+	}
+	return error;
+}
+
+struct lod_level_result
+{
+	acp_vulkan::gltf_data::data_view<uint32_t> indices;
+	float error;
+	// The level reuses the indices of the draw range.
+	bool unchanged;
+};
+
+struct lod_build_job
+{
+	const acp_vulkan::gltf_mesh_buffers* mesh_buffers;
+	const acp_vulkan::gltf_mesh_lod_level* levels;
+	uint32_t level_count;
+	uint32_t position_attribute;
+	VkAllocationCallbacks* host_allocator;
+	// level_count per draw range.
+	lod_level_result* results;
+};
+
+static void build_lods_job(void* job_data, size_t job_index)
+{
+	lod_build_job* job = reinterpret_cast<lod_build_job*>(job_data);
+	const acp_vulkan::gltf_mesh_buffers::draw_range& range = job->mesh_buffers->draw_ranges.data[job_index];
+	lod_level_result* results = job->results + job_index * job->level_count;
+	for (uint32_t ii = 0; ii < job->level_count; ++ii)
+		results[ii] = { .indices = {}, .error = 0.0f, .unchanged = true };
+
+	const uint32_t* range_indices = job->mesh_buffers->indices.data + range.first_index;
+	if (job->position_attribute == UINT32_MAX || range.mode != acp_vulkan::gltf_data::mesh::mode::TRIANGLES || range.index_count < 3 || range.index_count % 3)
+		return;
+	for (uint32_t ii = 0; ii < range.index_count; ++ii)
+		if (range_indices[ii] >= range.vertex_count)
+			return;
+
+	lod_simplifier s{};
+	s.vertex_count = range.vertex_count;
+	s.host_allocator = job->host_allocator;
+	mesh_scratch(s.positions, size_t(range.vertex_count) * 3, job->host_allocator);
+	mesh_scratch(s.position_remap, range.vertex_count, job->host_allocator);
+	mesh_scratch(s.wedges, range.vertex_count, job->host_allocator);
+	mesh_scratch(s.kinds, range.vertex_count, job->host_allocator);
+	mesh_scratch(s.quadrics, range.vertex_count, job->host_allocator);
+	mesh_scratch(s.indices, range.index_count, job->host_allocator);
+	mesh_scratch(s.adjacency_offsets, size_t(range.vertex_count) + 1, job->host_allocator);
+	mesh_scratch(s.adjacency, range.index_count, job->host_allocator);
+	memset(mesh_scratch(s.marks, range.vertex_count, job->host_allocator), 0, range.vertex_count * sizeof(uint32_t));
+	memcpy(s.indices.data, range_indices, range.index_count * sizeof(uint32_t));
+
+	range_positions positions = range_positions_for(job->mesh_buffers, job->position_attribute, range);
+	float bounds_min[3]{ FLT_MAX, FLT_MAX, FLT_MAX }, bounds_max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t ii = 0; ii < range.vertex_count; ++ii)
+	{
+		float* position = s.positions.data + size_t(ii) * 3;
+		load_position(positions, ii, position);
+		for (uint32_t jj = 0; jj < 3; ++jj)
+		{
+			bounds_min[jj] = fminf(bounds_min[jj], position[jj]);
+			bounds_max[jj] = fmaxf(bounds_max[jj], position[jj]);
+		}
+	}
+	float extent = fmaxf(bounds_max[0] - bounds_min[0], fmaxf(bounds_max[1] - bounds_min[1], bounds_max[2] - bounds_min[2]));
+	float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+	for (uint32_t ii = 0; ii < range.vertex_count; ++ii)
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			s.positions.data[size_t(ii) * 3 + jj] = (s.positions.data[size_t(ii) * 3 + jj] - bounds_min[jj]) * scale;
+
+	// Vertices split by other attributes at the same position are found by sorting on the position.
+	temp_data_view<uint32_t> sorted_view{};
+	uint32_t* sorted = mesh_scratch(sorted_view, range.vertex_count, job->host_allocator);
+	for (uint32_t ii = 0; ii < range.vertex_count; ++ii)
+		sorted[ii] = ii;
+	const float* sort_positions = s.positions.data;
+	std::sort(sorted, sorted + range.vertex_count, [sort_positions](uint32_t a, uint32_t b) {
+		return memcmp(sort_positions + size_t(a) * 3, sort_positions + size_t(b) * 3, sizeof(float) * 3) < 0; });
+	for (uint32_t begin = 0; begin < range.vertex_count;)
+	{
+		uint32_t end = begin + 1;
+		while (end < range.vertex_count && !memcmp(sort_positions + size_t(sorted[begin]) * 3, sort_positions + size_t(sorted[end]) * 3, sizeof(float) * 3))
+			++end;
+		for (uint32_t ii = begin; ii < end; ++ii)
+		{
+			s.position_remap.data[sorted[ii]] = sorted[begin];
+			s.wedges.data[sorted[ii]] = sorted[ii + 1 < end ? ii + 1 : begin];
+		}
+		begin = end;
+	}
+
+	rebuild_lod_adjacency(&s);
+	classify_lod_vertices(&s);
+	init_lod_quadrics(&s);
+
+	// Every level continues from the one before it.
+	size_t triangle_count = range.index_count / 3;
+	float error = 0.0f;
+	size_t previous_index_count = range.index_count;
+	temp_data_view<uint8_t> cluster_starts_view{};
+	uint8_t* cluster_starts = mesh_scratch(cluster_starts_view, triangle_count, job->host_allocator);
+	for (uint32_t ii = 0; ii < job->level_count; ++ii)
+	{
+		const acp_vulkan::gltf_mesh_lod_level& level = job->levels[ii];
+		size_t target = size_t(float(triangle_count) * (level.triangle_ratio < 0.0f ? 0.0f : level.triangle_ratio));
+		error = simplify_lod(&s, target, level.max_error, error);
+		if (s.indices.data_length == previous_index_count)
+			continue;
+		previous_index_count = s.indices.data_length;
+
+		temp_data_view<uint32_t> level_indices{};
+		mesh_scratch(level_indices, s.indices.data_length, job->host_allocator);
+		tipsify(s.indices.data, uint32_t(s.indices.data_length / 3), range.vertex_count, job->host_allocator, level_indices.data, cluster_starts);
+		results[ii] = { .indices = level_indices.to(), .error = error, .unchanged = false };
+	}
+}
+
+bool acp_vulkan::gltf_mesh_buffers_build_lods(gltf_mesh_buffers* mesh_buffers, const gltf_mesh_lod_level* levels, uint32_t level_count,
+	VkAllocationCallbacks* host_allocator, gltf_mesh_flags mesh_flags)
+{
+	size_t range_count = mesh_buffers->draw_ranges.data_length;
+	uint32_t position_attribute = readable_position_attribute(mesh_buffers);
+	if (position_attribute == UINT32_MAX)
+		return false;
+
+	// Levels built before are replaced, the indices of the draw ranges come first in the buffer.
+	size_t base_index_count = 0;
+	for (size_t ii = 0; ii < range_count; ++ii)
+	{
+		const gltf_mesh_buffers::draw_range& range = mesh_buffers->draw_ranges.data[ii];
+		base_index_count = base_index_count > size_t(range.first_index) + range.index_count ? base_index_count : size_t(range.first_index) + range.index_count;
+	}
+
+	temp_data_view<lod_level_result> results{};
+	mesh_scratch(results, range_count * level_count, host_allocator);
+	lod_build_job job{
+		.mesh_buffers = mesh_buffers,
+		.levels = levels,
+		.level_count = level_count,
+		.position_attribute = position_attribute,
+		.host_allocator = host_allocator,
+		.results = results.data,
+	};
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((mesh_flags & gltf_mesh_parallel_decode) && range_count > 1 && has_workers)
+		run_parsing_jobs(build_lods_job, &job, range_count);
+	else
+		for (size_t ii = 0; ii < range_count; ++ii)
+			build_lods_job(&job, ii);
+
+	size_t index_count = base_index_count;
+	for (size_t ii = 0; ii < results.data_length; ++ii)
+		index_count += results.data[ii].indices.data_length;
+
+	bool built = index_count <= UINT32_MAX;
+	if (built)
+	{
+		temp_data_view<uint32_t> indices{};
+		temp_data_view<gltf_mesh_buffers::lod_range> lods{};
+		mesh_scratch(indices, index_count, host_allocator);
+		mesh_scratch(lods, results.data_length, host_allocator);
+		memcpy(indices.data, mesh_buffers->indices.data, base_index_count * sizeof(uint32_t));
+
+		size_t first_index = base_index_count;
+		for (size_t ii = 0; ii < results.data_length; ++ii)
+		{
+			const lod_level_result& result = results.data[ii];
+			const gltf_mesh_buffers::draw_range& range = mesh_buffers->draw_ranges.data[ii / level_count];
+			if (result.unchanged)
+			{
+				// The level before it or the full detail range when simplification could not go further.
+				lods.data[ii] = ii % level_count ? lods.data[ii - 1] : gltf_mesh_buffers::lod_range{ .first_index = range.first_index, .index_count = range.index_count, .error = 0.0f };
+				continue;
+			}
+
+			memcpy(indices.data + first_index, result.indices.data, result.indices.data_length * sizeof(uint32_t));
+			lods.data[ii] = { .first_index = uint32_t(first_index), .index_count = uint32_t(result.indices.data_length), .error = result.error };
+			first_index += result.indices.data_length;
+		}
+
+		free_gltf_buffer(mesh_buffers->indices, host_allocator);
+		free_gltf_buffer(mesh_buffers->lods, host_allocator);
+		mesh_buffers->indices = indices.to();
+		mesh_buffers->lods = lods.to();
+		mesh_buffers->lod_level_count = level_count;
+	}
+
+	for (size_t ii = 0; ii < results.data_length; ++ii)
+		free_gltf_buffer(results.data[ii].indices, host_allocator);
+	return built;
+}
+
+// Component ii of entry jj of a structure of arrays transform stream.
+#define TRANSFORM_COMPONENT(stream, component, entry, entry_count) (stream)[size_t(component) * (entry_count) + (entry)]
+
+// Splits a node matrix in to translation, rotation and scale, gltf only allows matrices without shear.
+static void decompose_node_matrix(const float* matrix, float* translation, float* rotation, float* scale)
+{
+	translation[0] = matrix[12];
+	translation[1] = matrix[13];
+	translation[2] = matrix[14];
+
+	float columns[3][3];
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		scale[ii] = sqrtf(matrix[ii * 4 + 0] * matrix[ii * 4 + 0] + matrix[ii * 4 + 1] * matrix[ii * 4 + 1] + matrix[ii * 4 + 2] * matrix[ii * 4 + 2]);
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			columns[ii][jj] = scale[ii] > 0.0f ? matrix[ii * 4 + jj] / scale[ii] : float(ii == jj);
+	}
+	// A mirroring matrix keeps a proper rotation with one negative scale.
+	float determinant = columns[0][0] * (columns[1][1] * columns[2][2] - columns[2][1] * columns[1][2]) -
+		columns[1][0] * (columns[0][1] * columns[2][2] - columns[2][1] * columns[0][2]) +
+		columns[2][0] * (columns[0][1] * columns[1][2] - columns[1][1] * columns[0][2]);
+	if (determinant < 0.0f)
+	{
+		scale[0] = -scale[0];
+		for (uint32_t jj = 0; jj < 3; ++jj)
+			columns[0][jj] = -columns[0][jj];
+	}
+
+	float trace = columns[0][0] + columns[1][1] + columns[2][2];
+	if (trace > 0.0f)
+	{
+		float s = 0.5f / sqrtf(trace + 1.0f);
+		rotation[3] = 0.25f / s;
+		rotation[0] = (columns[1][2] - columns[2][1]) * s;
+		rotation[1] = (columns[2][0] - columns[0][2]) * s;
+		rotation[2] = (columns[0][1] - columns[1][0]) * s;
+	}
+	else if (columns[0][0] > columns[1][1] && columns[0][0] > columns[2][2])
+	{
+		float s = 2.0f * sqrtf(1.0f + columns[0][0] - columns[1][1] - columns[2][2]);
+		rotation[3] = (columns[1][2] - columns[2][1]) / s;
+		rotation[0] = 0.25f * s;
+		rotation[1] = (columns[1][0] + columns[0][1]) / s;
+		rotation[2] = (columns[2][0] + columns[0][2]) / s;
+	}
+	else if (columns[1][1] > columns[2][2])
+	{
+		float s = 2.0f * sqrtf(1.0f + columns[1][1] - columns[0][0] - columns[2][2]);
+		rotation[3] = (columns[2][0] - columns[0][2]) / s;
+		rotation[0] = (columns[1][0] + columns[0][1]) / s;
+		rotation[1] = 0.25f * s;
+		rotation[2] = (columns[2][1] + columns[1][2]) / s;
+	}
+	else
+	{
+		float s = 2.0f * sqrtf(1.0f + columns[2][2] - columns[0][0] - columns[1][1]);
+		rotation[3] = (columns[0][1] - columns[1][0]) / s;
+		rotation[0] = (columns[2][0] + columns[0][2]) / s;
+		rotation[1] = (columns[2][1] + columns[1][2]) / s;
+		rotation[2] = 0.25f * s;
+	}
+}
+
+static const float identity_matrix[16]{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+// world = parent world * translation * rotation * scale for count entries from first, their parents have to be up to date.
+typedef void (*compose_world_type)(acp_vulkan::gltf_scene_transforms* transforms, uint32_t first, uint32_t count);
+
+static void compose_world_scalar(acp_vulkan::gltf_scene_transforms* transforms, uint32_t first, uint32_t count)
+{
+	uint32_t entry_count = transforms->entry_count;
+	float* world = transforms->world_matrices.data;
+	for (uint32_t entry = first; entry < first + count; ++entry)
+	{
+		float t[3], q[4], s[3];
+		for (uint32_t ii = 0; ii < 3; ++ii)
+		{
+			t[ii] = TRANSFORM_COMPONENT(transforms->translations.data, ii, entry, entry_count);
+			s[ii] = TRANSFORM_COMPONENT(transforms->scales.data, ii, entry, entry_count);
+		}
+		for (uint32_t ii = 0; ii < 4; ++ii)
+			q[ii] = TRANSFORM_COMPONENT(transforms->rotations.data, ii, entry, entry_count);
+
+		float local[4][3]{
+			{ (1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) * s[0], 2.0f * (q[0] * q[1] + q[2] * q[3]) * s[0], 2.0f * (q[0] * q[2] - q[1] * q[3]) * s[0] },
+			{ 2.0f * (q[0] * q[1] - q[2] * q[3]) * s[1], (1.0f - 2.0f * (q[0] * q[0] + q[2] * q[2])) * s[1], 2.0f * (q[1] * q[2] + q[0] * q[3]) * s[1] },
+			{ 2.0f * (q[0] * q[2] + q[1] * q[3]) * s[2], 2.0f * (q[1] * q[2] - q[0] * q[3]) * s[2], (1.0f - 2.0f * (q[0] * q[0] + q[1] * q[1])) * s[2] },
+			{ t[0], t[1], t[2] },
+		};
+
+		uint32_t parent_entry = transforms->parents.data[entry];
+		float parent[16];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+			parent[ii] = parent_entry == UINT32_MAX ? identity_matrix[ii] : TRANSFORM_COMPONENT(world, ii, parent_entry, entry_count);
+
+		for (uint32_t column = 0; column < 4; ++column)
+			for (uint32_t row = 0; row < 4; ++row)
+				TRANSFORM_COMPONENT(world, column * 4 + row, entry, entry_count) = parent[row] * local[column][0] + parent[4 + row] * local[column][1] +
+					parent[8 + row] * local[column][2] + (column == 3 ? parent[12 + row] : 0.0f);
+	}
+}
+
+#if ACP_GLTF_X86
+// Four entries per lane group, the entries of one depth are contiguous so their translations, rotations and scales load directly.
+static void compose_world_sse2(acp_vulkan::gltf_scene_transforms* transforms, uint32_t first, uint32_t count)
+{
+	uint32_t entry_count = transforms->entry_count;
+	float* world = transforms->world_matrices.data;
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	uint32_t entry = first;
+	for (; entry + 4 <= first + count; entry += 4)
+	{
+		__m128 t[3], q[4], s[3];
+		for (uint32_t ii = 0; ii < 3; ++ii)
+		{
+			t[ii] = _mm_loadu_ps(&TRANSFORM_COMPONENT(transforms->translations.data, ii, entry, entry_count));
+			s[ii] = _mm_loadu_ps(&TRANSFORM_COMPONENT(transforms->scales.data, ii, entry, entry_count));
+		}
+		for (uint32_t ii = 0; ii < 4; ++ii)
+			q[ii] = _mm_loadu_ps(&TRANSFORM_COMPONENT(transforms->rotations.data, ii, entry, entry_count));
+
+		__m128 xx = _mm_mul_ps(q[0], q[0]), yy = _mm_mul_ps(q[1], q[1]), zz = _mm_mul_ps(q[2], q[2]);
+		__m128 xy = _mm_mul_ps(q[0], q[1]), xz = _mm_mul_ps(q[0], q[2]), yz = _mm_mul_ps(q[1], q[2]);
+		__m128 xw = _mm_mul_ps(q[0], q[3]), yw = _mm_mul_ps(q[1], q[3]), zw = _mm_mul_ps(q[2], q[3]);
+		__m128 local[4][3]{
+			{ _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), s[0]), _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), s[0]),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), s[0]) },
+			{ _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), s[1]), _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), s[1]),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), s[1]) },
+			{ _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), s[2]), _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), s[2]),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), s[2]) },
+			{ t[0], t[1], t[2] },
+		};
+
+		// Parents sit anywhere in the depth before, gather them in to lanes.
+		alignas(16) float parent_lanes[16][4];
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			uint32_t parent_entry = transforms->parents.data[entry + lane];
+			for (uint32_t ii = 0; ii < 16; ++ii)
+				parent_lanes[ii][lane] = parent_entry == UINT32_MAX ? identity_matrix[ii] : TRANSFORM_COMPONENT(world, ii, parent_entry, entry_count);
+		}
+		__m128 parent[16];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+			parent[ii] = _mm_load_ps(parent_lanes[ii]);
+
+		for (uint32_t column = 0; column < 4; ++column)
+			for (uint32_t row = 0; row < 4; ++row)
+			{
+				__m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(parent[row], local[column][0]), _mm_mul_ps(parent[4 + row], local[column][1])),
+					_mm_mul_ps(parent[8 + row], local[column][2]));
+				if (column == 3)
+					value = _mm_add_ps(value, parent[12 + row]);
+				_mm_storeu_ps(&TRANSFORM_COMPONENT(world, column * 4 + row, entry, entry_count), value);
+			}
+	}
+	compose_world_scalar(transforms, entry, first + count - entry);
+}
+#endif
+
+static compose_world_type compose_world_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend != acp_vulkan::gltf_scan_backend::scalar)
+		return compose_world_sse2;
+#endif
+	return compose_world_scalar;
+}
+
+bool acp_vulkan::gltf_scene_transforms_build(const gltf_data* gltf_data, uint32_t scene, VkAllocationCallbacks* host_allocator, gltf_scene_transforms* out)
+{
+	*out = {};
+	if (scene == UINT32_MAX)
+		scene = gltf_data->default_scene != UINT32_MAX ? gltf_data->default_scene : 0;
+	if (scene >= gltf_data->scenes.data_length)
+		return false;
+
+	size_t node_count = gltf_data->nodes.data_length;
+	temp_data_view<uint32_t> node_entries{}, nodes{}, parents{}, depth_offsets{};
+	mesh_scratch(node_entries, node_count, host_allocator);
+	memset(node_entries.data, 0xff, node_count * sizeof(uint32_t));
+	// Every node is in the scene at most once, so no more entries than nodes.
+	mesh_scratch(nodes, node_count, host_allocator);
+	mesh_scratch(parents, node_count, host_allocator);
+	nodes.data_length = 0;
+	parents.data_length = 0;
+	depth_offsets.host_allocator = host_allocator;
+
+	// Breadth first, a node reached twice means the nodes do not form a tree.
+	const gltf_data::scene& roots = gltf_data->scenes.data[scene];
+	for (size_t ii = 0; ii < roots.nodes.data_length; ++ii)
+	{
+		uint32_t node = roots.nodes.data[ii];
+		if (node >= node_count || node_entries.data[node] != UINT32_MAX)
+			return false;
+		node_entries.data[node] = uint32_t(nodes.data_length);
+		nodes.data[nodes.data_length++] = node;
+		parents.data[parents.data_length++] = UINT32_MAX;
+	}
+	for (uint32_t depth_begin = 0; depth_begin < nodes.data_length;)
+	{
+		depth_offsets.emplace_back(uint32_t(depth_begin));
+		uint32_t depth_end = uint32_t(nodes.data_length);
+		for (uint32_t entry = depth_begin; entry < depth_end; ++entry)
+		{
+			const gltf_data::node& node = gltf_data->nodes.data[nodes.data[entry]];
+			for (size_t ii = 0; ii < node.children.data_length; ++ii)
+			{
+				uint32_t child = node.children.data[ii];
+				if (child >= node_count || node_entries.data[child] != UINT32_MAX)
+					return false;
+				node_entries.data[child] = uint32_t(nodes.data_length);
+				nodes.data[nodes.data_length++] = child;
+				parents.data[parents.data_length++] = entry;
+			}
+		}
+		depth_begin = depth_end;
+	}
+	depth_offsets.emplace_back(uint32_t(nodes.data_length));
+
+	uint32_t entry_count = uint32_t(nodes.data_length);
+	temp_data_view<float> translations{}, rotations{}, scales{}, world_matrices{};
+	temp_data_view<uint8_t> dirty{};
+	mesh_scratch(translations, size_t(entry_count) * 3, host_allocator);
+	mesh_scratch(rotations, size_t(entry_count) * 4, host_allocator);
+	mesh_scratch(scales, size_t(entry_count) * 3, host_allocator);
+	mesh_scratch(world_matrices, size_t(entry_count) * 16, host_allocator);
+	memset(mesh_scratch(dirty, entry_count, host_allocator), 1, entry_count);
+	for (uint32_t entry = 0; entry < entry_count; ++entry)
+	{
+		const gltf_data::node& node = gltf_data->nodes.data[nodes.data[entry]];
+		float translation[3], rotation[4], scale[3];
+		if (node.has_matrix)
+			decompose_node_matrix(node.matrix, translation, rotation, scale);
+		else
+		{
+			memcpy(translation, node.translation, sizeof(translation));
+			memcpy(rotation, node.rotation, sizeof(rotation));
+			memcpy(scale, node.scale, sizeof(scale));
+		}
+		for (uint32_t ii = 0; ii < 3; ++ii)
+		{
+			TRANSFORM_COMPONENT(translations.data, ii, entry, entry_count) = translation[ii];
+			TRANSFORM_COMPONENT(scales.data, ii, entry, entry_count) = scale[ii];
+		}
+		for (uint32_t ii = 0; ii < 4; ++ii)
+			TRANSFORM_COMPONENT(rotations.data, ii, entry, entry_count) = rotation[ii];
+	}
+
+	out->entry_count = entry_count;
+	out->nodes = nodes.to();
+	out->parents = parents.to();
+	out->node_entries = node_entries.to();
+	out->depth_offsets = depth_offsets.to();
+	out->translations = translations.to();
+	out->rotations = rotations.to();
+	out->scales = scales.to();
+	out->world_matrices = world_matrices.to();
+	out->dirty = dirty.to();
+	gltf_scene_transforms_update(out);
+	return true;
+}
+
+void acp_vulkan::gltf_scene_transforms_set_local(gltf_scene_transforms* transforms, uint32_t node, const float* translation, const float* rotation, const float* scale)
+{
+	if (node >= transforms->node_entries.data_length || transforms->node_entries.data[node] == UINT32_MAX)
+		return;
+
+	uint32_t entry = transforms->node_entries.data[node];
+	uint32_t entry_count = transforms->entry_count;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		if (translation)
+			TRANSFORM_COMPONENT(transforms->translations.data, ii, entry, entry_count) = translation[ii];
+		if (scale)
+			TRANSFORM_COMPONENT(transforms->scales.data, ii, entry, entry_count) = scale[ii];
+	}
+	for (uint32_t ii = 0; rotation && ii < 4; ++ii)
+		TRANSFORM_COMPONENT(transforms->rotations.data, ii, entry, entry_count) = rotation[ii];
+	transforms->dirty.data[entry] = 1;
+}
+
+void acp_vulkan::gltf_scene_transforms_mark_dirty(gltf_scene_transforms* transforms, uint32_t node)
+{
+	if (node < transforms->node_entries.data_length && transforms->node_entries.data[node] != UINT32_MAX)
+		transforms->dirty.data[transforms->node_entries.data[node]] = 1;
+}
+
+uint32_t acp_vulkan::gltf_scene_transforms_update(gltf_scene_transforms* transforms)
+{
+	compose_world_type compose_world = compose_world_for(resolve_scan_backend(requested_scan_backend));
+	uint8_t* dirty = transforms->dirty.data;
+	const uint32_t* parents = transforms->parents.data;
+	uint32_t updated = 0;
+	for (size_t depth = 0; depth + 1 < transforms->depth_offsets.data_length; ++depth)
+	{
+		uint32_t depth_end = transforms->depth_offsets.data[depth + 1];
+		// Children of dirty entries are dirty, then runs of dirty entries are composed together.
+		for (uint32_t entry = transforms->depth_offsets.data[depth]; entry < depth_end; ++entry)
+			dirty[entry] |= parents[entry] != UINT32_MAX && dirty[parents[entry]];
+		for (uint32_t entry = transforms->depth_offsets.data[depth]; entry < depth_end;)
+		{
+			if (!dirty[entry])
+			{
+				++entry;
+				continue;
+			}
+			uint32_t run_end = entry + 1;
+			while (run_end < depth_end && dirty[run_end])
+				++run_end;
+			compose_world(transforms, entry, run_end - entry);
+			updated += run_end - entry;
+			entry = run_end;
+		}
+	}
+	memset(dirty, 0, transforms->entry_count);
+	return updated;
+}
+
+void acp_vulkan::gltf_scene_transforms_free(gltf_scene_transforms* transforms, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(transforms->nodes, host_allocator);
+	free_gltf_buffer(transforms->parents, host_allocator);
+	free_gltf_buffer(transforms->node_entries, host_allocator);
+	free_gltf_buffer(transforms->depth_offsets, host_allocator);
+	free_gltf_buffer(transforms->translations, host_allocator);
+	free_gltf_buffer(transforms->rotations, host_allocator);
+	free_gltf_buffer(transforms->scales, host_allocator);
+	free_gltf_buffer(transforms->world_matrices, host_allocator);
+	free_gltf_buffer(transforms->dirty, host_allocator);
+	*transforms = {};
+}
+
+// Cached keys are walked forward this many times before searching, so playback steps in O(1) and jumps stay O(log n).
+#define ANIMATION_CURSOR_STEPS 4
+// Slerp weights sin(t * angle) / sin(angle) as polynomials in t and cos(angle) (Eberly, A Fast and Accurate Algorithm for Computing SLERP),
+// close to float precision for the shorter arc without any trigonometry.
+#define SLERP_ONE_PLUS_MU 1.90110745351730037f
+static const float slerp_u[8]{ 1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9), 1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15),
+	SLERP_ONE_PLUS_MU / (8 * 17) };
+static const float slerp_v[8]{ 1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9, 5.0f / 11, 6.0f / 13, 7.0f / 15, SLERP_ONE_PLUS_MU * 8 / 17 };
+
+// Grows a stream geometrically so appending every channel stays linear.
+template<typename T>
+static void reserve_more(temp_data_view<T>& view, size_t count)
+{
+	size_t needed = view.data_length + count;
+	if (needed > view.data_capacity)
+		view.reserve(needed > view.data_capacity * 2 ? needed : view.data_capacity * 2);
+}
+
+bool acp_vulkan::gltf_animation_clip_build(const gltf_data* gltf_data, uint32_t animation_index, VkAllocationCallbacks* host_allocator, gltf_animation_clip* out)
+{
+	typedef gltf_data::animation::channel::target_type::path_type path_type;
+	typedef gltf_data::animation::sampler::interpolation_type interpolation_type;
+
+	*out = {};
+	if (animation_index >= gltf_data->animations.data_length)
+		return false;
+	const gltf_data::animation& animation = gltf_data->animations.data[animation_index];
+
+	temp_data_view<gltf_animation_clip::channel> channels{};
+	temp_data_view<float> times{}, values{};
+	channels.host_allocator = host_allocator;
+	times.host_allocator = host_allocator;
+	values.host_allocator = host_allocator;
+	// Samplers sharing an input accessor share their times.
+	std::map<uint32_t, uint32_t> input_times;
+	uint32_t output_count = 0;
+	float duration = 0.0f;
+
+	for (size_t ii = 0; ii < animation.channels.data_length; ++ii)
+	{
+		const gltf_data::animation::channel& source = animation.channels.data[ii];
+		if (source.sampler >= animation.samplers.data_length || source.target.node >= gltf_data->nodes.data_length)
+			return false;
+		const gltf_data::animation::sampler& sampler = animation.samplers.data[source.sampler];
+		if (sampler.input >= gltf_data->accesors.data_length || sampler.output >= gltf_data->accesors.data_length)
+			return false;
+
+		// The times are read in to key_count floats, a wider input accessor would write past them.
+		uint32_t key_count = gltf_data->accesors.data[sampler.input].count;
+		if (gltf_accessor_read_size(gltf_data, sampler.input, VK_FORMAT_R32_SFLOAT) != size_t(key_count) * sizeof(float))
+			return false;
+		size_t value_count = gltf_accessor_read_size(gltf_data, sampler.output, VK_FORMAT_R32_SFLOAT) / sizeof(float);
+		uint32_t per_key = sampler.interpolation == interpolation_type::CUBICSPLINE ? 3 : 1;
+		if (!key_count || !value_count || value_count % (size_t(key_count) * per_key))
+			return false;
+
+		uint32_t component_count = uint32_t(value_count / (size_t(key_count) * per_key));
+		if ((source.target.path == path_type::rotation && component_count != 4) ||
+			((source.target.path == path_type::translation || source.target.path == path_type::scale) && component_count != 3))
+			return false;
+
+		auto found = input_times.find(sampler.input);
+		uint32_t first_time = found != input_times.end() ? found->second : uint32_t(times.data_length);
+		if (found == input_times.end())
+		{
+			reserve_more(times, key_count);
+			if (!gltf_accessor_read(gltf_data, sampler.input, VK_FORMAT_R32_SFLOAT, times.data + times.data_length))
+				return false;
+			times.data_length += key_count;
+			input_times[sampler.input] = first_time;
+		}
+		duration = fmaxf(duration, times.data[first_time + key_count - 1]);
+
+		// The accessor holds key after key, the clip one stream per component (and per tangent with CUBICSPLINE).
+		temp_data_view<float> interleaved{};
+		mesh_scratch(interleaved, value_count, host_allocator);
+		if (!gltf_accessor_read(gltf_data, sampler.output, VK_FORMAT_R32_SFLOAT, interleaved.data))
+			return false;
+		uint32_t first_value = uint32_t(values.data_length);
+		uint32_t stream_count = component_count * per_key;
+		reserve_more(values, value_count);
+		for (uint32_t stream = 0; stream < stream_count; ++stream)
+			for (uint32_t key = 0; key < key_count; ++key)
+				values.data[first_value + size_t(stream) * key_count + key] = interleaved.data[size_t(key) * stream_count + stream];
+		values.data_length += value_count;
+
+		channels.emplace_back(gltf_animation_clip::channel{
+			.node = source.target.node,
+			.path = source.target.path,
+			.interpolation = sampler.interpolation,
+			.component_count = component_count,
+			.key_count = key_count,
+			.first_time = first_time,
+			.first_value = first_value,
+			.first_output = output_count,
+		});
+		output_count += component_count;
+	}
+
+	// Rotations are sampled per channel, every other component on its own, linear (and step) ones first so cubic ones group together.
+	temp_data_view<uint32_t> rotations{};
+	temp_data_view<gltf_animation_clip::track> tracks{};
+	rotations.host_allocator = host_allocator;
+	tracks.host_allocator = host_allocator;
+	uint32_t cubic_rotations = 0, cubic_tracks = 0;
+	for (uint32_t cubic = 0; cubic < 2; ++cubic)
+	{
+		if (cubic)
+		{
+			cubic_rotations = uint32_t(rotations.data_length);
+			cubic_tracks = uint32_t(tracks.data_length);
+		}
+		for (uint32_t ii = 0; ii < uint32_t(channels.data_length); ++ii)
+		{
+			const gltf_animation_clip::channel& channel = channels.data[ii];
+			if ((channel.interpolation == interpolation_type::CUBICSPLINE) != bool(cubic))
+				continue;
+			if (channel.path == path_type::rotation)
+				rotations.emplace_back(uint32_t(ii));
+			else
+				for (uint32_t component = 0; component < channel.component_count; ++component)
+					tracks.emplace_back(gltf_animation_clip::track{
+						.channel = ii,
+						.stream = channel.first_value + (cubic ? channel.component_count + component : component) * channel.key_count,
+						.output = channel.first_output + component,
+					});
+		}
+	}
+
+	out->channels = channels.to();
+	out->times = times.to();
+	out->values = values.to();
+	out->rotations = rotations.to();
+	out->tracks = tracks.to();
+	out->cubic_rotations = cubic_rotations;
+	out->cubic_tracks = cubic_tracks;
+	out->output_count = output_count;
+	out->duration = duration;
+	return true;
+}
+
+void acp_vulkan::gltf_animation_clip_free(gltf_animation_clip* clip, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(clip->channels, host_allocator);
+	free_gltf_buffer(clip->times, host_allocator);
+	free_gltf_buffer(clip->values, host_allocator);
+	free_gltf_buffer(clip->rotations, host_allocator);
+	free_gltf_buffer(clip->tracks, host_allocator);
+	*clip = {};
+}
+
+void acp_vulkan::gltf_animation_cursor_init(const gltf_animation_clip* clip, VkAllocationCallbacks* host_allocator, gltf_animation_cursor* out)
+{
+	size_t channel_count = clip->channels.data_length;
+	temp_data_view<uint32_t> keys{};
+	temp_data_view<float> factors{};
+	memset(mesh_scratch(keys, channel_count, host_allocator), 0, channel_count * sizeof(uint32_t));
+	mesh_scratch(factors, channel_count * 2, host_allocator);
+	out->keys = keys.to();
+	out->factors = factors.to();
+}
+
+void acp_vulkan::gltf_animation_cursor_free(gltf_animation_cursor* cursor, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(cursor->keys, host_allocator);
+	free_gltf_buffer(cursor->factors, host_allocator);
+	*cursor = {};
+}
+
+// Finds the key before time for every channel and the factor between it and the next one, STEP channels stay on the key.
+static void advance_animation_cursor(const acp_vulkan::gltf_animation_clip* clip, float time, acp_vulkan::gltf_animation_cursor* cursor)
+{
+	for (size_t ii = 0; ii < clip->channels.data_length; ++ii)
+	{
+		const acp_vulkan::gltf_animation_clip::channel& channel = clip->channels.data[ii];
+		const float* times = clip->times.data + channel.first_time;
+		uint32_t key = cursor->keys.data[ii] < channel.key_count ? cursor->keys.data[ii] : 0;
+
+		uint32_t steps = 0;
+		if (time >= times[key])
+			while (key + 1 < channel.key_count && times[key + 1] <= time && steps++ < ANIMATION_CURSOR_STEPS)
+				++key;
+		if (time < times[key] || (key + 1 < channel.key_count && times[key + 1] <= time))
+		{
+			const float* after = std::upper_bound(times, times + channel.key_count, time);
+			key = after == times ? 0 : uint32_t(after - times - 1);
+		}
+		cursor->keys.data[ii] = key;
+
+		float factor = 0.0f, delta = 0.0f;
+		if (key + 1 < channel.key_count)
+		{
+			delta = times[key + 1] - times[key];
+			factor = delta > 0.0f ? fminf(fmaxf((time - times[key]) / delta, 0.0f), 1.0f) : 0.0f;
+		}
+		if (channel.interpolation == acp_vulkan::gltf_data::animation::sampler::interpolation_type::STEP)
+			factor = 0.0f;
+		cursor->factors.data[ii * 2 + 0] = factor;
+		cursor->factors.data[ii * 2 + 1] = delta;
+	}
+}
+
+// Values of one lane: component streams of a channel at the cursor key and the one after it.
+struct animation_lane
+{
+	const float* stream;
+	uint32_t key;
+	uint32_t next_key;
+	uint32_t key_count;
+	uint32_t component_count;
+	float factor;
+	float delta;
+};
+
+static animation_lane animation_lane_for(const acp_vulkan::gltf_animation_clip* clip, const acp_vulkan::gltf_animation_cursor* cursor, uint32_t channel_index)
+{
+	const acp_vulkan::gltf_animation_clip::channel& channel = clip->channels.data[channel_index];
+	uint32_t key = cursor->keys.data[channel_index];
+	return {
+		.stream = clip->values.data + channel.first_value,
+		.key = key,
+		.next_key = key + 1 < channel.key_count ? key + 1 : key,
+		.key_count = channel.key_count,
+		.component_count = channel.component_count,
+		.factor = cursor->factors.data[channel_index * 2 + 0],
+		.delta = cursor->factors.data[channel_index * 2 + 1],
+	};
+}
+
+// Hermite weights of the value before, its out tangent, the value after and its in tangent.
+static void hermite_weights(float t, float delta, float* out)
+{
+	float t2 = t * t, t3 = t2 * t;
+	out[0] = 2.0f * t3 - 3.0f * t2 + 1.0f;
+	out[1] = (t3 - 2.0f * t2 + t) * delta;
+	out[2] = -2.0f * t3 + 3.0f * t2;
+	out[3] = (t3 - t2) * delta;
+}
+
+// Linear (cubic) lanes read the value before and after (and the tangents) of one component.
+static void gather_animation_lane(const animation_lane& lane, uint32_t component, bool cubic, float* out)
+{
+	if (!cubic)
+	{
+		const float* stream = lane.stream + size_t(component) * lane.key_count;
+		out[0] = stream[lane.key];
+		out[1] = stream[lane.next_key];
+		return;
+	}
+	const float* in_tangents = lane.stream + size_t(component) * lane.key_count;
+	const float* values = lane.stream + size_t(lane.component_count + component) * lane.key_count;
+	const float* out_tangents = lane.stream + size_t(2 * lane.component_count + component) * lane.key_count;
+	out[0] = values[lane.key];
+	out[1] = out_tangents[lane.key];
+	out[2] = values[lane.next_key];
+	out[3] = in_tangents[lane.next_key];
+}
+
+// Same for a track, its value stream is known up front and the tangent streams are component_count streams before and after it.
+static void gather_animation_track(const acp_vulkan::gltf_animation_clip* clip, const acp_vulkan::gltf_animation_clip::track& track, const animation_lane& lane,
+	bool cubic, float* out)
+{
+	const float* values = clip->values.data + track.stream;
+	out[0] = values[lane.key];
+	if (!cubic)
+	{
+		out[1] = values[lane.next_key];
+		return;
+	}
+	size_t tangent_offset = size_t(lane.component_count) * lane.key_count;
+	out[1] = values[tangent_offset + lane.key];
+	out[2] = values[lane.next_key];
+	out[3] = *(values - tangent_offset + lane.next_key);
+}
+
+// cosine of the shorter arc, at least 0.
+static float slerp_weight(float cosine, float t)
+{
+	float t2 = t * t;
+	float weight = 1.0f;
+	for (uint32_t ii = 8; ii > 0; --ii)
+		weight = 1.0f + (slerp_u[ii - 1] * t2 - slerp_v[ii - 1]) * (cosine - 1.0f) * weight;
+	return t * weight;
+}
+
+typedef void (*sample_rotations_type)(const acp_vulkan::gltf_animation_clip* clip, const acp_vulkan::gltf_animation_cursor* cursor, uint32_t first, uint32_t count,
+	bool cubic, bool nlerp, float* out);
+
+// Tracks stay scalar, one multiply add per value does not pay for gathering four of them in to a register.
+static void sample_animation_tracks(const acp_vulkan::gltf_animation_clip* clip, const acp_vulkan::gltf_animation_cursor* cursor, uint32_t first, uint32_t count,
+	bool cubic, float* out)
+{
+	for (uint32_t ii = first; ii < first + count; ++ii)
+	{
+		const acp_vulkan::gltf_animation_clip::track& track = clip->tracks.data[ii];
+		animation_lane lane = animation_lane_for(clip, cursor, track.channel);
+		float keys[4];
+		gather_animation_track(clip, track, lane, cubic, keys);
+		float* target = out + track.output;
+		if (!cubic)
+		{
+			*target = keys[0] + (keys[1] - keys[0]) * lane.factor;
+			continue;
+		}
+		float weights[4];
+		hermite_weights(lane.factor, lane.delta, weights);
+		*target = weights[0] * keys[0] + weights[1] * keys[1] + weights[2] * keys[2] + weights[3] * keys[3];
+	}
+}
+
+static void sample_rotations_scalar(const acp_vulkan::gltf_animation_clip* clip, const acp_vulkan::gltf_animation_cursor* cursor, uint32_t first, uint32_t count,
+	bool cubic, bool nlerp, float* out)
+{
+	for (uint32_t ii = first; ii < first + count; ++ii)
+	{
+		uint32_t channel = clip->rotations.data[ii];
+		animation_lane lane = animation_lane_for(clip, cursor, channel);
+		float keys[4][4];
+		for (uint32_t component = 0; component < 4; ++component)
+			gather_animation_lane(lane, component, cubic, keys[component]);
+
+		float rotation[4];
+		if (cubic)
+		{
+			float weights[4];
+			hermite_weights(lane.factor, lane.delta, weights);
+			for (uint32_t component = 0; component < 4; ++component)
+				rotation[component] = weights[0] * keys[component][0] + weights[1] * keys[component][1] + weights[2] * keys[component][2] + weights[3] * keys[component][3];
+		}
+		else
+		{
+			// The shorter way round.
+			float cosine = keys[0][0] * keys[0][1] + keys[1][0] * keys[1][1] + keys[2][0] * keys[2][1] + keys[3][0] * keys[3][1];
+			float sign = cosine < 0.0f ? -1.0f : 1.0f;
+			float weights[2]{ 1.0f - lane.factor, lane.factor };
+			if (!nlerp)
+			{
+				weights[0] = slerp_weight(cosine * sign, 1.0f - lane.factor);
+				weights[1] = slerp_weight(cosine * sign, lane.factor);
+			}
+			for (uint32_t component = 0; component < 4; ++component)
+				rotation[component] = weights[0] * keys[component][0] + weights[1] * sign * keys[component][1];
+		}
+
+		float length = sqrtf(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		float* target = out + clip->channels.data[channel].first_output;
+		for (uint32_t component = 0; component < 4; ++component)
+			target[component] = rotation[component] * scale;
+	}
+}
+
+#if ACP_GLTF_X86
+// Four rotation channels per iteration, one register per quaternion component.
+static void sample_rotations_sse2(const acp_vulkan::gltf_animation_clip* clip, const acp_vulkan::gltf_animation_cursor* cursor, uint32_t first, uint32_t count,
+	bool cubic, bool nlerp, float* out)
+{
+	uint32_t ii = first;
+	for (; ii + 4 <= first + count; ii += 4)
+	{
+		// Lane major and put together with set, a wide load of four narrow stores would stall on store forwarding.
+		float keys[4][4][4];
+		animation_lane lanes[4];
+		for (uint32_t lane_index = 0; lane_index < 4; ++lane_index)
+		{
+			lanes[lane_index] = animation_lane_for(clip, cursor, clip->rotations.data[ii + lane_index]);
+			for (uint32_t component = 0; component < 4; ++component)
+				gather_animation_lane(lanes[lane_index], component, cubic, keys[lane_index][component]);
+		}
+#define ROTATION_KEY(component, jj) _mm_setr_ps(keys[0][component][jj], keys[1][component][jj], keys[2][component][jj], keys[3][component][jj])
+
+		__m128 t = _mm_setr_ps(lanes[0].factor, lanes[1].factor, lanes[2].factor, lanes[3].factor);
+		__m128 rotation[4];
+		if (cubic)
+		{
+			__m128 t2 = _mm_mul_ps(t, t), t3 = _mm_mul_ps(t2, t);
+			__m128 delta = _mm_setr_ps(lanes[0].delta, lanes[1].delta, lanes[2].delta, lanes[3].delta);
+			__m128 two = _mm_set1_ps(2.0f), three = _mm_set1_ps(3.0f);
+			__m128 h00 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(two, t3), _mm_mul_ps(three, t2)), _mm_set1_ps(1.0f));
+			__m128 h10 = _mm_mul_ps(_mm_add_ps(_mm_sub_ps(t3, _mm_mul_ps(two, t2)), t), delta);
+			__m128 h01 = _mm_sub_ps(_mm_mul_ps(three, t2), _mm_mul_ps(two, t3));
+			__m128 h11 = _mm_mul_ps(_mm_sub_ps(t3, t2), delta);
+			for (uint32_t component = 0; component < 4; ++component)
+				rotation[component] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h00, ROTATION_KEY(component, 0)), _mm_mul_ps(h10, ROTATION_KEY(component, 1))),
+					_mm_add_ps(_mm_mul_ps(h01, ROTATION_KEY(component, 2)), _mm_mul_ps(h11, ROTATION_KEY(component, 3))));
+		}
+		else
+		{
+			__m128 before[4], after[4];
+			__m128 cosine = _mm_setzero_ps();
+			for (uint32_t component = 0; component < 4; ++component)
+			{
+				before[component] = ROTATION_KEY(component, 0);
+				after[component] = ROTATION_KEY(component, 1);
+				cosine = _mm_add_ps(cosine, _mm_mul_ps(before[component], after[component]));
+			}
+			// Flip the sign bit of the second quaternion where the cosine is negative to take the shorter way round.
+			__m128 sign = _mm_and_ps(cosine, _mm_set1_ps(-0.0f));
+			__m128 w0 = _mm_sub_ps(_mm_set1_ps(1.0f), t), w1 = t;
+			if (!nlerp)
+			{
+				__m128 one = _mm_set1_ps(1.0f);
+				__m128 cosine_minus_one = _mm_sub_ps(_mm_xor_ps(cosine, sign), one);
+				__m128 s2 = _mm_mul_ps(w0, w0), t2 = _mm_mul_ps(t, t);
+				__m128 weight0 = one, weight1 = one;
+				for (uint32_t jj = 8; jj > 0; --jj)
+				{
+					__m128 u = _mm_set1_ps(slerp_u[jj - 1]), v = _mm_set1_ps(slerp_v[jj - 1]);
+					weight0 = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, s2), v), cosine_minus_one), weight0));
+					weight1 = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, t2), v), cosine_minus_one), weight1));
+				}
+				w0 = _mm_mul_ps(w0, weight0);
+				w1 = _mm_mul_ps(w1, weight1);
+			}
+			w1 = _mm_xor_ps(w1, sign);
+			for (uint32_t component = 0; component < 4; ++component)
+				rotation[component] = _mm_add_ps(_mm_mul_ps(w0, before[component]), _mm_mul_ps(w1, after[component]));
+		}
+#undef ROTATION_KEY
+
+		__m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rotation[0], rotation[0]), _mm_mul_ps(rotation[1], rotation[1])),
+			_mm_add_ps(_mm_mul_ps(rotation[2], rotation[2]), _mm_mul_ps(rotation[3], rotation[3])));
+		__m128 length = _mm_sqrt_ps(length_squared);
+		__m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), length), _mm_cmpgt_ps(length, _mm_setzero_ps()));
+		alignas(16) float result[4][4];
+		for (uint32_t component = 0; component < 4; ++component)
+			_mm_store_ps(result[component], _mm_mul_ps(rotation[component], scale));
+		for (uint32_t lane_index = 0; lane_index < 4; ++lane_index)
+		{
+			float* target = out + clip->channels.data[clip->rotations.data[ii + lane_index]].first_output;
+			for (uint32_t component = 0; component < 4; ++component)
+				target[component] = result[component][lane_index];
+		}
+	}
+	sample_rotations_scalar(clip, cursor, ii, first + count - ii, cubic, nlerp, out);
+}
+#endif
+
+static sample_rotations_type sample_rotations_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend != acp_vulkan::gltf_scan_backend::scalar)
+		return sample_rotations_sse2;
+#endif
+	return sample_rotations_scalar;
+}
+
+static void sample_animation_clip(const acp_vulkan::gltf_animation_clip* clip, float time, acp_vulkan::gltf_animation_cursor* cursor, float* out,
+	acp_vulkan::gltf_animation_flags animation_flags, sample_rotations_type sample_rotations)
+{
+	advance_animation_cursor(clip, time, cursor);
+	bool nlerp = animation_flags & acp_vulkan::gltf_animation_nlerp;
+	uint32_t track_count = uint32_t(clip->tracks.data_length);
+	uint32_t rotation_count = uint32_t(clip->rotations.data_length);
+	sample_animation_tracks(clip, cursor, 0, clip->cubic_tracks, false, out);
+	sample_animation_tracks(clip, cursor, clip->cubic_tracks, track_count - clip->cubic_tracks, true, out);
+	sample_rotations(clip, cursor, 0, clip->cubic_rotations, false, nlerp, out);
+	sample_rotations(clip, cursor, clip->cubic_rotations, rotation_count - clip->cubic_rotations, true, nlerp, out);
+}
+
+void acp_vulkan::gltf_animation_clip_sample(const gltf_animation_clip* clip, float time, gltf_animation_cursor* cursor, float* out, gltf_animation_flags animation_flags)
+{
+	gltf_scan_backend backend = resolve_scan_backend(requested_scan_backend);
+	sample_animation_clip(clip, time, cursor, out, animation_flags, sample_rotations_for(backend));
+}
+
+// Instances handed to one job, enough to amortize the job overhead.
+#define ANIMATION_INSTANCES_PER_JOB 64
+
+struct animation_sample_job
+{
+	const acp_vulkan::gltf_animation_instance* instances;
+	uint32_t instance_count;
+	acp_vulkan::gltf_animation_flags animation_flags;
+	sample_rotations_type sample_rotations;
+};
+
+static void sample_animation_instances_job(void* job_data, size_t job_index)
+{
+	animation_sample_job* job = reinterpret_cast<animation_sample_job*>(job_data);
+	size_t end = (job_index + 1) * ANIMATION_INSTANCES_PER_JOB < job->instance_count ? (job_index + 1) * ANIMATION_INSTANCES_PER_JOB : job->instance_count;
+	for (size_t ii = job_index * ANIMATION_INSTANCES_PER_JOB; ii < end; ++ii)
+	{
+		const acp_vulkan::gltf_animation_instance& instance = job->instances[ii];
+		sample_animation_clip(instance.clip, instance.time, instance.cursor, instance.out, job->animation_flags, job->sample_rotations);
+	}
+}
+
+void acp_vulkan::gltf_animation_sample_instances(const gltf_animation_instance* instances, uint32_t instance_count, gltf_animation_flags animation_flags)
+{
+	gltf_scan_backend backend = resolve_scan_backend(requested_scan_backend);
+	animation_sample_job job{
+		.instances = instances,
+		.instance_count = instance_count,
+		.animation_flags = animation_flags,
+		.sample_rotations = sample_rotations_for(backend),
+	};
+	size_t job_count = (size_t(instance_count) + ANIMATION_INSTANCES_PER_JOB - 1) / ANIMATION_INSTANCES_PER_JOB;
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((animation_flags & gltf_animation_parallel_instances) && job_count > 1 && has_workers)
+		run_parsing_jobs(sample_animation_instances_job, &job, job_count);
+	else
+		for (size_t ii = 0; ii < job_count; ++ii)
+			sample_animation_instances_job(&job, ii);
+}
+
+void acp_vulkan::gltf_animation_clip_apply(const gltf_animation_clip* clip, const float* sampled, gltf_scene_transforms* transforms)
+{
+	typedef gltf_data::animation::channel::target_type::path_type path_type;
+	for (size_t ii = 0; ii < clip->channels.data_length; ++ii)
+	{
+		const gltf_animation_clip::channel& channel = clip->channels.data[ii];
+		const float* value = sampled + channel.first_output;
+		switch (channel.path)
+		{
+		case path_type::translation: gltf_scene_transforms_set_local(transforms, channel.node, value, nullptr, nullptr); break;
+		case path_type::rotation: gltf_scene_transforms_set_local(transforms, channel.node, nullptr, value, nullptr); break;
+		case path_type::scale: gltf_scene_transforms_set_local(transforms, channel.node, nullptr, nullptr, value); break;
+		default: break;
+		}
+	}
+}
+
+// Floats per joint matrix of a gltf_skin_palette.
+#define SKIN_PALETTE_STRIDE 12
+// Vertices handed to one job.
+#define SKINNING_VERTICES_PER_JOB 4096
+
+bool acp_vulkan::gltf_skin_palette_build(const gltf_data* gltf_data, uint32_t skin, const gltf_scene_transforms* transforms, VkAllocationCallbacks* host_allocator,
+	gltf_skin_palette* out)
+{
+	*out = {};
+	if (skin >= gltf_data->skins.data_length)
+		return false;
+	const gltf_data::skin& source = gltf_data->skins.data[skin];
+	uint32_t joint_count = uint32_t(source.joints.data_length);
+
+	temp_data_view<uint32_t> joint_entries{};
+	mesh_scratch(joint_entries, joint_count, host_allocator);
+	for (uint32_t ii = 0; ii < joint_count; ++ii)
+	{
+		uint32_t node = source.joints.data[ii];
+		if (node >= transforms->node_entries.data_length || transforms->node_entries.data[node] == UINT32_MAX)
+			return false;
+		joint_entries.data[ii] = transforms->node_entries.data[node];
+	}
+
+	temp_data_view<float> inverse_bind_matrices{}, matrices{};
+	mesh_scratch(inverse_bind_matrices, size_t(joint_count) * 16, host_allocator);
+	mesh_scratch(matrices, size_t(joint_count) * SKIN_PALETTE_STRIDE, host_allocator);
+	if (source.has_inverse_bind_matrices)
+	{
+		if (gltf_accessor_read_size(gltf_data, source.inverse_bind_matrices, VK_FORMAT_R32_SFLOAT) != size_t(joint_count) * 16 * sizeof(float) ||
+			!gltf_accessor_read(gltf_data, source.inverse_bind_matrices, VK_FORMAT_R32_SFLOAT, inverse_bind_matrices.data))
+			return false;
+	}
+	else
+		for (uint32_t ii = 0; ii < joint_count; ++ii)
+			memcpy(inverse_bind_matrices.data + size_t(ii) * 16, identity_matrix, sizeof(identity_matrix));
+
+	out->joint_count = joint_count;
+	out->joint_entries = joint_entries.to();
+	out->inverse_bind_matrices = inverse_bind_matrices.to();
+	out->matrices = matrices.to();
+	gltf_skin_palette_update(out, transforms);
+	return true;
+}
+
+void acp_vulkan::gltf_skin_palette_update(gltf_skin_palette* palette, const gltf_scene_transforms* transforms)
+{
+	uint32_t entry_count = transforms->entry_count;
+	for (uint32_t joint = 0; joint < palette->joint_count; ++joint)
+	{
+		uint32_t entry = palette->joint_entries.data[joint];
+		float world[16];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+			world[ii] = TRANSFORM_COMPONENT(transforms->world_matrices.data, ii, entry, entry_count);
+		const float* inverse_bind = palette->inverse_bind_matrices.data + size_t(joint) * 16;
+		float* rows = palette->matrices.data + size_t(joint) * SKIN_PALETTE_STRIDE;
+		for (uint32_t row = 0; row < 3; ++row)
+			for (uint32_t column = 0; column < 4; ++column)
+				rows[row * 4 + column] = world[row] * inverse_bind[column * 4 + 0] + world[4 + row] * inverse_bind[column * 4 + 1] +
+					world[8 + row] * inverse_bind[column * 4 + 2] + world[12 + row] * inverse_bind[column * 4 + 3];
+	}
+}
+
+void acp_vulkan::gltf_skin_palette_free(gltf_skin_palette* palette, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(palette->joint_entries, host_allocator);
+	free_gltf_buffer(palette->inverse_bind_matrices, host_allocator);
+	free_gltf_buffer(palette->matrices, host_allocator);
+	*palette = {};
+}
+
+bool acp_vulkan::gltf_skinning_layout_for(const gltf_mesh_buffers* mesh_buffers, gltf_skinning_layout* out)
+{
+	*out = {
+		.stride = mesh_buffers->vertex_stride,
+		.position = UINT32_MAX,
+		.normal = UINT32_MAX,
+		.tangent = UINT32_MAX,
+		.joints = UINT32_MAX,
+		.weights = UINT32_MAX,
+	};
+	for (size_t ii = 0; ii < mesh_buffers->attributes.data_length; ++ii)
+	{
+		const gltf_vertex_attribute& attribute = mesh_buffers->attributes.data[ii];
+		uint32_t offset = mesh_buffers->attribute_offsets.data[ii];
+		switch (attribute.attribute)
+		{
+		case gltf_data::attribute::POSITION:
+			if (attribute.format == VK_FORMAT_R32G32B32_SFLOAT)
+				out->position = offset;
+			break;
+		case gltf_data::attribute::NORMAL:
+			if (attribute.format != VK_FORMAT_R32G32B32_SFLOAT)
+				return false;
+			out->normal = offset;
+			break;
+		case gltf_data::attribute::TANGENT:
+			if (attribute.format != VK_FORMAT_R32G32B32A32_SFLOAT)
+				return false;
+			out->tangent = offset;
+			break;
+		case gltf_data::attribute::JOINTS_0:
+			if (attribute.format == VK_FORMAT_R16G16B16A16_UINT)
+				out->joints = offset;
+			break;
+		case gltf_data::attribute::WEIGHTS_0:
+			if (attribute.format == VK_FORMAT_R32G32B32A32_SFLOAT)
+				out->weights = offset;
+			break;
+		default:
+			break;
+		}
+	}
+	return out->stride && out->position != UINT32_MAX && out->joints != UINT32_MAX && out->weights != UINT32_MAX;
+}
+
+static void normalize_skinned(float* vector)
+{
+	float length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+	float scale = length > 0.0f ? 1.0f / length : 0.0f;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+		vector[ii] *= scale;
+}
+
+typedef void (*skin_vertices_type)(const acp_vulkan::gltf_skinning_layout& layout, const float* palette, uint32_t joint_count, const uint8_t* in, uint8_t* out,
+	uint32_t count);
+
+static void skin_vertices_scalar(const acp_vulkan::gltf_skinning_layout& layout, const float* palette, uint32_t joint_count, const uint8_t* in, uint8_t* out,
+	uint32_t count)
+{
+	for (uint32_t ii = 0; ii < count; ++ii, in += layout.stride, out += layout.stride)
+	{
+		memcpy(out, in, layout.stride);
+		uint16_t joints[4];
+		float weights[4];
+		memcpy(joints, in + layout.joints, sizeof(joints));
+		memcpy(weights, in + layout.weights, sizeof(weights));
+		float blended[SKIN_PALETTE_STRIDE]{};
+		for (uint32_t jj = 0; jj < 4; ++jj)
+		{
+			// Selects instead of branches, zero weights are common and would mispredict.
+			bool in_palette = joints[jj] < joint_count;
+			float weight = in_palette ? weights[jj] : 0.0f;
+			const float* joint = palette + size_t(in_palette ? joints[jj] : 0) * SKIN_PALETTE_STRIDE;
+			for (uint32_t kk = 0; kk < SKIN_PALETTE_STRIDE; ++kk)
+				blended[kk] += weight * joint[kk];
+		}
+
+		float position[3], skinned[3];
+		memcpy(position, in + layout.position, sizeof(position));
+		for (uint32_t row = 0; row < 3; ++row)
+			skinned[row] = blended[row * 4 + 0] * position[0] + blended[row * 4 + 1] * position[1] + blended[row * 4 + 2] * position[2] + blended[row * 4 + 3];
+		memcpy(out + layout.position, skinned, sizeof(skinned));
+		// Normals and tangents only rotate and scale, the renormalization covers the scale.
+		uint32_t directions[2]{ layout.normal, layout.tangent };
+		for (uint32_t offset : directions)
+		{
+			if (offset == UINT32_MAX)
+				continue;
+			float direction[3];
+			memcpy(direction, in + offset, sizeof(direction));
+			for (uint32_t row = 0; row < 3; ++row)
+				skinned[row] = blended[row * 4 + 0] * direction[0] + blended[row * 4 + 1] * direction[1] + blended[row * 4 + 2] * direction[2];
+			normalize_skinned(skinned);
+			memcpy(out + offset, skinned, sizeof(skinned));
+		}
+	}
+}
+
+#if ACP_GLTF_X86
+// The rows of the four joints are blended in registers, transposed in to columns and every attribute is a sum of columns scaled by its components.
+static void skin_vertices_sse2(const acp_vulkan::gltf_skinning_layout& layout, const float* palette, uint32_t joint_count, const uint8_t* in, uint8_t* out,
+	uint32_t count)
+{
+	for (uint32_t ii = 0; ii < count; ++ii, in += layout.stride, out += layout.stride)
+	{
+		memcpy(out, in, layout.stride);
+		uint16_t joints[4];
+		float weights[4];
+		memcpy(joints, in + layout.joints, sizeof(joints));
+		memcpy(weights, in + layout.weights, sizeof(weights));
+		__m128 column0 = _mm_setzero_ps(), column1 = _mm_setzero_ps(), column2 = _mm_setzero_ps(), column3 = _mm_setzero_ps();
+		for (uint32_t jj = 0; jj < 4; ++jj)
+		{
+			bool in_palette = joints[jj] < joint_count;
+			const float* joint = palette + size_t(in_palette ? joints[jj] : 0) * SKIN_PALETTE_STRIDE;
+			__m128 weight = _mm_set1_ps(in_palette ? weights[jj] : 0.0f);
+			column0 = _mm_add_ps(column0, _mm_mul_ps(weight, _mm_loadu_ps(joint + 0)));
+			column1 = _mm_add_ps(column1, _mm_mul_ps(weight, _mm_loadu_ps(joint + 4)));
+			column2 = _mm_add_ps(column2, _mm_mul_ps(weight, _mm_loadu_ps(joint + 8)));
+		}
+		_MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+
+		float position[3];
+		alignas(16) float skinned[4];
+		memcpy(position, in + layout.position, sizeof(position));
+		_mm_store_ps(skinned, _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(position[0])), _mm_mul_ps(column1, _mm_set1_ps(position[1]))),
+			_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(position[2])), column3)));
+		memcpy(out + layout.position, skinned, sizeof(float) * 3);
+		uint32_t directions[2]{ layout.normal, layout.tangent };
+		for (uint32_t offset : directions)
+		{
+			if (offset == UINT32_MAX)
+				continue;
+			float direction[3];
+			memcpy(direction, in + offset, sizeof(direction));
+			__m128 rotated = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(direction[0])), _mm_mul_ps(column1, _mm_set1_ps(direction[1]))),
+				_mm_mul_ps(column2, _mm_set1_ps(direction[2])));
+			// The fourth lane is 0 so it does not add to the length.
+			__m128 length_squared = _mm_mul_ps(rotated, rotated);
+			length_squared = _mm_add_ps(length_squared, _mm_shuffle_ps(length_squared, length_squared, _MM_SHUFFLE(2, 3, 0, 1)));
+			length_squared = _mm_add_ps(length_squared, _mm_shuffle_ps(length_squared, length_squared, _MM_SHUFFLE(1, 0, 3, 2)));
+			__m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared)), _mm_cmpgt_ps(length_squared, _mm_setzero_ps()));
+			_mm_store_ps(skinned, _mm_mul_ps(rotated, scale));
+			memcpy(out + offset, skinned, sizeof(float) * 3);
+		}
+	}
+}
+#endif
+
+static skin_vertices_type skin_vertices_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend != acp_vulkan::gltf_scan_backend::scalar)
+		return skin_vertices_sse2;
+#endif
+	return skin_vertices_scalar;
+}
+
+struct skinning_job
+{
+	const acp_vulkan::gltf_mesh_buffers* mesh_buffers;
+	const acp_vulkan::gltf_skinning_instance* instances;
+	uint32_t instance_count;
+	// First job of every instance, followed by the job count.
+	const uint32_t* first_jobs;
+	acp_vulkan::gltf_skinning_layout layout;
+	skin_vertices_type skin_vertices;
+};
+
+static void skin_vertices_job(void* job_data, size_t job_index)
+{
+	skinning_job* job = reinterpret_cast<skinning_job*>(job_data);
+	uint32_t instance_index = uint32_t(std::upper_bound(job->first_jobs, job->first_jobs + job->instance_count + 1, uint32_t(job_index)) - job->first_jobs) - 1;
+	const acp_vulkan::gltf_skinning_instance& instance = job->instances[instance_index];
+	const acp_vulkan::gltf_mesh_buffers::mesh_data& mesh = job->mesh_buffers->meshes.data[instance.mesh];
+
+	uint32_t first = (uint32_t(job_index) - job->first_jobs[instance_index]) * SKINNING_VERTICES_PER_JOB;
+	uint32_t count = mesh.vertex_count - first < SKINNING_VERTICES_PER_JOB ? mesh.vertex_count - first : SKINNING_VERTICES_PER_JOB;
+	size_t stride = job->layout.stride;
+	const uint8_t* source = instance.source ? instance.source : job->mesh_buffers->vertices.data + size_t(mesh.first_vertex) * stride;
+	job->skin_vertices(job->layout, instance.palette->matrices.data, instance.palette->joint_count, source + size_t(first) * stride, instance.out + size_t(first) * stride, count);
+}
+
+bool acp_vulkan::gltf_skin_vertices(const gltf_mesh_buffers* mesh_buffers, const gltf_skinning_instance* instances, uint32_t instance_count,
+	VkAllocationCallbacks* host_allocator, gltf_skinning_flags skinning_flags)
+{
+	gltf_skinning_layout layout;
+	if (!gltf_skinning_layout_for(mesh_buffers, &layout))
+		return false;
+
+	temp_data_view<uint32_t> first_jobs{};
+	mesh_scratch(first_jobs, size_t(instance_count) + 1, host_allocator);
+	uint32_t job_count = 0;
+	for (uint32_t ii = 0; ii < instance_count; ++ii)
+	{
+		if (!instances[ii].palette || !instances[ii].palette->joint_count || !instances[ii].out || instances[ii].mesh >= mesh_buffers->meshes.data_length)
+			return false;
+		first_jobs.data[ii] = job_count;
+		job_count += (mesh_buffers->meshes.data[instances[ii].mesh].vertex_count + SKINNING_VERTICES_PER_JOB - 1) / SKINNING_VERTICES_PER_JOB;
+	}
+	first_jobs.data[instance_count] = job_count;
+
+	skinning_job job{
+		.mesh_buffers = mesh_buffers,
+		.instances = instances,
+		.instance_count = instance_count,
+		.first_jobs = first_jobs.data,
+		.layout = layout,
+		.skin_vertices = skin_vertices_for(resolve_scan_backend(requested_scan_backend)),
+	};
+
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((skinning_flags & gltf_skinning_parallel_vertices) && job_count > 1 && has_workers)
+		run_parsing_jobs(skin_vertices_job, &job, job_count);
+	else
+		for (uint32_t ii = 0; ii < job_count; ++ii)
+			skin_vertices_job(&job, ii);
+	return true;
+}
+
+// Vertices of a dense target that have to move, as a fraction of the primitive, below which its deltas are kept sparse.
+#define MORPH_SPARSE_FRACTION 0.5f
+
+static const acp_vulkan::gltf_data::attribute morph_attributes[3]{
+	acp_vulkan::gltf_data::attribute::POSITION,
+	acp_vulkan::gltf_data::attribute::NORMAL,
+	acp_vulkan::gltf_data::attribute::TANGENT,
+};
+
+static uint32_t morph_target_accessor(const acp_vulkan::gltf_data::mesh::primitive_type::target& target, acp_vulkan::gltf_data::attribute attribute)
+{
+	for (size_t ii = 0; ii < target.attributes.data_length; ++ii)
+		if (target.attributes.data[ii].first == attribute)
+			return target.attributes.data[ii].second;
+	return UINT32_MAX;
+}
+
+// Reads the indices and deltas of a sparse accessor without a buffer view as they are, its other elements are zero deltas.
+static bool read_sparse_deltas(const acp_vulkan::gltf_data* gltf_data, const acp_vulkan::gltf_data::accesor& accessor, const accessor_layout& layout,
+	temp_data_view<uint32_t>& indices, temp_data_view<float>& deltas, uint32_t* out_count)
+{
+	sparse_source sparse{};
+	if (!sparse_source_for(gltf_data, accessor, layout, &sparse))
+		return false;
+
+	reserve_more(indices, sparse.count);
+	reserve_more(deltas, size_t(sparse.count) * 3);
+	uint32_t* span_indices = indices.data + indices.data_length;
+	widen_components_type widen_components = widen_components_for(acp_vulkan::gltf_get_scan_backend());
+	const widen_params index_params{ .source = sparse.index_size == 1 ? component_kind::u8 : component_kind::u16, .to_float = false, .scale = 1.0f, .clamp_to_minus_one = false };
+	if (sparse.index_size == 4)
+		memcpy(span_indices, sparse.indices, size_t(sparse.count) * sizeof(uint32_t));
+	else
+		widen_components(sparse.indices, sparse.count, index_params, reinterpret_cast<uint8_t*>(span_indices));
+	for (uint32_t ii = 0; ii < sparse.count; ++ii)
+		if (span_indices[ii] >= accessor.count)
+			return false;
+	convert_accessor_elements(layout, sparse.values, layout.element_size, sparse.count, reinterpret_cast<uint8_t*>(deltas.data + deltas.data_length));
+
+	indices.data_length += sparse.count;
+	deltas.data_length += size_t(sparse.count) * 3;
+	*out_count = sparse.count;
+	return true;
+}
+
+bool acp_vulkan::gltf_morph_targets_build(const gltf_data* gltf_data, const gltf_mesh_buffers* mesh_buffers, uint32_t mesh, VkAllocationCallbacks* host_allocator,
+	gltf_morph_targets* out)
+{
+	*out = {};
+	if (mesh >= gltf_data->meshes.data_length || mesh >= mesh_buffers->meshes.data_length || !mesh_buffers->vertex_stride)
+		return false;
+	const gltf_data::mesh& source = gltf_data->meshes.data[mesh];
+	const gltf_mesh_buffers::mesh_data& mesh_data = mesh_buffers->meshes.data[mesh];
+
+	uint32_t attribute_offsets[3]{ UINT32_MAX, UINT32_MAX, UINT32_MAX };
+	for (size_t ii = 0; ii < mesh_buffers->attributes.data_length; ++ii)
+		for (uint32_t slot = 0; slot < 3; ++slot)
+		{
+			const gltf_vertex_attribute& attribute = mesh_buffers->attributes.data[ii];
+			if (attribute.attribute != morph_attributes[slot])
+				continue;
+			VkFormat format = slot == 2 ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+			bool targeted = false;
+			for (size_t jj = 0; jj < source.primitives.data_length && !targeted; ++jj)
+				for (size_t kk = 0; kk < source.primitives.data[jj].targets.data_length && !targeted; ++kk)
+					targeted = morph_target_accessor(source.primitives.data[jj].targets.data[kk], attribute.attribute) != UINT32_MAX;
+			if (targeted && attribute.format != format)
+				return false;
+			attribute_offsets[slot] = mesh_buffers->attribute_offsets.data[ii];
+		}
+
+	uint32_t target_count = 0;
+	for (size_t ii = 0; ii < source.primitives.data_length; ++ii)
+		target_count = uint32_t(source.primitives.data[ii].targets.data_length) > target_count ? uint32_t(source.primitives.data[ii].targets.data_length) : target_count;
+
+	temp_data_view<gltf_morph_targets::span> spans{};
+	temp_data_view<uint32_t> target_spans{}, indices{};
+	temp_data_view<float> deltas{}, dense{};
+	spans.host_allocator = indices.host_allocator = deltas.host_allocator = dense.host_allocator = host_allocator;
+	mesh_scratch(target_spans, size_t(target_count) + 1, host_allocator);
+
+	for (uint32_t target = 0; target < target_count; ++target)
+	{
+		target_spans.data[target] = uint32_t(spans.data_length);
+		for (size_t primitive = 0; primitive < source.primitives.data_length; ++primitive)
+		{
+			const gltf_data::mesh::primitive_type& primitive_data = source.primitives.data[primitive];
+			if (target >= primitive_data.targets.data_length)
+				continue;
+			const gltf_mesh_buffers::draw_range* range = nullptr;
+			for (size_t ii = 0; ii < mesh_buffers->draw_ranges.data_length && !range; ++ii)
+				if (mesh_buffers->draw_ranges.data[ii].mesh == mesh && mesh_buffers->draw_ranges.data[ii].primitive == primitive)
+					range = mesh_buffers->draw_ranges.data + ii;
+			if (!range)
+				return false;
+			uint32_t first_vertex = uint32_t(range->vertex_offset) - mesh_data.first_vertex;
+
+			for (uint32_t slot = 0; slot < 3; ++slot)
+			{
+				uint32_t accessor_index = morph_target_accessor(primitive_data.targets.data[target], morph_attributes[slot]);
+				if (accessor_index == UINT32_MAX || attribute_offsets[slot] == UINT32_MAX)
+					continue;
+				if (accessor_index >= gltf_data->accesors.data_length)
+					return false;
+				const gltf_data::accesor& accessor = gltf_data->accesors.data[accessor_index];
+				accessor_layout layout;
+				if (accessor.count != range->vertex_count || !accessor_layout_for(accessor, VK_FORMAT_R32G32B32_SFLOAT, &layout) || layout.rows != 3 || layout.columns != 1)
+					return false;
+
+				gltf_morph_targets::span span{
+					.target = target,
+					.attribute = slot,
+					.first_index = uint32_t(indices.data_length),
+					.first_delta = uint32_t(deltas.data_length),
+				};
+				if (accessor.is_sparse && !accessor.has_buffer_view && !accessor.sparse_resolved_bytes.data)
+				{
+					if (!read_sparse_deltas(gltf_data, accessor, layout, indices, deltas, &span.index_count))
+						return false;
+				}
+				else
+				{
+					// Dense deltas usually leave most of the primitive in place, only the vertices that move are kept.
+					dense.data_length = 0;
+					reserve_more(dense, size_t(accessor.count) * 3);
+					if (!gltf_accessor_read(gltf_data, accessor_index, VK_FORMAT_R32G32B32_SFLOAT, dense.data))
+						return false;
+					uint32_t moved = 0, first_moved = UINT32_MAX, last_moved = 0;
+					for (uint32_t ii = 0; ii < accessor.count; ++ii)
+					{
+						const float* delta = dense.data + size_t(ii) * 3;
+						if (delta[0] == 0.0f && delta[1] == 0.0f && delta[2] == 0.0f)
+							continue;
+						++moved;
+						first_moved = first_moved == UINT32_MAX ? ii : first_moved;
+						last_moved = ii;
+					}
+					if (!moved)
+						continue;
+					if (float(moved) < MORPH_SPARSE_FRACTION * float(accessor.count))
+					{
+						reserve_more(indices, moved);
+						reserve_more(deltas, size_t(moved) * 3);
+						for (uint32_t ii = first_moved; ii <= last_moved; ++ii)
+						{
+							const float* delta = dense.data + size_t(ii) * 3;
+							if (delta[0] == 0.0f && delta[1] == 0.0f && delta[2] == 0.0f)
+								continue;
+							indices.data[indices.data_length++] = ii;
+							memcpy(deltas.data + deltas.data_length, delta, sizeof(float) * 3);
+							deltas.data_length += 3;
+						}
+						span.index_count = moved;
+					}
+					else
+					{
+						span.first_index = UINT32_MAX;
+						span.first_vertex = first_moved;
+						span.vertex_count = last_moved - first_moved + 1;
+						reserve_more(deltas, size_t(span.vertex_count) * 3);
+						memcpy(deltas.data + deltas.data_length, dense.data + size_t(first_moved) * 3, size_t(span.vertex_count) * 3 * sizeof(float));
+						deltas.data_length += size_t(span.vertex_count) * 3;
+					}
+				}
+
+				if (span.first_index != UINT32_MAX)
+				{
+					if (!span.index_count)
+						continue;
+					// Sparse indices are relative to the primitive until here, the span keeps them relative to the mesh.
+					uint32_t* span_indices = indices.data + span.first_index;
+					uint32_t lowest = UINT32_MAX, highest = 0;
+					for (uint32_t ii = 0; ii < span.index_count; ++ii)
+					{
+						span_indices[ii] += first_vertex;
+						lowest = span_indices[ii] < lowest ? span_indices[ii] : lowest;
+						highest = span_indices[ii] > highest ? span_indices[ii] : highest;
+					}
+					span.first_vertex = lowest;
+					span.vertex_count = highest - lowest + 1;
+				}
+				else
+					span.first_vertex += first_vertex;
+				spans.emplace_back(std::move(span));
+			}
+		}
+	}
+	target_spans.data[target_count] = uint32_t(spans.data_length);
+
+	out->mesh = mesh;
+	out->target_count = target_count;
+	out->vertex_count = mesh_data.vertex_count;
+	out->vertex_stride = mesh_buffers->vertex_stride;
+	memcpy(out->attribute_offsets, attribute_offsets, sizeof(attribute_offsets));
+	out->spans = spans.to();
+	out->target_spans = target_spans.to();
+	out->indices = indices.to();
+	out->deltas = deltas.to();
+	return true;
+}
+
+void acp_vulkan::gltf_morph_targets_free(gltf_morph_targets* targets, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(targets->spans, host_allocator);
+	free_gltf_buffer(targets->target_spans, host_allocator);
+	free_gltf_buffer(targets->indices, host_allocator);
+	free_gltf_buffer(targets->deltas, host_allocator);
+	*targets = {};
+}
+
+acp_vulkan::gltf_data::data_view<const float> acp_vulkan::gltf_morph_weights(const gltf_data* gltf_data, uint32_t node)
+{
+	if (node >= gltf_data->nodes.data_length)
+		return {};
+	const gltf_data::node& node_data = gltf_data->nodes.data[node];
+	if (node_data.weights.data_length)
+		return { node_data.weights.data, node_data.weights.data_length };
+	if (node_data.has_mesh && node_data.mesh < gltf_data->meshes.data_length)
+		return { gltf_data->meshes.data[node_data.mesh].weights.data, gltf_data->meshes.data[node_data.mesh].weights.data_length };
+	return {};
+}
+
+typedef void (*accumulate_deltas_type)(float* accumulated, const float* deltas, float weight, size_t count);
+
+static void accumulate_deltas_scalar(float* accumulated, const float* deltas, float weight, size_t count)
+{
+	for (size_t ii = 0; ii < count; ++ii)
+		accumulated[ii] += weight * deltas[ii];
+}
+
+#if ACP_GLTF_X86
+static void accumulate_deltas_sse2(float* accumulated, const float* deltas, float weight, size_t count)
+{
+	__m128 weights = _mm_set1_ps(weight);
+	size_t ii = 0;
+	for (; ii + 8 <= count; ii += 8)
+	{
+		_mm_storeu_ps(accumulated + ii, _mm_add_ps(_mm_loadu_ps(accumulated + ii), _mm_mul_ps(weights, _mm_loadu_ps(deltas + ii))));
+		_mm_storeu_ps(accumulated + ii + 4, _mm_add_ps(_mm_loadu_ps(accumulated + ii + 4), _mm_mul_ps(weights, _mm_loadu_ps(deltas + ii + 4))));
+	}
+	accumulate_deltas_scalar(accumulated + ii, deltas + ii, weight, count - ii);
+}
+#endif
+
+static accumulate_deltas_type accumulate_deltas_for(acp_vulkan::gltf_scan_backend backend)
+{
+#if ACP_GLTF_X86
+	if (backend != acp_vulkan::gltf_scan_backend::scalar)
+		return accumulate_deltas_sse2;
+#endif
+	return accumulate_deltas_scalar;
+}
+
+struct morph_job
+{
+	const acp_vulkan::gltf_mesh_buffers* mesh_buffers;
+	const acp_vulkan::gltf_morph_instance* instances;
+	VkAllocationCallbacks* host_allocator;
+	accumulate_deltas_type accumulate_deltas;
+};
+
+static void morph_vertices_job(void* job_data, size_t job_index)
+{
+	morph_job* job = reinterpret_cast<morph_job*>(job_data);
+	const acp_vulkan::gltf_morph_instance& instance = job->instances[job_index];
+	const acp_vulkan::gltf_morph_targets& targets = *instance.targets;
+	const acp_vulkan::gltf_mesh_buffers::mesh_data& mesh = job->mesh_buffers->meshes.data[targets.mesh];
+	size_t stride = targets.vertex_stride;
+	memcpy(instance.out, job->mesh_buffers->vertices.data + size_t(mesh.first_vertex) * stride, size_t(targets.vertex_count) * stride);
+
+	temp_data_view<float> accumulated{};
+	accumulated.host_allocator = job->host_allocator;
+	for (uint32_t slot = 0; slot < 3; ++slot)
+	{
+		// Only the vertices moved by targets with a weight get accumulated and written back.
+		uint32_t first = UINT32_MAX, end = 0;
+		for (uint32_t target = 0; target < targets.target_count; ++target)
+		{
+			if (instance.weights[target] == 0.0f)
+				continue;
+			for (uint32_t ii = targets.target_spans.data[target]; ii < targets.target_spans.data[target + 1]; ++ii)
+			{
+				const acp_vulkan::gltf_morph_targets::span& span = targets.spans.data[ii];
+				if (span.attribute != slot)
+					continue;
+				first = span.first_vertex < first ? span.first_vertex : first;
+				end = span.first_vertex + span.vertex_count > end ? span.first_vertex + span.vertex_count : end;
+			}
+		}
+		if (first >= end)
+			continue;
+
+		accumulated.data_length = 0;
+		reserve_more(accumulated, size_t(end - first) * 3);
+		memset(accumulated.data, 0, size_t(end - first) * 3 * sizeof(float));
+		for (uint32_t target = 0; target < targets.target_count; ++target)
+		{
+			float weight = instance.weights[target];
+			if (weight == 0.0f)
+				continue;
+			for (uint32_t ii = targets.target_spans.data[target]; ii < targets.target_spans.data[target + 1]; ++ii)
+			{
+				const acp_vulkan::gltf_morph_targets::span& span = targets.spans.data[ii];
+				if (span.attribute != slot)
+					continue;
+				const float* deltas = targets.deltas.data + span.first_delta;
+				if (span.first_index == UINT32_MAX)
+				{
+					job->accumulate_deltas(accumulated.data + size_t(span.first_vertex - first) * 3, deltas, weight, size_t(span.vertex_count) * 3);
+					continue;
+				}
+				const uint32_t* indices = targets.indices.data + span.first_index;
+				for (uint32_t jj = 0; jj < span.index_count; ++jj)
+				{
+					float* vertex = accumulated.data + size_t(indices[jj] - first) * 3;
+					vertex[0] += weight * deltas[jj * 3 + 0];
+					vertex[1] += weight * deltas[jj * 3 + 1];
+					vertex[2] += weight * deltas[jj * 3 + 2];
+				}
+			}
+		}
+
+		// Tangents keep their handedness in w.
+		uint8_t* vertex = instance.out + size_t(first) * stride + targets.attribute_offsets[slot];
+		for (uint32_t ii = 0; ii < end - first; ++ii, vertex += stride)
+		{
+			float value[3];
+			memcpy(value, vertex, sizeof(value));
+			value[0] += accumulated.data[ii * 3 + 0];
+			value[1] += accumulated.data[ii * 3 + 1];
+			value[2] += accumulated.data[ii * 3 + 2];
+			memcpy(vertex, value, sizeof(value));
+		}
+	}
+}
+
+bool acp_vulkan::gltf_morph_vertices(const gltf_mesh_buffers* mesh_buffers, const gltf_morph_instance* instances, uint32_t instance_count,
+	VkAllocationCallbacks* host_allocator, gltf_morph_flags morph_flags)
+{
+	for (uint32_t ii = 0; ii < instance_count; ++ii)
+	{
+		const gltf_morph_targets* targets = instances[ii].targets;
+		if (!targets || !instances[ii].out || (targets->target_count && !instances[ii].weights) || targets->mesh >= mesh_buffers->meshes.data_length ||
+			targets->vertex_stride != mesh_buffers->vertex_stride || targets->vertex_count != mesh_buffers->meshes.data[targets->mesh].vertex_count)
+			return false;
+	}
+
+	morph_job job{
+		.mesh_buffers = mesh_buffers,
+		.instances = instances,
 		.host_allocator = host_allocator,
+		.accumulate_deltas = accumulate_deltas_for(resolve_scan_backend(requested_scan_backend)),
 	};
 
-	if (expect(next_token(&state), token_types::open_curly) == return_value::error_value)
-		return {.gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char};
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((morph_flags & gltf_morph_parallel_instances) && instance_count > 1 && has_workers)
+		run_parsing_jobs(morph_vertices_job, &job, instance_count);
+	else
+		for (uint32_t ii = 0; ii < instance_count; ++ii)
+			morph_vertices_job(&job, ii);
+	return true;
+}
+
+// Entries handed to one node bounds job.
+#define NODE_BOUNDS_ENTRIES_PER_JOB 4096
+// SAH bins per axis.
+#define BVH_BINS 16
+// Leaves never get deeper than this, so traversal fits a fixed stack.
+#define BVH_MAX_DEPTH 64
+// Ranges up to this many items become leaves when splitting them does not lower the SAH cost.
+#define BVH_MAX_LEAF_ITEMS 8
+// Cost of visiting an inner node relative to testing one item.
+#define BVH_TRAVERSAL_COST 1.0f
+// Smallest subtree built on its own thread, and how many subtrees every thread gets so uneven ones still balance.
+#define BVH_SUBTREE_MIN_ITEMS 4096
+#define BVH_SUBTREES_PER_THREAD 8
+// Items bounded and binned by one job while the top of the tree is split.
+#define BVH_PARALLEL_BIN_ITEMS 65536
+
+static void set_empty_bounds(acp_vulkan::gltf_bounds* bounds)
+{
+	*bounds = {
+		.min = { FLT_MAX, FLT_MAX, FLT_MAX },
+		.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX },
+		.center = { 0.0f, 0.0f, 0.0f },
+		.radius = -1.0f,
+	};
+}
+
+static bool is_empty_bounds(const float* min, const float* max)
+{
+	return !(min[0] <= max[0] && min[1] <= max[1] && min[2] <= max[2]);
+}
+
+static float half_diagonal(const float* min, const float* max)
+{
+	float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+	return 0.5f * sqrtf(x * x + y * y + z * z);
+}
 
-	temp_data_view<token_types> found_sections{};
-	found_sections.host_allocator = host_allocator;
-	pair<token_types, acp_vulkan::gltf_data::gltf_state_type> mandatory_sections[] = {
-		{token_types::asset, acp_vulkan::gltf_data::missing_asset_section }
-	};
-	while (true)
+struct mesh_bounds_job
+{
+	const acp_vulkan::gltf_data* gltf_data;
+	acp_vulkan::gltf_mesh_bounds* out;
+	acp_vulkan::gltf_bounds_flags bounds_flags;
+	VkAllocationCallbacks* host_allocator;
+	std::atomic<bool> failed;
+};
+
+static void primitive_bounds_job(void* job_data, size_t job_index)
+{
+	mesh_bounds_job* job = reinterpret_cast<mesh_bounds_job*>(job_data);
+	const acp_vulkan::gltf_mesh_bounds& mesh_bounds = *job->out;
+	uint32_t mesh = uint32_t(std::upper_bound(mesh_bounds.first_primitives.data, mesh_bounds.first_primitives.data + mesh_bounds.first_primitives.data_length,
+		uint32_t(job_index)) - mesh_bounds.first_primitives.data) - 1;
+	const acp_vulkan::gltf_data::mesh::primitive_type& primitive =
+		job->gltf_data->meshes.data[mesh].primitives.data[job_index - mesh_bounds.first_primitives.data[mesh]];
+	acp_vulkan::gltf_bounds& bounds = mesh_bounds.primitives.data[job_index];
+	set_empty_bounds(&bounds);
+
+	uint32_t accessor_index = primitive_attribute_accessor(primitive, acp_vulkan::gltf_data::attribute::POSITION);
+	if (accessor_index >= job->gltf_data->accesors.data_length || !job->gltf_data->accesors.data[accessor_index].count)
+		return;
+	const acp_vulkan::gltf_data::accesor& accessor = job->gltf_data->accesors.data[accessor_index];
+
+	// min and max are required for positions but parse as zeros when missing, and are in raw units for quantized positions.
+	bool has_min_max = accessor.component_type == acp_vulkan::gltf_data::accesor::component_type_type::FLOAT;
+	has_min_max = has_min_max && (accessor.min[0] || accessor.min[1] || accessor.min[2] || accessor.max[0] || accessor.max[1] || accessor.max[2]);
+	if (has_min_max && !(job->bounds_flags & acp_vulkan::gltf_bounds_read_positions))
 	{
-		token t = next_token(&state);
-		if (t.type == token_types::none)
+		for (uint32_t ii = 0; ii < 3; ++ii)
 		{
-			return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };
-			assert(false);
+			bounds.min[ii] = accessor.min[ii];
+			bounds.max[ii] = accessor.max[ii];
+			bounds.center[ii] = 0.5f * (accessor.min[ii] + accessor.max[ii]);
 		}
+		bounds.radius = half_diagonal(bounds.min, bounds.max);
+		return;
+	}
 
-		switch (t.type)
-		{
-			GLTF_SECTION(token_types::bufferViews, buffer_views, acp_vulkan::gltf_data::buffer_view, parse_buffer_view);
-			GLTF_SECTION(token_types::buffers, buffers, acp_vulkan::gltf_data::buffer, parse_buffer);
-			GLTF_SECTION(token_types::images, images, acp_vulkan::gltf_data::image, parse_image);
-			GLTF_SECTION(token_types::accessors, accesors, acp_vulkan::gltf_data::accesor, parse_accesor);
-			GLTF_SECTION(token_types::textures, textures, acp_vulkan::gltf_data::texture, parse_texture);
-			GLTF_SECTION(token_types::meshes, meshes, acp_vulkan::gltf_data::mesh, parse_mesh);
-			GLTF_SECTION(token_types::materials, materials, acp_vulkan::gltf_data::material, parse_material);
-			GLTF_SECTION(token_types::nodes, nodes, acp_vulkan::gltf_data::node, parse_node);
-			GLTF_SECTION(token_types::scenes, scenes, acp_vulkan::gltf_data::scene, parse_scene);
-			GLTF_SECTION(token_types::samplers, samplers, acp_vulkan::gltf_data::sampler, parse_sampler);
-			GLTF_SECTION(token_types::skins, skins, acp_vulkan::gltf_data::skin, parse_skin);
-			GLTF_SECTION(token_types::cameras, cameras, acp_vulkan::gltf_data::camera, parse_camera);
-			GLTF_SECTION(token_types::animations, animations, acp_vulkan::gltf_data::animation, parse_animation);		
-			case token_types::asset:
-			{
-				auto asset = parse_asset(&state);
-				if(asset.second != return_value::true_value)
-					return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };
-				out.asset = asset.first;
-				found_sections.emplace_back(token_types::asset);
-				break;
-			}
-			case token_types::scene:
-			{
-				if (expect_ordered_and_discard_tokens(&state, { token_types::colon }) == return_value::error_value)
-					return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };
-
-				token default_scene = next_token(&state);
-				if(default_scene.type != token_types::is_int)
-					return { .gltf_state = acp_vulkan::gltf_data::parsing_error, .parsing_error_location = state.next_char };
-				out.default_scene = uint32_t(default_scene.value.as_int);
-				out.has_defautl_scene = true;
-				found_sections.emplace_back(token_types::scene);
-				break;
-			}
-			default:
-				skip_object_and_arries_if_found(&state);
-		}
+	temp_data_view<float> positions{};
+	mesh_scratch(positions, size_t(accessor.count) * 3, job->host_allocator);
+	if (!acp_vulkan::gltf_accessor_read(job->gltf_data, accessor_index, VK_FORMAT_R32G32B32_SFLOAT, positions.data))
+	{
+		job->failed = true;
+		return;
+	}
+	for (size_t ii = 0; ii < positions.data_length; ++ii)
+	{
+		bounds.min[ii % 3] = fminf(bounds.min[ii % 3], positions.data[ii]);
+		bounds.max[ii % 3] = fmaxf(bounds.max[ii % 3], positions.data[ii]);
+	}
+	for (uint32_t ii = 0; ii < 3; ++ii)
+		bounds.center[ii] = 0.5f * (bounds.min[ii] + bounds.max[ii]);
+	float radius_squared = 0.0f;
+	for (size_t ii = 0; ii < positions.data_length; ii += 3)
+	{
+		float x = positions.data[ii] - bounds.center[0], y = positions.data[ii + 1] - bounds.center[1], z = positions.data[ii + 2] - bounds.center[2];
+		radius_squared = fmaxf(radius_squared, x * x + y * y + z * z);
+	}
+	bounds.radius = sqrtf(radius_squared);
+}
 
-		if (t.type == token_types::eof)
-			break;
+bool acp_vulkan::gltf_mesh_bounds_build(const gltf_data* gltf_data, VkAllocationCallbacks* host_allocator, gltf_mesh_bounds* out, gltf_bounds_flags bounds_flags)
+{
+	*out = {};
+	size_t mesh_count = gltf_data->meshes.data_length;
+	temp_data_view<uint32_t> first_primitives{};
+	mesh_scratch(first_primitives, mesh_count + 1, host_allocator);
+	uint32_t primitive_count = 0;
+	for (size_t ii = 0; ii < mesh_count; ++ii)
+	{
+		first_primitives.data[ii] = primitive_count;
+		primitive_count += uint32_t(gltf_data->meshes.data[ii].primitives.data_length);
+	}
+	first_primitives.data[mesh_count] = primitive_count;
+
+	temp_data_view<gltf_bounds> primitives{}, meshes{};
+	mesh_scratch(primitives, primitive_count, host_allocator);
+	mesh_scratch(meshes, mesh_count, host_allocator);
+	out->first_primitives = first_primitives.to();
+	out->primitives = primitives.to();
+	out->meshes = meshes.to();
+
+	mesh_bounds_job job{
+		.gltf_data = gltf_data,
+		.out = out,
+		.bounds_flags = bounds_flags,
+		.host_allocator = host_allocator,
+		.failed = false,
+	};
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((bounds_flags & gltf_bounds_parallel) && primitive_count > 1 && has_workers)
+		run_parsing_jobs(primitive_bounds_job, &job, primitive_count);
+	else
+		for (uint32_t ii = 0; ii < primitive_count; ++ii)
+			primitive_bounds_job(&job, ii);
+	if (job.failed)
+	{
+		gltf_mesh_bounds_free(out, host_allocator);
+		return false;
 	}
 
-	for (auto ii : mandatory_sections)
+	// The mesh sphere is centered on the mesh box and reaches the far side of every primitive sphere, unless half the box diagonal is smaller.
+	for (size_t ii = 0; ii < mesh_count; ++ii)
 	{
-		bool found_section = false;
-		for (size_t jj = 0; jj < found_sections.data_length; ++jj)
-		{
-			if (found_sections.data[jj] == ii.first)
+		gltf_bounds& mesh = out->meshes.data[ii];
+		set_empty_bounds(&mesh);
+		for (uint32_t jj = out->first_primitives.data[ii]; jj < out->first_primitives.data[ii + 1]; ++jj)
+			for (uint32_t kk = 0; kk < 3; ++kk)
 			{
-				found_section = true;
-				break;
+				mesh.min[kk] = fminf(mesh.min[kk], out->primitives.data[jj].min[kk]);
+				mesh.max[kk] = fmaxf(mesh.max[kk], out->primitives.data[jj].max[kk]);
 			}
-		}
-		if (!found_section)
+		if (is_empty_bounds(mesh.min, mesh.max))
+			continue;
+
+		for (uint32_t kk = 0; kk < 3; ++kk)
+			mesh.center[kk] = 0.5f * (mesh.min[kk] + mesh.max[kk]);
+		mesh.radius = 0.0f;
+		for (uint32_t jj = out->first_primitives.data[ii]; jj < out->first_primitives.data[ii + 1]; ++jj)
 		{
-			return { .gltf_state = ii.second, .parsing_error_location = 0 };
-			assert(false);
+			const gltf_bounds& primitive = out->primitives.data[jj];
+			if (primitive.radius < 0.0f)
+				continue;
+			float x = primitive.center[0] - mesh.center[0], y = primitive.center[1] - mesh.center[1], z = primitive.center[2] - mesh.center[2];
+			mesh.radius = fmaxf(mesh.radius, sqrtf(x * x + y * y + z * z) + primitive.radius);
 		}
+		mesh.radius = fminf(mesh.radius, half_diagonal(mesh.min, mesh.max));
 	}
+	return true;
+}
+
+void acp_vulkan::gltf_mesh_bounds_free(gltf_mesh_bounds* mesh_bounds, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(mesh_bounds->first_primitives, host_allocator);
+	free_gltf_buffer(mesh_bounds->primitives, host_allocator);
+	free_gltf_buffer(mesh_bounds->meshes, host_allocator);
+	*mesh_bounds = {};
+}
 
-	for (size_t ii = 0; ii < out.buffers.data_length; ++ii)
+// The box of the transformed box (the extents go through the absolute matrix) and the sphere scaled by the longest axis.
+static void transform_bounds(const float* world, const acp_vulkan::gltf_bounds& local, acp_vulkan::gltf_bounds* out)
+{
+	float center[3], extent[3];
+	for (uint32_t ii = 0; ii < 3; ++ii)
 	{
-		auto embaded_data = get_embedded_data(out.buffers.data[ii].uri);
-		if (embaded_data.first.data && embaded_data.second.data)
-		{
-			out.buffers.data[ii].embedded_bytes = base64_decode(embaded_data.second);
-			if (out.buffers.data[ii].embedded_bytes.data && out.buffers.data[ii].embedded_bytes.data_length != 0)
-				out.buffers.data[ii].embedded_mime = copy(embaded_data.first, host_allocator);
-		}
+		center[ii] = 0.5f * (local.min[ii] + local.max[ii]);
+		extent[ii] = 0.5f * (local.max[ii] - local.min[ii]);
+	}
+	float scale_squared = 0.0f;
+	for (uint32_t column = 0; column < 3; ++column)
+		scale_squared = fmaxf(scale_squared, world[column * 4] * world[column * 4] + world[column * 4 + 1] * world[column * 4 + 1] +
+			world[column * 4 + 2] * world[column * 4 + 2]);
+	for (uint32_t row = 0; row < 3; ++row)
+	{
+		float moved = world[row] * center[0] + world[4 + row] * center[1] + world[8 + row] * center[2] + world[12 + row];
+		float reach = fabsf(world[row]) * extent[0] + fabsf(world[4 + row]) * extent[1] + fabsf(world[8 + row]) * extent[2];
+		out->min[row] = moved - reach;
+		out->max[row] = moved + reach;
+		out->center[row] = world[row] * local.center[0] + world[4 + row] * local.center[1] + world[8 + row] * local.center[2] + world[12 + row];
 	}
+	out->radius = local.radius * sqrtf(scale_squared);
+}
 
-	for (size_t ii = 0; ii < out.images.data_length; ++ii)
+struct node_bounds_job
+{
+	const acp_vulkan::gltf_data* gltf_data;
+	const acp_vulkan::gltf_mesh_bounds* mesh_bounds;
+	const acp_vulkan::gltf_scene_transforms* transforms;
+	acp_vulkan::gltf_bounds* out;
+};
+
+static void update_node_bounds_job(void* job_data, size_t job_index)
+{
+	node_bounds_job* job = reinterpret_cast<node_bounds_job*>(job_data);
+	const acp_vulkan::gltf_scene_transforms& transforms = *job->transforms;
+	uint32_t first = uint32_t(job_index) * NODE_BOUNDS_ENTRIES_PER_JOB;
+	uint32_t end = transforms.entry_count - first < NODE_BOUNDS_ENTRIES_PER_JOB ? transforms.entry_count : first + NODE_BOUNDS_ENTRIES_PER_JOB;
+	for (uint32_t entry = first; entry < end; ++entry)
 	{
-		auto embaded_data = get_embedded_data(out.images.data[ii].uri);
-		if (embaded_data.first.data && embaded_data.second.data)
+		const acp_vulkan::gltf_data::node& node = job->gltf_data->nodes.data[transforms.nodes.data[entry]];
+		if (!node.has_mesh || node.mesh >= job->mesh_bounds->meshes.data_length || job->mesh_bounds->meshes.data[node.mesh].radius < 0.0f)
 		{
-			out.images.data[ii].embedded_bytes = base64_decode(embaded_data.second);
-			if (out.images.data[ii].embedded_bytes.data && out.images.data[ii].embedded_bytes.data_length != 0)
-				out.images.data[ii].embedded_mime = copy(embaded_data.first, host_allocator);
+			set_empty_bounds(job->out + entry);
+			continue;
 		}
+		float world[16];
+		for (uint32_t ii = 0; ii < 16; ++ii)
+			world[ii] = TRANSFORM_COMPONENT(transforms.world_matrices.data, ii, entry, transforms.entry_count);
+		transform_bounds(world, job->mesh_bounds->meshes.data[node.mesh], job->out + entry);
 	}
-	out.gltf_state = acp_vulkan::gltf_data::gltf_state_type::valid;
+}
 
-	return out;
+void acp_vulkan::gltf_node_bounds_update(const gltf_data* gltf_data, const gltf_mesh_bounds* mesh_bounds, const gltf_scene_transforms* transforms, gltf_bounds* out,
+	gltf_bounds_flags bounds_flags)
+{
+	node_bounds_job job{
+		.gltf_data = gltf_data,
+		.mesh_bounds = mesh_bounds,
+		.transforms = transforms,
+		.out = out,
+	};
+	uint32_t job_count = (transforms->entry_count + NODE_BOUNDS_ENTRIES_PER_JOB - 1) / NODE_BOUNDS_ENTRIES_PER_JOB;
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((bounds_flags & gltf_bounds_parallel) && job_count > 1 && has_workers)
+		run_parsing_jobs(update_node_bounds_job, &job, job_count);
+	else
+		for (uint32_t ii = 0; ii < job_count; ++ii)
+			update_node_bounds_job(&job, ii);
 }
 
-struct gltf_binary_header
+struct bvh_item
 {
-	uint32_t magic;
-	uint32_t version;
-	uint32_t length;
+	float min[3];
+	uint32_t index;
+	float max[3];
 };
 
-struct gltf_binary_chunk_header
+// The box of a range of items and the box of their centroids, doubled (min + max) since only their order matters.
+struct bvh_range_bounds
 {
-	enum class type
-	{
-		JSON = 0x4E4F534A,
-		BIN = 0x004E4942
-	};
-	uint32_t chunk_length;
-	type chunk_type;
+	float min[3];
+	float max[3];
+	float centroid_min[3];
+	float centroid_max[3];
 };
 
-gltf_binary_header binary_gltf_header(const char* data, size_t data_size)
+struct bvh_bin
 {
-	if (data_size < sizeof(gltf_binary_header))
-		return {};
+	float min[3];
+	float max[3];
+	uint32_t count;
+};
 
-	gltf_binary_header out{};
-	memcpy(&out, data, sizeof(gltf_binary_header));
+// A range of items left to build on its own under node, its children go in [first_node, first_node + 2 * (end - begin) - 2).
+struct bvh_subtree
+{
+	uint32_t node;
+	uint32_t begin;
+	uint32_t end;
+	uint32_t depth;
+	uint32_t first_node;
+	uint32_t node_count;
+};
 
-	if (out.magic == 0x46546C67 /*glTF*/)
-		return out;
+struct bvh_builder
+{
+	bvh_item* items;
+	acp_vulkan::gltf_bvh::node* nodes;
+	uint32_t next_node;
+	// Ranges up to subtree_items items go to subtrees instead of being split, when subtrees is set.
+	uint32_t subtree_items;
+	temp_data_view<bvh_subtree>* subtrees;
+	// Ranges of at least 2 * BVH_PARALLEL_BIN_ITEMS are bounded and binned on the parsing threads, every job with its own part of job_bounds and job_bins.
+	bool parallel_passes;
+	bvh_range_bounds* job_bounds;
+	bvh_bin* job_bins;
+};
 
-	return {};
+// Half the surface area, SAH only compares areas.
+static float box_area(const float* min, const float* max)
+{
+	float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+	return x * y + y * z + z * x;
 }
 
-bool is_binary_gltf(const char* data, size_t data_size)
+// Compares instead of fminf and fmaxf, which do not inline to single instructions and dominate the build otherwise.
+static void grow_box(float* min, float* max, const float* other_min, const float* other_max)
 {
-	gltf_binary_header test = binary_gltf_header(data, data_size);
-	return test.version == 2 && test.length != 0 && test.magic == 0x46546C67;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		min[ii] = other_min[ii] < min[ii] ? other_min[ii] : min[ii];
+		max[ii] = other_max[ii] > max[ii] ? other_max[ii] : max[ii];
+	}
 }
 
-acp_vulkan::gltf_data acp_vulkan::binary_gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator)
+static void clear_bvh_bins(bvh_bin* bins, uint32_t count)
 {
-	gltf_binary_header header = binary_gltf_header(data, data_size);
-	if(header.version != 2)
-		return { .gltf_state = acp_vulkan::gltf_data::invalid_binary_data_version, .parsing_error_location = 0 };
+	for (uint32_t ii = 0; ii < count; ++ii)
+		bins[ii] = { .min = { FLT_MAX, FLT_MAX, FLT_MAX }, .max = { -FLT_MAX, -FLT_MAX, -FLT_MAX }, .count = 0 };
+}
 
-	if (header.magic != 0x46546C67)
-		return { .gltf_state = acp_vulkan::gltf_data::invalid_binary_data_magic, .parsing_error_location = 0 };
+static void bound_bvh_items(const bvh_item* items, uint32_t begin, uint32_t end, bvh_range_bounds* out)
+{
+	*out = {
+		.min = { FLT_MAX, FLT_MAX, FLT_MAX },
+		.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX },
+		.centroid_min = { FLT_MAX, FLT_MAX, FLT_MAX },
+		.centroid_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX },
+	};
+	for (uint32_t ii = begin; ii < end; ++ii)
+	{
+		float centroid[3]{ items[ii].min[0] + items[ii].max[0], items[ii].min[1] + items[ii].max[1], items[ii].min[2] + items[ii].max[2] };
+		grow_box(out->min, out->max, items[ii].min, items[ii].max);
+		grow_box(out->centroid_min, out->centroid_max, centroid, centroid);
+	}
+}
 
-	if (header.length == 0)
-		return { .gltf_state = acp_vulkan::gltf_data::invalid_binary_data_with_zero_length, .parsing_error_location = 0 };
+static uint32_t bvh_bin_of(const bvh_item& item, uint32_t axis, float centroid_min, float bin_scale)
+{
+	uint32_t bin = uint32_t((item.min[axis] + item.max[axis] - centroid_min) * bin_scale);
+	return bin < BVH_BINS ? bin : BVH_BINS - 1;
+}
 
-	data += sizeof(gltf_binary_header);
+// Bins every axis in the same pass over the items, bins has BVH_BINS per axis.
+static void bin_bvh_items(const bvh_item* items, uint32_t begin, uint32_t end, const float* centroid_min, const float* bin_scales, bvh_bin* bins)
+{
+	clear_bvh_bins(bins, 3 * BVH_BINS);
+	for (uint32_t ii = begin; ii < end; ++ii)
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			bvh_bin& bin = bins[axis * BVH_BINS + bvh_bin_of(items[ii], axis, centroid_min[axis], bin_scales[axis])];
+			grow_box(bin.min, bin.max, items[ii].min, items[ii].max);
+			++bin.count;
+		}
+}
 
-	uint8_t* data_buffer = nullptr;
-	size_t data_buffer_size = 0;
-	acp_vulkan::gltf_data out_data{};
+struct bvh_pass_job
+{
+	const bvh_item* items;
+	uint32_t begin;
+	uint32_t end;
+	const float* centroid_min;
+	const float* bin_scales;
+	bvh_range_bounds* bounds;
+	bvh_bin* bins;
+};
 
-	for (size_t ii = 0; ii < header.length;)
-	{
-		if (ii + sizeof(gltf_binary_chunk_header) >= header.length)
-			break;
-		gltf_binary_chunk_header chunk{};
-		memcpy(&chunk, data + ii, sizeof(gltf_binary_chunk_header));
-		ii += sizeof(gltf_binary_chunk_header);
+static void bound_bvh_items_job(void* job_data, size_t job_index)
+{
+	bvh_pass_job* job = reinterpret_cast<bvh_pass_job*>(job_data);
+	uint32_t first = job->begin + uint32_t(job_index) * BVH_PARALLEL_BIN_ITEMS;
+	uint32_t end = job->end - first < BVH_PARALLEL_BIN_ITEMS ? job->end : first + BVH_PARALLEL_BIN_ITEMS;
+	bound_bvh_items(job->items, first, end, job->bounds + job_index);
+}
 
-		if (header.length - ii < chunk.chunk_length)
-			break;
+static void bin_bvh_items_job(void* job_data, size_t job_index)
+{
+	bvh_pass_job* job = reinterpret_cast<bvh_pass_job*>(job_data);
+	uint32_t first = job->begin + uint32_t(job_index) * BVH_PARALLEL_BIN_ITEMS;
+	uint32_t end = job->end - first < BVH_PARALLEL_BIN_ITEMS ? job->end : first + BVH_PARALLEL_BIN_ITEMS;
+	bin_bvh_items(job->items, first, end, job->centroid_min, job->bin_scales, job->bins + job_index * 3 * BVH_BINS);
+}
 
-		if (chunk.chunk_type == gltf_binary_chunk_header::type::JSON)
+static void build_bvh_node(bvh_builder* builder, uint32_t node_index, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	acp_vulkan::gltf_bvh::node& node = builder->nodes[node_index];
+	bvh_item* items = builder->items;
+	uint32_t count = end - begin;
+	bool parallel = builder->parallel_passes && count >= 2 * BVH_PARALLEL_BIN_ITEMS;
+	uint32_t job_count = (count + BVH_PARALLEL_BIN_ITEMS - 1) / BVH_PARALLEL_BIN_ITEMS;
+	bvh_pass_job job{ .items = items, .begin = begin, .end = end, .bounds = builder->job_bounds, .bins = builder->job_bins };
+
+	bvh_range_bounds bounds;
+	if (parallel)
+	{
+		run_parsing_jobs(bound_bvh_items_job, &job, job_count);
+		bounds = job.bounds[0];
+		for (uint32_t ii = 1; ii < job_count; ++ii)
 		{
-			out_data = gltf_data_from_memory(data + ii, chunk.chunk_length, host_allocator);
+			grow_box(bounds.min, bounds.max, job.bounds[ii].min, job.bounds[ii].max);
+			grow_box(bounds.centroid_min, bounds.centroid_max, job.bounds[ii].centroid_min, job.bounds[ii].centroid_max);
 		}
-		else if (chunk.chunk_type == gltf_binary_chunk_header::type::BIN)
-		{
-			uint8_t* chunk_data = host_allocator ?
-				reinterpret_cast<uint8_t*>(host_allocator->pfnAllocation(host_allocator->pUserData, chunk.chunk_length, sizeof(uint8_t), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
-				: new uint8_t[chunk.chunk_length];
+	}
+	else
+		bound_bvh_items(items, begin, end, &bounds);
+	node = { .min = { bounds.min[0], bounds.min[1], bounds.min[2] }, .first = begin, .max = { bounds.max[0], bounds.max[1], bounds.max[2] }, .count = count };
 
-			memcpy(chunk_data, data + ii, chunk.chunk_length);
+	if (builder->subtrees && count <= builder->subtree_items)
+	{
+		builder->subtrees->emplace_back(bvh_subtree{ .node = node_index, .begin = begin, .end = end, .depth = depth });
+		return;
+	}
+	if (count == 1 || depth + 1 >= BVH_MAX_DEPTH)
+		return;
 
-			data_buffer = chunk_data;
-			data_buffer_size = chunk.chunk_length;
-		}
+	float bin_scales[3]{};
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		float extent = bounds.centroid_max[axis] - bounds.centroid_min[axis];
+		bin_scales[axis] = extent > 0.0f ? BVH_BINS * 0.99999f / extent : 0.0f;
+	}
+	bvh_bin bins[3 * BVH_BINS];
+	if (parallel)
+	{
+		job.centroid_min = bounds.centroid_min;
+		job.bin_scales = bin_scales;
+		run_parsing_jobs(bin_bvh_items_job, &job, job_count);
+		clear_bvh_bins(bins, 3 * BVH_BINS);
+		for (uint32_t ii = 0; ii < job_count; ++ii)
+			for (uint32_t jj = 0; jj < 3 * BVH_BINS; ++jj)
+			{
+				const bvh_bin& job_bin = job.bins[ii * 3 * BVH_BINS + jj];
+				grow_box(bins[jj].min, bins[jj].max, job_bin.min, job_bin.max);
+				bins[jj].count += job_bin.count;
+			}
+	}
+	else
+		bin_bvh_items(items, begin, end, bounds.centroid_min, bin_scales, bins);
 
-		ii += chunk.chunk_length;
+	float best_cost = FLT_MAX;
+	uint32_t best_axis = UINT32_MAX, best_split = 0;
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		if (bin_scales[axis] == 0.0f)
+			continue;
+		// Cost of splitting after every bin, the right sides swept from the end first.
+		const bvh_bin* axis_bins = bins + axis * BVH_BINS;
+		float right_costs[BVH_BINS];
+		float right_min[3]{ FLT_MAX, FLT_MAX, FLT_MAX }, right_max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t right_count = 0;
+		for (uint32_t bin = BVH_BINS - 1; bin > 0; --bin)
+		{
+			grow_box(right_min, right_max, axis_bins[bin].min, axis_bins[bin].max);
+			right_count += axis_bins[bin].count;
+			right_costs[bin - 1] = right_count ? box_area(right_min, right_max) * float(right_count) : 0.0f;
+		}
+		float left_min[3]{ FLT_MAX, FLT_MAX, FLT_MAX }, left_max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t left_count = 0;
+		for (uint32_t bin = 0; bin + 1 < BVH_BINS; ++bin)
+		{
+			grow_box(left_min, left_max, axis_bins[bin].min, axis_bins[bin].max);
+			left_count += axis_bins[bin].count;
+			if (!left_count || left_count == count)
+				continue;
+			float cost = box_area(left_min, left_max) * float(left_count) + right_costs[bin];
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_split = bin;
+			}
+		}
 	}
 
-	out_data.embedded_buffer.data = data_buffer;
-	out_data.embedded_buffer.data_length = data_buffer_size;
+	// Compared without dividing by the node area, which is zero for flat or point instances.
+	float area = box_area(bounds.min, bounds.max);
+	if (count <= BVH_MAX_LEAF_ITEMS && (best_axis == UINT32_MAX || area * float(count) <= area * BVH_TRAVERSAL_COST + best_cost))
+		return;
 
-	if (out_data.gltf_state != gltf_data::valid)
-		free_gltf_buffer(out_data.embedded_buffer, host_allocator);
+	// Without a split every centroid is the same and any half is as good.
+	uint32_t middle = begin + count / 2;
+	if (best_axis != UINT32_MAX)
+	{
+		float centroid_min = bounds.centroid_min[best_axis], bin_scale = bin_scales[best_axis];
+		middle = uint32_t(std::partition(items + begin, items + end, [=](const bvh_item& item)
+		{
+			return bvh_bin_of(item, best_axis, centroid_min, bin_scale) <= best_split;
+		}) - items);
+	}
 
-	return out_data;
+	uint32_t left = builder->next_node;
+	builder->next_node += 2;
+	node.first = left;
+	node.count = 0;
+	build_bvh_node(builder, left, begin, middle, depth + 1);
+	build_bvh_node(builder, left + 1, middle, end, depth + 1);
 }
 
-acp_vulkan::gltf_data acp_vulkan::gltf_data_from_file(const char* path, VkAllocationCallbacks* host_allocator)
+struct bvh_subtree_job
 {
-	FILE* gltf_bytes = fopen(path, "rb");
-	if (!gltf_bytes)
-		return { .gltf_state = acp_vulkan::gltf_data::unable_to_open_file, .parsing_error_location = 0 };
+	bvh_item* items;
+	acp_vulkan::gltf_bvh::node* nodes;
+	bvh_subtree* subtrees;
+};
 
-	fseek(gltf_bytes, 0, SEEK_END);
-	long gltf_size = ftell(gltf_bytes);
-	fseek(gltf_bytes, 0, SEEK_SET);
+static void build_bvh_subtree_job(void* job_data, size_t job_index)
+{
+	bvh_subtree_job* job = reinterpret_cast<bvh_subtree_job*>(job_data);
+	bvh_subtree& subtree = job->subtrees[job_index];
+	bvh_builder builder{
+		.items = job->items,
+		.nodes = job->nodes,
+		.next_node = subtree.first_node,
+		.subtree_items = 0,
+		.subtrees = nullptr,
+		.parallel_passes = false,
+		.job_bounds = nullptr,
+		.job_bins = nullptr,
+	};
+	build_bvh_node(&builder, subtree.node, subtree.begin, subtree.end, subtree.depth);
+	subtree.node_count = builder.next_node - subtree.first_node;
+}
 
-	char* gltf_data = host_allocator ?
-		reinterpret_cast<char*>(host_allocator->pfnAllocation(host_allocator->pUserData, gltf_size, 1, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
-		: new char[gltf_size];
+bool acp_vulkan::gltf_bvh_build(const gltf_bounds* bounds, uint32_t count, VkAllocationCallbacks* host_allocator, gltf_bvh* out, gltf_bounds_flags bounds_flags)
+{
+	*out = {};
+	temp_data_view<bvh_item> items{};
+	mesh_scratch(items, count, host_allocator);
+	uint32_t item_count = 0;
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		if (is_empty_bounds(bounds[ii].min, bounds[ii].max))
+			continue;
+		bvh_item& item = items.data[item_count++];
+		memcpy(item.min, bounds[ii].min, sizeof(item.min));
+		memcpy(item.max, bounds[ii].max, sizeof(item.max));
+		item.index = ii;
+	}
+	if (!item_count)
+		return false;
+
+	// A binary tree with at least one item per leaf never has more nodes than this.
+	temp_data_view<gltf_bvh::node> nodes{};
+	mesh_scratch(nodes, size_t(item_count) * 2 - 1, host_allocator);
+	temp_data_view<bvh_subtree> subtrees{};
+	subtrees.host_allocator = host_allocator;
+
+	// The top of the tree is split here with parallel passes over its items, the subtrees under it are built one per job.
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	bool parallel = (bounds_flags & gltf_bounds_parallel) && has_workers;
+	uint32_t subtree_items = item_count;
+	temp_data_view<bvh_range_bounds> job_bounds{};
+	temp_data_view<bvh_bin> job_bins{};
+	if (parallel)
+	{
+		subtree_items = item_count / (parsing_thread_count() * BVH_SUBTREES_PER_THREAD);
+		subtree_items = subtree_items > BVH_SUBTREE_MIN_ITEMS ? subtree_items : BVH_SUBTREE_MIN_ITEMS;
+		size_t pass_jobs = (item_count + BVH_PARALLEL_BIN_ITEMS - 1) / BVH_PARALLEL_BIN_ITEMS;
+		mesh_scratch(job_bounds, pass_jobs, host_allocator);
+		mesh_scratch(job_bins, pass_jobs * 3 * BVH_BINS, host_allocator);
+	}
+	bvh_builder builder{
+		.items = items.data,
+		.nodes = nodes.data,
+		.next_node = 1,
+		.subtree_items = subtree_items,
+		.subtrees = &subtrees,
+		.parallel_passes = parallel,
+		.job_bounds = job_bounds.data,
+		.job_bins = job_bins.data,
+	};
+	build_bvh_node(&builder, 0, 0, item_count, 0);
 
-	if (!gltf_data)
+	uint32_t top_node_count = builder.next_node;
+	uint32_t next_node = top_node_count;
+	for (size_t ii = 0; ii < subtrees.data_length; ++ii)
 	{
-		fclose(gltf_bytes);
-		return { .gltf_state = acp_vulkan::gltf_data::gltf_state_type::unable_to_read_file, .parsing_error_location = 0 };
+		subtrees.data[ii].first_node = next_node;
+		next_node += 2 * (subtrees.data[ii].end - subtrees.data[ii].begin) - 2;
+	}
+	bvh_subtree_job job{ .items = items.data, .nodes = nodes.data, .subtrees = subtrees.data };
+	if (parallel && subtrees.data_length > 1)
+		run_parsing_jobs(build_bvh_subtree_job, &job, subtrees.data_length);
+	else
+		for (size_t ii = 0; ii < subtrees.data_length; ++ii)
+			build_bvh_subtree_job(&job, ii);
+
+	// Subtrees rarely use all the nodes they could, close the gaps between them.
+	temp_data_view<uint32_t> subtree_offsets{};
+	mesh_scratch(subtree_offsets, subtrees.data_length + 1, host_allocator);
+	next_node = top_node_count;
+	for (size_t ii = 0; ii < subtrees.data_length; ++ii)
+	{
+		const bvh_subtree& subtree = subtrees.data[ii];
+		uint32_t shift = subtree.first_node - next_node;
+		subtree_offsets.data[ii] = next_node;
+		if (shift)
+		{
+			memmove(nodes.data + next_node, nodes.data + subtree.first_node, size_t(subtree.node_count) * sizeof(gltf_bvh::node));
+			for (uint32_t jj = next_node; jj < next_node + subtree.node_count; ++jj)
+				if (!nodes.data[jj].count)
+					nodes.data[jj].first -= shift;
+			if (!nodes.data[subtree.node].count)
+				nodes.data[subtree.node].first -= shift;
+		}
+		next_node += subtree.node_count;
 	}
+	subtree_offsets.data[subtrees.data_length] = next_node;
+	nodes.data_length = next_node;
+
+	temp_data_view<uint32_t> item_indices{};
+	mesh_scratch(item_indices, item_count, host_allocator);
+	for (uint32_t ii = 0; ii < item_count; ++ii)
+		item_indices.data[ii] = items.data[ii].index;
+
+	out->nodes = nodes.to();
+	out->items = item_indices.to();
+	out->top_node_count = top_node_count;
+	out->subtree_offsets = subtree_offsets.to();
+	return true;
+}
 
-	size_t bytes_to_read = gltf_size;
-	size_t offset = 0;
-	while (size_t bytes_read = fread(gltf_data + offset, 1, bytes_to_read, gltf_bytes))
+// Children always come after their parent, so going backwards every child is refit before it is read.
+static void refit_bvh_nodes(acp_vulkan::gltf_bvh* bvh, const acp_vulkan::gltf_bounds* bounds, uint32_t first, uint32_t end)
+{
+	for (uint32_t ii = end; ii-- > first;)
 	{
-		offset += bytes_read;
-		bytes_to_read -= bytes_read;
+		acp_vulkan::gltf_bvh::node& node = bvh->nodes.data[ii];
+		float min[3]{ FLT_MAX, FLT_MAX, FLT_MAX }, max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		if (node.count)
+			for (uint32_t jj = node.first; jj < node.first + node.count; ++jj)
+				grow_box(min, max, bounds[bvh->items.data[jj]].min, bounds[bvh->items.data[jj]].max);
+		else
+		{
+			grow_box(min, max, bvh->nodes.data[node.first].min, bvh->nodes.data[node.first].max);
+			grow_box(min, max, bvh->nodes.data[node.first + 1].min, bvh->nodes.data[node.first + 1].max);
+		}
+		memcpy(node.min, min, sizeof(min));
+		memcpy(node.max, max, sizeof(max));
 	}
+}
 
-	fclose(gltf_bytes);
+struct bvh_refit_job
+{
+	acp_vulkan::gltf_bvh* bvh;
+	const acp_vulkan::gltf_bounds* bounds;
+};
+
+static void refit_bvh_subtree_job(void* job_data, size_t job_index)
+{
+	bvh_refit_job* job = reinterpret_cast<bvh_refit_job*>(job_data);
+	refit_bvh_nodes(job->bvh, job->bounds, job->bvh->subtree_offsets.data[job_index], job->bvh->subtree_offsets.data[job_index + 1]);
+}
+
+void acp_vulkan::gltf_bvh_refit(gltf_bvh* bvh, const gltf_bounds* bounds, gltf_bounds_flags bounds_flags)
+{
+	bvh_refit_job job{ .bvh = bvh, .bounds = bounds };
+	size_t subtree_count = bvh->subtree_offsets.data_length ? bvh->subtree_offsets.data_length - 1 : 0;
+	bool has_workers = parsing_job_system.run || parsing_thread_count() > 1;
+	if ((bounds_flags & gltf_bounds_parallel) && subtree_count > 1 && has_workers)
+		run_parsing_jobs(refit_bvh_subtree_job, &job, subtree_count);
+	else
+		for (size_t ii = 0; ii < subtree_count; ++ii)
+			refit_bvh_subtree_job(&job, ii);
+	refit_bvh_nodes(bvh, bounds, 0, bvh->top_node_count);
+}
+
+void acp_vulkan::gltf_bvh_free(gltf_bvh* bvh, VkAllocationCallbacks* host_allocator)
+{
+	free_gltf_buffer(bvh->nodes, host_allocator);
+	free_gltf_buffer(bvh->items, host_allocator);
+	free_gltf_buffer(bvh->subtree_offsets, host_allocator);
+	*bvh = {};
+}
 
-	if (gltf_size < offset)
+static bool box_inside_planes(const float* min, const float* max, const float* planes, uint32_t plane_count)
+{
+	for (uint32_t ii = 0; ii < plane_count; ++ii)
 	{
-		if (host_allocator)
-			host_allocator->pfnFree(host_allocator->pUserData, gltf_data);
-		else
-			delete[] gltf_data;
+		// The corner furthest along the normal.
+		const float* plane = planes + ii * 4;
+		float distance = plane[0] * (plane[0] >= 0.0f ? max[0] : min[0]) + plane[1] * (plane[1] >= 0.0f ? max[1] : min[1]) +
+			plane[2] * (plane[2] >= 0.0f ? max[2] : min[2]) + plane[3];
+		if (!(distance >= 0.0f))
+			return false;
+	}
+	return true;
+}
 
-		return {};
+static bool box_hit_by_ray(const float* min, const float* max, const float* origin, const float* inverse_direction, float max_distance)
+{
+	float near_distance = 0.0f, far_distance = max_distance;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		float t0 = (min[ii] - origin[ii]) * inverse_direction[ii];
+		float t1 = (max[ii] - origin[ii]) * inverse_direction[ii];
+		// fminf and fmaxf drop the NaN of a ray starting on a slab it runs along.
+		near_distance = fmaxf(near_distance, fminf(t0, t1));
+		far_distance = fminf(far_distance, fmaxf(t0, t1));
 	}
+	return near_distance <= far_distance;
+}
 
-	acp_vulkan::gltf_data out = is_binary_gltf(gltf_data, gltf_size) ?
-		acp_vulkan::binary_gltf_data_from_memory(gltf_data, gltf_size, host_allocator) :
-		acp_vulkan::gltf_data_from_memory(gltf_data, gltf_size, host_allocator);
+template<typename F>
+static uint32_t query_bvh(const acp_vulkan::gltf_bvh* bvh, const acp_vulkan::gltf_bounds* bounds, F hits, uint32_t* out)
+{
+	if (!bvh->nodes.data_length)
+		return 0;
+	uint32_t stack[BVH_MAX_DEPTH + 1];
+	uint32_t stack_size = 0;
+	uint32_t written = 0;
+	stack[stack_size++] = 0;
+	while (stack_size)
+	{
+		const acp_vulkan::gltf_bvh::node& node = bvh->nodes.data[stack[--stack_size]];
+		if (!hits(node.min, node.max))
+			continue;
+		if (!node.count)
+		{
+			stack[stack_size++] = node.first + 1;
+			stack[stack_size++] = node.first;
+			continue;
+		}
+		for (uint32_t ii = node.first; ii < node.first + node.count; ++ii)
+		{
+			uint32_t item = bvh->items.data[ii];
+			if (hits(bounds[item].min, bounds[item].max))
+				out[written++] = item;
+		}
+	}
+	return written;
+}
 
-	if (host_allocator)
-		host_allocator->pfnFree(host_allocator->pUserData, gltf_data);
-	else
-		delete[] gltf_data;
+uint32_t acp_vulkan::gltf_bvh_cull(const gltf_bvh* bvh, const gltf_bounds* bounds, const float* planes, uint32_t plane_count, uint32_t* out)
+{
+	return query_bvh(bvh, bounds, [=](const float* min, const float* max) { return box_inside_planes(min, max, planes, plane_count); }, out);
+}
 
-	return out;
+uint32_t acp_vulkan::gltf_bvh_raycast(const gltf_bvh* bvh, const gltf_bounds* bounds, const float* origin, const float* direction, float max_distance, uint32_t* out)
+{
+	float inverse_direction[3]{ 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+	return query_bvh(bvh, bounds, [&](const float* min, const float* max) { return box_hit_by_ray(min, max, origin, inverse_direction, max_distance); }, out);
 }
 
 void acp_vulkan::gltf_data_free(gltf_data* gltf_data, VkAllocationCallbacks* host_allocator)
 {
+	release_resolved_files_of(gltf_data, host_allocator);
+	release_sparse_resolved_of(gltf_data, host_allocator);
+
+	if (gltf_data->arena)
+	{
+		release_arena_of(gltf_data, host_allocator);
+		release_source_of(gltf_data, host_allocator);
+		gltf_data->gltf_state = acp_vulkan::gltf_data::gltf_state_type::deleted;
+		return;
+	}
+
+	// Everything was allocated through the source callbacks, they skip the strings that point in to the source.
+	acp_vulkan::gltf_source* source = gltf_data->source;
+	if (source)
+		host_allocator = &source->callbacks;
+
 	gltf_data->gltf_state = acp_vulkan::gltf_data::gltf_state_type::deleted;
 
 	delete_asset_data(&gltf_data->asset, host_allocator);
@@ -2572,5 +10738,10 @@ void acp_vulkan::gltf_data_free(gltf_data* gltf_data, VkAllocationCallbacks* hos
 		delete_animation_data(&gltf_data->animations.data[ii], host_allocator);
 	free_gltf_buffer(gltf_data->animations, host_allocator);
 
-	free_gltf_buffer(gltf_data->embedded_buffer, host_allocator);
+	if (gltf_data->embedded_buffer_borrowed)
+		gltf_data->embedded_buffer = {};
+	else
+		free_gltf_buffer(gltf_data->embedded_buffer, host_allocator);
+
+	release_source_of(gltf_data, host_allocator);
 }
\ No newline at end of file
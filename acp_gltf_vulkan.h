@@ -4,6 +4,10 @@
 
 namespace acp_vulkan
 {
+	struct gltf_arena;
+	struct gltf_source;
+	struct gltf_resolved_files;
+
 	struct gltf_data
 	{
 		enum gltf_state_type
@@ -16,10 +20,18 @@ namespace acp_vulkan
 			invalid_binary_data_magic,
 			invalid_binary_data_version,
 			invalid_binary_data_with_zero_length,
+			invalid_cache,
 			deleted
 		} gltf_state;
 		size_t parsing_error_location;
 
+		// Tokens the tokenizer had to lex to consume the JSON bytes, ideally one lex per token in the input.
+		struct parsing_stats_type
+		{
+			size_t tokens_lexed{ 0 };
+			size_t bytes_consumed{ 0 };
+		} parsing_stats;
+
 		template<typename T>
 		struct data_view
 		{
@@ -47,6 +59,8 @@ namespace acp_vulkan
 			uint32_t buffer;
 			uint32_t byte_offset;
 			uint32_t byte_length;
+			// 0 when the elements are tightly packed.
+			uint32_t byte_stride;
 		};
 		data_view<buffer_view> buffer_views;
 
@@ -57,6 +71,8 @@ namespace acp_vulkan
 			uint32_t byte_length;
 			data_view<uint8_t> embedded_bytes;
 			string_view embedded_mime;
+			// The first byte_length bytes of the file uri points at, set by gltf_resolve_uris. Buffers and images with the same uri share them.
+			data_view<uint8_t> resolved_bytes;
 		};
 		data_view<buffer> buffers;
 
@@ -67,14 +83,19 @@ namespace acp_vulkan
 			string_view mime_type;
 			data_view<uint8_t> embedded_bytes;
 			string_view embedded_mime;
+			// The file uri points at, set by gltf_resolve_uris with gltf_resolve_images.
+			data_view<uint8_t> resolved_bytes;
 		};
 		data_view<image> images;
 
 		struct accesor
 		{
-			uint32_t buffer_view;
+			// Without a buffer view the accessor reads as zeros.
+			bool has_buffer_view;
+			uint32_t buffer_view{ UINT32_MAX };
 			uint32_t byte_offset;
 			enum class component_type_type {
+				BYTE = 5120,
 				UNSIGNED_BYTE = 5121,
 				SHORT = 5122,
 				UNSIGNED_SHORT = 5123,
@@ -117,6 +138,8 @@ namespace acp_vulkan
 			};
 			bool is_sparse;
 			sparse_type sparse;
+			// The accessor with the sparse values applied, tightly packed in its own component type. Set by gltf_resolve_sparse_accessors.
+			data_view<uint8_t> sparse_resolved_bytes;
 
 			string_view name;
 		};
@@ -195,8 +218,10 @@ namespace acp_vulkan
 			struct primitive_type
 			{
 				data_view<pair<attribute, uint32_t>> attributes;
-				uint32_t indices;
-				uint32_t material;
+				bool has_indices;
+				uint32_t indices{ UINT32_MAX };
+				bool has_material;
+				uint32_t material{ UINT32_MAX };
 				mode mode{ mode::TRIANGLES };
 				struct target
 				{
@@ -394,13 +419,612 @@ namespace acp_vulkan
 		data_view<animation> animations;
 
 		data_view<uint8_t> embedded_buffer;
+		// embedded_buffer points in to the memory given to binary_gltf_data_from_memory, gltf_data_free leaves it alone.
+		bool embedded_buffer_borrowed{ false };
+
+		// Set when the data was loaded with gltf_load_arena_allocation, owns every allocation above.
+		gltf_arena* arena{ nullptr };
+		// Set when the data was loaded with gltf_load_strings_in_source or from a binary file, owns the input the strings or embedded_buffer point in to.
+		gltf_source* source{ nullptr };
+		// Set by gltf_resolve_uris, owns the files resolved_bytes point in to.
+		gltf_resolved_files* resolved_files{ nullptr };
+	};
+
+	// Instruction set used to find whitespace and quotes in the JSON, to decode base64 data uris (sse2 decodes with SSSE3 when the cpu has it),
+	// to convert accessors, to compose node transforms, to sample animation rotations, to skin vertices and to blend morph targets (sse2 for avx2 as well).
+	// automatic picks the widest one the cpu supports, an unsupported request falls back to the next narrower one.
+	enum class gltf_scan_backend
+	{
+		automatic,
+		scalar,
+		sse2,
+		avx2
 	};
+	void gltf_set_scan_backend(gltf_scan_backend backend);
+	gltf_scan_backend gltf_get_scan_backend();
+
+	enum gltf_load_flag_bits : uint32_t
+	{
+		gltf_load_default = 0,
+		// Bump allocate everything from a few large blocks sized from the input, gltf_data_free releases the blocks instead of walking the data.
+		gltf_load_arena_allocation = 1 << 0,
+		// Keep a single copy of the input (the file buffer itself for gltf_data_from_file) and point every string_view in to it instead of allocating each string.
+		gltf_load_strings_in_source = 1 << 1,
+		// binary_gltf_data_from_memory points embedded_buffer at the BIN chunk in the input instead of copying it, the input has to outlive the gltf_data.
+		gltf_load_borrow_binary_chunk = 1 << 2,
+		// Find the top level arrays (nodes, accessors, meshes...) with a bracket matching pre-pass and parse them split in to chunks on several threads,
+		// base64 data uris are decoded in slices on the same threads. host_allocator has to be thread safe.
+		gltf_load_parallel_sections = 1 << 3,
+	};
+	typedef uint32_t gltf_load_flags;
+
+	// Runs job(job_data, ii) for every ii in [0, job_count) on any threads and returns once all of them finished.
+	struct gltf_job_system
+	{
+		void* user_data;
+		void (*run)(void* user_data, void (*job)(void* job_data, size_t job_index), void* job_data, size_t job_count);
+	};
+	// Threads used by gltf_load_parallel_sections, 0 uses every hardware thread. When job_system is set it runs the jobs instead of threads started for each load.
+	void gltf_set_parsing_threads(uint32_t thread_count, const gltf_job_system* job_system);
+
+	// String views hold the string as written in the JSON, this decodes its escape sequences.
+	// out needs room for in.data_length bytes, returns the decoded length.
+	size_t gltf_string_unescape(gltf_data::string_view in, char* out);
 
 	//todo(alex) : Investigate how to turn this in to Vulkan friendly data.
-	gltf_data gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator);
-	gltf_data binary_gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator);
+	gltf_data gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags = gltf_load_default);
+	gltf_data binary_gltf_data_from_memory(const char* data, size_t data_size, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags = gltf_load_default);
 
-	gltf_data gltf_data_from_file(const char* path, VkAllocationCallbacks* host_allocator);
+	gltf_data gltf_data_from_file(const char* path, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags = gltf_load_default);
+
+	// The source a cache was written from. Caches match on source_size and source_hash, source_mtime (nanoseconds, 0 where the platform has none)
+	// only lets gltf_data_from_file_cached skip hashing an unchanged file.
+	struct gltf_cache_key
+	{
+		uint64_t source_size{ 0 };
+		uint64_t source_mtime{ 0 };
+		uint64_t source_hash{ 0 };
+	};
+	// Fills key from the file at path, it is read whole for the hash. Returns false when it cannot be read.
+	bool gltf_cache_key_for_file(const char* path, gltf_cache_key* key);
+	// Writes gltf_data as one versioned blob in which every view is an offset from the start of the blob, resolved_bytes and sparse_resolved_bytes are left out.
+	// Returns the blob size, call with out null to get it. Returns 0 when gltf_data is not valid, or out is too small or not 16 byte aligned.
+	size_t gltf_cache_serialize(const gltf_data* gltf_data, const gltf_cache_key& key, void* out, size_t out_size);
+	// Uses a blob gltf_cache_serialize wrote in place, its offsets are fixed up in to pointers: data has to be writable, 16 byte aligned and outlive the gltf_data.
+	// Returns invalid_cache when the blob is damaged, comes from another version or struct layout, or was written for another source than expected_key (when set).
+	gltf_data gltf_cache_from_memory(void* data, size_t data_size, const gltf_cache_key* expected_key, VkAllocationCallbacks* host_allocator);
+	// Maps the cache at cache_path copy on write and fixes it up when it was written from the file at path as it is now, otherwise parses path like
+	// gltf_data_from_file (load_flags only apply then) and writes the cache again. When only the mtime changed the source is hashed and the cache restamped.
+	// External files are not part of the key, gltf_resolve_uris works on the result as usual.
+	gltf_data gltf_data_from_file_cached(const char* path, const char* cache_path, VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags = gltf_load_default);
+
+	// Top level sections of a glTF file.
+	enum gltf_section_bits : uint32_t
+	{
+		gltf_section_asset = 1 << 0,
+		gltf_section_buffers = 1 << 1,
+		gltf_section_buffer_views = 1 << 2,
+		gltf_section_images = 1 << 3,
+		gltf_section_accessors = 1 << 4,
+		gltf_section_textures = 1 << 5,
+		gltf_section_meshes = 1 << 6,
+		gltf_section_materials = 1 << 7,
+		gltf_section_nodes = 1 << 8,
+		gltf_section_scenes = 1 << 9,
+		// The default scene index.
+		gltf_section_scene = 1 << 10,
+		gltf_section_samplers = 1 << 11,
+		gltf_section_skins = 1 << 12,
+		gltf_section_cameras = 1 << 13,
+		gltf_section_animations = 1 << 14,
+	};
+	typedef uint32_t gltf_sections;
+
+	// Parses a JSON glTF handed over in pieces as they are read or decompressed. Every top level section is parsed as soon as its last byte arrives,
+	// and the data uris of buffers and images are decoded then. Strings are always copied (gltf_load_strings_in_source is ignored), so only the bytes
+	// of the section still arriving are kept. size_hint is the expected input size, used to size the arena with gltf_load_arena_allocation.
+	// gltf_load_parallel_sections decodes data uris on the parsing threads, the sections themselves are parsed on the appending thread.
+	struct gltf_stream_parser;
+	gltf_stream_parser* gltf_stream_parser_create(VkAllocationCallbacks* host_allocator, gltf_load_flags load_flags = gltf_load_default, size_t size_hint = 0);
+	// Returns parsing_error when the input can not be parsed, later calls do nothing and finish reports the error. An entry that fails is tried
+	// again as more arrives (a stray bracket can end it early), so most errors are only reported by finish.
+	gltf_data::gltf_state_type gltf_stream_parser_append(gltf_stream_parser* parser, const char* data, size_t data_size);
+	// The sections parsed so far. Their views in the data can be read, and gltf_resolve_uris run on it once the buffers (and images) are in, while the rest arrives.
+	gltf_sections gltf_stream_parser_sections(const gltf_stream_parser* parser);
+	gltf_data* gltf_stream_parser_data(gltf_stream_parser* parser);
+	// Call after the last append, returns the data as gltf_data_from_memory would and frees the parser.
+	gltf_data gltf_stream_parser_finish(gltf_stream_parser* parser);
+	// Frees a parser that will not be finished, along with everything it parsed.
+	void gltf_stream_parser_free(gltf_stream_parser* parser);
 
 	void gltf_data_free(gltf_data* gltf_data, VkAllocationCallbacks* host_allocator);
+
+	// Loads the file at path for gltf_resolve_uris, data has to stay valid until release is called with it.
+	struct gltf_file_reader
+	{
+		void* user_data;
+		bool (*read)(void* user_data, const char* path, uint8_t** data, size_t* data_size);
+		void (*release)(void* user_data, uint8_t* data, size_t data_size);
+	};
+
+	enum gltf_resolve_flag_bits : uint32_t
+	{
+		// Only buffers are resolved.
+		gltf_resolve_default = 0,
+		// Resolve the images with a uri as well.
+		gltf_resolve_images = 1 << 0,
+		// Read the files on the threads set with gltf_set_parsing_threads, host_allocator and the reader have to be thread safe.
+		gltf_resolve_parallel_reads = 1 << 1,
+	};
+	typedef uint32_t gltf_resolve_flags;
+
+	// Loads the external files the buffer (and image) uris reference relative to base_directory, the directory of the glTF file, in to resolved_bytes.
+	// Every distinct uri is read once, by reader when set or otherwise mapped like gltf_data_from_file does. data: uris are left to embedded_bytes.
+	// Returns valid, or the state of the first file that failed, the others are still resolved. The files are released by gltf_data_free.
+	gltf_data::gltf_state_type gltf_resolve_uris(gltf_data* gltf_data, const char* base_directory, VkAllocationCallbacks* host_allocator,
+		gltf_resolve_flags resolve_flags = gltf_resolve_default, const gltf_file_reader* reader = nullptr);
+
+	// Bytes behind a buffer: embedded_bytes for data uris, resolved_bytes for external files or embedded_buffer for the GLB BIN chunk.
+	gltf_data::data_view<uint8_t> gltf_buffer_bytes(const gltf_data* gltf_data, uint32_t buffer_index);
+
+	// target_format has as many components as the accessor type, or a single one that every component (of a matrix for example) is converted to.
+	// Normalized integers read as [0, 1] or [-1, 1], floats are clamped and rounded in to normalized formats and integers convert to integers by value.
+	// Bytes gltf_accessor_read writes, 0 when target_format is not supported for the accessor.
+	size_t gltf_accessor_read_size(const gltf_data* gltf_data, uint32_t accessor_index, VkFormat target_format);
+	// Writes the accessor elements tightly packed as target_format, returns false when the data is missing, out of range or cannot be converted.
+	// Sparse values are scattered over the base elements unless gltf_resolve_sparse_accessors already cached the result.
+	bool gltf_accessor_read(const gltf_data* gltf_data, uint32_t accessor_index, VkFormat target_format, void* out);
+	// The accessor data in place when it is already tightly packed as target_format, an empty view when it needs gltf_accessor_read.
+	gltf_data::data_view<const uint8_t> gltf_accessor_packed_view(const gltf_data* gltf_data, uint32_t accessor_index, VkFormat target_format);
+	// Applies the sparse values of every sparse accessor once in to sparse_resolved_bytes, later reads convert from them and packed views return them.
+	// Call after the buffers are available (gltf_resolve_uris for external files), gltf_data_free releases them. Returns false when an accessor could not be resolved.
+	bool gltf_resolve_sparse_accessors(gltf_data* gltf_data, VkAllocationCallbacks* host_allocator);
+
+	// Formats are plain conversions of the accessor (see gltf_accessor_read) except for these quantized encodings:
+	// * POSITION as R16G16B16A16_UNORM, normalized to the bounds of its mesh (see gltf_mesh_buffers::mesh_data), w is 1.
+	// * NORMAL as R16G16_SNORM, octahedral: n = vec3(e, 1 - |e.x| - |e.y|), if n.z < 0 then n.xy = (1 - |n.yx|) * sign(n.xy), then normalize.
+	// * NORMAL or TANGENT as A2B10G10R10_SNORM_PACK32, the tangent handedness goes in alpha. Devices do not have to support it as a vertex format.
+	// UVs quantize to half floats with a plain R16G16_SFLOAT conversion.
+	struct gltf_vertex_attribute
+	{
+		gltf_data::attribute attribute;
+		VkFormat format;
+	};
+	// Bytes the attribute takes in a vertex, 0 when its format is not supported.
+	uint32_t gltf_vertex_attribute_size(const gltf_vertex_attribute& attribute);
+
+	enum gltf_mesh_flag_bits : uint32_t
+	{
+		gltf_mesh_default = 0,
+		// Every attribute gets its own tightly packed stream in vertices, one after the other, instead of sharing an interleaved vertex.
+		gltf_mesh_deinterleaved = 1 << 0,
+		// Build or optimize the primitives on the threads set with gltf_set_parsing_threads, host_allocator has to be thread safe.
+		gltf_mesh_parallel_decode = 1 << 1,
+	};
+	typedef uint32_t gltf_mesh_flags;
+
+	struct gltf_mesh_buffers
+	{
+		// One per mesh primitive, in mesh order. Draw with vkCmdDrawIndexed(index_count, 1, first_index, vertex_offset, 0) or the matching VkDrawIndexedIndirectCommand.
+		struct draw_range
+		{
+			uint32_t mesh;
+			uint32_t primitive;
+			uint32_t first_index;
+			int32_t vertex_offset;
+			uint32_t index_count;
+			uint32_t vertex_count;
+			// UINT32_MAX when the primitive has no material.
+			uint32_t material;
+			gltf_data::mesh::mode mode;
+		};
+		gltf_data::data_view<draw_range> draw_ranges;
+		// One per gltf mesh.
+		struct mesh_data
+		{
+			// position = quantized position * position_scale + position_offset with R16G16B16A16_UNORM positions, 1 and 0 otherwise.
+			float position_scale[3];
+			float position_offset[3];
+			// Bytes the vertices of the mesh take, and would take with every attribute decoded to 32 bit floats.
+			uint64_t vertex_bytes;
+			uint64_t float_vertex_bytes;
+			// The vertices of the draw ranges of the mesh, one range after the other.
+			uint32_t first_vertex;
+			uint32_t vertex_count;
+		};
+		gltf_data::data_view<mesh_data> meshes;
+		gltf_data::data_view<uint8_t> vertices;
+		// Indices relative to vertex_offset, primitives without indices get 0, 1, 2... so every range draws indexed.
+		gltf_data::data_view<uint32_t> indices;
+		uint32_t vertex_count;
+		// Bytes per interleaved vertex, 0 with gltf_mesh_deinterleaved.
+		uint32_t vertex_stride;
+		// The requested attributes and, for each of them, the offset in the vertex when interleaved or where its stream starts in vertices (256 byte aligned) otherwise.
+		gltf_data::data_view<gltf_vertex_attribute> attributes;
+		gltf_data::data_view<uint32_t> attribute_offsets;
+		// Filled by gltf_mesh_buffers_build_lods, lod_level_count per draw range (lods[draw range * lod_level_count + level]).
+		// Draw like the draw range with its vertex_offset, the indices live after those of the draw ranges in indices.
+		struct lod_range
+		{
+			uint32_t first_index;
+			uint32_t index_count;
+			// Largest collapse error of this level and the ones before it, relative to the largest extent of the draw range.
+			float error;
+		};
+		gltf_data::data_view<lod_range> lods;
+		uint32_t lod_level_count;
+	};
+	// Decodes the requested attributes of every mesh primitive in to one vertex buffer and their indices in to one index buffer, ready to upload at once.
+	// Attributes a primitive does not have are zeros. Interleaved attributes start on 4 byte boundaries, the padding is zeroed.
+	// Returns false when an accessor cannot be read as its requested format (one element per vertex, no fewer components than the accessor has),
+	// the requested attributes of a primitive have different counts, or the indices are not SCALAR or index past the primitive's vertices.
+	// Quantized positions share the bounds of their mesh so its primitives keep meeting without cracks.
+	bool gltf_mesh_buffers_build(const gltf_data* gltf_data, const gltf_vertex_attribute* attributes, uint32_t attribute_count,
+		VkAllocationCallbacks* host_allocator, gltf_mesh_buffers* out, gltf_mesh_flags mesh_flags = gltf_mesh_default);
+	void gltf_mesh_buffers_free(gltf_mesh_buffers* mesh_buffers, VkAllocationCallbacks* host_allocator);
+
+	// Cache misses of a 16 entry FIFO post transform cache per triangle (ACMR) and per referenced vertex (ATVR), over every optimized draw range.
+	struct gltf_mesh_optimize_stats
+	{
+		float acmr_before;
+		float acmr_after;
+		float atvr_before;
+		float atvr_after;
+		uint32_t optimized_draw_ranges;
+	};
+	// Reorders the triangles of every TRIANGLES draw range for the post transform cache (Tipsify), then orders the resulting clusters so outward facing
+	// ones draw first to cut overdraw (needs a R32G32B32_SFLOAT or R16G16B16A16_UNORM POSITION attribute) and finally renumbers the vertices in the order the indices fetch them.
+	// Ranges with out of range indices are left alone.
+	void gltf_mesh_buffers_optimize(gltf_mesh_buffers* mesh_buffers, VkAllocationCallbacks* host_allocator, gltf_mesh_optimize_stats* stats = nullptr,
+		gltf_mesh_flags mesh_flags = gltf_mesh_default);
+
+	struct gltf_mesh_lod_level
+	{
+		// Fraction of the triangles of the draw range to keep.
+		float triangle_ratio;
+		// Stop collapsing edges before the error gets over this, relative to the largest extent of the draw range.
+		float max_error;
+	};
+	// Simplifies every TRIANGLES draw range with quadric error edge collapses in to level_count levels of detail, each continuing from the one before,
+	// and appends their indices to the index buffer so they share the vertices. Open borders and vertices split by uv or normal seams only slide along them.
+	// Levels that cannot be simplified further reuse the indices before them, other ranges get their own indices with error 0.
+	// Replaces levels built before. Levels come out ordered for the post transform cache, gltf_mesh_buffers_optimize renumbers their vertices along with the range.
+	// Returns false without a R32G32B32_SFLOAT or R16G16B16A16_UNORM POSITION attribute.
+	bool gltf_mesh_buffers_build_lods(gltf_mesh_buffers* mesh_buffers, const gltf_mesh_lod_level* levels, uint32_t level_count, VkAllocationCallbacks* host_allocator,
+		gltf_mesh_flags mesh_flags = gltf_mesh_default);
+
+	// 64 bytes, laid out to be read as a std430 struct by task and mesh shaders.
+	struct gltf_meshlet
+	{
+		// Where the meshlet starts in gltf_meshlet_buffers vertices and triangles.
+		uint32_t vertex_offset;
+		uint32_t triangle_offset;
+		uint32_t vertex_count;
+		uint32_t triangle_count;
+		// Bounding sphere of the meshlet vertices.
+		float center[3];
+		float radius;
+		// Every triangle faces away from a camera at camera_position when dot(normalize(cone_apex - camera_position), cone_axis) >= cone_cutoff,
+		// cone_cutoff is 1 when the normals spread too much to ever cull the meshlet.
+		float cone_apex[3];
+		float cone_cutoff;
+		float cone_axis[3];
+		// The gltf_mesh_buffers draw range the meshlet belongs to.
+		uint32_t draw_range;
+	};
+	struct gltf_meshlet_buffers
+	{
+		struct draw_range
+		{
+			uint32_t first_meshlet;
+			uint32_t meshlet_count;
+		};
+		// One per draw range of the gltf_mesh_buffers, ranges that are not TRIANGLES have no meshlets.
+		gltf_data::data_view<draw_range> draw_ranges;
+		gltf_data::data_view<gltf_meshlet> meshlets;
+		// Indices in to the packed vertex buffer, vertex_offset of the draw range included.
+		gltf_data::data_view<uint32_t> vertices;
+		// One per triangle, three 8 bit indices in to the vertices of its meshlet in the low 24 bits.
+		gltf_data::data_view<uint32_t> triangles;
+	};
+	// Splits the TRIANGLES draw ranges in to meshlets of up to 64 vertices and 124 triangles with their culling bounds. Triangles are taken in index order,
+	// run gltf_mesh_buffers_optimize first for tighter meshlets.
+	// Returns false without a R32G32B32_SFLOAT or R16G16B16A16_UNORM POSITION attribute or when a triangle range has out of range indices.
+	bool gltf_meshlet_buffers_build(const gltf_mesh_buffers* mesh_buffers, VkAllocationCallbacks* host_allocator, gltf_meshlet_buffers* out,
+		gltf_mesh_flags mesh_flags = gltf_mesh_default);
+	void gltf_meshlet_buffers_free(gltf_meshlet_buffers* meshlet_buffers, VkAllocationCallbacks* host_allocator);
+
+	// The node hierarchy of a scene flattened for animation. Entries are the nodes breadth first, so parents come before their children and the entries of
+	// every depth are contiguous. Per entry streams are structures of arrays: component ii of entry jj is at [ii * entry_count + jj].
+	struct gltf_scene_transforms
+	{
+		uint32_t entry_count;
+		// The gltf node of every entry and the entry of its parent, UINT32_MAX for the roots of the scene.
+		gltf_data::data_view<uint32_t> nodes;
+		gltf_data::data_view<uint32_t> parents;
+		// The entry of every gltf node, UINT32_MAX for nodes outside the scene.
+		gltf_data::data_view<uint32_t> node_entries;
+		// Where every depth starts in the entries, with entry_count at the end.
+		gltf_data::data_view<uint32_t> depth_offsets;
+		// Local transform with 3, 4 (quaternion xyzw) and 3 components, node matrices are decomposed.
+		gltf_data::data_view<float> translations;
+		gltf_data::data_view<float> rotations;
+		gltf_data::data_view<float> scales;
+		// 16 components, column major like gltf node matrices.
+		gltf_data::data_view<float> world_matrices;
+		// Entries whose local transform changed since the last update.
+		gltf_data::data_view<uint8_t> dirty;
+	};
+	// Flattens scene (UINT32_MAX for the default scene, or the first one without it) and computes every world matrix.
+	// Returns false when the scene does not exist or its nodes do not form a tree.
+	bool gltf_scene_transforms_build(const gltf_data* gltf_data, uint32_t scene, VkAllocationCallbacks* host_allocator, gltf_scene_transforms* out);
+	// Sets the local transform of a gltf node and marks it dirty, null parts stay as they are. Nodes outside the scene are ignored.
+	void gltf_scene_transforms_set_local(gltf_scene_transforms* transforms, uint32_t node, const float* translation, const float* rotation, const float* scale);
+	// Marks a gltf node dirty after writing its translations, rotations or scales directly.
+	void gltf_scene_transforms_mark_dirty(gltf_scene_transforms* transforms, uint32_t node);
+	// Recomputes the world matrices of the dirty entries and their subtrees only, returns how many entries were updated.
+	uint32_t gltf_scene_transforms_update(gltf_scene_transforms* transforms);
+	void gltf_scene_transforms_free(gltf_scene_transforms* transforms, VkAllocationCallbacks* host_allocator);
+
+	// An animation ready to sample. Every sampler is converted to float streams: times per input accessor and one stream per value component
+	// (in tangents, values and out tangents for CUBICSPLINE), so the keys of one component are contiguous.
+	struct gltf_animation_clip
+	{
+		struct channel
+		{
+			uint32_t node;
+			gltf_data::animation::channel::target_type::path_type path;
+			gltf_data::animation::sampler::interpolation_type interpolation;
+			// 3 for translation and scale, 4 for rotation and the morph target count for weights.
+			uint32_t component_count;
+			uint32_t key_count;
+			uint32_t first_time;
+			// Stream ii of the channel starts at values[first_value + ii * key_count].
+			uint32_t first_value;
+			// Where the sampled components of the channel go in the output of gltf_animation_clip_sample.
+			uint32_t first_output;
+		};
+		gltf_data::data_view<channel> channels;
+		gltf_data::data_view<float> times;
+		gltf_data::data_view<float> values;
+		// Rotation channels, sampled four at a time, and one track per component of the other channels. Cubic ones come after the linear and step ones.
+		struct track
+		{
+			uint32_t channel;
+			// Where the value stream of the component starts in values and where it goes in the output.
+			uint32_t stream;
+			uint32_t output;
+		};
+		gltf_data::data_view<uint32_t> rotations;
+		gltf_data::data_view<track> tracks;
+		uint32_t cubic_rotations;
+		uint32_t cubic_tracks;
+		// Floats gltf_animation_clip_sample writes.
+		uint32_t output_count;
+		// Time of the last key.
+		float duration;
+	};
+	// Returns false when a channel or sampler references missing data or the output does not match the keys.
+	bool gltf_animation_clip_build(const gltf_data* gltf_data, uint32_t animation, VkAllocationCallbacks* host_allocator, gltf_animation_clip* out);
+	void gltf_animation_clip_free(gltf_animation_clip* clip, VkAllocationCallbacks* host_allocator);
+
+	// Playback state of one instance of a clip: the key every channel was at last, sequential playback steps forward from it instead of searching.
+	struct gltf_animation_cursor
+	{
+		gltf_data::data_view<uint32_t> keys;
+		// Interpolation factor and key interval of every channel for the current sample.
+		gltf_data::data_view<float> factors;
+	};
+	void gltf_animation_cursor_init(const gltf_animation_clip* clip, VkAllocationCallbacks* host_allocator, gltf_animation_cursor* out);
+	void gltf_animation_cursor_free(gltf_animation_cursor* cursor, VkAllocationCallbacks* host_allocator);
+
+	enum gltf_animation_flag_bits : uint32_t
+	{
+		gltf_animation_default = 0,
+		// Normalized lerp for linear rotations instead of slerp, cheaper and close for dense keys.
+		gltf_animation_nlerp = 1 << 0,
+		// Sample the instances of gltf_animation_sample_instances on the threads set with gltf_set_parsing_threads.
+		gltf_animation_parallel_instances = 1 << 1,
+	};
+	typedef uint32_t gltf_animation_flags;
+
+	// Samples every channel at time (clamped to the keys of the channel) in to out, output_count floats. Wrap time with duration to loop.
+	// Rotations use sse2 unless gltf_set_scan_backend asks for scalar.
+	void gltf_animation_clip_sample(const gltf_animation_clip* clip, float time, gltf_animation_cursor* cursor, float* out,
+		gltf_animation_flags animation_flags = gltf_animation_default);
+	struct gltf_animation_instance
+	{
+		const gltf_animation_clip* clip;
+		float time;
+		gltf_animation_cursor* cursor;
+		float* out;
+	};
+	void gltf_animation_sample_instances(const gltf_animation_instance* instances, uint32_t instance_count, gltf_animation_flags animation_flags = gltf_animation_default);
+	// Writes the sampled translations, rotations and scales to the local transforms of their nodes and marks them dirty, weights are left in sampled.
+	void gltf_animation_clip_apply(const gltf_animation_clip* clip, const float* sampled, gltf_scene_transforms* transforms);
+
+	// Joint matrices of a skin, the world matrix of every joint times its inverse bind matrix. The transform of the skinned mesh node is ignored like the gltf spec asks.
+	struct gltf_skin_palette
+	{
+		uint32_t joint_count;
+		// The gltf_scene_transforms entry of every joint.
+		gltf_data::data_view<uint32_t> joint_entries;
+		// 16 per joint, column major, identity when the skin has none.
+		gltf_data::data_view<float> inverse_bind_matrices;
+		// The top three rows of every joint matrix, 12 floats per joint (a std430 vec4[3]).
+		gltf_data::data_view<float> matrices;
+	};
+	// Returns false when the skin does not exist, a joint is outside the scene of transforms or the inverse bind matrices are not one MAT4 per joint.
+	bool gltf_skin_palette_build(const gltf_data* gltf_data, uint32_t skin, const gltf_scene_transforms* transforms, VkAllocationCallbacks* host_allocator,
+		gltf_skin_palette* out);
+	// Recomputes the joint matrices from the world matrices, call after gltf_scene_transforms_update.
+	void gltf_skin_palette_update(gltf_skin_palette* palette, const gltf_scene_transforms* transforms);
+	void gltf_skin_palette_free(gltf_skin_palette* palette, VkAllocationCallbacks* host_allocator);
+
+	// Byte offsets of the attributes skinning reads and writes in an interleaved vertex, UINT32_MAX for a missing NORMAL or TANGENT.
+	struct gltf_skinning_layout
+	{
+		uint32_t stride;
+		uint32_t position;
+		uint32_t normal;
+		uint32_t tangent;
+		uint32_t joints;
+		uint32_t weights;
+	};
+	// Skinnable vertices are interleaved with POSITION as R32G32B32_SFLOAT, JOINTS_0 as R16G16B16A16_UINT and WEIGHTS_0 as R32G32B32A32_SFLOAT,
+	// NORMAL and TANGENT are optional but have to be R32G32B32_SFLOAT and R32G32B32A32_SFLOAT when present. Returns false otherwise.
+	bool gltf_skinning_layout_for(const gltf_mesh_buffers* mesh_buffers, gltf_skinning_layout* out);
+
+	enum gltf_skinning_flag_bits : uint32_t
+	{
+		gltf_skinning_default = 0,
+		// Skin the instances of gltf_skin_vertices on the threads set with gltf_set_parsing_threads.
+		gltf_skinning_parallel_vertices = 1 << 0,
+	};
+	typedef uint32_t gltf_skinning_flags;
+
+	struct gltf_skinning_instance
+	{
+		const gltf_skin_palette* palette;
+		// The gltf mesh to skin.
+		uint32_t mesh;
+		// vertex_count vertices of the mesh (mesh_data first_vertex and vertex_count) in the layout of the mesh buffers, draw them with vertex_offset - first_vertex.
+		uint8_t* out;
+		// The vertices to skin in the same layout, the output of gltf_morph_vertices for example. Null skins those of the mesh buffers.
+		const uint8_t* source{ nullptr };
+	};
+	// Copies the vertices of every instance mesh to its out with position, normal and tangent blended by up to four joints. Normals and tangents are renormalized,
+	// joints outside the palette do not contribute. Uses sse2 unless gltf_set_scan_backend asks for scalar. Returns false when the vertices are not skinnable.
+	bool gltf_skin_vertices(const gltf_mesh_buffers* mesh_buffers, const gltf_skinning_instance* instances, uint32_t instance_count,
+		VkAllocationCallbacks* host_allocator, gltf_skinning_flags skinning_flags = gltf_skinning_default);
+
+	// Morph target deltas of one gltf mesh, ready to blend in to its packed vertices. Every target of every primitive is a span of deltas for one of
+	// POSITION, NORMAL and TANGENT, either dense (a delta per vertex of the primitive) or sparse (vertex indices and their deltas). Sparse accessors
+	// keep their own indices and dense targets that move less than half of the vertices are made sparse.
+	struct gltf_morph_targets
+	{
+		uint32_t mesh;
+		uint32_t target_count;
+		uint32_t vertex_count;
+		uint32_t vertex_stride;
+		// Byte offsets of POSITION, NORMAL and TANGENT in the vertex, UINT32_MAX when the mesh buffers do not have them.
+		uint32_t attribute_offsets[3];
+		struct span
+		{
+			uint32_t target;
+			// 0 for POSITION, 1 for NORMAL and 2 for TANGENT.
+			uint32_t attribute;
+			// The vertices the span moves are in [first_vertex, first_vertex + vertex_count), relative to the first vertex of the mesh.
+			uint32_t first_vertex;
+			uint32_t vertex_count;
+			// UINT32_MAX for dense spans, otherwise where the index_count vertex indices of the span start in indices.
+			uint32_t first_index;
+			uint32_t index_count;
+			// Where the deltas of the span start in deltas, 3 floats per vertex or index.
+			uint32_t first_delta;
+		};
+		// In target order, target_spans has the first span of every target followed by the span count.
+		gltf_data::data_view<span> spans;
+		gltf_data::data_view<uint32_t> target_spans;
+		gltf_data::data_view<uint32_t> indices;
+		gltf_data::data_view<float> deltas;
+	};
+	// mesh_buffers have to be interleaved, keep the vertices in accessor order (built without gltf_mesh_buffers_optimize) and POSITION, NORMAL and TANGENT, when the
+	// targets move them, have to be R32G32B32_SFLOAT (R32G32B32A32_SFLOAT for TANGENT). Targets of attributes the mesh buffers do not have are skipped.
+	// Returns false otherwise or when a target accessor cannot be read or does not have a delta per vertex.
+	bool gltf_morph_targets_build(const gltf_data* gltf_data, const gltf_mesh_buffers* mesh_buffers, uint32_t mesh, VkAllocationCallbacks* host_allocator,
+		gltf_morph_targets* out);
+	void gltf_morph_targets_free(gltf_morph_targets* targets, VkAllocationCallbacks* host_allocator);
+	// The default weights of a node, its own or those of its mesh, empty when it has none.
+	gltf_data::data_view<const float> gltf_morph_weights(const gltf_data* gltf_data, uint32_t node);
+
+	enum gltf_morph_flag_bits : uint32_t
+	{
+		gltf_morph_default = 0,
+		// Blend the instances of gltf_morph_vertices on the threads set with gltf_set_parsing_threads.
+		gltf_morph_parallel_instances = 1 << 0,
+	};
+	typedef uint32_t gltf_morph_flags;
+
+	struct gltf_morph_instance
+	{
+		const gltf_morph_targets* targets;
+		// target_count weights, from gltf_morph_weights or a sampled weights channel.
+		const float* weights;
+		// vertex_count vertices of the mesh in the layout of the mesh buffers, like gltf_skinning_instance::out.
+		uint8_t* out;
+	};
+	// Copies the vertices of every instance mesh to its out with the deltas of the targets added, scaled by their weights. Targets with a zero weight are skipped,
+	// the others accumulate in contiguous buffers (with sse2 unless gltf_set_scan_backend asks for scalar) over the vertices they move only.
+	// Returns false when the targets were built for other mesh buffers.
+	bool gltf_morph_vertices(const gltf_mesh_buffers* mesh_buffers, const gltf_morph_instance* instances, uint32_t instance_count,
+		VkAllocationCallbacks* host_allocator, gltf_morph_flags morph_flags = gltf_morph_default);
+
+	// An axis aligned box and a sphere around the same positions. Empty bounds have min above max and a negative radius.
+	struct gltf_bounds
+	{
+		float min[3];
+		float max[3];
+		float center[3];
+		float radius;
+	};
+
+	enum gltf_bounds_flag_bits : uint32_t
+	{
+		gltf_bounds_default = 0,
+		// Reads every POSITION accessor instead of trusting its min and max, for exact boxes and spheres tighter than the box.
+		// Positions are read anyway when the accessor is not FLOAT or has no min and max.
+		gltf_bounds_read_positions = 1 << 0,
+		// Runs on the threads set with gltf_set_parsing_threads.
+		gltf_bounds_parallel = 1 << 1,
+	};
+	typedef uint32_t gltf_bounds_flags;
+
+	// Mesh space bounds of every mesh primitive and of every mesh. Morph targets and skins are not taken in to account.
+	struct gltf_mesh_bounds
+	{
+		// The bounds of primitive jj of mesh ii are primitives[first_primitives[ii] + jj], first_primitives ends with the primitive count.
+		gltf_data::data_view<uint32_t> first_primitives;
+		gltf_data::data_view<gltf_bounds> primitives;
+		gltf_data::data_view<gltf_bounds> meshes;
+	};
+	// Returns false when a POSITION accessor has to be read and cannot be.
+	bool gltf_mesh_bounds_build(const gltf_data* gltf_data, VkAllocationCallbacks* host_allocator, gltf_mesh_bounds* out,
+		gltf_bounds_flags bounds_flags = gltf_bounds_default);
+	void gltf_mesh_bounds_free(gltf_mesh_bounds* mesh_bounds, VkAllocationCallbacks* host_allocator);
+	// World bounds of the mesh of every entry of transforms (entry_count of them in out), empty for entries without a mesh.
+	// Call again after gltf_scene_transforms_update.
+	void gltf_node_bounds_update(const gltf_data* gltf_data, const gltf_mesh_bounds* mesh_bounds, const gltf_scene_transforms* transforms, gltf_bounds* out,
+		gltf_bounds_flags bounds_flags = gltf_bounds_default);
+
+	// A bounding volume hierarchy over instance bounds, gltf_node_bounds_update entries for example, split with binned SAH.
+	struct gltf_bvh
+	{
+		// Inner nodes have a count of 0 and their children at first and first + 1, leaves have count items starting at items[first].
+		struct node
+		{
+			float min[3];
+			uint32_t first;
+			float max[3];
+			uint32_t count;
+		};
+		gltf_data::data_view<node> nodes;
+		// Indices in to the instance bounds, empty instances are left out.
+		gltf_data::data_view<uint32_t> items;
+		// The first nodes were split one after the other, the subtrees under them were built (and refit) on their own.
+		// Every subtree takes a contiguous range of nodes starting at subtree_offsets[ii], subtree_offsets ends with the node count.
+		uint32_t top_node_count;
+		gltf_data::data_view<uint32_t> subtree_offsets;
+	};
+	// Builds the hierarchy over count instances. Returns false when there are no instances with bounds.
+	bool gltf_bvh_build(const gltf_bounds* bounds, uint32_t count, VkAllocationCallbacks* host_allocator, gltf_bvh* out,
+		gltf_bounds_flags bounds_flags = gltf_bounds_default);
+	// Recomputes the node boxes from the moved instance bounds keeping the tree as it is. Rebuild once instances moved far, or once empty ones get bounds.
+	void gltf_bvh_refit(gltf_bvh* bvh, const gltf_bounds* bounds, gltf_bounds_flags bounds_flags = gltf_bounds_default);
+	void gltf_bvh_free(gltf_bvh* bvh, VkAllocationCallbacks* host_allocator);
+	// Writes the instances whose box is at least partly inside every plane (xyz normal and w, inside when dot(normal, p) + w >= 0) to out, which has to
+	// have room for every item of the hierarchy. Returns how many were written.
+	uint32_t gltf_bvh_cull(const gltf_bvh* bvh, const gltf_bounds* bounds, const float* planes, uint32_t plane_count, uint32_t* out);
+	// Writes the instances whose box the ray hits between 0 and max_distance to out, in no particular order. Returns how many were written.
+	uint32_t gltf_bvh_raycast(const gltf_bvh* bvh, const gltf_bounds* bounds, const float* origin, const float* direction, float max_distance, uint32_t* out);
 };
\ No newline at end of file
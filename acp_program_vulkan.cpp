@@ -873,6 +873,12 @@ acp_vulkan::program* acp_vulkan::graphics_program_init(VkDevice logical_device,
                             attribute_description.binding = vertex_input_attribute.binding;
                             attribute_description.offset = vertex_input_attribute.offsets[ii];
                             attribute_description.location = vertex_input_attribute.locations[ii];
+                            if (ii < vertex_input_attribute.formats.size())
+                            {
+                                attribute_description.format = vertex_input_attribute.formats[ii];
+                                attribute_descriptions.push_back(std::move(attribute_description));
+                                continue;
+                            }
                             switch (shader_usage_attribute.field_type)
                             {
                             //todo(alex) : Check that bools are actualy transfered as signed ints, this is what I remember.
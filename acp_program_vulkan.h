@@ -83,6 +83,8 @@ namespace acp_vulkan
         std::vector<uint32_t>	locations;
         uint32_t				stride;
         VkVertexInputRate		input_rate;
+        // One per location for packed or quantized vertex data, empty uses the 32 bit format of the shader input type.
+        std::vector<VkFormat>	formats;
     };
 
     typedef std::initializer_list<input_attribute_data> input_attributes;
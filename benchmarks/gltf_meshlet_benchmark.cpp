@@ -0,0 +1,144 @@
+// Meshlet build throughput of gltf_meshlet_buffers_build over 1 to 8 parsing threads and the hardware thread count.
+// Twelve UV spheres (2.4M triangles by default) are packed in to a GLB, built in to interleaved mesh buffers and optimized first.
+// Build: cl /std:c++20 /O2 /EHsc /I.. gltf_meshlet_benchmark.cpp ../acp_gltf_vulkan.cpp
+//        g++ -std=c++20 -O2 -fpermissive -I.. gltf_meshlet_benchmark.cpp ../acp_gltf_vulkan.cpp -lpthread
+// Usage: gltf_meshlet_benchmark [sphere segments] [iterations]
+#include "acp_gltf_vulkan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SPHERE_COUNT 12
+
+static double now_seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void append_bytes(std::vector<char>* out, const void* data, size_t size)
+{
+	out->insert(out->end(), reinterpret_cast<const char*>(data), reinterpret_cast<const char*>(data) + size);
+}
+
+// Positions and 32 bit indices of every sphere one after the other in the BIN chunk, a mesh per sphere.
+static std::vector<char> make_spheres_glb(uint32_t segments)
+{
+	std::vector<char> bin;
+	std::string views, accessors, meshes;
+	for (uint32_t ii = 0; ii < SPHERE_COUNT; ++ii)
+	{
+		uint32_t columns = segments + ii;
+		uint32_t rows = segments;
+		size_t positions_offset = bin.size();
+		for (uint32_t y = 0; y <= rows; ++y)
+			for (uint32_t x = 0; x <= columns; ++x)
+			{
+				float theta = 3.14159265f * float(y) / float(rows);
+				float phi = 6.28318531f * float(x) / float(columns);
+				float position[3] = { sinf(theta) * cosf(phi) + float(ii) * 3.0f, cosf(theta), sinf(theta) * sinf(phi) };
+				append_bytes(&bin, position, sizeof(position));
+			}
+		size_t indices_offset = bin.size();
+		for (uint32_t y = 0; y < rows; ++y)
+			for (uint32_t x = 0; x < columns; ++x)
+			{
+				uint32_t corner = y * (columns + 1) + x;
+				uint32_t quad[6] = { corner, corner + columns + 1, corner + 1, corner + 1, corner + columns + 1, corner + columns + 2 };
+				append_bytes(&bin, quad, sizeof(quad));
+			}
+
+		uint32_t vertex_count = (rows + 1) * (columns + 1);
+		uint32_t index_count = rows * columns * 6;
+		char entry[512];
+		snprintf(entry, sizeof(entry), "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}",
+			ii ? "," : "", positions_offset, indices_offset - positions_offset, indices_offset, bin.size() - indices_offset);
+		views += entry;
+		snprintf(entry, sizeof(entry), "%s{\"bufferView\":%u,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},{\"bufferView\":%u,\"componentType\":5125,\"count\":%u,\"type\":\"SCALAR\"}",
+			ii ? "," : "", ii * 2, vertex_count, ii * 2 + 1, index_count);
+		accessors += entry;
+		snprintf(entry, sizeof(entry), "%s{\"primitives\":[{\"attributes\":{\"POSITION\":%u},\"indices\":%u}]}", ii ? "," : "", ii * 2, ii * 2 + 1);
+		meshes += entry;
+	}
+
+	std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}],\"bufferViews\":[" + views +
+		"],\"accessors\":[" + accessors + "],\"meshes\":[" + meshes + "]}";
+	while (json.size() % 4)
+		json += ' ';
+
+	std::vector<char> glb;
+	uint32_t header[3] = { 0x46546C67, 2, uint32_t(12 + 8 + json.size() + 8 + bin.size()) };
+	uint32_t json_chunk[2] = { uint32_t(json.size()), 0x4E4F534A };
+	uint32_t bin_chunk[2] = { uint32_t(bin.size()), 0x004E4942 };
+	append_bytes(&glb, header, sizeof(header));
+	append_bytes(&glb, json_chunk, sizeof(json_chunk));
+	append_bytes(&glb, json.data(), json.size());
+	append_bytes(&glb, bin_chunk, sizeof(bin_chunk));
+	append_bytes(&glb, bin.data(), bin.size());
+	return glb;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t segments = argc > 1 ? uint32_t(atoi(argv[1])) : 320;
+	int iterations = argc > 2 ? atoi(argv[2]) : 3;
+
+	std::vector<char> glb = make_spheres_glb(segments);
+	acp_vulkan::gltf_data gltf_data = acp_vulkan::binary_gltf_data_from_memory(glb.data(), glb.size(), nullptr);
+	if (gltf_data.gltf_state != acp_vulkan::gltf_data::valid)
+	{
+		printf("parsing failed with state %d\n", int(gltf_data.gltf_state));
+		return 1;
+	}
+
+	acp_vulkan::gltf_vertex_attribute attributes[] = { { acp_vulkan::gltf_data::attribute::POSITION, VK_FORMAT_R32G32B32_SFLOAT } };
+	acp_vulkan::gltf_mesh_buffers mesh_buffers;
+	if (!acp_vulkan::gltf_mesh_buffers_build(&gltf_data, attributes, 1, nullptr, &mesh_buffers))
+	{
+		printf("gltf_mesh_buffers_build failed\n");
+		return 1;
+	}
+	acp_vulkan::gltf_mesh_buffers_optimize(&mesh_buffers, nullptr);
+
+	uint32_t hardware_threads = std::thread::hardware_concurrency();
+	printf("%u ranges, %zu triangles, best of %d, %u hardware threads\n", uint32_t(mesh_buffers.draw_ranges.data_length),
+		mesh_buffers.indices.data_length / 3, iterations, hardware_threads);
+
+	uint32_t thread_counts[] = { 1, 2, 4, 8, hardware_threads };
+	for (uint32_t ii = 0; ii < sizeof(thread_counts) / sizeof(thread_counts[0]); ++ii)
+	{
+		if (ii == 4 && hardware_threads <= 8)
+			break;
+		acp_vulkan::gltf_set_parsing_threads(thread_counts[ii], nullptr);
+
+		double best = 1e9;
+		size_t meshlet_count = 0;
+		size_t triangle_count = 0;
+		for (int jj = 0; jj < iterations; ++jj)
+		{
+			acp_vulkan::gltf_meshlet_buffers meshlet_buffers;
+			double start = now_seconds();
+			bool built = acp_vulkan::gltf_meshlet_buffers_build(&mesh_buffers, nullptr, &meshlet_buffers, acp_vulkan::gltf_mesh_parallel_decode);
+			double elapsed = now_seconds() - start;
+			if (!built)
+			{
+				printf("gltf_meshlet_buffers_build failed\n");
+				return 1;
+			}
+			best = elapsed < best ? elapsed : best;
+			meshlet_count = meshlet_buffers.meshlets.data_length;
+			triangle_count = meshlet_buffers.triangles.data_length;
+			acp_vulkan::gltf_meshlet_buffers_free(&meshlet_buffers, nullptr);
+		}
+		printf("  %2u threads: %7.2f ms %7.1f M triangles/s, %zu meshlets, %.1f triangles per meshlet\n", thread_counts[ii], best * 1e3,
+			double(triangle_count) / best / 1e6, meshlet_count, double(triangle_count) / double(meshlet_count));
+	}
+
+	acp_vulkan::gltf_mesh_buffers_free(&mesh_buffers, nullptr);
+	acp_vulkan::gltf_data_free(&gltf_data, nullptr);
+	return 0;
+}
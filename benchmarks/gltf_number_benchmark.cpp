@@ -0,0 +1,130 @@
+// Number parsing throughput of gltf_data_from_memory: ten nodes with 1M element weights arrays, 10M numbers in total.
+// The same numbers are also read with strtoll/strtod for reference.
+// Build: cl /std:c++20 /O2 /EHsc /I.. gltf_number_benchmark.cpp ../acp_gltf_vulkan.cpp
+//        g++ -std=c++20 -O2 -fpermissive -I.. gltf_number_benchmark.cpp ../acp_gltf_vulkan.cpp -lpthread
+// Usage: gltf_number_benchmark [iterations]
+#include "acp_gltf_vulkan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <string>
+
+#define NODE_COUNT 10
+#define WEIGHTS_PER_NODE 1000000
+
+static double now_seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A fixed xorshift so every run parses the same text.
+static uint64_t next_random(uint64_t* state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+// Fixed point, 16 digit and exponent reals and integers, the shapes exporters write.
+static std::string make_numbers_gltf()
+{
+	std::string out = "{\"asset\":{\"version\":\"2.0\"},\"nodes\":[";
+	out.reserve(size_t(NODE_COUNT) * WEIGHTS_PER_NODE * 13);
+	uint64_t random = 0x9E3779B97F4A7C15ull;
+	char number[64];
+	for (uint32_t ii = 0; ii < NODE_COUNT; ++ii)
+	{
+		out += ii ? ",{\"weights\":[" : "{\"weights\":[";
+		for (uint32_t jj = 0; jj < WEIGHTS_PER_NODE; ++jj)
+		{
+			uint64_t bits = next_random(&random);
+			double unit = double(bits >> 11) / double(uint64_t(1) << 53);
+			bool negative = bits & 1;
+			switch (jj % 4)
+			{
+			case 0: snprintf(number, sizeof(number), "%.6f", (negative ? -1000.0 : 1000.0) * unit); break;
+			case 1: snprintf(number, sizeof(number), "%.16g", unit); break;
+			case 2: snprintf(number, sizeof(number), "%lld", (negative ? -1 : 1) * (long long)(bits % 100000)); break;
+			default: snprintf(number, sizeof(number), "%e", (negative ? -1.0 : 1.0) * unit); break;
+			}
+			if (jj)
+				out += ',';
+			out += number;
+		}
+		out += "]}";
+	}
+	out += "]}";
+	return out;
+}
+
+// Reads every number between the brackets of the weights arrays, integers with strtoll and the rest with strtod.
+static double parse_with_strtod(const std::string& text)
+{
+	double sum = 0.0;
+	const char* current = text.c_str();
+	while ((current = strstr(current, "\"weights\":[")))
+	{
+		current += strlen("\"weights\":[");
+		while (*current && *current != ']')
+		{
+			char* end = nullptr;
+			errno = 0;
+			long long as_int = strtoll(current, &end, 10);
+			if (errno || *end == '.' || *end == 'e' || *end == 'E')
+				sum += strtod(current, &end);
+			else
+				sum += double(as_int);
+			current = *end == ',' ? end + 1 : end;
+		}
+	}
+	return sum;
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 5;
+	std::string text = make_numbers_gltf();
+	double megabytes = double(text.size()) / (1024.0 * 1024.0);
+	double numbers = double(NODE_COUNT) * WEIGHTS_PER_NODE;
+
+	double best_reference = 1e9;
+	double reference_sum = 0.0;
+	for (int ii = 0; ii < iterations; ++ii)
+	{
+		double start = now_seconds();
+		reference_sum = parse_with_strtod(text);
+		double elapsed = now_seconds() - start;
+		best_reference = elapsed < best_reference ? elapsed : best_reference;
+	}
+
+	double best_parse = 1e9;
+	double parsed_sum = 0.0;
+	for (int ii = 0; ii < iterations; ++ii)
+	{
+		double start = now_seconds();
+		acp_vulkan::gltf_data gltf_data = acp_vulkan::gltf_data_from_memory(text.data(), text.size(), nullptr);
+		double elapsed = now_seconds() - start;
+		best_parse = elapsed < best_parse ? elapsed : best_parse;
+		if (gltf_data.gltf_state != acp_vulkan::gltf_data::valid)
+		{
+			printf("parsing failed with state %d at %zu\n", int(gltf_data.gltf_state), gltf_data.parsing_error_location);
+			return 1;
+		}
+
+		parsed_sum = 0.0;
+		for (size_t jj = 0; jj < gltf_data.nodes.data_length; ++jj)
+			for (size_t kk = 0; kk < gltf_data.nodes.data[jj].weights.data_length; ++kk)
+				parsed_sum += gltf_data.nodes.data[jj].weights.data[kk];
+		acp_vulkan::gltf_data_free(&gltf_data, nullptr);
+	}
+
+	printf("%.0fM numbers, %.1f MB, best of %d\n", numbers / 1e6, megabytes, iterations);
+	printf("  strtoll/strtod:        %7.1f MB/s %7.1f M numbers/s\n", megabytes / best_reference, numbers / best_reference / 1e6);
+	printf("  gltf_data_from_memory: %7.1f MB/s %7.1f M numbers/s\n", megabytes / best_parse, numbers / best_parse / 1e6);
+	// Weights are stored as floats, the sums only agree to float precision.
+	printf("  sums %.6g / %.6g\n", reference_sum, parsed_sum);
+	return 0;
+}